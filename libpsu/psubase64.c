@@ -11,6 +11,7 @@
 
 #include <sys/types.h>
 #include <stdint.h>
+#include <ctype.h>
 
 #include <libpsu/psucommon.h>
 #include <libpsu/psualloc.h>
@@ -29,6 +30,20 @@ static char encoder[] = {
 
 static char decoder[256];	/* Filled in on-demand */
 
+/*
+ * If the decoder isn't initialized, fill it with reverse mappings
+ */
+static void
+psu_base64_decoder_init (void)
+{
+    int i;
+
+    if (decoder['A'] == 0) {
+	for (i = 0; i < 0x40; i++)
+	    decoder[(uint) encoder[i]] = i;
+    }
+}
+
 /**
  * Encode data using base64 encoding.  Allocates a buffer and returns
  * it, after filling it with the base64-encoded data.  The returned
@@ -45,7 +60,7 @@ psu_base64_encode (const char *buf, size_t blen, size_t *olenp)
 {
     int olen = (size_t) ((blen  + 2) / 3) * 4;
     char *data = psu_realloc(NULL, olen + 1);
-    const char *cp, *ep;
+    const unsigned char *cp, *ep;
     char *out;
     uint32_t bits;
 
@@ -53,8 +68,8 @@ psu_base64_encode (const char *buf, size_t blen, size_t *olenp)
 	return NULL;
 
     out = data;
-    cp = buf;
-    ep = buf + blen;
+    cp = (const unsigned char *) buf;
+    ep = cp + blen;
     while (cp < ep) {
 	bits = *cp++ << 16;
 	bits += cp < ep ? *cp++ << 8 : 0;
@@ -93,7 +108,6 @@ psu_base64_decode (const char *buf, size_t blen, size_t *olenp)
 {
     const char *cp, *ep;
     uint32_t bits;
-    int i;
     char *out, *data, *stop;
 
     if (blen % 4 != 0) {
@@ -104,11 +118,7 @@ psu_base64_decode (const char *buf, size_t blen, size_t *olenp)
 	    return NULL;
     }
 
-    /* If the decoder isn't initialized, fill it with reverse mappings */
-    if (decoder['A'] == 0) {
-	for (i = 0, cp = decoder; i < 0x40; i++)
-	    decoder[(uint) encoder[i]] = i;
-    }
+    psu_base64_decoder_init();
 
     int olen = (blen / 4) * 3;
 
@@ -157,3 +167,183 @@ psu_base64_decode (const char *buf, size_t blen, size_t *olenp)
 
     return data;
 }
+
+/**
+ * Decode a chunk of base64 data into a caller-supplied buffer.  Any
+ * trailing partial quantum is held in the state until the next call.
+ * The output buffer must have room for PSU_BASE64_DECODE_MAX(blen)
+ * bytes.
+ *
+ * @param[in,out] statep Decoder state
+ * @param[in] buf Input buffer
+ * @param[in] blen Number of bytes in the input buffer
+ * @param[out] out Output buffer
+ * @return Number of bytes written to the output buffer
+ */
+size_t
+psu_base64_decode_chunk (psu_base64_state_t *statep,
+			 const char *buf, size_t blen, char *out)
+{
+    const unsigned char *cp = (const unsigned char *) buf;
+    const unsigned char *ep = cp + blen;
+    uint32_t bits = statep->pbs_bits;
+    unsigned count = statep->pbs_count;
+    char *start = out;
+
+    if (statep->pbs_error)
+	return 0;
+
+    psu_base64_decoder_init();
+
+    for ( ; cp < ep; cp++) {
+	if (*cp == '\n' || *cp == '\r' || *cp == ' ' || *cp == '\t')
+	    continue;
+
+	if (*cp == '=') {
+	    statep->pbs_done = TRUE;
+	    continue;
+	}
+
+	/* Only padding can follow padding */
+	if (statep->pbs_done
+		|| !(isalnum(*cp) || *cp == '+' || *cp == '/')) {
+	    statep->pbs_error = TRUE;
+	    break;
+	}
+
+	bits = (bits << 6) | decoder[*cp];
+	if (++count == 4) {
+	    *out++ = (bits >> 16) & 0xFF;
+	    *out++ = (bits >> 8) & 0xFF;
+	    *out++ = bits & 0xFF;
+	    bits = count = 0;
+	}
+    }
+
+    statep->pbs_bits = bits;
+    statep->pbs_count = count;
+
+    return out - start;
+}
+
+/**
+ * Flush any partial quantum held in the decoder state.  At most two
+ * bytes are written to the output buffer.  pbs_error is left set if
+ * the input was invalid.
+ *
+ * @param[in,out] statep Decoder state
+ * @param[out] out Output buffer
+ * @return Number of bytes written to the output buffer
+ */
+size_t
+psu_base64_decode_finish (psu_base64_state_t *statep, char *out)
+{
+    uint32_t bits = statep->pbs_bits;
+    size_t len = 0;
+
+    if (statep->pbs_error)
+	return 0;
+
+    /* A single trailing sextet carries no complete byte */
+    if (statep->pbs_count == 1) {
+	statep->pbs_error = TRUE;
+	return 0;
+    } else if (statep->pbs_count == 2) {
+	out[len++] = (bits >> 4) & 0xFF;
+    } else if (statep->pbs_count == 3) {
+	out[len++] = (bits >> 10) & 0xFF;
+	out[len++] = (bits >> 2) & 0xFF;
+    }
+
+    statep->pbs_bits = statep->pbs_count = statep->pbs_done = 0;
+    return len;
+}
+
+/**
+ * Encode a chunk of data into a caller-supplied buffer.  Up to two
+ * trailing bytes are held in the state until the next call, so the
+ * output is identical to encoding all the chunks at once.  The
+ * output buffer must have room for PSU_BASE64_ENCODE_MAX(blen) bytes.
+ *
+ * @param[in,out] statep Encoder state
+ * @param[in] buf Input buffer
+ * @param[in] blen Number of bytes in the input buffer
+ * @param[out] out Output buffer
+ * @return Number of bytes written to the output buffer
+ */
+size_t
+psu_base64_encode_chunk (psu_base64_state_t *statep,
+			 const char *buf, size_t blen, char *out)
+{
+    const unsigned char *cp = (const unsigned char *) buf;
+    const unsigned char *ep = cp + blen;
+    uint32_t bits = statep->pbs_bits;
+    unsigned count = statep->pbs_count;
+    char *start = out;
+
+    /* Finish any partial quantum from the last chunk */
+    while (count > 0 && count < 3 && cp < ep) {
+	bits = (bits << 8) | *cp++;
+	count += 1;
+    }
+
+    if (count == 3) {
+	*out++ = encoder[(bits >> 3 * 6) & 0x3F];
+	*out++ = encoder[(bits >> 2 * 6) & 0x3F];
+	*out++ = encoder[(bits >> 1 * 6) & 0x3F];
+	*out++ = encoder[(bits >> 0 * 6) & 0x3F];
+	bits = count = 0;
+    }
+
+    /* The main loop works on complete quanta */
+    for ( ; ep - cp >= 3; cp += 3) {
+	bits = (cp[0] << 16) | (cp[1] << 8) | cp[2];
+	*out++ = encoder[(bits >> 3 * 6) & 0x3F];
+	*out++ = encoder[(bits >> 2 * 6) & 0x3F];
+	*out++ = encoder[(bits >> 1 * 6) & 0x3F];
+	*out++ = encoder[(bits >> 0 * 6) & 0x3F];
+    }
+
+    /* Hold on to any leftovers */
+    for (bits = (count ? bits : 0); cp < ep; cp++) {
+	bits = (bits << 8) | *cp;
+	count += 1;
+    }
+
+    statep->pbs_bits = bits;
+    statep->pbs_count = count;
+
+    return out - start;
+}
+
+/**
+ * Flush any bytes held in the encoder state, with padding.  At most
+ * four bytes are written to the output buffer.
+ *
+ * @param[in,out] statep Encoder state
+ * @param[out] out Output buffer
+ * @return Number of bytes written to the output buffer
+ */
+size_t
+psu_base64_encode_finish (psu_base64_state_t *statep, char *out)
+{
+    uint32_t bits = statep->pbs_bits;
+    size_t len = 0;
+
+    if (statep->pbs_count == 1) {
+	bits <<= 16;
+	out[len++] = encoder[(bits >> 3 * 6) & 0x3F];
+	out[len++] = encoder[(bits >> 2 * 6) & 0x3F];
+	out[len++] = '=';
+	out[len++] = '=';
+    } else if (statep->pbs_count == 2) {
+	bits <<= 8;
+	out[len++] = encoder[(bits >> 3 * 6) & 0x3F];
+	out[len++] = encoder[(bits >> 2 * 6) & 0x3F];
+	out[len++] = encoder[(bits >> 1 * 6) & 0x3F];
+	out[len++] = '=';
+    }
+
+    statep->pbs_bits = statep->pbs_count = statep->pbs_done = 0;
+    return len;
+}
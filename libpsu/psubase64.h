@@ -13,6 +13,7 @@
 #define LIBPSU_PSUBASE64_H
 
 #include <string.h>
+#include <stdint.h>
 
 /**
  * Encode data using base64 encoding.  Allocates a buffer and returns
@@ -42,4 +43,95 @@ psu_base64_encode (const char *buf, size_t blen, size_t *olenp);
 char *
 psu_base64_decode (const char *buf, size_t blen, size_t *olenp);
 
+/**
+ * State for incremental base64 decoding, allowing input to be
+ * handed over in arbitrarily sized chunks.  Whitespace is ignored
+ * and padding ("=") marks the end of the encoded data.  Characters
+ * outside the base64 alphabet, data after padding, or a truncated
+ * quantum set pbs_error, after which no more data is decoded; the
+ * caller should check it after psu_base64_decode_finish().
+ */
+typedef struct psu_base64_state_s {
+    uint32_t pbs_bits;		/* Bits accumulated from partial quantum */
+    unsigned pbs_count;		/* Number of sextets in pbs_bits */
+    unsigned pbs_done;		/* Seen padding; only padding may follow */
+    unsigned pbs_error;		/* Seen invalid input; stop decoding */
+} psu_base64_state_t;
+
+/**
+ * Initialize an incremental base64 decoder state
+ *
+ * @param[out] statep Decoder state
+ */
+static inline void
+psu_base64_state_init (psu_base64_state_t *statep)
+{
+    memset(statep, 0, sizeof(*statep));
+}
+
+/**
+ * Decode a chunk of base64 data into a caller-supplied buffer.  Any
+ * trailing partial quantum is held in the state until the next call.
+ * The output buffer must have room for PSU_BASE64_DECODE_MAX(blen)
+ * bytes.
+ *
+ * @param[in,out] statep Decoder state
+ * @param[in] buf Input buffer
+ * @param[in] blen Number of bytes in the input buffer
+ * @param[out] out Output buffer
+ * @return Number of bytes written to the output buffer
+ */
+size_t
+psu_base64_decode_chunk (psu_base64_state_t *statep,
+			 const char *buf, size_t blen, char *out);
+
+/**
+ * Flush any partial quantum held in the decoder state.  At most two
+ * bytes are written to the output buffer.  pbs_error is left set if
+ * the input was invalid.
+ *
+ * @param[in,out] statep Decoder state
+ * @param[out] out Output buffer
+ * @return Number of bytes written to the output buffer
+ */
+size_t
+psu_base64_decode_finish (psu_base64_state_t *statep, char *out);
+
+/* Maximum number of bytes decoded from a chunk of "len" bytes */
+#define PSU_BASE64_DECODE_MAX(len) ((((len) / 4) + 1) * 3)
+
+/**
+ * Encode a chunk of data into a caller-supplied buffer.  Up to two
+ * trailing bytes are held in the state until the next call, so the
+ * output is identical to encoding all the chunks at once.  The
+ * output buffer must have room for PSU_BASE64_ENCODE_MAX(blen) bytes.
+ * The state is initialized with psu_base64_state_init().
+ *
+ * @param[in,out] statep Encoder state
+ * @param[in] buf Input buffer
+ * @param[in] blen Number of bytes in the input buffer
+ * @param[out] out Output buffer
+ * @return Number of bytes written to the output buffer
+ */
+size_t
+psu_base64_encode_chunk (psu_base64_state_t *statep,
+			 const char *buf, size_t blen, char *out);
+
+/**
+ * Flush any bytes held in the encoder state, with padding.  At most
+ * four bytes are written to the output buffer.
+ *
+ * @param[in,out] statep Encoder state
+ * @param[out] out Output buffer
+ * @return Number of bytes written to the output buffer
+ */
+size_t
+psu_base64_encode_finish (psu_base64_state_t *statep, char *out);
+
+/* Maximum number of bytes encoded from a chunk of "len" bytes */
+#define PSU_BASE64_ENCODE_MAX(len) ((((len) / 3) + 1) * 4)
+
+/* Number of bytes needed to encode "len" bytes in total */
+#define PSU_BASE64_ENCODE_LEN(len) ((((len) + 2) / 3) * 4)
+
 #endif /* LIBPSU_PSUBASE64_H */
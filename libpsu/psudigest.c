@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Incremental message digest functions
+ */
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <strings.h>
+
+#include <libpsu/psucommon.h>
+#include <libpsu/psudigest.h>
+
+#define FNV1A64_BASIS	0xcbf29ce484222325ULL
+#define FNV1A64_PRIME	0x100000001b3ULL
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t sha256_init[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+#define ROTR(_x, _n) (((_x) >> (_n)) | ((_x) << (32 - (_n))))
+
+static void
+psu_sha256_block (uint32_t *state, const uint8_t *block)
+{
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, h, t1, t2;
+    int i;
+
+    for (i = 0; i < 16; i++, block += 4)
+	w[i] = ((uint32_t) block[0] << 24) | ((uint32_t) block[1] << 16)
+	    | ((uint32_t) block[2] << 8) | block[3];
+
+    for ( ; i < 64; i++) {
+	uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18)
+	    ^ (w[i - 15] >> 3);
+	uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19)
+	    ^ (w[i - 2] >> 10);
+	w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    a = state[0]; b = state[1]; c = state[2]; d = state[3];
+    e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+    for (i = 0; i < 64; i++) {
+	t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25))
+	    + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+	t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22))
+	    + ((a & b) ^ (a & c) ^ (b & c));
+	h = g; g = f; f = e; e = d + t1;
+	d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+unsigned
+psu_digest_lookup (const char *name)
+{
+    if (name == NULL || *name == '\0')
+	return PSU_DIGEST_SHA256;
+
+    if (strcasecmp(name, "sha256") == 0 || strcasecmp(name, "sha-256") == 0)
+	return PSU_DIGEST_SHA256;
+
+    if (strcasecmp(name, "fnv1a64") == 0 || strcasecmp(name, "fnv1a") == 0)
+	return PSU_DIGEST_FNV1A64;
+
+    return 0;
+}
+
+void
+psu_digest_init (psu_digest_t *pdp, unsigned algo)
+{
+    memset(pdp, 0, sizeof(*pdp));
+    pdp->pd_algo = algo;
+
+    if (algo == PSU_DIGEST_FNV1A64)
+	pdp->pd_u.pd_fnv1a64 = FNV1A64_BASIS;
+    else
+	memcpy(pdp->pd_u.pd_sha256.ps_state, sha256_init,
+	       sizeof(sha256_init));
+}
+
+void
+psu_digest_update (psu_digest_t *pdp, const void *buf, size_t blen)
+{
+    const uint8_t *cp = buf;
+
+    if (pdp->pd_algo == PSU_DIGEST_FNV1A64) {
+	uint64_t hash = pdp->pd_u.pd_fnv1a64;
+	const uint8_t *ep = cp + blen;
+
+	for ( ; cp < ep; cp++)
+	    hash = (hash ^ *cp) * FNV1A64_PRIME;
+
+	pdp->pd_u.pd_fnv1a64 = hash;
+	pdp->pd_bytes += blen;
+	return;
+    }
+
+    size_t used = pdp->pd_bytes % 64;
+    pdp->pd_bytes += blen;
+
+    /* Fill out a partial block first */
+    if (used) {
+	size_t len = 64 - used;
+	if (len > blen)
+	    len = blen;
+
+	memcpy(pdp->pd_u.pd_sha256.ps_block + used, cp, len);
+	cp += len;
+	blen -= len;
+	if (used + len < 64)
+	    return;
+
+	psu_sha256_block(pdp->pd_u.pd_sha256.ps_state,
+			 pdp->pd_u.pd_sha256.ps_block);
+    }
+
+    for ( ; blen >= 64; cp += 64, blen -= 64)
+	psu_sha256_block(pdp->pd_u.pd_sha256.ps_state, cp);
+
+    if (blen)
+	memcpy(pdp->pd_u.pd_sha256.ps_block, cp, blen);
+}
+
+size_t
+psu_digest_final (psu_digest_t *pdp, uint8_t *out)
+{
+    int i;
+
+    if (pdp->pd_algo == PSU_DIGEST_FNV1A64) {
+	uint64_t hash = pdp->pd_u.pd_fnv1a64;
+
+	for (i = 0; i < 8; i++)
+	    out[i] = hash >> (56 - i * 8);
+	return 8;
+    }
+
+    uint8_t pad[72];
+    uint64_t bits = pdp->pd_bytes * 8;
+    size_t used = pdp->pd_bytes % 64;
+    size_t plen = (used < 56) ? 56 - used : 120 - used;
+
+    /* Padding is a one bit, zeros, then the length in bits */
+    memset(pad, 0, sizeof(pad));
+    pad[0] = 0x80;
+    for (i = 0; i < 8; i++)
+	pad[plen + i] = bits >> (56 - i * 8);
+
+    psu_digest_update(pdp, pad, plen + 8);
+
+    for (i = 0; i < 8; i++) {
+	uint32_t val = pdp->pd_u.pd_sha256.ps_state[i];
+	out[i * 4] = val >> 24;
+	out[i * 4 + 1] = val >> 16;
+	out[i * 4 + 2] = val >> 8;
+	out[i * 4 + 3] = val;
+    }
+
+    return 32;
+}
+
+char *
+psu_digest_final_hex (psu_digest_t *pdp, char *out)
+{
+    static const char hex[] = "0123456789abcdef";
+    uint8_t digest[PSU_DIGEST_MAX];
+    size_t i, len;
+
+    len = psu_digest_final(pdp, digest);
+    for (i = 0; i < len; i++) {
+	out[i * 2] = hex[digest[i] >> 4];
+	out[i * 2 + 1] = hex[digest[i] & 0xf];
+    }
+    out[len * 2] = '\0';
+
+    return out;
+}
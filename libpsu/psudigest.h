@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Incremental message digest functions
+ */
+
+#ifndef LIBPSU_PSUDIGEST_H
+#define LIBPSU_PSUDIGEST_H
+
+#include <string.h>
+#include <stdint.h>
+
+#define PSU_DIGEST_SHA256	1 /* SHA-256 (FIPS 180-4) */
+#define PSU_DIGEST_FNV1A64	2 /* 64-bit FNV-1a (fast, not secure) */
+
+#define PSU_DIGEST_MAX		32 /* Largest digest, in bytes */
+#define PSU_DIGEST_HEX_MAX	(PSU_DIGEST_MAX * 2 + 1) /* With NUL */
+
+/**
+ * State for an incremental digest.  Data can be handed over in
+ * arbitrarily sized chunks; the state is fixed in size, so memory
+ * use is constant regardless of the amount of data.
+ */
+typedef struct psu_digest_s {
+    unsigned pd_algo;		/* PSU_DIGEST_* */
+    uint64_t pd_bytes;		/* Total bytes seen */
+    union {
+	struct {
+	    uint32_t ps_state[8]; /* Hash state */
+	    uint8_t ps_block[64]; /* Partial block */
+	} pd_sha256;
+	uint64_t pd_fnv1a64;	/* Hash state */
+    } pd_u;
+} psu_digest_t;
+
+/**
+ * Find the digest algorithm with the given name ("sha256" or
+ * "fnv1a64").  A NULL or empty name gives the default (SHA-256).
+ *
+ * @param[in] name Name of the algorithm
+ * @return PSU_DIGEST_* value, or zero if the name is not known
+ */
+unsigned
+psu_digest_lookup (const char *name);
+
+/**
+ * Initialize a digest state
+ *
+ * @param[out] pdp Digest state
+ * @param[in] algo Algorithm (PSU_DIGEST_*)
+ */
+void
+psu_digest_init (psu_digest_t *pdp, unsigned algo);
+
+/**
+ * Add data to the digest
+ *
+ * @param[in,out] pdp Digest state
+ * @param[in] buf Input buffer
+ * @param[in] blen Number of bytes in the input buffer
+ */
+void
+psu_digest_update (psu_digest_t *pdp, const void *buf, size_t blen);
+
+/**
+ * Finish the digest, writing it to the output buffer, which must
+ * have room for PSU_DIGEST_MAX bytes.  The state must be initialized
+ * again before it can be reused.
+ *
+ * @param[in,out] pdp Digest state
+ * @param[out] out Output buffer
+ * @return Number of bytes written to the output buffer
+ */
+size_t
+psu_digest_final (psu_digest_t *pdp, uint8_t *out);
+
+/**
+ * Finish the digest, writing it as a NUL-terminated lowercase hex
+ * string to the output buffer, which must have room for
+ * PSU_DIGEST_HEX_MAX bytes.
+ *
+ * @param[in,out] pdp Digest state
+ * @param[out] out Output buffer
+ * @return Output buffer
+ */
+char *
+psu_digest_final_hex (psu_digest_t *pdp, char *out);
+
+#endif /* LIBPSU_PSUDIGEST_H */
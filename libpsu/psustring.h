@@ -89,6 +89,34 @@ strnstr (char *s1,  const char *s2, size_t n)
 }
 #endif /* HAVE_STRNSTR */
 
+#ifndef HAVE_MEMMEM
+/*
+ * memmem, for those that don't have it
+ */
+static inline void *
+memmem (const void *big, size_t big_len, const void *little, size_t little_len)
+{
+    const char *cp = big, *ep, *np;
+
+    if (little_len == 0)      /* Empty string means immediate match */
+	return (void *) big;
+
+    if (big_len < little_len)
+	return NULL;
+
+    ep = cp + big_len - little_len + 1;
+    for ( ; cp < ep; cp = np + 1) {
+	np = memchr(cp, *(const char *) little, ep - cp);
+	if (np == NULL)
+	    return NULL;
+	if (memcmp(np, little, little_len) == 0)
+	    return (void *) np;
+    }
+
+    return NULL;
+}
+#endif /* HAVE_MEMMEM */
+
 #ifndef HAVE_STRLCPY
 /*
  * strlcpy, for those that don't have it
@@ -137,12 +137,43 @@ slaxProgressEnable (slaxProgressCallback_t func, void *data);
 int
 slaxEmitProgressMessages (int);
 
+/* ----------------------------------------------------------------------
+ * Syslog output
+ */
+
+/**
+ * Send slax:syslog messages directly to a syslog socket, buffering
+ * them until a size or age threshold is reached
+ *
+ * @path socket path (NULL for the system default)
+ * @ident tag for each message (NULL for "slax")
+ * @max_bytes flush when this many bytes are buffered (0 to not buffer)
+ * @max_msecs flush when the oldest message is this old (0 for no limit)
+ * @returns 0 on success, -1 if the socket cannot be reached
+ */
+int
+slaxSyslogOpen (const char *path, const char *ident,
+		size_t max_bytes, unsigned max_msecs);
+
+/**
+ * Send any buffered syslog messages (e.g. at the end of a transform)
+ */
+void
+slaxSyslogFlush (void);
+
+/**
+ * Flush buffered syslog messages and revert to syslog(3)
+ */
+void
+slaxSyslogClose (void);
+
 /* ---------------------------------------------------------------------- */
 
 /* Flags for slaxInputCallback_t */
 #define SIF_HISTORY	(1<<0)	/* Add input line to history */
 #define SIF_SECRET	(1<<1)	/* Secret/password text (do not echo) */
 #define SIF_NO_TTY	(1<<2)	/* Avoid the real terminal tty (use stdin) */
+#define SIF_UNBUFFERED	(1<<3)	/* Flush output after every message */
 
 /*
  * IO hooks
@@ -161,6 +192,39 @@ slaxIoRegister (slaxInputCallback_t input_callback,
 
 void slaxIoUseStdio (unsigned flags);	/* Use the stock std{in,out} */
 void slaxTraceToFile (FILE *fp);
+void slaxIoFlush (void);		/* Flush buffered output and trace */
+
+/*
+ * Memory statistics, from counting wrappers around xmlMalloc() and
+ * friends.  Call slaxMemStatsEnable() before xmlInitParser().
+ */
+typedef struct slax_mem_stats_s {
+    unsigned long sms_allocs;	/* Calls to malloc/strdup */
+    unsigned long sms_reallocs;	/* Calls to realloc */
+    unsigned long sms_frees;	/* Calls to free */
+    unsigned long sms_bytes;	/* Total bytes requested */
+    unsigned long sms_max_rss;	/* Peak resident set size (KB) */
+} slax_mem_stats_t;
+
+int slaxMemStatsEnable (void);
+void slaxMemStatsGet (slax_mem_stats_t *smsp);
+
+/*
+ * Call timeline: enter/exit events for templates, functions, and
+ * extension functions, in Chrome trace-event format.  Call
+ * slaxTimelineOpen() before slaxEnable() and slaxTimelineClose()
+ * after the transform.
+ */
+int slaxTimelineOpen (const char *filename);
+void slaxTimelineClose (void);
+
+/*
+ * Batch input: answer prompts from a table rather than the tty
+ */
+int slaxIoBatchAdd (const char *line);	/* "prompt=answer" or "answer" */
+int slaxIoBatchLoad (const char *filename); /* One answer per line */
+void slaxIoUseBatch (void);		/* Use the table for all input */
+void slaxIoBatchClean (void);		/* Release the table */
 
 /**
  * Use the input callback to get data
@@ -176,13 +176,22 @@ typedef struct slaxDebugRestartItem_s {
 TAILQ_HEAD(slaxDebugRestartList_s, slaxDebugRestartItem_s) slaxDebugRestartList;
 
 /*
- * Double linked list to hold the breakpoints
+ * Double linked list to hold the breakpoints.  Watchpoints live here
+ * too (sharing the numbering), but have a dbp_watch name instead of
+ * an instruction.
  */
 typedef struct slaxDebugBreakpoint_s {
     TAILQ_ENTRY(slaxDebugBreakpoint_s) dbp_link;
     char *dbp_where;		/* Text name as given by user */
     xmlNodePtr dbp_inst;	/* Node we are breaking on */
     uint dbp_num;		/* Breakpoint number */
+    char *dbp_cond;		/* Condition ("break loc if cond") */
+    xmlXPathCompExprPtr dbp_comp; /* Compiled form of dbp_cond */
+    int dbp_disabled;		/* dbp_cond failed to compile on reload */
+    char *dbp_watch;		/* Name of watched variable (sans '$') */
+    char *dbp_watch_uri;	/* Namespace of watched variable */
+    char *dbp_value;		/* Last seen value of watched variable */
+    xmlXPathObjectPtr dbp_last;	/* Same, for cheap comparisons */
 } slaxDebugBreakpoint_t;
 
 TAILQ_HEAD(slaxDebugBpList_s, slaxDebugBreakpoint_s) slaxDebugBreakpoints;
@@ -445,6 +454,21 @@ slaxDebugOutputXpath (xmlXPathObjectPtr xpath, const char *tag, int full)
     }
 }
  
+static void
+slaxDebugFreeBreakpoint (slaxDebugBreakpoint_t *dbp)
+{
+    xmlFreeAndEasy(dbp->dbp_where);
+    xmlFreeAndEasy(dbp->dbp_cond);
+    if (dbp->dbp_comp)
+	xmlXPathFreeCompExpr(dbp->dbp_comp);
+    xmlFreeAndEasy(dbp->dbp_watch);
+    xmlFreeAndEasy(dbp->dbp_watch_uri);
+    xmlFreeAndEasy(dbp->dbp_value);
+    if (dbp->dbp_last)
+	xmlXPathFreeObject(dbp->dbp_last);
+    xmlFree(dbp);
+}
+
 /*
  * Clear all breakpoints
  */
@@ -457,8 +481,8 @@ slaxDebugClearBreakpoints (void)
 	dbp = TAILQ_FIRST(&slaxDebugBreakpoints);
 	if (dbp == NULL)
 	    break;
-	xmlFreeAndEasy(dbp->dbp_where);
 	TAILQ_REMOVE(&slaxDebugBreakpoints, dbp, dbp_link);
+	slaxDebugFreeBreakpoint(dbp);
     }
 
     slaxDebugBreakpointNumber = 0;
@@ -678,6 +702,40 @@ slaxDebugSplitArgs (char *buf, const char **args, int maxargs)
     return i;
 }
 
+/*
+ * Evaluate a breakpoint's condition in the current context.  The
+ * condition was compiled when the breakpoint was set, so this is
+ * cheap enough to do each time the instruction is reached.  If we
+ * can't evaluate it, we stop, since that's the safer mistake.
+ */
+static int
+slaxDebugTestCondition (slaxDebugState_t *statep, slaxDebugBreakpoint_t *dbp)
+{
+    xsltTransformContextPtr ctxt = statep->ds_ctxt;
+    xmlXPathObjectPtr res;
+    int rc;
+
+    if (dbp->dbp_comp == NULL || ctxt == NULL || ctxt->xpathCtxt == NULL)
+	return TRUE;
+
+    /* Functions in the condition mustn't recurse into the debugger */
+    statep->ds_flags |= DSF_INSHELL;
+    res = slaxXpathEvalCompiled(statep->ds_node, statep->ds_inst,
+				ctxt->xpathCtxt, dbp->dbp_comp);
+    statep->ds_flags &= ~DSF_INSHELL;
+
+    if (res == NULL) {
+	slaxOutput("Error evaluating condition for breakpoint %d: %s",
+		   dbp->dbp_num, dbp->dbp_cond);
+	return TRUE;
+    }
+
+    rc = xmlXPathCastToBoolean(res);
+    xmlXPathFreeObject(res);
+
+    return rc;
+}
+
 /*
  * Check if the breakpoint is available for curnode being executed
  */
@@ -699,8 +757,11 @@ slaxDebugCheckBreakpoint (slaxDebugState_t *statep,
     }
 
     TAILQ_FOREACH(dbp, &slaxDebugBreakpoints, dbp_link) {
-	if (dbp->dbp_inst && dbp->dbp_inst == node) {
+	if (dbp->dbp_inst && dbp->dbp_inst == node && !dbp->dbp_disabled) {
 	    if (reached) {
+		if (dbp->dbp_cond && !slaxDebugTestCondition(statep, dbp))
+		    continue;
+
 		slaxOutput("Reached breakpoint %d, at %s:%ld", 
 				dbp->dbp_num, node->doc->URL,
 				xmlGetLineNo(node));
@@ -713,6 +774,194 @@ slaxDebugCheckBreakpoint (slaxDebugState_t *statep,
     return FALSE;
 }
 
+/*
+ * Find the value of a watched variable, or NULL if the variable
+ * isn't in scope.  The caller owns the (copied) value.
+ */
+static xmlXPathObjectPtr
+slaxDebugWatchLookup (slaxDebugState_t *statep, slaxDebugBreakpoint_t *dbp)
+{
+    xsltTransformContextPtr ctxt = statep->ds_ctxt;
+    xmlXPathObjectPtr obj;
+
+    if (ctxt == NULL)
+	return NULL;
+
+    /* Lookup can evaluate a lazy global, so don't recurse */
+    statep->ds_flags |= DSF_INSHELL;
+    obj = xsltVariableLookup(ctxt, (const xmlChar *) dbp->dbp_watch,
+			     (const xmlChar *) dbp->dbp_watch_uri);
+    statep->ds_flags &= ~DSF_INSHELL;
+
+    return obj;
+}
+
+/*
+ * Is a watched value the same as last time?  This is checked at
+ * every instruction, so we compare types, scalars, and node pointers
+ * without building strings.  The nodes of an old value may have been
+ * freed, so we only compare their addresses.
+ */
+static int
+slaxDebugWatchSame (xmlXPathObjectPtr old, xmlXPathObjectPtr obj)
+{
+    xmlNodeSetPtr oset, nset;
+    int onr, nnr;
+
+    if (old->type != obj->type)
+	return FALSE;
+
+    switch (obj->type) {
+    case XPATH_BOOLEAN:
+	return (old->boolval == obj->boolval);
+
+    case XPATH_NUMBER:
+	if (xmlXPathIsNaN(old->floatval) && xmlXPathIsNaN(obj->floatval))
+	    return TRUE;
+	return (old->floatval == obj->floatval);
+
+    case XPATH_STRING:
+	return xmlStrEqual(old->stringval, obj->stringval);
+
+    case XPATH_NODESET:
+    case XPATH_XSLT_TREE:
+	oset = old->nodesetval;
+	nset = obj->nodesetval;
+	onr = oset ? oset->nodeNr : 0;
+	nnr = nset ? nset->nodeNr : 0;
+	if (onr != nnr)
+	    return FALSE;
+	return (nnr == 0 || memcmp(oset->nodeTab, nset->nodeTab,
+				   nnr * sizeof(nset->nodeTab[0])) == 0);
+
+    default:
+	return (old == obj);
+    }
+}
+
+/*
+ * Build a printable value for a watched variable.  The string
+ * doubles as the value we compare when the cheap comparison says
+ * it's changed, so node-sets include their count and string value.
+ */
+static char *
+slaxDebugWatchString (xmlXPathObjectPtr obj)
+{
+    xmlChar *str, *res = NULL;
+    char buf[BUFSIZ];
+    int i;
+
+    switch (obj->type) {
+    case XPATH_BOOLEAN:
+	res = xmlStrdup((const xmlChar *)
+			(obj->boolval ? "[boolean] true" : "[boolean] false"));
+	break;
+
+    case XPATH_NUMBER:
+	str = xmlXPathCastNumberToString(obj->floatval);
+	snprintf(buf, sizeof(buf), "[number] %s", str ? (char *) str : "");
+	res = xmlStrdup((const xmlChar *) buf);
+	xmlFreeAndEasy(str);
+	break;
+
+    case XPATH_STRING:
+	res = xmlStrdup((const xmlChar *) "[string] \"");
+	res = xmlStrcat(res, obj->stringval);
+	res = xmlStrcat(res, (const xmlChar *) "\"");
+	break;
+
+    case XPATH_NODESET:
+    case XPATH_XSLT_TREE:
+	snprintf(buf, sizeof(buf), "[%s] (%d) \"",
+		 (obj->type == XPATH_NODESET) ? "node-set" : "rtf",
+		 obj->nodesetval ? obj->nodesetval->nodeNr : 0);
+	res = xmlStrdup((const xmlChar *) buf);
+
+	for (i = 0; obj->nodesetval && i < obj->nodesetval->nodeNr; i++) {
+	    str = xmlXPathCastNodeToString(obj->nodesetval->nodeTab[i]);
+	    res = xmlStrcat(res, str);
+	    xmlFreeAndEasy(str);
+	}
+
+	res = xmlStrcat(res, (const xmlChar *) "\"");
+	break;
+
+    default:
+	res = xmlStrdup((const xmlChar *) "[unknown]");
+    }
+
+    return (char *) res;
+}
+
+/*
+ * Remember the value of a watched variable, taking ownership of it
+ */
+static void
+slaxDebugWatchSave (slaxDebugBreakpoint_t *dbp, xmlXPathObjectPtr obj,
+		    char *value)
+{
+    xmlFreeAndEasy(dbp->dbp_value);
+    if (dbp->dbp_last)
+	xmlXPathFreeObject(dbp->dbp_last);
+
+    dbp->dbp_value = value;
+    dbp->dbp_last = obj;
+}
+
+/*
+ * Check watchpoints, stopping if a watched variable has changed
+ * since we last saw it.  Variables that are out of scope are
+ * skipped, but their last value is kept, so a loop that rebinds a
+ * variable will trigger on each new value.
+ */
+static void
+slaxDebugCheckWatchpoints (slaxDebugState_t *statep)
+{
+    slaxDebugBreakpoint_t *dbp;
+    xmlXPathObjectPtr obj;
+    char *value;
+    const int width = 72;
+
+    TAILQ_FOREACH(dbp, &slaxDebugBreakpoints, dbp_link) {
+	if (dbp->dbp_watch == NULL)
+	    continue;
+
+	obj = slaxDebugWatchLookup(statep, dbp);
+	if (obj == NULL)
+	    continue;
+
+	if (dbp->dbp_last && slaxDebugWatchSame(dbp->dbp_last, obj)) {
+	    xmlXPathFreeObject(obj);
+	    continue;
+	}
+
+	/* Different bits, but perhaps the same value */
+	value = slaxDebugWatchString(obj);
+	if (value && dbp->dbp_value && !streq(value, dbp->dbp_value)) {
+	    slaxOutput("Watchpoint %d: %s", dbp->dbp_num, dbp->dbp_where);
+	    slaxOutput("    Old value = %.*s%s", width, dbp->dbp_value,
+		       strlen(dbp->dbp_value) > (size_t) width ? "..." : "");
+	    slaxOutput("    New value = %.*s%s", width, value,
+		       strlen(value) > (size_t) width ? "..." : "");
+	    xsltSetDebuggerStatus(XSLT_DEBUG_INIT);
+	}
+
+	slaxDebugWatchSave(dbp, obj, value);
+    }
+}
+
+/*
+ * Forget watched values, so a new run starts fresh
+ */
+static void
+slaxDebugResetWatchpoints (void)
+{
+    slaxDebugBreakpoint_t *dbp;
+
+    TAILQ_FOREACH(dbp, &slaxDebugBreakpoints, dbp_link)
+	slaxDebugWatchSave(dbp, NULL, NULL);
+}
+
 static char *
 slaxDebugTemplateInfo (xsltTemplatePtr template, char *buf, int bufsiz)
 {
@@ -803,8 +1052,31 @@ slaxDebugReloadBreakpoints (slaxDebugState_t *statep)
     xmlNodePtr node;
 
     TAILQ_FOREACH(dbp, &slaxDebugBreakpoints, dbp_link) {
+	if (dbp->dbp_watch)
+	    continue;
+
 	dbp->dbp_inst = NULL;	/* No dangling references */
 
+	/* Compiled expressions belong to the old script */
+	if (dbp->dbp_comp) {
+	    xmlXPathFreeCompExpr(dbp->dbp_comp);
+	    dbp->dbp_comp = NULL;
+	}
+
+	/*
+	 * A condition that no longer compiles would make the
+	 * breakpoint fire every time, so disable it instead.
+	 */
+	dbp->dbp_disabled = FALSE;
+	if (dbp->dbp_cond) {
+	    dbp->dbp_comp = slaxXpathCompile(statep->ds_script, dbp->dbp_cond);
+	    if (dbp->dbp_comp == NULL) {
+		slaxOutput("Breakpoint %d disabled; invalid condition: %s",
+			   dbp->dbp_num, dbp->dbp_cond);
+		dbp->dbp_disabled = TRUE;
+	    }
+	}
+
 	node = slaxDebugGetNode(statep, dbp->dbp_where);
 	if (node)
 	    dbp->dbp_inst = node;
@@ -841,21 +1113,140 @@ slaxDebugCmdBreak (DC_ARGS)
 {
     xmlNodePtr node = NULL;
     slaxDebugBreakpoint_t *bp;
+    const char *where = argv[1];
+    const char *cond = NULL;
+    xmlXPathCompExprPtr comp = NULL;
+    const char *cp;
+
+    /*
+     * "break [loc] if <expr>" makes a conditional breakpoint.  The
+     * condition is the rest of the command line, whitespace and all.
+     */
+    if (where && streq(where, "if"))
+	where = NULL;
+    if (where == NULL ? argv[1] != NULL : argv[2] && streq(argv[2], "if")) {
+	for (cp = commandline; *cp; cp++) {
+	    if (strncmp(cp, "if", 2) == 0 && (cp == commandline
+				      || isspace((int) cp[-1]))
+		    && (cp[2] == '\0' || isspace((int) cp[2])))
+		break;
+	}
+
+	for (cp += 2; *cp && isspace((int) *cp); cp++)
+	    continue;
+
+	if (*cp == '\0') {
+	    slaxOutput("Missing condition");
+	    return;
+	}
 
-    node = slaxDebugGetNode(statep, argv[1]);
+	cond = cp;
+    }
+
+    node = slaxDebugGetNode(statep, where);
     if (node == NULL) {
-	slaxOutput("Target \"%s\" is not defined", argv[1]);
+	slaxOutput("Target \"%s\" is not defined", where ?: "");
 	return;
     }
 
-    if (slaxDebugCheckBreakpoint(statep, node, FALSE)) {
+    if (cond == NULL && slaxDebugCheckBreakpoint(statep, node, FALSE)) {
 	slaxOutput("Duplicate breakpoint");
 	return; 
     }
 
+    if (cond) {
+	comp = slaxXpathCompile(statep->ds_script, cond);
+	if (comp == NULL) {
+	    slaxOutput("Invalid condition: %s", cond);
+	    return;
+	}
+    }
+
     /*
      * Create a record of the breakpoint and add it to the list
      */
+    bp = xmlMalloc(sizeof(*bp));
+    if (bp == NULL) {
+	if (comp)
+	    xmlXPathFreeCompExpr(comp);
+	return;
+    }
+
+    bzero(bp, sizeof(*bp));
+    bp->dbp_where = xmlStrdup2(where);
+    bp->dbp_num = ++slaxDebugBreakpointNumber;
+    bp->dbp_inst = node;
+    bp->dbp_comp = comp;
+    if (cond)
+	bp->dbp_cond = xmlStrdup2(cond);
+    TAILQ_INSERT_TAIL(&slaxDebugBreakpoints, bp, dbp_link);
+
+    if (cond)
+	slaxOutput("Breakpoint %d at file %s, line %ld, if %s",
+		   bp->dbp_num, node->doc->URL, xmlGetLineNo(node), cond);
+    else
+	slaxOutput("Breakpoint %d at file %s, line %ld",
+		   bp->dbp_num, 
+		   node->doc->URL, xmlGetLineNo(node));  
+}
+
+static void
+slaxDebugHelpBreak (DH_ARGS)
+{
+    slaxOutput("Usage: break [loc] [if <expression>]");
+    slaxOutput("    Stop when the instruction at [file:]line or template "
+	       "is reached.");
+    slaxOutput("    If a condition is given, it is evaluated in the "
+	       "context of that");
+    slaxOutput("    instruction and we only stop when it is true.");
+}
+
+/*
+ * 'watch' command
+ */
+static void
+slaxDebugCmdWatch (DC_ARGS)
+{
+    slaxDebugBreakpoint_t *bp;
+    const char *name = argv[1], *cp;
+    const xmlChar *uri = NULL;
+    xmlNodePtr node;
+    xmlNsPtr nsp;
+    xmlChar *prefix;
+    xmlXPathObjectPtr obj;
+
+    if (name == NULL || argv[2] != NULL) {
+	slaxOutput("Usage: watch $var");
+	return;
+    }
+
+    if (*name == '$')
+	name += 1;
+    if (*name == '\0') {
+	slaxOutput("Missing variable name");
+	return;
+    }
+
+    /* A prefixed name needs its namespace from the script */
+    cp = strchr(name, ':');
+    if (cp) {
+	node = statep->ds_inst;
+	if (node == NULL && statep->ds_script && statep->ds_script->doc)
+	    node = xmlDocGetRootElement(statep->ds_script->doc);
+
+	prefix = xmlStrndup((const xmlChar *) name, cp - name);
+	nsp = node ? xmlSearchNs(node->doc, node, prefix) : NULL;
+	xmlFreeAndEasy(prefix);
+
+	if (nsp == NULL) {
+	    slaxOutput("Unknown namespace prefix in \"%s\"", argv[1]);
+	    return;
+	}
+
+	uri = nsp->href;
+	name = cp + 1;
+    }
+
     bp = xmlMalloc(sizeof(*bp));
     if (bp == NULL)
 	return;
@@ -863,12 +1254,18 @@ slaxDebugCmdBreak (DC_ARGS)
     bzero(bp, sizeof(*bp));
     bp->dbp_where = xmlStrdup2(argv[1]);
     bp->dbp_num = ++slaxDebugBreakpointNumber;
-    bp->dbp_inst = node;
+    bp->dbp_watch = xmlStrdup2(name);
+    if (uri)
+	bp->dbp_watch_uri = xmlStrdup2((const char *) uri);
+
+    /* If it's in scope now, this is the value we compare against */
+    obj = slaxDebugWatchLookup(statep, bp);
+    if (obj)
+	slaxDebugWatchSave(bp, obj, slaxDebugWatchString(obj));
+
     TAILQ_INSERT_TAIL(&slaxDebugBreakpoints, bp, dbp_link);
 
-    slaxOutput("Breakpoint %d at file %s, line %ld",
-		    bp->dbp_num, 
-		    node->doc->URL, xmlGetLineNo(node));  
+    slaxOutput("Watchpoint %d: %s", bp->dbp_num, bp->dbp_where);
 }
 
 static int
@@ -967,6 +1364,7 @@ slaxDebugCmdDelete (DC_ARGS)
     TAILQ_FOREACH(dbpp, &slaxDebugBreakpoints, dbp_link) {
 	if (dbpp->dbp_num == num) {
 	    TAILQ_REMOVE(&slaxDebugBreakpoints, dbpp, dbp_link);
+	    slaxDebugFreeBreakpoint(dbpp);
 	    slaxOutput("Deleted breakpoint '%d'", num);
 	    return;
 	}
@@ -1026,15 +1424,23 @@ slaxDebugInfoBreakpoints (slaxDebugState_t *statep)
 	if (++hit == 1)
 	    slaxOutput("List of breakpoints:");
 
+	if (dbp->dbp_watch) {
+	    slaxOutput("     #%d watch %s", dbp->dbp_num, dbp->dbp_where);
+	    continue;
+	}
+
 	tag = (dbp->dbp_inst == statep->ds_node) ? "*" : " ";
 	template = slaxDebugGetTemplate(statep, dbp->dbp_inst);
 
 	if (dbp->dbp_inst)
-	    slaxOutput("    %s#%d %s at %s:%ld",
+	    slaxOutput("    %s#%d %s at %s:%ld%s%s%s",
 		       tag, dbp->dbp_num,
 		       slaxDebugTemplateInfo(template, buf, sizeof(buf)),
 		       dbp->dbp_inst->doc ? dbp->dbp_inst->doc->URL : slaxNull,
-		       xmlGetLineNo(dbp->dbp_inst));
+		       xmlGetLineNo(dbp->dbp_inst),
+		       dbp->dbp_cond ? " if " : "",
+		       dbp->dbp_cond ?: "",
+		       dbp->dbp_disabled ? " (disabled)" : "");
 	else
 	    slaxOutput("    #%d %s (orphaned)", dbp->dbp_num, dbp->dbp_where);
     }
@@ -1283,6 +1689,7 @@ slaxDebugHelpProfile (DH_ARGS)
     slaxOutput("  profile off     Disable profiling");
     slaxOutput("  profile on      Enable profiling");
     slaxOutput("  profile report [brief]  Report profiling information");
+    slaxOutput("  profile report memory  Report memory allocated by each line");
 }
 
 /*
@@ -1309,6 +1716,11 @@ slaxDebugCmdProfiler (DC_ARGS)
 	    return;
 
 	} else if (slaxDebugIsAbbrev("report", arg)) {
+	    if (argv[2] && slaxDebugIsAbbrev("memory", argv[2])) {
+		slaxProfMemReport(NULL, statep->ds_script_buffer);
+		return;
+	    }
+
 	    int brief = (argv[2] && slaxDebugIsAbbrev("brief", argv[2]));
 	    slaxProfReport(brief, statep->ds_script_buffer);
 	    return;
@@ -1635,7 +2047,7 @@ slaxDebugCmdQuit (DC_ARGS)
 static slaxDebugCommand_t slaxDebugCmdTable[] = {
     { "break",	       1, slaxDebugCmdBreak,
       "break [loc]     Add a breakpoint at [file:]line or template",
-      NULL,
+      slaxDebugHelpBreak,
     },
 
     { "bt",	       1, slaxDebugCmdWhere, NULL, NULL }, /* Hidden */
@@ -1719,6 +2131,11 @@ static slaxDebugCommand_t slaxDebugCmdTable[] = {
       slaxDebugHelpVerbose,
     },
 
+    { "watch",	       2, slaxDebugCmdWatch,
+      "watch $var      Stop when the value of a variable changes",
+      NULL,
+    },
+
     { "where",	       1, slaxDebugCmdWhere,
       "where           Show the backtrace of template calls",
       NULL,
@@ -1946,6 +2363,7 @@ slaxDebugHandler (xmlNodePtr inst, xmlNodePtr node,
     }
 
     slaxDebugCheckBreakpoint(statep, inst, TRUE);
+    slaxDebugCheckWatchpoints(statep);
 
 #if 0
     if (statep->ds_flags & DSF_OVER) {
@@ -2056,6 +2474,7 @@ slaxDebugAddFrame (xsltTemplatePtr template, xmlNodePtr inst)
 
     if (statep->ds_flags & DSF_CALLFLOW)
 	slaxDebugCallFlow(statep, template, inst, "enter");
+    slaxTimelineEnter(template, inst);
 
     /*
      * Store the template backtrace in linked list
@@ -2144,6 +2563,7 @@ slaxDebugDropFrame (void)
 
     if (statep->ds_flags & DSF_CALLFLOW)
 	slaxDebugCallFlow(statep, template, inst, "exit");
+    slaxTimelineExit();
 
     /*
      * If we're popping stack frames, then we're not on the same
@@ -2177,6 +2597,7 @@ slaxDebugInit (void)
     xsltSetDebuggerStatus(XSLT_DEBUG_INIT);
     xsltSetDebuggerCallbacksHelper(slaxDebugHandler, slaxDebugAddFrame,
 				   slaxDebugDropFrame);
+    slaxProfHooksReplaced();
 
     slaxDebugDisplayMode = DEBUG_MODE_CLI;
 
@@ -2368,6 +2789,7 @@ slaxDebugApplyStylesheet (const char *scriptname, xsltStylesheetPtr style,
 	if (res)		/* Free doc from last run */
 	    xmlFreeDoc(res);
 
+	slaxDebugResetWatchpoints();
 	res = xsltApplyStylesheet(style, doc, params);
 
 	status = xsltGetDebuggerStatus();
@@ -30,9 +30,11 @@
 #include <fcntl.h>
 #include <sys/file.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/time.h>
 #include <time.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
@@ -50,10 +52,13 @@
 
 #include <libxslt/xsltutils.h>
 #include <libxslt/transform.h>
+#include <libxslt/extensions.h>
 #include <libxml/xpathInternals.h>
 #include <libxml/parserInternals.h>
 #include <libxml/uri.h>
 #include <libpsu/psubase64.h>
+#include <libpsu/psudigest.h>
+#include <libpsu/psustring.h>
 #include <libpsu/psuthread.h>
 
 #include "slaxext.h"
@@ -616,6 +621,28 @@ fail:
  * generic.  We include them here because they are quite useful.
  */
 
+/*
+ * Is this value "empty", in the slax:first-of() sense?  Empty node-sets
+ * and empty strings are empty; numbers and booleans never are.
+ */
+static int
+slaxExtFirstOfEmpty (xmlXPathObjectPtr xop)
+{
+    if (xop == NULL)
+	return TRUE;
+
+    if (xop->type == XPATH_NODESET && xop->nodesetval == NULL)
+	return TRUE;
+
+    if (xop->nodesetval && xop->nodesetval->nodeNr == 0)
+	return TRUE;
+
+    if (xop->type == XPATH_STRING && (!xop->stringval || !*xop->stringval))
+	return TRUE;
+
+    return FALSE;
+}
+
 /*
  * Return the first non-NULL member of the argument list
  *
@@ -629,22 +656,9 @@ slaxExtFirstOf (xmlXPathParserContext *ctxt, int nargs)
 
     for (i = 0; i < nargs; i++) {
 	xmlXPathObjectPtr xop = valuePop(ctxt);
-	if (xop == NULL)
-	    continue;
-
-	if (xop->type == XPATH_NODESET && xop->nodesetval == NULL) {
-	    xmlXPathFreeObject(xop);
-	    continue;
-	}
-	
-	if (xop->nodesetval && xop->nodesetval->nodeNr == 0) {
-	    xmlXPathFreeObject(xop);
-	    continue;
-	}
-
-	if (xop->type == XPATH_STRING
-		    && (!xop->stringval || !*xop->stringval)) {
-	    xmlXPathFreeObject(xop);
+	if (slaxExtFirstOfEmpty(xop)) {
+	    if (xop)
+		xmlXPathFreeObject(xop);
 	    continue;
 	}
 
@@ -669,6 +683,229 @@ slaxExtFirstOf (xmlXPathParserContext *ctxt, int nargs)
     valuePush(ctxt, results);
 }
 
+/*
+ * Is this value "empty", in the slax:is-empty() sense?  This never
+ * needs the string value of a node; an RTF is empty if it has no
+ * children and a node-set is empty if it has no members.
+ */
+static int
+slaxExtIsEmpty (xmlXPathObjectPtr xop)
+{
+    if (xop == NULL)
+	return TRUE;
+
+    if (xop->nodesetval) {
+	if (xop->nodesetval->nodeNr > 1)
+	    return FALSE;
+
+	if (xop->nodesetval->nodeNr == 1) {
+	    xmlNodePtr nop = xop->nodesetval->nodeTab[0];
+	    if (XSLT_IS_RES_TREE_FRAG(nop))
+		return (nop->children == NULL);
+	    return FALSE;
+	}
+
+    } else if (xop->stringval) {
+	if (*xop->stringval)
+	    return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Deferred arguments: the parser rewrites calls like
+ * "slax:first-of(a, b, c)" into "slax:first-of-lazy(a, 'b', 'c')",
+ * so the trailing alternatives arrive as expression strings.  These
+ * are compiled once per transform, cached by instruction and
+ * expression, and evaluated in the caller's context only when needed.
+ * The cache hangs off the transform context as extension module data,
+ * so libxslt frees it with the transform.
+ */
+#define SLAX_LAZY_URI SLAX_URI "/lazy"
+
+static void
+slaxLazyCacheFree (void *payload, const xmlChar *name UNUSED)
+{
+    xmlXPathFreeCompExpr(payload);
+}
+
+static void *
+slaxLazyInit (xsltTransformContextPtr tctxt UNUSED,
+	      const xmlChar *uri UNUSED)
+{
+    return xmlHashCreate(0);
+}
+
+static void
+slaxLazyShutdown (xsltTransformContextPtr tctxt UNUSED,
+		  const xmlChar *uri UNUSED, void *data)
+{
+    if (data)
+	xmlHashFree(data, slaxLazyCacheFree);
+}
+
+/*
+ * Evaluate a deferred argument in the context of the original call
+ */
+static xmlXPathObjectPtr
+slaxLazyEval (xmlXPathParserContextPtr ctxt, xmlXPathObjectPtr arg)
+{
+    xmlXPathContextPtr xpctxt = ctxt->context;
+    xsltTransformContextPtr tctxt = xsltXPathGetTransformContext(ctxt);
+    xmlHashTablePtr cache = NULL;
+    xmlXPathCompExprPtr comp = NULL;
+    xmlXPathObjectPtr res;
+    xmlChar *expr;
+    char key[32];
+
+    if (arg == NULL || arg->type != XPATH_STRING || arg->stringval == NULL)
+	return NULL;
+    expr = arg->stringval;
+
+    /*
+     * The instruction decides the in-scope namespaces, so it's
+     * part of the key.  Outside a transform, we don't cache.
+     */
+    if (tctxt && tctxt->inst) {
+	cache = xsltGetExtData(tctxt, (const xmlChar *) SLAX_LAZY_URI);
+	if (cache) {
+	    snprintf(key, sizeof(key), "%p", tctxt->inst);
+	    comp = xmlHashLookup2(cache, expr, (const xmlChar *) key);
+	}
+    }
+
+    if (comp == NULL) {
+	comp = xmlXPathCtxtCompile(xpctxt, expr);
+	if (comp == NULL) {
+	    xsltGenericError(xsltGenericErrorContext,
+			     "invalid deferred expression: %s\n", expr);
+	    return NULL;
+	}
+
+	if (cache && xmlHashAddEntry2(cache, expr,
+				      (const xmlChar *) key, comp) < 0) {
+	    xmlXPathFreeCompExpr(comp);
+	    return NULL;
+	}
+    }
+
+    /* The evaluation can move the context, so we put it back */
+    xmlNodePtr node = xpctxt->node;
+    xmlDocPtr doc = xpctxt->doc;
+    int position = xpctxt->proximityPosition;
+    int size = xpctxt->contextSize;
+
+    res = xmlXPathCompiledEval(comp, xpctxt);
+
+    xpctxt->node = node;
+    xpctxt->doc = doc;
+    xpctxt->proximityPosition = position;
+    xpctxt->contextSize = size;
+
+    if (cache == NULL)
+	xmlXPathFreeCompExpr(comp);
+
+    return res;
+}
+
+/*
+ * Find the first non-empty argument, evaluating deferred arguments
+ * only until one is found.  The arguments stay on the stack until
+ * we're done, so the winner can be handed back without copying.
+ * Returns the value (which the caller owns) or NULL on error.
+ */
+static xmlXPathObjectPtr
+slaxLazyFirst (xmlXPathParserContextPtr ctxt, int nargs,
+	       int (*is_empty)(xmlXPathObjectPtr))
+{
+    xmlXPathObjectPtr *argv = &ctxt->valueTab[ctxt->valueNr - nargs];
+    xmlXPathObjectPtr res = NULL;
+    int i, error = FALSE;
+
+    if (!is_empty(argv[0])) {
+	res = argv[0];
+	argv[0] = NULL;
+
+    } else {
+	for (i = 1; i < nargs; i++) {
+	    res = slaxLazyEval(ctxt, argv[i]);
+	    if (res == NULL) {
+		error = TRUE;
+		break;
+	    }
+
+	    if (!is_empty(res))
+		break;
+
+	    xmlXPathFreeObject(res);
+	    res = NULL;
+	}
+    }
+
+    for (i = 0; i < nargs; i++) {
+	xmlXPathObjectPtr xop = valuePop(ctxt);
+	if (xop)
+	    xmlXPathFreeObject(xop);
+    }
+
+    if (error) {
+	xmlXPathSetError(ctxt, XPATH_EXPR_ERROR);
+	return NULL;
+    }
+
+    return res ?: xmlXPathNewNodeSet(NULL);
+}
+
+/*
+ * The deferred form of slax:first-of(), generated by the parser
+ *
+ * Usage: <output> slax:first-of-lazy($input, "$argument", "'huh?'");
+ */
+static void
+slaxExtFirstOfLazy (xmlXPathParserContext *ctxt, int nargs)
+{
+    xmlXPathObjectPtr res;
+
+    if (nargs < 1 || ctxt->valueNr < nargs) {
+	xmlXPathSetArityError(ctxt);
+	return;
+    }
+
+    res = slaxLazyFirst(ctxt, nargs, slaxExtFirstOfEmpty);
+    if (res)
+	valuePush(ctxt, res);
+}
+
+/*
+ * The deferred form of slax:is-empty(), generated by the parser
+ *
+ * Usage: if (slax:is-empty-lazy($set, "$other")) { .... }
+ */
+static void
+slaxExtEmptyLazy (xmlXPathParserContext *ctxt, int nargs)
+{
+    xmlXPathObjectPtr res;
+    int empty;
+
+    if (nargs < 1 || ctxt->valueNr < nargs) {
+	xmlXPathSetArityError(ctxt);
+	return;
+    }
+
+    res = slaxLazyFirst(ctxt, nargs, slaxExtIsEmpty);
+    if (res == NULL)
+	return;
+
+    empty = slaxExtIsEmpty(res);
+    xmlXPathFreeObject(res);
+
+    if (empty)
+	xmlXPathReturnTrue(ctxt);
+    else
+	xmlXPathReturnFalse(ctxt);
+}
+
 /* ---------------------------------------------------------------------- */
 
 static int
@@ -1157,68 +1394,124 @@ slaxExtMakeTextNode (xmlDocPtr docp, xmlNs *nsp, const char *name,
     return newp;
 }
 
+/*
+ * A window of lines (by position) to be turned into nodes.  Lines
+ * before the window are skipped without making nodes, and scanning
+ * stops once the window is full.  This lets callers that want a few
+ * lines out of a large blob of output avoid paying for all of them.
+ */
+typedef struct slax_line_window_s {
+    long lw_skip;		/* Number of lines to skip */
+    long lw_left;		/* Number of lines to make (-1 means all) */
+    long lw_seen;		/* Number of lines seen (when counting) */
+} slax_line_window_t;
+
 /*
  * Break a string into the set of clone element, with each clone
- * containing one line of text.
+ * containing one line of text.  If the container is NULL, we just
+ * count the lines.  Returns TRUE when the window is full.
  */
-static void
-slaxExtBreakString (xmlDocPtr container, xmlNodeSet *results, char *content,
-		    xmlNsPtr nsp, const char *name)
+static int
+slaxExtBreakString (xmlDocPtr container, xmlNodeSet *results,
+		    const char *content, xmlNsPtr nsp, const char *name,
+		    slax_line_window_t *lwp)
 {
     xmlNode *clone;
-    xmlNode *last;
-    char *cp, *sp;
+    const char *cp, *sp, *ep;
+    int dos_format;
 
     /* If there's no content, return an empty clone */
-    if (content == NULL) {
-	clone = slaxExtMakeTextNode(container, nsp, name, NULL, 0);
-	if (clone) {
-	    xmlXPathNodeSetAdd(results, clone);
-	    xmlAddChild((xmlNodePtr) container, clone);
-	}
-	return;
-    }
-
-    cp = strchr(content, '\n');
-    if (cp == NULL) {
-	clone = slaxExtMakeTextNode(container, nsp, name,
-				    content, strlen(content));
-	if (clone) {
-	    xmlXPathNodeSetAdd(results, clone);
-	    xmlAddChild((xmlNodePtr) container, clone);
-	}
-	return;
-    }
+    if (content == NULL)
+	ep = NULL;
+    else
+	ep = content + strlen(content);
 
-    sp = content;
-    last = NULL;
+    for (sp = content;; sp = cp + 1) {
+	cp = sp ? memchr(sp, '\n', ep - sp) : NULL;
+	if (cp == NULL)
+	    cp = ep;
 
-    for (;;) {
 	/*
 	 * MS-DOS uses CRLF instead of just LF, and windows keeps this
-	 * encoding alive.
+	 * encoding alive.  A string without any newlines is left alone.
 	 */
-	int dos_format = (cp <= sp) ? 0 : (cp[-1] == '\r') ? 1 : 0;
-					  
-	clone = slaxExtMakeTextNode(container, nsp, name,
-				    sp, cp - sp - dos_format);
-	if (clone) {
-	    xmlXPathNodeSetAdd(results, clone);
-	    if (last)
-		xmlAddSibling(last, clone);
+	dos_format = (cp <= sp || (sp == content && cp == ep)) ? 0
+	    : (cp[-1] == '\r') ? 1 : 0;
+
+	if (container == NULL) {
+	    lwp->lw_seen += 1;
+
+	} else if (lwp->lw_skip > 0) {
+	    lwp->lw_skip -= 1;
+
+	} else {
+	    clone = slaxExtMakeTextNode(container, nsp, name,
+					sp, cp - sp - dos_format);
+	    if (clone) {
+		xmlXPathNodeSetAddUnique(results, clone);
+		xmlAddChild((xmlNodePtr) container, clone);
+	    }
 
-	    xmlAddChild((xmlNodePtr) container, clone);
-	    last = clone;
+	    if (lwp->lw_left > 0 && --lwp->lw_left == 0)
+		return TRUE;
 	}
 
-	sp = cp;
-	if (*sp == '\0' || *++sp == '\0')
+	/* A trailing newline does not make an empty final line */
+	if (cp == ep || cp + 1 == ep)
 	    break;
+    }
 
-	cp = strchr(sp, '\n');
-	if (cp == NULL)
-	    cp = sp + strlen(sp);
+    return FALSE;
+}
+
+/*
+ * Break the lines of one argument, which can be either a node-set
+ * (where we use the text content of each node) or a string.  Returns
+ * TRUE when the window is full.
+ */
+static int
+slaxExtBreakObject (xmlDocPtr container, xmlNodeSet *results,
+		    xmlXPathObjectPtr obj, slax_line_window_t *lwp)
+{
+    if (obj == NULL)		/* Should not occur */
+	return FALSE;
+
+    if (obj->nodesetval) {
+	int i;
+	for (i = 0; i < obj->nodesetval->nodeNr; i++) {
+	    xmlNode *nop = obj->nodesetval->nodeTab[i];
+	    if (nop == NULL || nop->children == NULL)
+		continue;
+
+	    /*
+	     * If we're handed a fragment, assume they wanted the
+	     * contents.
+	     */
+	    if (XSLT_IS_RES_TREE_FRAG(nop))
+		nop = nop->children;
+
+	    /*
+	     * Whiffle thru the children looking for a node
+	     */
+	    xmlNode *cop;
+	    for (cop = nop->children; cop; cop = cop->next) {
+		if (cop->type != XML_TEXT_NODE)
+		    continue;
+
+		if (slaxExtBreakString(container, results,
+				       (const char *) cop->content,
+				       nop->ns, (const char *) nop->name, lwp))
+		    return TRUE;
+	    }
+	}
+
+    } else if (obj->stringval) {
+	return slaxExtBreakString(container, results,
+				  (const char *) obj->stringval,
+				  NULL, ELT_TEXT, lwp);
     }
+
+    return FALSE;
 }
 
 /*
@@ -1232,16 +1525,16 @@ static void
 slaxExtBreakLines (xmlXPathParserContext *ctxt, int nargs)
 {
     xmlXPathObject *stack[nargs];	/* Stack for args as objects */
-    xmlXPathObject *obj;
     xmlXPathObjectPtr ret;
     xmlDocPtr container;
+    slax_line_window_t window = { 0, -1, 0 };
+    int ndx;
 
     if (nargs == 0) {
 	xmlXPathSetArityError(ctxt);
 	return;
     }
 
-    int ndx;
     for (ndx = 0; ndx < nargs; ndx++)
 	stack[nargs - 1 - ndx] = valuePop(ctxt);
 
@@ -1252,57 +1545,100 @@ slaxExtBreakLines (xmlXPathParserContext *ctxt, int nargs)
      * collector. 
      */
     container = slaxMakeRtf(ctxt);
-    if (container == NULL)
-	goto fail;
+    if (container != NULL) {
+	for (ndx = 0; ndx < nargs; ndx++)
+	    slaxExtBreakObject(container, results, stack[ndx], &window);
+    }
 
-    for (ndx = 0; ndx < nargs; ndx++) {
-	if (stack[ndx] == NULL)	/* Should not occur */
-	    continue;
+    for (ndx = 0; ndx < nargs; ndx++)
+	xmlXPathFreeObject(stack[ndx]);
 
-	obj = stack[ndx];
-	if (obj->nodesetval) {
-	    int i;
-	    for (i = 0; i < obj->nodesetval->nodeNr; i++) {
-		xmlNode *nop = obj->nodesetval->nodeTab[i];
-		if (nop == NULL || nop->children == NULL)
-		    continue;
+    ret = xmlXPathNewNodeSetList(results);
+    valuePush(ctxt, ret);
+    xmlXPathFreeNodeSet(results);
+}
 
-		/*
-		 * If we're handed a fragment, assume they wanted the
-		 * contents.
-		 */
-		if (XSLT_IS_RES_TREE_FRAG(nop))
-		    nop = nop->children;
+/*
+ * Return a range of lines, as slax:break-lines would, but only
+ * making nodes for the lines requested.  Positions start at one, as
+ * in XPath, and a missing count means "to the end".  Scanning stops
+ * as soon as the last requested line is made.
+ *
+ * Usage:  var $head = slax:break-lines-range($output, 1, 10);
+ */
+static void
+slaxExtBreakLinesRange (xmlXPathParserContext *ctxt, int nargs)
+{
+    xmlXPathObjectPtr obj, ret;
+    xmlDocPtr container;
+    slax_line_window_t window = { 0, -1, 0 };
+    double first, count = -1;
 
-		/*
-		 * Whiffle thru the children looking for a node
-		 */
-		xmlNode *cop;
-		for (cop = nop->children; cop; cop = cop->next) {
-		    if (cop->type != XML_TEXT_NODE)
-			continue;
-
-		    slaxExtBreakString(container, results,
-				       (char *) cop->content,
-				       nop->ns, (const char *) nop->name);
-		}
-	    }
+    if (nargs != 2 && nargs != 3) {
+	xmlXPathSetArityError(ctxt);
+	return;
+    }
 
-	} else if (obj->stringval) {
-	    slaxExtBreakString(container, results, (char *) obj->stringval,
-			       NULL, ELT_TEXT);
-	}
+    if (nargs == 3) {
+	count = xmlXPathPopNumber(ctxt);
+	if (xmlXPathCheckError(ctxt))
+	    return;
     }
 
-    for (ndx = 0; ndx < nargs; ndx++)
-	xmlXPathFreeObject(stack[ndx]);
+    first = xmlXPathPopNumber(ctxt);
+    if (xmlXPathCheckError(ctxt))
+	return;
+
+    obj = valuePop(ctxt);
+
+    xmlNodeSet *results = xmlXPathNodeSetCreate(NULL);
+
+    if (first > 1)
+	window.lw_skip = (long) first - 1;
+
+    if (nargs == 3)
+	window.lw_left = (count >= 1) ? (long) count : 0;
+
+    if (window.lw_left != 0) {
+	container = slaxMakeRtf(ctxt);
+	if (container != NULL)
+	    slaxExtBreakObject(container, results, obj, &window);
+    }
+
+    xmlXPathFreeObject(obj);
 
- fail:
     ret = xmlXPathNewNodeSetList(results);
     valuePush(ctxt, ret);
     xmlXPathFreeNodeSet(results);
 }
 
+/*
+ * Return the number of lines slax:break-lines would make, without
+ * making any of them.
+ *
+ * Usage:  var $count = slax:line-count($output);
+ */
+static void
+slaxExtLineCount (xmlXPathParserContext *ctxt, int nargs)
+{
+    slax_line_window_t window = { 0, -1, 0 };
+    xmlXPathObjectPtr obj;
+    int ndx;
+
+    if (nargs == 0) {
+	xmlXPathSetArityError(ctxt);
+	return;
+    }
+
+    for (ndx = 0; ndx < nargs; ndx++) {
+	obj = valuePop(ctxt);
+	slaxExtBreakObject(NULL, NULL, obj, &window);
+	xmlXPathFreeObject(obj);
+    }
+
+    xmlXPathReturnNumber(ctxt, window.lw_seen);
+}
+
 /*
  * Return the set of matches matched by the given regular expression.
  * This requires two arguments, the regex and the string to match on.
@@ -1470,31 +1806,15 @@ slaxExtEmpty (xmlXPathParserContext *ctxt, int nargs)
     for (ndx = 0; ndx < nargs; ndx++) {
 	xop = valuePop(ctxt);
 
-	if (!empty) {
-	    /*
-	     * Not empty; we don't need to look anymore, but
-	     * we need to keep popping (and freeing) the stack
-	     */
-
-	} else if (xop->nodesetval) {
-	    if (xop->nodesetval->nodeNr > 1) {
-		empty = FALSE;
-
-	    } else if (xop->nodesetval->nodeNr == 1) {
-		xmlNodePtr nop = xop->nodesetval->nodeTab[0];
-		if (XSLT_IS_RES_TREE_FRAG(nop)) {
-		    if (nop->children != NULL)
-			empty = FALSE;
-		} else 
-		    empty = FALSE;
-	    }
+	/*
+	 * Once we've found a non-empty value, we don't need to look
+	 * anymore, but we need to keep popping (and freeing) the stack
+	 */
+	if (empty && !slaxExtIsEmpty(xop))
+	    empty = FALSE;
 
-	} else if (xop->stringval) {
-	    if (*xop->stringval)
-		empty = FALSE;
-	}
-
-	xmlXPathFreeObject(xop);
+	if (xop)
+	    xmlXPathFreeObject(xop);
     }
 
     if (empty)
@@ -1554,13 +1874,74 @@ slaxExtSysctl (xmlXPathParserContext *ctxt, int nargs)
 }
 #endif /* HAVE_SYS_SYSCTL_H */
 
+/*
+ * If a split pattern has no regex metacharacters, return the literal
+ * string it matches (allocated), so we can avoid regcomp/regexec and
+ * just search for it.  A backslash before punctuation is just a
+ * quoted literal.  Returns NULL for real regular expressions.
+ */
+static char *
+slaxExtSplitLiteral (const char *pattern, size_t *lenp)
+{
+    static const char metachars[] = ".[]()*+?{}|^$";
+    const char *cp;
+    char *lit, *lp;
+
+    if (*pattern == '\0')	/* Empty patterns are left to regcomp */
+	return NULL;
+
+    lit = lp = xmlMalloc(strlen(pattern) + 1);
+    if (lit == NULL)
+	return NULL;
+
+    for (cp = pattern; *cp; cp++) {
+	if (*cp == '\\') {
+	    cp += 1;
+	    /* Things like "\w", "\1", or GNU's "\<" and "\`" */
+	    if (*cp == '\0' || isalnum((unsigned char) *cp)
+		    || strchr("<>`'", *cp) != NULL)
+		goto regex;
+
+	} else if (strchr(metachars, *cp) != NULL) {
+	    goto regex;
+	}
+
+	*lp++ = *cp;
+    }
+
+    *lp = '\0';
+    *lenp = lp - lit;
+    return lit;
+
+ regex:
+    xmlFree(lit);
+    return NULL;
+}
+
+/*
+ * Add one piece of a split string to the results
+ */
+static void
+slaxExtSplitAdd (xmlDocPtr container, xmlNodeSet *results,
+		 const char *strp, int len)
+{
+    xmlNode *newp;
+
+    newp = slaxExtMakeTextNode(container, NULL, "split", strp, len);
+    if (newp) {
+	xmlXPathNodeSetAddUnique(results, newp);
+	xmlAddChild((xmlNodePtr) container, newp);
+    }
+}
+
 /*
  * Usage: 
  *     var $substrings = slax:split($pattern, $string, [$limit]);
  *
  * Split string into an array of substrings on the regular expression pattern. 
  * If optional argument limit is specified, then only substrings up to limit 
- * are returned.
+ * are returned.  Patterns without regex metacharacters (like "," or
+ * ":") are searched for directly, without the regex library.
  */
 static void
 slaxExtSplit (xmlXPathParserContext *ctxt, int nargs)
@@ -1569,8 +1950,8 @@ slaxExtSplit (xmlXPathParserContext *ctxt, int nargs)
     xmlChar *string, *pattern;
     xmlXPathObjectPtr ret;
     xmlNodeSet *results;
-    xmlNode *newp, *last = NULL;
-    char buf[BUFSIZ], *strp, *endp;
+    char buf[BUFSIZ], *strp, *endp, *lit, *cp;
+    size_t litlen = 0;
     regex_t reg;
     regmatch_t pmatch[1];
     int rc, limit = -1;
@@ -1606,6 +1987,30 @@ slaxExtSplit (xmlXPathParserContext *ctxt, int nargs)
     if (container == NULL)
 	goto done;
 
+    lit = slaxExtSplitLiteral((char *) pattern, &litlen);
+    if (lit) {
+	while (limit == -1 || limit > 1) {
+	    if (litlen == 1)
+		cp = psu_memchr(strp, *lit, endp - strp);
+	    else
+		cp = memmem(strp, endp - strp, lit, litlen);
+	    if (cp == NULL)
+		break;
+
+	    /* A match at start of the string makes an empty node */
+	    slaxExtSplitAdd(container, results,
+			    (cp == strp) ? NULL : strp, cp - strp);
+	    strp = cp + litlen;
+
+	    if (limit != -1)
+		limit -= 1;
+	}
+
+	xmlFree(lit);
+	slaxExtSplitAdd(container, results, strp, endp - strp);
+	goto done;
+    }
+
     rc = regcomp(&reg, (char *) pattern, REG_EXTENDED);
     if (rc)
 	goto fail;
@@ -1618,147 +2023,1319 @@ slaxExtSplit (xmlXPathParserContext *ctxt, int nargs)
 	if (pmatch[0].rm_so == -1 &&  pmatch[0].rm_eo == -1)
 	    goto done;
 
-	if (pmatch[0].rm_so == 0 && pmatch[0].rm_eo) {
-	    /* Match at start of the string, create empty node */
-	    newp = slaxExtMakeTextNode(container, NULL, "split", NULL, 0);
-	} else {
-	    newp = slaxExtMakeTextNode(container, NULL, "split",
-				       strp, pmatch[0].rm_so);
+	/* A match at start of the string makes an empty node */
+	slaxExtSplitAdd(container, results,
+			(pmatch[0].rm_so == 0) ? NULL : strp, pmatch[0].rm_so);
+
+	strp += pmatch[0].rm_eo;
+
+	if (limit != -1)
+	    limit -= 1;
+    }
+
+    if (rc && rc != REG_NOMATCH)
+	goto fail;
+
+    slaxExtSplitAdd(container, results, strp, endp - strp);
+
+ done:
+    regfree(&reg);
+    xmlFree(string);
+    xmlFree(pattern);
+
+    ret = xmlXPathNewNodeSetList(results);
+    valuePush(ctxt, ret);
+    xmlXPathFreeNodeSet(results);
+    return;
+
+ fail:
+
+    regerror(rc, &reg, buf, sizeof(buf));
+    xsltGenericError(xsltGenericErrorContext, "regex error: %s\n", buf);
+    goto done;
+}
+
+/*
+ * slax:digest() feeds nodes to a hash in a canonical form, so no
+ * serialized copy is ever made.  Markers separate the pieces; they
+ * are control characters that cannot appear in XML 1.0 content, so
+ * the encoding is unambiguous.  Namespaces are hashed by URI, never
+ * by prefix or declaration, and attributes are sorted, so neither
+ * prefix choice, declaration placement nor attribute order affects
+ * the result.
+ */
+#define SLAX_DIGEST_ELEMENT	"\001"	/* Start of an element */
+#define SLAX_DIGEST_END		"\002"	/* End of an element */
+#define SLAX_DIGEST_ATTR	"\003"	/* Attribute */
+#define SLAX_DIGEST_TEXT	"\004"	/* Run of text */
+#define SLAX_DIGEST_COMMENT	"\005"	/* Comment */
+#define SLAX_DIGEST_PI		"\006"	/* Processing instruction */
+
+/* Flags for slax:digest() */
+#define DGF_CHILDREN	(1<<0)	/* Hash each child separately */
+#define DGF_STRIP_SPACE	(1<<1)	/* Ignore whitespace-only text */
+#define DGF_COMMENTS	(1<<2)	/* Include comments */
+
+#define SLAX_DIGEST_ATTR_MAX	16 /* Attributes sorted on the stack */
+
+static void
+slaxDigestString (psu_digest_t *pdp, const xmlChar *str)
+{
+    if (str)
+	psu_digest_update(pdp, str, xmlStrlen(str));
+    psu_digest_update(pdp, "", 1);
+}
+
+static void
+slaxDigestName (psu_digest_t *pdp, xmlNsPtr nsp, const xmlChar *name)
+{
+    slaxDigestString(pdp, nsp ? nsp->href : NULL);
+    slaxDigestString(pdp, name);
+}
+
+static int
+slaxDigestAttrCompare (const void *a, const void *b)
+{
+    xmlAttrPtr aa = *(xmlAttrPtr const *) a, bb = *(xmlAttrPtr const *) b;
+    int rc;
+
+    rc = xmlStrcmp(aa->ns ? aa->ns->href : NULL, bb->ns ? bb->ns->href : NULL);
+    return rc ? rc : xmlStrcmp(aa->name, bb->name);
+}
+
+static int
+slaxDigestIsText (xmlNodePtr nodep)
+{
+    return (nodep->type == XML_TEXT_NODE
+	    || nodep->type == XML_CDATA_SECTION_NODE
+	    || nodep->type == XML_ENTITY_REF_NODE);
+}
+
+/*
+ * Hash the content of a text node, without copying it (unless it's
+ * an unexpanded entity reference, which should be rare).
+ */
+static void
+slaxDigestText (psu_digest_t *pdp, xmlNodePtr nodep)
+{
+    xmlChar *content;
+
+    if (nodep->type == XML_ENTITY_REF_NODE) {
+	content = xmlNodeGetContent(nodep);
+	if (content) {
+	    psu_digest_update(pdp, content, xmlStrlen(content));
+	    xmlFree(content);
+	}
+
+    } else if (nodep->content) {
+	psu_digest_update(pdp, nodep->content, xmlStrlen(nodep->content));
+    }
+}
+
+static void
+slaxDigestAttr (psu_digest_t *pdp, xmlAttrPtr attr)
+{
+    xmlNodePtr nodep;
+
+    psu_digest_update(pdp, SLAX_DIGEST_ATTR, 1);
+    slaxDigestName(pdp, attr->ns, attr->name);
+    for (nodep = attr->children; nodep; nodep = nodep->next)
+	if (slaxDigestIsText(nodep))
+	    slaxDigestText(pdp, nodep);
+    psu_digest_update(pdp, "", 1);
+}
+
+static void
+slaxDigestNode (psu_digest_t *pdp, xmlNodePtr nodep, unsigned flags);
+
+/*
+ * Hash the children of a node, merging adjacent text nodes into a
+ * single run so that the way the text was split doesn't matter.
+ */
+static void
+slaxDigestChildren (psu_digest_t *pdp, xmlNodePtr nodep, unsigned flags)
+{
+    int in_text = FALSE;
+
+    for ( ; nodep; nodep = nodep->next) {
+	if (slaxDigestIsText(nodep)) {
+	    if ((flags & DGF_STRIP_SPACE) && xmlIsBlankNode(nodep))
+		continue;
+
+	    if (!in_text) {
+		psu_digest_update(pdp, SLAX_DIGEST_TEXT, 1);
+		in_text = TRUE;
+	    }
+
+	    slaxDigestText(pdp, nodep);
+	    continue;
+	}
+
+	if (nodep->type == XML_COMMENT_NODE && !(flags & DGF_COMMENTS))
+	    continue;
+
+	if (in_text) {
+	    psu_digest_update(pdp, "", 1);
+	    in_text = FALSE;
+	}
+
+	slaxDigestNode(pdp, nodep, flags);
+    }
+
+    if (in_text)
+	psu_digest_update(pdp, "", 1);
+}
+
+static void
+slaxDigestElement (psu_digest_t *pdp, xmlNodePtr nodep, unsigned flags)
+{
+    xmlAttrPtr local[SLAX_DIGEST_ATTR_MAX], *attrs = local;
+    xmlAttrPtr attr;
+    int i, count = 0;
+
+    psu_digest_update(pdp, SLAX_DIGEST_ELEMENT, 1);
+    slaxDigestName(pdp, nodep->ns, nodep->name);
+
+    for (attr = nodep->properties; attr; attr = attr->next)
+	count += 1;
+
+    if (count > SLAX_DIGEST_ATTR_MAX) {
+	attrs = xmlMalloc(count * sizeof(*attrs));
+	if (attrs == NULL)
+	    return;
+    }
+
+    for (i = 0, attr = nodep->properties; attr; attr = attr->next)
+	attrs[i++] = attr;
+
+    if (count > 1)
+	qsort(attrs, count, sizeof(*attrs), slaxDigestAttrCompare);
+
+    for (i = 0; i < count; i++)
+	slaxDigestAttr(pdp, attrs[i]);
+
+    if (attrs != local)
+	xmlFree(attrs);
+
+    slaxDigestChildren(pdp, nodep->children, flags);
+    psu_digest_update(pdp, SLAX_DIGEST_END, 1);
+}
+
+static void
+slaxDigestNode (psu_digest_t *pdp, xmlNodePtr nodep, unsigned flags)
+{
+    switch (nodep->type) {
+    case XML_ELEMENT_NODE:
+	slaxDigestElement(pdp, nodep, flags);
+	break;
+
+    case XML_ATTRIBUTE_NODE:
+	slaxDigestAttr(pdp, (xmlAttrPtr) nodep);
+	break;
+
+    case XML_TEXT_NODE:
+    case XML_CDATA_SECTION_NODE:
+    case XML_ENTITY_REF_NODE:
+	psu_digest_update(pdp, SLAX_DIGEST_TEXT, 1);
+	slaxDigestText(pdp, nodep);
+	psu_digest_update(pdp, "", 1);
+	break;
+
+    case XML_COMMENT_NODE:
+	psu_digest_update(pdp, SLAX_DIGEST_COMMENT, 1);
+	slaxDigestString(pdp, nodep->content);
+	break;
+
+    case XML_PI_NODE:
+	psu_digest_update(pdp, SLAX_DIGEST_PI, 1);
+	slaxDigestString(pdp, nodep->name);
+	slaxDigestString(pdp, nodep->content);
+	break;
+
+    case XML_DOCUMENT_NODE:
+    case XML_HTML_DOCUMENT_NODE:
+    case XML_DOCUMENT_FRAG_NODE:
+	slaxDigestChildren(pdp, nodep->children, flags);
+	break;
+
+    default:
+	break;
+    }
+}
+
+/*
+ * Make a <digest> node for one child, recording its name and
+ * position so callers can tell which record changed.
+ */
+static xmlNodePtr
+slaxDigestMakeNode (xmlDocPtr container, xmlNodePtr nodep,
+		    int position, const char *hex)
+{
+    char buf[16];
+    xmlNodePtr newp;
+
+    newp = slaxExtMakeTextNode(container, NULL, "digest", hex, strlen(hex));
+    if (newp == NULL)
+	return NULL;
+
+    xmlSetProp(newp, (const xmlChar *) "name", nodep->name);
+    snprintf(buf, sizeof(buf), "%d", position);
+    xmlSetProp(newp, (const xmlChar *) "position", (const xmlChar *) buf);
+
+    return newp;
+}
+
+/*
+ * Usage:
+ *     var $sum = slax:digest($config/interfaces);
+ *     var $fast = slax:digest($config, "fnv1a64");
+ *     var $sums = slax:digest($config/interfaces, "sha256", "cs");
+ *
+ * Return a digest of the given nodes, hashed in a canonical form
+ * that ignores attribute order, namespace prefixes and namespace
+ * declaration placement.  Strings are hashed as-is.  The algorithm
+ * is "sha256" (the default) or "fnv1a64".  The optional third
+ * argument is a string of flags:
+ *     'c' -- hash each child element separately, returning a set of
+ *            <digest name="..." position="N"> elements
+ *     's' -- ignore whitespace-only text nodes
+ *     'm' -- include comments
+ * Data is fed to the hash as the tree is walked, so no serialized
+ * copy is made, regardless of the size of the input.
+ */
+static void
+slaxExtDigest (xmlXPathParserContext *ctxt, int nargs)
+{
+    xmlChar *name = NULL, *opts = NULL;
+    xmlXPathObjectPtr xop = NULL;
+    xmlNodeSetPtr nodeset, results;
+    xmlNodePtr nodep, childp, last = NULL, newp;
+    xmlDocPtr container;
+    psu_digest_t digest;
+    char hex[PSU_DIGEST_HEX_MAX];
+    unsigned algo, flags = 0;
+    int i, position;
+
+    if (nargs < 1 || nargs > 3) {
+	xmlXPathSetArityError(ctxt);
+	return;
+    }
+
+    if (nargs == 3) {
+	opts = xmlXPathPopString(ctxt);
+	for (i = 0; opts && opts[i]; i++) {
+	    if (opts[i] == 'c')
+		flags |= DGF_CHILDREN;
+	    else if (opts[i] == 's')
+		flags |= DGF_STRIP_SPACE;
+	    else if (opts[i] == 'm')
+		flags |= DGF_COMMENTS;
+	}
+    }
+
+    if (nargs >= 2)
+	name = xmlXPathPopString(ctxt);
+
+    xop = valuePop(ctxt);
+    if (xop == NULL || xmlXPathCheckError(ctxt))
+	goto fail;
+
+    algo = psu_digest_lookup((const char *) name);
+    if (algo == 0) {
+	xsltGenericError(xsltGenericErrorContext,
+			 "slax:digest: unknown algorithm: %s\n", name);
+	goto fail;
+    }
+
+    if (xop->type != XPATH_NODESET && xop->type != XPATH_XSLT_TREE) {
+	xmlChar *str = xmlXPathCastToString(xop);
+
+	psu_digest_init(&digest, algo);
+	if (str) {
+	    psu_digest_update(&digest, str, xmlStrlen(str));
+	    xmlFree(str);
+	}
+	xmlXPathReturnString(ctxt,
+		     xmlStrdup((xmlChar *) psu_digest_final_hex(&digest, hex)));
+	goto done;
+    }
+
+    nodeset = xop->nodesetval;
+
+    if (!(flags & DGF_CHILDREN)) {
+	psu_digest_init(&digest, algo);
+	for (i = 0; nodeset && i < nodeset->nodeNr; i++)
+	    slaxDigestNode(&digest, nodeset->nodeTab[i], flags);
+
+	xmlXPathReturnString(ctxt,
+		     xmlStrdup((xmlChar *) psu_digest_final_hex(&digest, hex)));
+	goto done;
+    }
+
+    container = slaxMakeRtf(ctxt);
+    if (container == NULL)
+	goto fail;
+
+    results = xmlXPathNodeSetCreate(NULL);
+
+    for (i = 0; nodeset && i < nodeset->nodeNr; i++) {
+	nodep = nodeset->nodeTab[i];
+	position = 0;
+
+	for (childp = nodep->children; childp; childp = childp->next) {
+	    if (childp->type != XML_ELEMENT_NODE)
+		continue;
+
+	    position += 1;
+	    psu_digest_init(&digest, algo);
+	    slaxDigestNode(&digest, childp, flags);
+
+	    newp = slaxDigestMakeNode(container, childp, position,
+				      psu_digest_final_hex(&digest, hex));
+	    if (newp == NULL)
+		continue;
+
+	    xmlXPathNodeSetAddUnique(results, newp);
+	    if (last)
+		xmlAddSibling(last, newp);
+	    else
+		xmlAddChild((xmlNodePtr) container, newp);
+	    last = newp;
+	}
+    }
+
+    valuePush(ctxt, xmlXPathNewNodeSetList(results));
+    xmlXPathFreeNodeSet(results);
+    goto done;
+
+ fail:
+    xmlXPathReturnEmptyString(ctxt);
+
+ done:
+    xmlFreeAndEasy(name);
+    xmlFreeAndEasy(opts);
+    if (xop)
+	xmlXPathFreeObject(xop);
+}
+
+/*
+ * Grouping: slax:distinct(), slax:group-by() and slax:count-by() put
+ * each node in a group based on a key, which is either the node's
+ * string value or the value of an expression evaluated with the node
+ * as the context node.  A hash table maps keys to groups, so the cost
+ * is linear in the number of nodes.  Groups are kept in the order in
+ * which their first member appears, which is document order.
+ */
+typedef struct slax_group_s {
+    xmlNodePtr sg_first;	/* First member of the group */
+    xmlNodePtr sg_node;		/* Result node for this group */
+    unsigned long sg_count;	/* Number of members */
+} slax_group_t;
+
+#define SLAX_GROUP_DISTINCT	1 /* slax:distinct(): first members */
+#define SLAX_GROUP_MEMBERS	2 /* slax:group-by(): copies of members */
+#define SLAX_GROUP_COUNT	3 /* slax:count-by(): member counts */
+
+/*
+ * Return the key for a node, which the caller must free
+ */
+static xmlChar *
+slaxExtGroupKey (xmlXPathParserContextPtr ctxt, xmlXPathCompExprPtr comp,
+		 xmlNodePtr nodep)
+{
+    xmlXPathObjectPtr res;
+    xmlChar *key;
+
+    if (comp == NULL)
+	return xmlXPathCastNodeToString(nodep);
+
+    ctxt->context->node = nodep;
+    ctxt->context->doc = nodep->doc;
+    res = xmlXPathCompiledEval(comp, ctxt->context);
+    if (res == NULL)
+	return NULL;
+
+    key = xmlXPathCastToString(res);
+    xmlXPathFreeObject(res);
+    return key;
+}
+
+/*
+ * Make the result node for a new group
+ */
+static xmlNodePtr
+slaxExtGroupMakeNode (xmlDocPtr container, int mode, const xmlChar *key)
+{
+    xmlNodePtr newp;
+
+    newp = xmlNewDocNode(container, NULL, (const xmlChar *)
+			 ((mode == SLAX_GROUP_COUNT) ? "count" : "group"),
+			 NULL);
+    if (newp == NULL)
+	return NULL;
+
+    xmlSetProp(newp, (const xmlChar *) "key", key);
+    xmlAddChild((xmlNodePtr) container, newp);
+    return newp;
+}
+
+static void
+slaxExtGroup (xmlXPathParserContext *ctxt, int nargs, int mode)
+{
+    xmlXPathContextPtr xpctxt = ctxt->context;
+    xmlXPathObjectPtr xop = NULL;
+    xmlXPathCompExprPtr comp = NULL;
+    xmlHashTablePtr hash = NULL;
+    xmlNodeSetPtr nodeset, results = NULL;
+    xmlDocPtr container = NULL;
+    slax_group_t *groups = NULL, *sgp;
+    size_t count = 0, size = 0, ndx;
+    xmlChar *expr = NULL, *key;
+    xmlNodePtr nodep, copyp;
+    char buf[32];
+    int i;
+
+    if (nargs < 1 || nargs > 2) {
+	xmlXPathSetArityError(ctxt);
+	return;
+    }
+
+    if (nargs == 2)
+	expr = xmlXPathPopString(ctxt);
+
+    xop = valuePop(ctxt);
+    if (xop == NULL || xmlXPathCheckError(ctxt))
+	goto fail;
+
+    if (xop->type != XPATH_NODESET && xop->type != XPATH_XSLT_TREE) {
+	xsltGenericError(xsltGenericErrorContext,
+			 "slax:group: argument must be a node-set\n");
+	goto fail;
+    }
+
+    if (expr && *expr) {
+	comp = xmlXPathCtxtCompile(xpctxt, expr);
+	if (comp == NULL) {
+	    xsltGenericError(xsltGenericErrorContext,
+			     "slax:group: invalid key expression: %s\n", expr);
+	    goto fail;
+	}
+    }
+
+    nodeset = xop->nodesetval;
+    if (nodeset && nodeset->nodeNr > 1)
+	xmlXPathNodeSetSort(nodeset);
+
+    if (mode != SLAX_GROUP_DISTINCT) {
+	container = slaxMakeRtf(ctxt);
+	if (container == NULL)
+	    goto fail;
+    }
+
+    hash = xmlHashCreate(0);
+    results = xmlXPathNodeSetCreate(NULL);
+    if (hash == NULL || results == NULL)
+	goto fail;
+
+    /* The key expression moves the context, so we put it back */
+    xmlNodePtr save_node = xpctxt->node;
+    xmlDocPtr save_doc = xpctxt->doc;
+    int save_position = xpctxt->proximityPosition;
+    int save_size = xpctxt->contextSize;
+
+    for (i = 0; nodeset && i < nodeset->nodeNr; i++) {
+	nodep = nodeset->nodeTab[i];
+
+	xpctxt->proximityPosition = i + 1;
+	xpctxt->contextSize = nodeset->nodeNr;
+	key = slaxExtGroupKey(ctxt, comp, nodep);
+	if (key == NULL)
+	    break;
+
+	/* The hash holds the group number plus one, since NULL is "none" */
+	ndx = (size_t) xmlHashLookup(hash, key);
+	if (ndx == 0) {
+	    if (count == size) {
+		size_t nsize = size ? size * 2 : 64;
+		sgp = xmlRealloc(groups, nsize * sizeof(*sgp));
+		if (sgp == NULL) {
+		    xmlFree(key);
+		    break;
+		}
+		groups = sgp;
+		size = nsize;
+	    }
+
+	    ndx = ++count;
+	    sgp = &groups[ndx - 1];
+	    sgp->sg_first = nodep;
+	    sgp->sg_count = 0;
+	    sgp->sg_node = container
+		? slaxExtGroupMakeNode(container, mode, key) : NULL;
+
+	    if (xmlHashAddEntry(hash, key, (void *) ndx) < 0) {
+		xmlFree(key);
+		break;
+	    }
+	}
+	xmlFree(key);
+
+	sgp = &groups[ndx - 1];
+	sgp->sg_count += 1;
+
+	if (mode == SLAX_GROUP_MEMBERS && sgp->sg_node) {
+	    copyp = xmlDocCopyNode(nodep, container, 1);
+	    if (copyp)
+		xmlAddChild(sgp->sg_node, copyp);
+	}
+    }
+
+    xpctxt->node = save_node;
+    xpctxt->doc = save_doc;
+    xpctxt->proximityPosition = save_position;
+    xpctxt->contextSize = save_size;
+
+    for (ndx = 0; ndx < count; ndx++) {
+	sgp = &groups[ndx];
+
+	if (mode == SLAX_GROUP_DISTINCT) {
+	    xmlXPathNodeSetAddUnique(results, sgp->sg_first);
+	    continue;
+	}
+
+	if (sgp->sg_node == NULL)
+	    continue;
+
+	snprintf(buf, sizeof(buf), "%lu", sgp->sg_count);
+	if (mode == SLAX_GROUP_COUNT)
+	    xmlNodeAddContent(sgp->sg_node, (const xmlChar *) buf);
+	else
+	    xmlSetProp(sgp->sg_node, (const xmlChar *) "count",
+		       (const xmlChar *) buf);
+
+	xmlXPathNodeSetAddUnique(results, sgp->sg_node);
+    }
+
+    valuePush(ctxt, xmlXPathWrapNodeSet(results));
+    results = NULL;
+    goto done;
+
+ fail:
+    valuePush(ctxt, xmlXPathNewNodeSet(NULL));
+
+ done:
+    if (results)
+	xmlXPathFreeNodeSet(results);
+    if (hash)
+	xmlHashFree(hash, NULL);
+    xmlFreeAndEasy(groups);
+    if (comp)
+	xmlXPathFreeCompExpr(comp);
+    xmlFreeAndEasy(expr);
+    if (xop)
+	xmlXPathFreeObject(xop);
+}
+
+/*
+ * Return the first node with each distinct key
+ *
+ * Usage:
+ *     var $hops = slax:distinct($routes/route/next-hop);
+ *     var $first = slax:distinct($routes/route, "next-hop");
+ */
+static void
+slaxExtDistinct (xmlXPathParserContext *ctxt, int nargs)
+{
+    slaxExtGroup(ctxt, nargs, SLAX_GROUP_DISTINCT);
+}
+
+/*
+ * Return a <group key="..." count="N"> element for each distinct
+ * key, holding copies of the nodes with that key
+ *
+ * Usage:
+ *     for-each (slax:group-by($routes/route, "next-hop")) {
+ *         <hop name=@key> count(route);
+ *     }
+ */
+static void
+slaxExtGroupBy (xmlXPathParserContext *ctxt, int nargs)
+{
+    slaxExtGroup(ctxt, nargs, SLAX_GROUP_MEMBERS);
+}
+
+/*
+ * Return a <count key="...">N</count> element for each distinct key
+ *
+ * Usage:
+ *     var $summary = slax:count-by($routes/route, "next-hop");
+ */
+static void
+slaxExtCountBy (xmlXPathParserContext *ctxt, int nargs)
+{
+    slaxExtGroup(ctxt, nargs, SLAX_GROUP_COUNT);
+}
+
+/*
+ * Helper function for slaxExtSyslog() to decode the given priority.
+ *
+ */
+static int
+slaxExtDecode (const char *name, CODE *codetab)
+{
+    CODE *c;
+
+    for (c = codetab; c->c_name; c++)
+	if (!strcasecmp(name, c->c_name))
+	    return c->c_val;
+
+    return -1;
+}
+
+static int
+slaxExtDecode2 (const char *name, XCODE *codetab)
+{
+    XCODE *c;
+
+    for (c = codetab; c->c_name; c++)
+	if (!strcasecmp(name, c->c_name))
+	    return c->c_val;
+
+    return -1;
+}
+
+/*
+ * Helper function for slaxExtSyslog() to decode the given priority.
+ *
+ */
+int
+slaxExtDecodePriority (const char *priority)
+{
+    int pri, sev;
+    int fac = LOG_USER;
+    char *cp;
+	
+    if (isdigit((int) *priority)) {
+	pri = atoi(priority);
+
+	fac = LOG_FAC(pri);
+	sev = LOG_PRI(pri);
+
+	if (fac >= LOG_NFACILITIES) {
+	    xsltGenericError(xsltGenericErrorContext,
+			     "syslog error: Invalid facility number\n");
+	    return -1;
+	}
+
+	/*
+	 * Sadly, there's no LOG_NPRIORITIES to test, like:
+	 *   sev = LOG_PRI(pri);
+	 *   if (sev >= LOG_NPRIORITIES) { ... }
+	 * We blindly take what we're given.
+	 */
+
+	return pri;
+    }
+
+    cp = strchr(priority, '.');
+
+    if (cp) {
+	*cp = '\0';
+	
+	fac = slaxExtDecode2(priority, junos_facilitynames);
+	if (fac < 0)
+	    fac = slaxExtDecode(priority, facilitynames);
+	if (fac < 0) {
+	    xsltGenericError(xsltGenericErrorContext,
+			     "syslog error: Unknown facility name: %s\n",
+			     priority);
+	    return -1;
+	}
+
+	*cp++ = '.';
+    }
+
+    sev = slaxExtDecode(cp ?: priority, prioritynames);
+    if (sev < 0) {
+	xsltGenericError(xsltGenericErrorContext,
+			 "syslog error: Unknown severity name: %s\n",
+			 cp ?: priority);
+	return -1;
+    }
+
+    return (LOG_MAKEPRI_REAL(fac, sev));
+}
+
+/* ----------------------------------------------------------------------
+ * Direct syslog output
+ *
+ * syslog(3) makes one send() per message, which hurts scripts that
+ * log per-interface or per-route.  slaxSyslogOpen() lets the caller
+ * talk directly to the syslog socket instead, coalescing messages
+ * until a byte or age threshold is reached, or until the caller
+ * flushes them (typically at the end of the transform).  Each
+ * buffered message is still sent as its own datagram, but they go
+ * out in batches using sendmmsg(2) where available.
+ *
+ * The same machinery provides RFC 5424 output for
+ * slax:syslog-structured(), since syslog(3) cannot carry
+ * structured data.
+ */
+
+#ifndef _PATH_LOG
+#define _PATH_LOG "/dev/log"
+#endif /* _PATH_LOG */
+
+#define SLAX_SYSLOG_IDENT	"slax" /* Default tag/app-name */
+#define SLAX_SYSLOG_BATCH	64     /* Messages per sendmmsg() call */
+#define SLAX_SYSLOG_SD_NAME_MAX	32     /* Max length of SD-NAME (5424) */
+#define SLAX_SYSLOG_NILVALUE	"-"    /* RFC 5424 NILVALUE */
+
+typedef struct slax_syslog_s {
+    int ss_sock;		/* Socket to syslogd (or -1) */
+    int ss_direct;		/* slax:syslog bypasses syslog(3) */
+    char *ss_path;		/* Path to syslog socket */
+    char *ss_ident;		/* Tag/app-name for our messages */
+    char ss_hostname[MAXHOSTNAMELEN]; /* Hostname for RFC 5424 */
+    size_t ss_max_bytes;	/* Flush when buffer reaches this size */
+    unsigned ss_max_msecs;	/* Flush when oldest message is this old */
+    struct timeval ss_first;	/* Time of the oldest buffered message */
+    char *ss_buf;		/* Buffered messages (NUL separated) */
+    size_t ss_len;		/* Bytes used in ss_buf */
+    size_t ss_size;		/* Bytes allocated for ss_buf */
+    unsigned ss_count;		/* Number of buffered messages */
+} slax_syslog_t;
+
+static THREAD_GLOBAL(slax_syslog_t) slaxSyslogState = { .ss_sock = -1 };
+
+static int
+slaxSyslogConnect (slax_syslog_t *ssp)
+{
+    struct sockaddr_un sun;
+    const char *path = ssp->ss_path ?: _PATH_LOG;
+
+    if (ssp->ss_sock >= 0)
+	return 0;
+
+    if (strlen(path) >= sizeof(sun.sun_path)) {
+	slaxLog("syslog: socket path too long: %s", path);
+	return -1;
+    }
+
+    bzero(&sun, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strlcpy(sun.sun_path, path, sizeof(sun.sun_path));
+
+    ssp->ss_sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (ssp->ss_sock < 0) {
+	slaxLog("syslog: socket failed: %s", strerror(errno));
+	return -1;
+    }
+
+    fcntl(ssp->ss_sock, F_SETFD, FD_CLOEXEC);
+
+    if (connect(ssp->ss_sock, (struct sockaddr *) &sun, sizeof(sun)) < 0) {
+	slaxLog("syslog: connect to '%s' failed: %s", path, strerror(errno));
+	close(ssp->ss_sock);
+	ssp->ss_sock = -1;
+	return -1;
+    }
+
+    if (ssp->ss_hostname[0] == '\0'
+	    && gethostname(ssp->ss_hostname, sizeof(ssp->ss_hostname)) < 0)
+	strlcpy(ssp->ss_hostname, SLAX_SYSLOG_NILVALUE,
+		sizeof(ssp->ss_hostname));
+    ssp->ss_hostname[sizeof(ssp->ss_hostname) - 1] = '\0';
+
+    return 0;
+}
+
+/*
+ * Send a batch of messages; returns the number of messages sent
+ */
+static int
+slaxSyslogSend (slax_syslog_t *ssp, struct iovec *iov, int count)
+{
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgs[SLAX_SYSLOG_BATCH];
+    int i, rc;
+
+    bzero(msgs, count * sizeof(msgs[0]));
+    for (i = 0; i < count; i++) {
+	msgs[i].msg_hdr.msg_iov = &iov[i];
+	msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    for (i = 0; i < count; i += rc) {
+	rc = sendmmsg(ssp->ss_sock, msgs + i, count - i, 0);
+	if (rc <= 0)
+	    break;
+    }
+
+    return i;
+#else /* HAVE_SENDMMSG */
+    int i;
+
+    for (i = 0; i < count; i++)
+	if (send(ssp->ss_sock, iov[i].iov_base, iov[i].iov_len, 0) < 0)
+	    break;
+
+    return i;
+#endif /* HAVE_SENDMMSG */
+}
+
+/*
+ * Send everything we've buffered, in batches.  If syslogd has gone
+ * away (or been restarted), we reconnect once before giving up.
+ */
+static void
+slaxSyslogFlushBuffer (slax_syslog_t *ssp)
+{
+    struct iovec iov[SLAX_SYSLOG_BATCH];
+    char *cp = ssp->ss_buf, *ep = ssp->ss_buf + ssp->ss_len;
+    int count, sent, retried = FALSE;
+    unsigned delivered = 0;
+
+    while (cp < ep) {
+	char *start = cp;
+
+	for (count = 0; count < SLAX_SYSLOG_BATCH && cp < ep; count++) {
+	    iov[count].iov_base = cp;
+	    iov[count].iov_len = strlen(cp);
+	    cp += iov[count].iov_len + 1;
+	}
+
+	sent = (ssp->ss_sock >= 0) ? slaxSyslogSend(ssp, iov, count) : 0;
+	delivered += sent;
+	if (sent == count)
+	    continue;
+
+	if (!retried) {
+	    retried = TRUE;
+	    if (ssp->ss_sock >= 0) {
+		close(ssp->ss_sock);
+		ssp->ss_sock = -1;
+	    }
+
+	    if (slaxSyslogConnect(ssp) == 0) {
+		/* Back up to the first unsent message and try again */
+		cp = sent ? iov[sent].iov_base : start;
+		continue;
+	    }
+	}
+
+	slaxLog("syslog: dropped %u messages", ssp->ss_count - delivered);
+	break;
+    }
+
+    ssp->ss_len = 0;
+    ssp->ss_count = 0;
+}
+
+static int
+slaxSyslogReserve (slax_syslog_t *ssp, size_t len)
+{
+    size_t size;
+    char *newp;
+
+    if (ssp->ss_len + len <= ssp->ss_size)
+	return 0;
+
+    size = ssp->ss_size ? ssp->ss_size : BUFSIZ;
+    while (size < ssp->ss_len + len)
+	size <<= 1;
+
+    newp = xmlRealloc(ssp->ss_buf, size);
+    if (newp == NULL)
+	return -1;
+
+    ssp->ss_buf = newp;
+    ssp->ss_size = size;
+    return 0;
+}
+
+static void
+slaxSyslogAdd (slax_syslog_t *ssp, const char *data, size_t len)
+{
+    if (slaxSyslogReserve(ssp, len) == 0) {
+	memcpy(ssp->ss_buf + ssp->ss_len, data, len);
+	ssp->ss_len += len;
+    }
+}
+
+static void
+slaxSyslogAddString (slax_syslog_t *ssp, const char *str)
+{
+    slaxSyslogAdd(ssp, str, strlen(str));
+}
+
+/*
+ * Append a PARAM-VALUE, escaping the three characters RFC 5424 requires
+ */
+static void
+slaxSyslogAddSdValue (slax_syslog_t *ssp, const xmlChar *value)
+{
+    const char *cp, *sp;
+
+    if (value == NULL)
+	return;
+
+    for (cp = sp = (const char *) value; *cp; cp++) {
+	if (*cp == '"' || *cp == '\\' || *cp == ']') {
+	    slaxSyslogAdd(ssp, sp, cp - sp);
+	    slaxSyslogAdd(ssp, "\\", 1);
+	    sp = cp;
+	}
+    }
+
+    slaxSyslogAdd(ssp, sp, cp - sp);
+}
+
+/*
+ * Append an SD-ID or PARAM-NAME.  These are restricted to printable
+ * ASCII minus '=', ']', '"' and space, so we map anything else to '_'.
+ */
+static void
+slaxSyslogAddSdName (slax_syslog_t *ssp, const xmlChar *name)
+{
+    int i;
+    char ch;
+
+    for (i = 0; name[i] && i < SLAX_SYSLOG_SD_NAME_MAX; i++) {
+	ch = name[i];
+	if (ch <= ' ' || ch >= 127 || ch == '=' || ch == ']' || ch == '"')
+	    ch = '_';
+	slaxSyslogAdd(ssp, &ch, 1);
+    }
+}
+
+static void
+slaxSyslogAddSdParam (slax_syslog_t *ssp, const xmlChar *name,
+		      xmlChar *value)
+{
+    slaxSyslogAdd(ssp, " ", 1);
+    slaxSyslogAddSdName(ssp, name);
+    slaxSyslogAdd(ssp, "=\"", 2);
+    slaxSyslogAddSdValue(ssp, value);
+    slaxSyslogAdd(ssp, "\"", 1);
+
+    if (value)
+	xmlFree(value);
+}
+
+/*
+ * Turn an element into an SD-ELEMENT.  The SD-ID is the "id"
+ * attribute, if any, or the element name.  Other attributes and
+ * any child elements become SD-PARAMs.
+ */
+static void
+slaxSyslogAddSdElement (slax_syslog_t *ssp, xmlNodePtr nodep)
+{
+    xmlAttrPtr attr;
+    xmlNodePtr childp;
+    xmlChar *id;
+
+    slaxSyslogAdd(ssp, "[", 1);
+    id = xmlGetProp(nodep, (const xmlChar *) "id");
+    slaxSyslogAddSdName(ssp, id ?: nodep->name);
+    if (id)
+	xmlFree(id);
+
+    for (attr = nodep->properties; attr; attr = attr->next) {
+	if (streq((const char *) attr->name, "id"))
+	    continue;
+	slaxSyslogAddSdParam(ssp, attr->name,
+			     xmlNodeListGetString(nodep->doc,
+						  attr->children, 1));
+    }
+
+    for (childp = nodep->children; childp; childp = childp->next) {
+	if (childp->type == XML_ELEMENT_NODE)
+	    slaxSyslogAddSdParam(ssp, childp->name, xmlNodeGetContent(childp));
+    }
+
+    slaxSyslogAdd(ssp, "]", 1);
+}
+
+/*
+ * Append the STRUCTURED-DATA field, built from either a node-set
+ * of elements (or an RTF containing them) or a preformatted string.
+ */
+static void
+slaxSyslogAddSd (slax_syslog_t *ssp, xmlXPathObjectPtr xop)
+{
+    xmlNodeSetPtr nodeset;
+    xmlNodePtr nodep, childp;
+    size_t start = ssp->ss_len;
+    int i;
+
+    if (xop->type == XPATH_STRING) {
+	if (xop->stringval && *xop->stringval)
+	    slaxSyslogAddString(ssp, (const char *) xop->stringval);
+
+    } else if (xop->type == XPATH_NODESET || xop->type == XPATH_XSLT_TREE) {
+	nodeset = xop->nodesetval;
+
+	for (i = 0; nodeset && i < nodeset->nodeNr; i++) {
+	    nodep = nodeset->nodeTab[i];
+	    if (nodep->type == XML_ELEMENT_NODE) {
+		slaxSyslogAddSdElement(ssp, nodep);
+
+	    } else if (nodep->type == XML_DOCUMENT_NODE) {
+		for (childp = nodep->children; childp; childp = childp->next)
+		    if (childp->type == XML_ELEMENT_NODE)
+			slaxSyslogAddSdElement(ssp, childp);
+	    }
+	}
+    }
+
+    if (ssp->ss_len == start)
+	slaxSyslogAddString(ssp, SLAX_SYSLOG_NILVALUE);
+}
+
+/*
+ * Start a new message in the buffer, flushing what's already there
+ * if it has gotten too old.
+ */
+static void
+slaxSyslogStart (slax_syslog_t *ssp)
+{
+    struct timeval now;
+
+    if (ssp->ss_count == 0) {
+	gettimeofday(&ssp->ss_first, NULL);
+
+    } else if (ssp->ss_max_msecs) {
+	gettimeofday(&now, NULL);
+	if ((now.tv_sec - ssp->ss_first.tv_sec) * 1000
+	        + (now.tv_usec - ssp->ss_first.tv_usec) / 1000
+	        >= (long) ssp->ss_max_msecs) {
+	    slaxSyslogFlushBuffer(ssp);
+	    ssp->ss_first = now;
 	}
+    }
+}
 
-	strp += pmatch[0].rm_eo;
-
-	if (newp) {
-	    xmlXPathNodeSetAdd(results, newp);
+/*
+ * Finish the current message, flushing if we've hit our size
+ * limit (or we're not buffering at all).
+ */
+static void
+slaxSyslogFinish (slax_syslog_t *ssp)
+{
+    slaxSyslogAdd(ssp, "", 1);
+    ssp->ss_count += 1;
 
-	    if (last)
-		xmlAddSibling(last, newp);
+    if (ssp->ss_len >= ssp->ss_max_bytes)
+	slaxSyslogFlushBuffer(ssp);
+}
 
-	    xmlAddChild((xmlNodePtr) container, newp);
-	    last = newp;
-	}
+static int
+slaxSyslogFixPriority (int pri)
+{
+    /* Like syslog(3), a missing facility means LOG_USER */
+    if ((pri & LOG_FACMASK) == 0)
+	pri |= LOG_USER;
+    return pri;
+}
 
-	if (limit != -1)
-	    limit -= 1;
-    }
+/*
+ * Queue a traditional (RFC 3164-style) message, formatted as
+ * syslog(3) would have done.
+ */
+static void
+slaxSyslogMessage (slax_syslog_t *ssp, int pri, const char *msg)
+{
+    char buf[BUFSIZ];
+    time_t now;
+    struct tm tm;
+    size_t len;
+
+    slaxSyslogStart(ssp);
+
+    now = time(NULL);
+    localtime_r(&now, &tm);
+    len = snprintf(buf, sizeof(buf), "<%d>", slaxSyslogFixPriority(pri));
+    len += strftime(buf + len, sizeof(buf) - len, "%b %e %H:%M:%S ", &tm);
+    if (len < sizeof(buf))
+	len += snprintf(buf + len, sizeof(buf) - len, "%s[%d]: ",
+			ssp->ss_ident ?: SLAX_SYSLOG_IDENT, (int) getpid());
+    if (len >= sizeof(buf))
+	len = sizeof(buf) - 1;
+
+    slaxSyslogAdd(ssp, buf, len);
+    slaxSyslogAddString(ssp, msg);
+    slaxSyslogFinish(ssp);
+}
 
-    if (rc && rc != REG_NOMATCH)
-	goto fail;
+/*
+ * Queue an RFC 5424 message:
+ *   <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA MSG
+ */
+static void
+slaxSyslogStructured (slax_syslog_t *ssp, int pri, const char *msgid,
+		      xmlXPathObjectPtr sd, const char *msg)
+{
+    char buf[BUFSIZ];
+    struct timeval tv;
+    struct tm tm;
+    size_t len;
 
-    newp = slaxExtMakeTextNode(container, NULL, "split", strp, endp - strp);
-    if (newp) {
-	xmlXPathNodeSetAdd(results, newp);
+    slaxSyslogStart(ssp);
 
-	if (last)
-	    xmlAddSibling(last, newp);
-	xmlAddChild((xmlNodePtr) container, newp);
+    gettimeofday(&tv, NULL);
+    gmtime_r(&tv.tv_sec, &tm);
+    len = snprintf(buf, sizeof(buf), "<%d>1 ", slaxSyslogFixPriority(pri));
+    len += strftime(buf + len, sizeof(buf) - len, "%Y-%m-%dT%H:%M:%S", &tm);
+    if (len < sizeof(buf))
+	len += snprintf(buf + len, sizeof(buf) - len, ".%06ldZ %s %s %d %s ",
+			(long) tv.tv_usec, ssp->ss_hostname,
+			ssp->ss_ident ?: SLAX_SYSLOG_IDENT, (int) getpid(),
+			(msgid && *msgid) ? msgid : SLAX_SYSLOG_NILVALUE);
+    if (len >= sizeof(buf))
+	len = sizeof(buf) - 1;
+
+    slaxSyslogAdd(ssp, buf, len);
+    slaxSyslogAddSd(ssp, sd);
+    if (msg && *msg) {
+	slaxSyslogAdd(ssp, " ", 1);
+	slaxSyslogAddString(ssp, msg);
     }
+    slaxSyslogFinish(ssp);
+}
 
- done:
-    regfree(&reg);
-    xmlFree(string);
-    xmlFree(pattern);
+/*
+ * Send slax:syslog messages directly to the syslog socket at "path"
+ * (or the system default), using "ident" as the tag.  Messages are
+ * buffered until "max_bytes" are pending or the oldest is "max_msecs"
+ * old; a zero "max_bytes" means each message is sent immediately.
+ * Buffered messages are sent by slaxSyslogFlush() and slaxSyslogClose().
+ * Returns 0 on success and -1 if the socket cannot be reached.
+ */
+int
+slaxSyslogOpen (const char *path, const char *ident,
+		size_t max_bytes, unsigned max_msecs)
+{
+    slax_syslog_t *ssp = &slaxSyslogState;
 
-    ret = xmlXPathNewNodeSetList(results);
-    valuePush(ctxt, ret);
-    xmlXPathFreeNodeSet(results);
-    return;
+    slaxSyslogClose();
 
- fail:
+    ssp->ss_path = path ? xmlStrdup2(path) : NULL;
+    ssp->ss_ident = ident ? xmlStrdup2(ident) : NULL;
+    ssp->ss_max_bytes = max_bytes;
+    ssp->ss_max_msecs = max_msecs;
 
-    regerror(rc, &reg, buf, sizeof(buf));
-    xsltGenericError(xsltGenericErrorContext, "regex error: %s\n", buf);
-    goto done;
+    if (slaxSyslogConnect(ssp) < 0)
+	return -1;
+
+    ssp->ss_direct = TRUE;
+    return 0;
 }
 
 /*
- * Helper function for slaxExtSyslog() to decode the given priority.
- *
+ * Send any buffered syslog messages
  */
-static int
-slaxExtDecode (const char *name, CODE *codetab)
+void
+slaxSyslogFlush (void)
 {
-    CODE *c;
-
-    for (c = codetab; c->c_name; c++)
-	if (!strcasecmp(name, c->c_name))
-	    return c->c_val;
+    slax_syslog_t *ssp = &slaxSyslogState;
 
-    return -1;
+    if (ssp->ss_count)
+	slaxSyslogFlushBuffer(ssp);
 }
 
-static int
-slaxExtDecode2 (const char *name, XCODE *codetab)
+/*
+ * Flush buffered messages and return to using syslog(3)
+ */
+void
+slaxSyslogClose (void)
 {
-    XCODE *c;
+    slax_syslog_t *ssp = &slaxSyslogState;
 
-    for (c = codetab; c->c_name; c++)
-	if (!strcasecmp(name, c->c_name))
-	    return c->c_val;
+    slaxSyslogFlush();
 
-    return -1;
+    if (ssp->ss_sock >= 0)
+	close(ssp->ss_sock);
+    xmlFreeAndEasy(ssp->ss_path);
+    xmlFreeAndEasy(ssp->ss_ident);
+    xmlFreeAndEasy(ssp->ss_buf);
+
+    bzero(ssp, sizeof(*ssp));
+    ssp->ss_sock = -1;
 }
 
 /*
- * Helper function for slaxExtSyslog() to decode the given priority.
+ * Usage:
+ *      expr slax:syslog-structured(priority, msgid, $sd, "message ", $text);
  *
+ * Logs an RFC 5424 message, with the given MSGID and structured data.
+ * Each element in $sd becomes an SD-ELEMENT, where the "id" attribute
+ * (or the element name) gives the SD-ID and the remaining attributes
+ * and child elements give the SD-PARAMs.  A string argument is used
+ * as preformatted structured data.  The remaining arguments make the
+ * message, as with slax:syslog().
  */
-int
-slaxExtDecodePriority (const char *priority)
+static void
+slaxExtSyslogStructured (xmlXPathParserContext *ctxt, int nargs)
 {
-    int pri, sev;
-    int fac = LOG_USER;
-    char *cp;
-	
-    if (isdigit((int) *priority)) {
-	pri = atoi(priority);
-
-	fac = LOG_FAC(pri);
-	sev = LOG_PRI(pri);
+    slax_syslog_t *ssp = &slaxSyslogState;
+    xmlChar *strstack[nargs];	/* Stack for strings */
+    xmlXPathObjectPtr sd = NULL;
+    xmlChar *priority = NULL, *msgid = NULL;
+    int ndx, pri;
+    slax_printf_buffer_t pb;
 
-	if (fac >= LOG_NFACILITIES) {
-	    xsltGenericError(xsltGenericErrorContext,
-			     "syslog error: Invalid facility number\n");
-	    return -1;
-	}
+    if (nargs < 3) {
+	xmlXPathSetArityError(ctxt);
+	return;
+    }
 
-	/*
-	 * Sadly, there's no LOG_NPRIORITIES to test, like:
-	 *   sev = LOG_PRI(pri);
-	 *   if (sev >= LOG_NPRIORITIES) { ... }
-	 * We blindly take what we're given.
-	 */
+    bzero(&pb, sizeof(pb));
 
-	return pri;
+    bzero(strstack, sizeof(strstack));
+    for (ndx = nargs - 1; ndx >= 3; ndx--) {
+	strstack[ndx] = xmlXPathPopString(ctxt);
+	if (xmlXPathCheckError(ctxt))
+	    goto bail;
     }
 
-    cp = strchr(priority, '.');
+    sd = valuePop(ctxt);
+    msgid = xmlXPathPopString(ctxt);
+    priority = xmlXPathPopString(ctxt);
+    if (sd == NULL || priority == NULL || xmlXPathCheckError(ctxt))
+	goto bail;
 
-    if (cp) {
-	*cp = '\0';
-	
-	fac = slaxExtDecode2(priority, junos_facilitynames);
-	if (fac < 0)
-	    fac = slaxExtDecode(priority, facilitynames);
-	if (fac < 0) {
-	    xsltGenericError(xsltGenericErrorContext,
-			     "syslog error: Unknown facility name: %s\n",
-			     priority);
-	    return -1;
-	}
+    pri = slaxExtDecodePriority((char *) priority);
+    if (pri < 0)
+	goto bail;
 
-	*cp++ = '.';
+    for (ndx = 3; ndx < nargs; ndx++) {
+	xmlChar *str = strstack[ndx];
+	if (str == NULL)
+	    continue;
+
+	slaxExtPrintAppend(&pb, str, xmlStrlen(str));
     }
 
-    sev = slaxExtDecode(cp ?: priority, prioritynames);
-    if (sev < 0) {
-	xsltGenericError(xsltGenericErrorContext,
-			 "syslog error: Unknown severity name: %s\n",
-			 cp ?: priority);
-	return -1;
+    if (slaxSyslogConnect(ssp) == 0)
+	slaxSyslogStructured(ssp, pri, (char *) msgid, sd, pb.pb_buf);
+
+bail:
+    xmlFreeAndEasy(pb.pb_buf);
+    xmlFreeAndEasy(msgid);
+    xmlFreeAndEasy(priority);
+    if (sd)
+	xmlXPathFreeObject(sd);
+
+    for (ndx = nargs - 1; ndx >= 3; ndx--) {
+	if (strstack[ndx])
+	    xmlFree(strstack[ndx]);
     }
 
-    return (LOG_MAKEPRI_REAL(fac, sev));
+    /*
+     * Nothing to return, we just push NULL
+     */
+    valuePush(ctxt, xmlXPathNewNodeSet(NULL));
 }
 
 /*
@@ -1815,7 +3392,10 @@ slaxExtSyslog (xmlXPathParserContext *ctxt, int nargs)
     }
 
     if (pb.pb_buf && pri) {
-	syslog(pri, "%s", pb.pb_buf);
+	if (slaxSyslogState.ss_direct)
+	    slaxSyslogMessage(&slaxSyslogState, pri, pb.pb_buf);
+	else
+	    syslog(pri, "%s", pb.pb_buf);
 	xmlFree(pb.pb_buf);
     }
 
@@ -2341,103 +3921,345 @@ slaxExtDocumentOptions (struct slaxDocumentOptions *sdop,
     }
 }
 
+/*
+ * slax:document() output is "cooked" as it arrives: base64 decoding,
+ * removal of carriage returns, and rewriting of non-xml characters
+ * are done in a single pass over the input, appending directly to
+ * the buffer that becomes the returned string.  The slax:base64-*
+ * functions use the same machinery, and can direct the output to a
+ * file instead of the buffer.
+ */
+typedef struct slax_document_cook_s {
+    struct slaxDocumentOptions *dc_opts; /* Options for this document */
+    psu_base64_state_t dc_base64; /* Incremental base64 coder state */
+    char *dc_buf;		/* Output buffer (returned as string) */
+    size_t dc_len;		/* Number of bytes used in dc_buf (or written) */
+    size_t dc_size;		/* Number of bytes allocated (minus NUL) */
+    FILE *dc_fp;		/* Output file (instead of dc_buf) */
+    int dc_failed;		/* Allocation (or write) failure seen */
+} slax_document_cook_t;
+
+/* Size of the input chunks we base64 decode at a time */
+#define SLAX_DOCUMENT_CHUNK	(16 * 1024)
+
+static int
+slaxExtDocumentCookExpand (slax_document_cook_t *dcp, size_t need)
+{
+    size_t size;
+    char *newp;
+
+    if (dcp->dc_failed)
+	return TRUE;
+
+    if (dcp->dc_len + need <= dcp->dc_size)
+	return FALSE;
+
+    size = dcp->dc_size ? dcp->dc_size : BUFSIZ;
+    while (size < dcp->dc_len + need)
+	size <<= 1;
+
+    newp = xmlRealloc(dcp->dc_buf, size + 1); /* Add 1 for NUL */
+    if (newp == NULL) {
+	dcp->dc_failed = TRUE;
+	return TRUE;
+    }
+
+    dcp->dc_buf = newp;
+    dcp->dc_size = size;
+    return FALSE;
+}
+
 static void
-slaxExtRewriteNonXmlCharacters (char **datap, size_t *lenp,
-				 const xmlChar *non_xml)
+slaxExtDocumentCookInit (slax_document_cook_t *dcp,
+			 struct slaxDocumentOptions *sdop, size_t hint)
 {
-    char *data = *datap;
-    size_t len = *lenp;
-    char *cp;
-    size_t i;
-
-    if (non_xml[0] == '\0') {
-	/* If the string is empty, remove non-xml characters */
-	char *op;
-	for (i = 0, op = cp = data; i < len; i++, cp++)
-	    if (xmlIsChar_ch(*cp))
-		*op++ = *cp;
-	*op = '\0';
-	len = op - data;
-
-    } else if (non_xml[1] == '\0') {
-	/* If the string is length == 1 , replace non-xml characters */
-	for (i = 0, cp = data; i < len; i++, cp++)
-	    if (!xmlIsChar_ch(*cp))
-		*cp = non_xml[0];
+    bzero(dcp, sizeof(*dcp));
+    dcp->dc_opts = sdop;
+    psu_base64_state_init(&dcp->dc_base64);
+
+    /* Base64 decoded data is three quarters the size of the input */
+    if (sdop->sdo_base64)
+	hint = PSU_BASE64_DECODE_MAX(hint);
+
+    /* When we know the size, allocate exactly that, not a power of two */
+    if (hint) {
+	dcp->dc_buf = xmlMalloc(hint + 1); /* Add 1 for NUL */
+	if (dcp->dc_buf)
+	    dcp->dc_size = hint;
+    }
+}
 
-    } else {
-	int count;
+/*
+ * Append (decoded) data to the output buffer, removing carriage
+ * returns and rewriting non-xml characters as directed by the options.
+ */
+static void
+slaxExtDocumentCookFilter (slax_document_cook_t *dcp,
+			   const char *data, size_t len)
+{
+    struct slaxDocumentOptions *sdop = dcp->dc_opts;
+    const xmlChar *non_xml = sdop->sdo_non_xml;
+    size_t add = non_xml ? xmlStrlen(non_xml) : 0;
+    const char *cp, *ep = data + len;
+    char *op;
+
+    /* Files get the data as-is; filtering is for XML-bound strings */
+    if (dcp->dc_fp) {
+	if (len && !dcp->dc_failed) {
+	    if (fwrite(data, 1, len, dcp->dc_fp) != len)
+		dcp->dc_failed = TRUE;
+	    dcp->dc_len += len;
+	}
+	return;
+    }
+
+    if (len == 0 || slaxExtDocumentCookExpand(dcp, len))
+	return;
+
+    /* The dull (and common) case is just a copy */
+    if (sdop->sdo_retain_returns && non_xml == NULL) {
+	memcpy(dcp->dc_buf + dcp->dc_len, data, len);
+	dcp->dc_len += len;
+	return;
+    }
+
+    op = dcp->dc_buf + dcp->dc_len;
+    for (cp = data; cp < ep; cp++) {
+	if (*cp == '\r' && !sdop->sdo_retain_returns)
+	    continue;
+
+	if (non_xml == NULL || xmlIsChar_ch(*cp)) {
+	    *op++ = *cp;
+	    continue;
+	}
+
+	/*
+	 * The non-xml value is the text used to replace all non-xml
+	 * characters, since XML documents cannot contain some control
+	 * characters (which is exceedingly lame).  An empty string
+	 * removes them.
+	 */
+	if (add > 1) {
+	    /* Recompute space needed, since the buffer may move */
+	    dcp->dc_len = op - dcp->dc_buf;
+	    if (slaxExtDocumentCookExpand(dcp, (ep - cp) + add))
+		return;
+	    op = dcp->dc_buf + dcp->dc_len;
+	}
+
+	memcpy(op, non_xml, add);
+	op += add;
+    }
+
+    dcp->dc_len = op - dcp->dc_buf;
+}
+
+static void
+slaxExtDocumentCookData (slax_document_cook_t *dcp,
+			 const char *data, size_t len)
+{
+    char buf[PSU_BASE64_DECODE_MAX(SLAX_DOCUMENT_CHUNK)];
+    size_t chunk, dlen;
+
+    if (!dcp->dc_opts->sdo_base64) {
+	slaxExtDocumentCookFilter(dcp, data, len);
+	return;
+    }
+
+    while (len > 0) {
+	chunk = (len < SLAX_DOCUMENT_CHUNK) ? len : SLAX_DOCUMENT_CHUNK;
+	dlen = psu_base64_decode_chunk(&dcp->dc_base64, data, chunk, buf);
+	slaxExtDocumentCookFilter(dcp, buf, dlen);
+
+	data += chunk;
+	len -= chunk;
+    }
+}
+
+/*
+ * Flush any partial base64 quantum held in the decoder
+ */
+static void
+slaxExtDocumentCookFlush (slax_document_cook_t *dcp)
+{
+    char buf[PSU_BASE64_DECODE_MAX(0)];
+    size_t dlen;
+
+    if (dcp->dc_opts->sdo_base64) {
+	dlen = psu_base64_decode_finish(&dcp->dc_base64, buf);
+	slaxExtDocumentCookFilter(dcp, buf, dlen);
+    }
+}
+
+/*
+ * Finish cooking, returning the NUL-terminated output buffer
+ */
+static char *
+slaxExtDocumentCookFinish (slax_document_cook_t *dcp)
+{
+    slaxExtDocumentCookFlush(dcp);
+
+    /*
+     * Ensure we have a buffer, even for empty documents.  There's
+     * always room for the NUL, since we allocate one extra byte.
+     */
+    if (dcp->dc_failed
+	    || (dcp->dc_buf == NULL && slaxExtDocumentCookExpand(dcp, 1))) {
+	xmlFreeAndEasy(dcp->dc_buf);
+	return NULL;
+    }
+
+    dcp->dc_buf[dcp->dc_len] = '\0';
+    return dcp->dc_buf;
+}
+
+/*
+ * Return the path for a local file that we can map directly, or
+ * NULL if the URI needs to go thru libxml2's I/O layer.
+ */
+static const char *
+slaxExtDocumentLocalPath (const char *filename)
+{
+    static const char file_scheme[] = "file://";
+
+    if (strncmp(filename, file_scheme, sizeof(file_scheme) - 1) == 0) {
+	filename += sizeof(file_scheme) - 1;
+	return (*filename == '/') ? filename : NULL;
+    }
+
+    /* Any other scheme (or stdin) is not ours */
+    if (strstr(filename, "://") != NULL || streq(filename, "-"))
+	return NULL;
+
+    return filename;
+}
+
+/*
+ * Map a local regular file for sequential reading.  Returns FALSE if
+ * the file cannot be mapped; otherwise the caller must munmap() it.
+ * Files that claim to be empty (including those in /proc and /sys,
+ * which report a zero size but still have content) are not mapped,
+ * so the caller reads them instead.
+ */
+static int
+slaxExtMapFile (const char *path, void **addrp, size_t *sizep)
+{
+    struct stat st;
+    void *addr;
+    int fd;
+
+    *addrp = NULL;
+    *sizep = 0;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+	return FALSE;
+
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+	close(fd);
+	return FALSE;
+    }
+
+    if (st.st_size == 0) {
+	close(fd);
+	return FALSE;
+    }
 
-	for (i = 0, count = 0, cp = data; i < len; i++, cp++)
-	    if (!xmlIsChar_ch(*cp))
-		count += 1;
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+	return FALSE;
 
-	if (count) {
-	    int add = xmlStrlen(non_xml);
-	    size_t nlen = len + count * (add - 1);
-	    char *newp = xmlMalloc(nlen + 1), *np = newp;
+#ifdef MADV_SEQUENTIAL
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+#endif /* MADV_SEQUENTIAL */
 
-	    if (newp) {
-		for (i = 0, count = 0, cp = data; i < len; i++, cp++)
-		    if (!xmlIsChar_ch(*cp)) {
-			memcpy(np, non_xml, add);
-			np += add;
-		    } else {
-			*np++ = *cp;
-		    }
+    *addrp = addr;
+    *sizep = st.st_size;
+    return TRUE;
+}
 
-		xmlFree(data);
-		data = newp;
-		len = nlen;
-		data[len] = '\0';
-	    }
-	}
+/*
+ * Read a local file via mmap, cooking the contents directly into the
+ * output buffer.  Returns FALSE if the file cannot be handled here,
+ * in which case the caller should use the libxml2 I/O layer.
+ */
+static int
+slaxExtDocumentMap (slax_document_cook_t *dcp, const char *filename)
+{
+    const char *path = slaxExtDocumentLocalPath(filename);
+    void *addr;
+    size_t size;
+
+    if (path == NULL || !slaxExtMapFile(path, &addr, &size))
+	return FALSE;
+
+    /* Compressed files need libxml2's decompression */
+    const unsigned char *magic = addr;
+    if (size >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+	munmap(addr, size);
+	return FALSE;
     }
 
-    *datap = data;
-    *lenp = len;
+    slaxExtDocumentCookInit(dcp, dcp->dc_opts, size);
+    slaxExtDocumentCookData(dcp, addr, size);
+    munmap(addr, size);
+
+    return TRUE;
 }
 
-static void
-slaxExtRemoveReturns (char *data, size_t *lenp)
+/*
+ * Read a document, cooking it into dcp.  Returns FALSE if the
+ * document cannot be opened.
+ */
+static int
+slaxExtDocumentRead (slax_document_cook_t *dcp,
+		     struct slaxDocumentOptions *sdop, const char *filename)
 {
-    size_t len = *lenp;
-    char *fp, *tp;
-    size_t i, delta = 0;
+    xmlParserInputBufferPtr input;
+    int rc;
 
-    tp = data;
-    fp = memchr(data, '\r', len);
-    if (fp == NULL)
-	return;
+    dcp->dc_opts = sdop;
+    if (slaxExtDocumentMap(dcp, filename))
+	return TRUE;
 
-    /* We now know that we're stuck doing the find/copy loop */
-    i = fp - data;
-    tp = fp;
-    for ( ; i < len; i++, fp++) {
-	if (*fp == '\r') {
-	    delta += 1;
-	} else if (fp != tp) {
-	    *tp++ = *fp;
-	}
+    input = xmlParserInputBufferCreateFilename(filename, sdop->sdo_encoding);
+    if (input == NULL) {
+	slaxLog("slax:document: failed to parse URI ('%s')", filename);
+	return FALSE;
     }
 
-    *tp = '\0';
+    slaxExtDocumentCookInit(dcp, sdop, 0);
+
+    for (;;) {
+	char buf[BUFSIZ];
+
+	rc = input->readcallback(input->context, buf, sizeof(buf));
+	if (rc <= 0)
+	    break;
+	slaxExtDocumentCookData(dcp, buf, rc);
+    }
+    xmlFreeParserInputBuffer(input);
 
-    *lenp -= delta;		/* Mark the removed bytes */
+    return TRUE;
 }
 
+/*
+ * Read a document into a string.  Local files are mapped, while
+ * everything else uses libxml2's I/O layer.  Either way, the data is
+ * cooked as it arrives, rather than being collected and rewritten.
+ *
+ * Usage:  var $data = slax:document($url, $options);
+ */
 static void
 slaxExtDocument (xmlXPathParserContext *ctxt, int nargs)
 {
     xmlXPathObjectPtr ret = NULL;
     xmlXPathObjectPtr xop = NULL;
     xmlChar *filename = NULL;
-    xmlParserInputBufferPtr input;
     char *data;
     struct slaxDocumentOptions sdo;
-    size_t len = 0;
-    int rc;
-    slax_data_list_t list;
+    slax_document_cook_t cook;
 
     bzero(&sdo, sizeof(sdo));
     sdo.sdo_encoding = XML_CHAR_ENCODING_UTF8;
@@ -2464,72 +4286,33 @@ slaxExtDocument (xmlXPathParserContext *ctxt, int nargs)
 	return;
     }
 
-    input = xmlParserInputBufferCreateFilename((char *) filename,
-					       sdo.sdo_encoding);
-    if (input == NULL) {
-	slaxLog("slax:document: failed to parse URI ('%s')", filename);
-        valuePush(ctxt, xmlXPathNewNodeSet(NULL));
-	xmlFree(filename);
-	slaxExtDocumentOptionsClear(&sdo);
-        return;
-    }
-
-    xmlFree(filename);
-
-    slaxDataListInit(&list);
-
-    for (;;) {
-	char buf[BUFSIZ];
-	
-        rc = input->readcallback(input->context, buf, sizeof(buf));
-	if (rc <= 0)
-	    break;
-	slaxDataListAddLen(&list, buf, rc);
-    }
-    xmlFreeParserInputBuffer(input);
-
-    /*
-     * At this point, we've read all our data into the list
-     * Now we turn it into a single blob of data
-     */
-    len = slaxDataListAsCharLen(&list, NULL);
-    data = xmlMalloc(len);
-    if (data == NULL)
+    if (!slaxExtDocumentRead(&cook, &sdo, (const char *) filename))
 	goto fail;
 
-    slaxDataListAsChar(data, len, &list, NULL);
-    len -= 1;			/* Remove trailing NUL */
+    data = slaxExtDocumentCookFinish(&cook);
 
     /*
-     * Now we can apply any post-processing needed
+     * Like psu_base64_decode(), data that turns out not to be base64
+     * is returned as-is, so we read it again without decoding.
      */
-    if (sdo.sdo_base64) {
-	size_t dlen;
-	char *dec = psu_base64_decode(data, len, &dlen);
-	if (dec) {
-	    xmlFree(data);
-	    data = dec;
-	    len = dlen;
-	}
+    if (sdo.sdo_base64 && cook.dc_base64.pbs_error) {
+	xmlFreeAndEasy(data);
+	sdo.sdo_base64 = FALSE;
+	if (!slaxExtDocumentRead(&cook, &sdo, (const char *) filename))
+	    goto fail;
+	data = slaxExtDocumentCookFinish(&cook);
     }
 
-    if (!sdo.sdo_retain_returns)
-	slaxExtRemoveReturns(data, &len);
-
-    /*
-     * The non-xml value is a single character to replace
-     * all non-xml characters.  This is required since XML documents
-     * cannot contain some control characters (which is exceedingly lame).
-     */
-    if (sdo.sdo_non_xml)
-	slaxExtRewriteNonXmlCharacters(&data, &len, sdo.sdo_non_xml);
+    if (data == NULL)
+	goto fail;
 
     /* Generate our returnable object */
     ret = xmlXPathWrapString((xmlChar *) data);
 
-    slaxDataListClean(&list);
-
  fail:
+    xmlFreeAndEasy(filename);
+    if (xop)
+	xmlXPathFreeObject(xop);
     slaxExtDocumentOptionsClear(&sdo);
 
     if (ret != NULL)
@@ -2538,71 +4321,457 @@ slaxExtDocument (xmlXPathParserContext *ctxt, int nargs)
 	valuePush(ctxt, xmlXPathNewNodeSet(NULL));
 }
 
+/*
+ * Pass the string value of an XPath object to "func" in pieces, one
+ * per text node, rather than building the string value as a whole.
+ * As with string(), only the first node of a node-set is used.
+ */
+typedef void (*slax_text_func_t)(void *opaque, const char *data, size_t len);
+
+static void
+slaxExtTextWalk (xmlXPathObjectPtr xop, slax_text_func_t func, void *opaque)
+{
+    xmlNodePtr top, nodep;
+    xmlChar *str;
+    const xmlChar *href;
+
+    if (xop->type == XPATH_STRING) {
+	if (xop->stringval)
+	    func(opaque, (const char *) xop->stringval,
+		 strlen((const char *) xop->stringval));
+	return;
+    }
+
+    if (xop->type != XPATH_NODESET && xop->type != XPATH_XSLT_TREE) {
+	str = xmlXPathCastToString(xop);
+	if (str) {
+	    func(opaque, (const char *) str, strlen((const char *) str));
+	    xmlFree(str);
+	}
+	return;
+    }
+
+    if (xop->nodesetval == NULL || xop->nodesetval->nodeNr == 0)
+	return;
+
+    if (xop->nodesetval->nodeNr > 1)
+	xmlXPathNodeSetSort(xop->nodesetval);
+    top = xop->nodesetval->nodeTab[0];
+
+    switch (top->type) {
+    case XML_TEXT_NODE:
+    case XML_CDATA_SECTION_NODE:
+    case XML_COMMENT_NODE:
+    case XML_PI_NODE:
+	if (top->content)
+	    func(opaque, (const char *) top->content,
+		 strlen((const char *) top->content));
+	return;
+
+    case XML_NAMESPACE_DECL:
+	href = ((xmlNsPtr) top)->href;
+	if (href)
+	    func(opaque, (const char *) href, strlen((const char *) href));
+	return;
+
+    case XML_ELEMENT_NODE:
+    case XML_ATTRIBUTE_NODE:
+    case XML_DOCUMENT_NODE:
+    case XML_HTML_DOCUMENT_NODE:
+    case XML_DOCUMENT_FRAG_NODE:
+	break;
+
+    default:
+	return;
+    }
+
+    /* Visit the descendant text nodes in document order */
+    for (nodep = top->children; nodep; ) {
+	if (nodep->type == XML_TEXT_NODE
+		|| nodep->type == XML_CDATA_SECTION_NODE) {
+	    if (nodep->content)
+		func(opaque, (const char *) nodep->content,
+		     strlen((const char *) nodep->content));
+
+	} else if (nodep->type == XML_ELEMENT_NODE && nodep->children) {
+	    nodep = nodep->children;
+	    continue;
+	}
+
+	while (nodep != top && nodep->next == NULL)
+	    nodep = nodep->parent;
+	nodep = (nodep == top) ? NULL : nodep->next;
+    }
+}
+
+static void
+slaxExtTextLength (void *opaque, const char *data UNUSED, size_t len)
+{
+    size_t *lenp = opaque;
+
+    *lenp += len;
+}
+
+/*
+ * Scan base64 data before decoding it, to learn its size and to see
+ * if it's really base64.  Line breaks are allowed, but anything else
+ * outside the base64 alphabet means this isn't base64 data.  Padding
+ * ("=") may only appear at the end, at most twice.
+ */
+typedef struct slax_base64_scan_s {
+    size_t bs_len;		/* Total length */
+    size_t bs_count;		/* Number of base64 characters */
+    int bs_invalid;		/* Saw a non-base64 character */
+    int bs_pad;			/* Number of padding characters seen */
+} slax_base64_scan_t;
+
+static void
+slaxExtBase64Scan (void *opaque, const char *data, size_t len)
+{
+    slax_base64_scan_t *bsp = opaque;
+    const char *cp, *ep = data + len;
+    int bad;
+
+    bsp->bs_len += len;
+    if (bsp->bs_invalid)
+	return;
+
+    for (cp = data; cp < ep; cp++) {
+	if (*cp == '\n' || *cp == '\r')
+	    continue;
+
+	if (*cp == '=') {
+	    bad = (++bsp->bs_pad > 2);
+	} else {
+	    /* Only padding can follow padding */
+	    bad = (bsp->bs_pad != 0 || !(isalnum((unsigned char) *cp)
+					 || *cp == '+' || *cp == '/'));
+	}
+
+	if (bad) {
+	    bsp->bs_invalid = TRUE;
+	    return;
+	}
+
+	bsp->bs_count += 1;
+    }
+}
+
+static void
+slaxExtBase64DecodeText (void *opaque, const char *data, size_t len)
+{
+    slaxExtDocumentCookData(opaque, data, len);
+}
+
+/*
+ * Encode directly into the output buffer; we know exactly how much
+ * each call will add, so a correctly sized buffer never moves.
+ */
+static void
+slaxExtBase64EncodeText (void *opaque, const char *data, size_t len)
+{
+    slax_document_cook_t *dcp = opaque;
+    size_t elen = ((dcp->dc_base64.pbs_count + len) / 3) * 4;
+
+    if (slaxExtDocumentCookExpand(dcp, elen))
+	return;
+
+    dcp->dc_len += psu_base64_encode_chunk(&dcp->dc_base64, data, len,
+					   dcp->dc_buf + dcp->dc_len);
+}
+
+static void
+slaxExtBase64EncodeFlush (slax_document_cook_t *dcp)
+{
+    char buf[PSU_BASE64_ENCODE_MAX(0)];
+    size_t elen;
+
+    elen = psu_base64_encode_finish(&dcp->dc_base64, buf);
+    slaxExtDocumentCookFilter(dcp, buf, elen);
+}
+
+/*
+ * Feed the contents of a local file to "func".  Regular files are
+ * mapped; anything else (like a pipe) is read in chunks.
+ */
+static int
+slaxExtBase64ReadFile (const char *filename, slax_text_func_t func,
+		       void *opaque, size_t *sizep)
+{
+    char buf[SLAX_DOCUMENT_CHUNK];
+    void *addr;
+    size_t size;
+    ssize_t rc;
+    int fd;
+
+    if (slaxExtMapFile(filename, &addr, &size)) {
+	*sizep = size;
+	func(opaque, addr, size);
+	munmap(addr, size);
+	return FALSE;
+    }
+
+    *sizep = 0;
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+	return TRUE;
+
+    for (;;) {
+	rc = read(fd, buf, sizeof(buf));
+	if (rc < 0 && errno == EINTR)
+	    continue;
+	if (rc <= 0)
+	    break;
+	func(opaque, buf, rc);
+    }
+
+    close(fd);
+    return (rc < 0);
+}
+
+/*
+ * Decode base64 data.  The data can be a string or a node-set (or
+ * RTF); for the latter, the text nodes are decoded as we find them,
+ * without building the string value first.  The optional second
+ * argument is the text used to replace non-xml characters.  Data
+ * that isn't base64 is returned as-is.
+ *
+ * Usage:  var $data = slax:base64-decode($attachment/content, "?");
+ */
 static void
 slaxExtBase64Decode (xmlXPathParserContext *ctxt, int nargs)
 {
+    xmlXPathObjectPtr xop;
     xmlChar *non_xml = NULL;
+    struct slaxDocumentOptions sdo;
+    slax_document_cook_t cook;
+    slax_base64_scan_t scan = { 0, 0, FALSE, 0 };
     char *data;
 
-    if (nargs == 1) {
-	data = (char *) xmlXPathPopString(ctxt);
-    } else if (nargs == 2) {
+    if (nargs == 2) {
 	non_xml = xmlXPathPopString(ctxt);
-	data = (char *) xmlXPathPopString(ctxt);
-    } else {
+    } else if (nargs != 1) {
 	xmlXPathSetArityError(ctxt);
 	return;
     }
 
-    if (data == NULL) {
+    xop = valuePop(ctxt);
+    if (xop == NULL) {
 	xsltTransformError(xsltXPathGetTransformContext(ctxt), NULL, NULL,
 	      "slax:base64-decode : internal error: data == NULL\n");
+	xmlFreeAndEasy(non_xml);
 	return;
     }
 
-    size_t len = strlen(data), dlen;
+    slaxExtTextWalk(xop, slaxExtBase64Scan, &scan);
 
-    char *dec = psu_base64_decode(data, len, &dlen);
-    if (dec) {
-	xmlFree(data);
-	data = dec;
-	len = dlen;
+    bzero(&sdo, sizeof(sdo));
+    sdo.sdo_base64 = (!scan.bs_invalid && scan.bs_count % 4 == 0);
+    sdo.sdo_retain_returns = TRUE;
+    if (non_xml && *non_xml)
+	sdo.sdo_non_xml = non_xml;
+
+    slaxExtDocumentCookInit(&cook, &sdo, scan.bs_len);
+    slaxExtTextWalk(xop, slaxExtBase64DecodeText, &cook);
+    data = slaxExtDocumentCookFinish(&cook);
+
+    /* The scan can't see everything the decoder rejects */
+    if (sdo.sdo_base64 && cook.dc_base64.pbs_error) {
+	xmlFreeAndEasy(data);
+	sdo.sdo_base64 = FALSE;
+	slaxExtDocumentCookInit(&cook, &sdo, scan.bs_len);
+	slaxExtTextWalk(xop, slaxExtBase64DecodeText, &cook);
+	data = slaxExtDocumentCookFinish(&cook);
     }
 
-    if (non_xml && *non_xml)
-	slaxExtRewriteNonXmlCharacters(&data, &len, non_xml);
+    xmlXPathFreeObject(xop);
+    xmlFreeAndEasy(non_xml);
 
-    xmlXPathReturnString(ctxt, (xmlChar *) data);
+    if (data)
+	xmlXPathReturnString(ctxt, (xmlChar *) data);
+    else
+	xmlXPathReturnEmptyString(ctxt);
 }
 
+/*
+ * Encode data using base64.  As with slax:base64-decode(), node-sets
+ * are encoded from their text nodes directly.
+ *
+ * Usage:  var $content = slax:base64-encode($data);
+ */
 static void
 slaxExtBase64Encode (xmlXPathParserContext *ctxt, int nargs)
 {
+    xmlXPathObjectPtr xop;
+    struct slaxDocumentOptions sdo;
+    slax_document_cook_t cook;
+    size_t len = 0;
     char *data;
 
-    if (nargs == 1) {
-	data = (char *) xmlXPathPopString(ctxt);
-    } else {
+    if (nargs != 1) {
 	xmlXPathSetArityError(ctxt);
 	return;
     }
 
-    if (data == NULL) {
+    xop = valuePop(ctxt);
+    if (xop == NULL) {
 	xsltTransformError(xsltXPathGetTransformContext(ctxt), NULL, NULL,
 	      "slax:base64-encode : internal error: data == NULL\n");
 	return;
     }
 
-    size_t len = strlen(data), dlen;
+    bzero(&sdo, sizeof(sdo));
+    sdo.sdo_retain_returns = TRUE;
+
+    slaxExtTextWalk(xop, slaxExtTextLength, &len);
+    slaxExtDocumentCookInit(&cook, &sdo, PSU_BASE64_ENCODE_LEN(len));
+    slaxExtTextWalk(xop, slaxExtBase64EncodeText, &cook);
+    slaxExtBase64EncodeFlush(&cook);
+    data = slaxExtDocumentCookFinish(&cook);
+
+    xmlXPathFreeObject(xop);
+
+    if (data)
+	xmlXPathReturnString(ctxt, (xmlChar *) data);
+    else
+	xmlXPathReturnEmptyString(ctxt);
+}
+
+/*
+ * Decode base64 data (a string or node-set) into a file, returning
+ * the number of bytes written.  The decoded data never becomes an
+ * XPath string, so binary content is written as-is.
+ *
+ * Usage:  var $len = slax:base64-decode-file($attachment/content, $path);
+ */
+static void
+slaxExtBase64DecodeFile (xmlXPathParserContext *ctxt, int nargs)
+{
+    xmlXPathObjectPtr xop;
+    xmlChar *filename;
+    struct slaxDocumentOptions sdo;
+    slax_document_cook_t cook;
+    slax_base64_scan_t scan = { 0, 0, FALSE, 0 };
+    FILE *fp;
+
+    if (nargs != 2) {
+	xmlXPathSetArityError(ctxt);
+	return;
+    }
+
+    filename = xmlXPathPopString(ctxt);
+    xop = valuePop(ctxt);
+    if (filename == NULL || xop == NULL)
+	goto fail;
+
+    slaxExtTextWalk(xop, slaxExtBase64Scan, &scan);
+    if (scan.bs_invalid || scan.bs_count % 4 != 0) {
+	xsltGenericError(xsltGenericErrorContext,
+			 "slax:base64-decode-file: %s: invalid base64 data\n",
+			 filename);
+	goto fail;
+    }
+
+    fp = fopen((const char *) filename, "w");
+    if (fp == NULL) {
+	xsltGenericError(xsltGenericErrorContext,
+			 "slax:base64-decode-file: %s: %s\n",
+			 filename, strerror(errno));
+	goto fail;
+    }
+
+    bzero(&sdo, sizeof(sdo));
+    sdo.sdo_base64 = TRUE;
+    sdo.sdo_retain_returns = TRUE;
+
+    slaxExtDocumentCookInit(&cook, &sdo, 0);
+    cook.dc_fp = fp;
+    slaxExtTextWalk(xop, slaxExtBase64DecodeText, &cook);
+    slaxExtDocumentCookFlush(&cook);
+
+    if (fclose(fp) != 0)
+	cook.dc_failed = TRUE;
+
+    if (cook.dc_base64.pbs_error) {
+	xsltGenericError(xsltGenericErrorContext,
+			 "slax:base64-decode-file: %s: invalid base64 data\n",
+			 filename);
+	goto fail;
+    }
+
+    if (cook.dc_failed) {
+	xsltGenericError(xsltGenericErrorContext,
+			 "slax:base64-decode-file: %s: write failed\n",
+			 filename);
+	goto fail;
+    }
+
+    xmlXPathReturnNumber(ctxt, (double) cook.dc_len);
+    xmlXPathFreeObject(xop);
+    xmlFree(filename);
+    return;
+
+ fail:
+    if (xop)
+	xmlXPathFreeObject(xop);
+    xmlFreeAndEasy(filename);
+    valuePush(ctxt, xmlXPathNewNodeSet(NULL));
+}
+
+/*
+ * Encode the contents of a local file using base64.  The file is
+ * mapped (when possible) and encoded directly into the result.
+ *
+ * Usage:  <content> slax:base64-encode-file("/var/tmp/image.png");
+ */
+static void
+slaxExtBase64EncodeFile (xmlXPathParserContext *ctxt, int nargs)
+{
+    xmlChar *filename;
+    struct slaxDocumentOptions sdo;
+    slax_document_cook_t cook;
+    struct stat st;
+    size_t size;
+    char *data;
+
+    if (nargs != 1) {
+	xmlXPathSetArityError(ctxt);
+	return;
+    }
+
+    filename = xmlXPathPopString(ctxt);
+    if (filename == NULL)
+	goto fail;
+
+    bzero(&sdo, sizeof(sdo));
+    sdo.sdo_retain_returns = TRUE;
+
+    /* Size the result exactly for regular files */
+    size = (stat((const char *) filename, &st) == 0 && S_ISREG(st.st_mode))
+	? PSU_BASE64_ENCODE_LEN(st.st_size) : 0;
 
-    char *dec = psu_base64_encode(data, len, &dlen);
-    if (dec) {
-	xmlFree(data);
-	data = dec;
-	len = dlen;
+    slaxExtDocumentCookInit(&cook, &sdo, size);
+    if (slaxExtBase64ReadFile((const char *) filename,
+			      slaxExtBase64EncodeText, &cook, &size)) {
+	xsltGenericError(xsltGenericErrorContext,
+			 "slax:base64-encode-file: %s: %s\n",
+			 filename, strerror(errno));
+	xmlFreeAndEasy(cook.dc_buf);
+	goto fail;
     }
 
+    slaxExtBase64EncodeFlush(&cook);
+    data = slaxExtDocumentCookFinish(&cook);
+    if (data == NULL)
+	goto fail;
+
+    xmlFree(filename);
     xmlXPathReturnString(ctxt, (xmlChar *) data);
+    return;
+
+ fail:
+    xmlFreeAndEasy(filename);
+    valuePush(ctxt, xmlXPathNewNodeSet(NULL));
 }
 
 static void
@@ -2895,17 +5064,27 @@ slaxExtRegisterOther (const char *namespace)
     if (namespace == NULL)
 	namespace = SLAX_URI;
 
+    xsltRegisterExtModule((const xmlChar *) SLAX_LAZY_URI,
+			  slaxLazyInit, slaxLazyShutdown);
+
     slaxRegisterFunction(namespace, "break-lines", slaxExtBreakLines);
+    slaxRegisterFunction(namespace, "break-lines-range",
+			 slaxExtBreakLinesRange);
     slaxRegisterFunction(namespace, "break_lines", slaxExtBreakLines); /*OLD*/
+    slaxRegisterFunction(namespace, "count-by", slaxExtCountBy);
     slaxRegisterFunction(namespace, "dampen", slaxExtDampen);
+    slaxRegisterFunction(namespace, "digest", slaxExtDigest);
+    slaxRegisterFunction(namespace, "distinct", slaxExtDistinct);
     slaxRegisterFunction(namespace, "empty", slaxExtEmpty);
     slaxRegisterFunction(namespace, "first-of", slaxExtFirstOf);
     slaxRegisterFunction(namespace, "get-command", slaxExtGetCommand);
     slaxRegisterFunction(namespace, "get-input", slaxExtGetInput);
     slaxRegisterFunction(namespace, "get-secret", slaxExtGetSecret);
     slaxRegisterFunction(namespace, "getsecret", slaxExtGetSecret); /*OLD*/
+    slaxRegisterFunction(namespace, "group-by", slaxExtGroupBy);
     slaxRegisterFunction(namespace, "input", slaxExtGetInput); /*OLD*/
     slaxRegisterFunction(namespace, "is-empty", slaxExtEmpty);
+    slaxRegisterFunction(namespace, "line-count", slaxExtLineCount);
     slaxRegisterFunction(namespace, "output", slaxExtOutput);
     slaxRegisterFunction(namespace, "progress", slaxExtProgress);
     slaxRegisterFunction(namespace, "printf", slaxExtPrintf);
@@ -2917,6 +5096,8 @@ slaxExtRegisterOther (const char *namespace)
     slaxRegisterFunction(namespace, "sysctl", slaxExtSysctl);
 #endif
     slaxRegisterFunction(namespace, "syslog", slaxExtSyslog);
+    slaxRegisterFunction(namespace, "syslog-structured",
+			 slaxExtSyslogStructured);
     slaxRegisterFunction(namespace, "trace", slaxExtTrace);
 
     return 0;
@@ -2937,9 +5118,15 @@ slaxExtRegister (void)
 			slaxWhileCompile, slaxWhileElement);
 
     slaxRegisterFunction(SLAX_URI, FUNC_BUILD_SEQUENCE, slaxExtBuildSequence);
+    slaxRegisterFunction(SLAX_URI, FUNC_EMPTY_LAZY, slaxExtEmptyLazy);
+    slaxRegisterFunction(SLAX_URI, FUNC_FIRST_OF_LAZY, slaxExtFirstOfLazy);
 
     slaxRegisterFunction(SLAX_URI, "base64-decode", slaxExtBase64Decode);
+    slaxRegisterFunction(SLAX_URI, "base64-decode-file",
+			 slaxExtBase64DecodeFile);
     slaxRegisterFunction(SLAX_URI, "base64-encode", slaxExtBase64Encode);
+    slaxRegisterFunction(SLAX_URI, "base64-encode-file",
+			 slaxExtBase64EncodeFile);
     slaxRegisterFunction(SLAX_URI, "debug", slaxExtDebug);
     slaxRegisterFunction(SLAX_URI, "document", slaxExtDocument);
     slaxRegisterFunction(SLAX_URI, "evaluate", slaxExtEvaluate);
@@ -82,6 +82,17 @@ slaxMvarCreateSvar (slax_data_t *sdp, const char *varname);
 void
 slaxMvarRegister (void);
 
+/* --- slaxlint.c --- */
+
+/**
+ * Report known-expensive patterns in a parsed script
+ *
+ * @style the parsed script
+ * @returns the number of warnings issued
+ */
+unsigned
+slaxLintPerf (xsltStylesheetPtr style);
+
 /* --- slaxwriter.h --- */
 
 struct slax_writer_s;
@@ -115,6 +126,9 @@ slaxWriteRedoTernary (slax_data_t *sdp, slax_string_t *);
 slax_string_t *
 slaxWriteRedoConcat (slax_data_t *sdp, slax_string_t *f);
 
+slax_string_t *
+slaxWriteRedoLazy (slax_data_t *sdp, slax_string_t *);
+
 slax_string_t *
 slaxWriteRemoveParens (slax_data_t *sdp, slax_string_t *);
 
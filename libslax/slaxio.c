@@ -22,6 +22,7 @@
 
 #include <libxml/xmlsave.h>
 #include <libxml/xmlIO.h>
+#include <libxml/hash.h>
 #include <libxslt/variables.h>
 #include <libxslt/transform.h>
 
@@ -57,6 +58,33 @@ static slaxErrorCallback_t slaxErrorCallback;
 
 static FILE *slaxIoTty;
 
+/*
+ * Unless they are going to a terminal, messages written to stderr
+ * (from slax:output, progress messages, etc) and trace data are
+ * buffered, so output-heavy scripts aren't bound by a write() per
+ * line.  slaxIoFlush() empties the buffers; it's called before
+ * prompting for input and should be called at the end of the
+ * transform.
+ */
+#define SLAX_IO_BUFSIZ	(64 * 1024) /* Buffer size for non-tty output */
+
+static int slaxIoBuffered;	/* Buffering stderr (not a tty) */
+static int slaxIoUnbuffered;	/* Caller asked for SIF_UNBUFFERED */
+static FILE *slaxIoTraceFile;	/* From slaxTraceToFile() */
+static int slaxIoTraceFlush;	/* Flush trace file after each line */
+
+/**
+ * Flush any buffered output and trace data
+ */
+void
+slaxIoFlush (void)
+{
+    if (slaxIoBuffered)
+	fflush(stderr);
+    if (slaxIoTraceFile)
+	fflush(slaxIoTraceFile);
+}
+
 /**
  * Use the input callback to get data
  * @prompt the prompt to be displayed
@@ -67,6 +95,8 @@ slaxInput (const char *prompt, unsigned flags)
     char *res, *cp;
     int count, len;
 
+    slaxIoFlush();		/* Let the user see our output first */
+
     /* slaxLog("slaxInput: -> [%s]", prompt); */
     res = slaxInputCallback ? slaxInputCallback(prompt, flags) : NULL;
     /* slaxLog("slaxInput: <- [%s]", res ?: "null"); */
@@ -254,7 +284,7 @@ slaxIoStdioInputCallback (const char *prompt, unsigned flags UNUSED)
 	fflush(stderr);
 
 	buf[0] = '\0';
-	if (fgets(buf, sizeof(buf), slaxIoTty) == NULL)
+	if (fgets(buf, sizeof(buf), slaxIoTty ?: stdin) == NULL)
 	    return NULL;
 
 	len = strlen(buf);
@@ -266,6 +296,255 @@ slaxIoStdioInputCallback (const char *prompt, unsigned flags UNUSED)
     }
 }
 
+/*
+ * Batch input: prompts from slax:get-input() and friends are answered
+ * from a table built by slaxIoBatchAdd() (or slaxIoBatchLoad()), with
+ * no tty interaction.  Answers are keyed by prompt, so lookups are a
+ * single hash probe.  A prompt can be given more than once, in which
+ * case its answers are handed out in order, with the last one repeated
+ * once the list is exhausted.  Answers without a prompt are used, in
+ * order, for any prompt without a keyed answer.
+ */
+typedef struct slax_io_answers_s {
+    char **sia_values;		/* Array of answers */
+    int sia_count;		/* Number of answers */
+    int sia_next;		/* Next answer to hand out */
+} slax_io_answers_t;
+
+static xmlHashTablePtr slaxIoBatch;	/* Answers keyed by prompt */
+static slax_io_answers_t slaxIoBatchAnon; /* Answers without a prompt */
+
+/*
+ * Normalize a prompt (or the prompt half of an answer) into the key
+ * we hash on: only the last line is used, and trailing whitespace and
+ * a trailing colon are ignored, so "Password: " and "Password" match.
+ * Returns the length of the key, which starts at *keyp.
+ */
+static int
+slaxIoBatchKey (const char *prompt, int len, const char **keyp)
+{
+    const char *cp;
+
+    for (cp = prompt + len; cp > prompt; cp--)
+	if (cp[-1] == '\n')
+	    break;
+    len -= cp - prompt;
+    prompt = cp;
+
+    while (len > 0 && isspace((int) prompt[len - 1]))
+	len -= 1;
+    if (len > 0 && prompt[len - 1] == ':')
+	len -= 1;
+    while (len > 0 && isspace((int) prompt[len - 1]))
+	len -= 1;
+    while (len > 0 && isspace((int) *prompt)) {
+	prompt += 1;
+	len -= 1;
+    }
+
+    *keyp = prompt;
+    return len;
+}
+
+static int
+slaxIoBatchAppend (slax_io_answers_t *siap, const char *value)
+{
+    char **values;
+    char *cp;
+
+    cp = (char *) xmlStrdup((const xmlChar *) value);
+    if (cp == NULL)
+	return -1;
+
+    values = xmlRealloc(siap->sia_values,
+			(siap->sia_count + 1) * sizeof(*values));
+    if (values == NULL) {
+	xmlFree(cp);
+	return -1;
+    }
+
+    values[siap->sia_count++] = cp;
+    siap->sia_values = values;
+    return 0;
+}
+
+static void
+slaxIoBatchFreeAnswers (slax_io_answers_t *siap)
+{
+    int i;
+
+    for (i = 0; i < siap->sia_count; i++)
+	xmlFree(siap->sia_values[i]);
+    xmlFreeAndEasy(siap->sia_values);
+    bzero(siap, sizeof(*siap));
+}
+
+static void
+slaxIoBatchFreeEntry (void *payload, const xmlChar *name UNUSED)
+{
+    slax_io_answers_t *siap = payload;
+
+    slaxIoBatchFreeAnswers(siap);
+    xmlFree(siap);
+}
+
+/**
+ * Add an answer for batch input.  The line is either "prompt=answer"
+ * or a bare answer, which is used for any prompt without one.
+ * @line the answer
+ * @return zero on success, -1 on failure
+ */
+int
+slaxIoBatchAdd (const char *line)
+{
+    slax_io_answers_t *siap;
+    const char *eq, *key;
+    char *name;
+    int len;
+
+    eq = strchr(line, '=');
+    if (eq == NULL)
+	return slaxIoBatchAppend(&slaxIoBatchAnon, line);
+
+    if (slaxIoBatch == NULL) {
+	slaxIoBatch = xmlHashCreate(0);
+	if (slaxIoBatch == NULL)
+	    return -1;
+    }
+
+    len = slaxIoBatchKey(line, eq - line, &key);
+    name = alloca(len + 1);
+    memcpy(name, key, len);
+    name[len] = '\0';
+
+    siap = xmlHashLookup(slaxIoBatch, (xmlChar *) name);
+    if (siap == NULL) {
+	siap = xmlMalloc(sizeof(*siap));
+	if (siap == NULL)
+	    return -1;
+	bzero(siap, sizeof(*siap));
+
+	if (xmlHashAddEntry(slaxIoBatch, (xmlChar *) name, siap) < 0) {
+	    xmlFree(siap);
+	    return -1;
+	}
+    }
+
+    return slaxIoBatchAppend(siap, eq + 1);
+}
+
+/**
+ * Load answers for batch input from a file, one per line, in the
+ * format accepted by slaxIoBatchAdd().  Blank lines and lines
+ * starting with "#" are ignored.
+ * @filename the file to read
+ * @return zero on success, -1 on failure (with errno set)
+ */
+int
+slaxIoBatchLoad (const char *filename)
+{
+    FILE *fp;
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    int rc = 0;
+
+    fp = slaxFilenameIsStd(filename) ? stdin : fopen(filename, "r");
+    if (fp == NULL)
+	return -1;
+
+    while ((len = getline(&line, &size, fp)) >= 0) {
+	if (len > 0 && line[len - 1] == '\n')
+	    line[--len] = '\0';
+	if (len > 0 && line[len - 1] == '\r')
+	    line[--len] = '\0';
+
+	if (len == 0 || *line == '#')
+	    continue;
+
+	if (slaxIoBatchAdd(line) < 0) {
+	    rc = -1;
+	    break;
+	}
+    }
+
+    free(line);			/* Allocated by getline() */
+    if (fp != stdin)
+	fclose(fp);
+
+    return rc;
+}
+
+static char *
+slaxIoBatchNext (slax_io_answers_t *siap, int repeat)
+{
+    const char *cp;
+
+    if (siap->sia_next < siap->sia_count)
+	cp = siap->sia_values[siap->sia_next++];
+    else if (repeat && siap->sia_count > 0)
+	cp = siap->sia_values[siap->sia_count - 1];
+    else
+	return NULL;
+
+    return (char *) xmlStrdup((const xmlChar *) cp);
+}
+
+static char *
+slaxIoBatchInputCallback (const char *prompt, unsigned flags)
+{
+    slax_io_answers_t *siap = NULL;
+    const char *key;
+    char *name, *res;
+    int len;
+
+    len = slaxIoBatchKey(prompt, strlen(prompt), &key);
+
+    if (slaxIoBatch) {
+	name = alloca(len + 1);
+	memcpy(name, key, len);
+	name[len] = '\0';
+	siap = xmlHashLookup(slaxIoBatch, (xmlChar *) name);
+    }
+
+    res = siap ? slaxIoBatchNext(siap, TRUE)
+	: slaxIoBatchNext(&slaxIoBatchAnon, FALSE);
+
+    if (res == NULL) {
+	/* Callers treat NULL as a failure; an empty answer is kinder */
+	slaxLog("batch input: no answer for '%.*s'", len, key);
+	res = (char *) xmlStrdup((const xmlChar *) "");
+    } else
+	slaxLog("batch input: '%.*s' -> '%s'", len, key,
+		(flags & SIF_SECRET) ? "***" : res);
+
+    return res;
+}
+
+/**
+ * Answer all input prompts from the batch table, rather than the
+ * current input callback.  The output callbacks are untouched.
+ */
+void
+slaxIoUseBatch (void)
+{
+    slaxInputCallback = slaxIoBatchInputCallback;
+}
+
+/**
+ * Release the batch input table
+ */
+void
+slaxIoBatchClean (void)
+{
+    if (slaxIoBatch) {
+	xmlHashFree(slaxIoBatch, slaxIoBatchFreeEntry);
+	slaxIoBatch = NULL;
+    }
+
+    slaxIoBatchFreeAnswers(&slaxIoBatchAnon);
+}
+
 static void
 slaxIoStdioOutputCallback (const char *fmt, ...)
 {
@@ -273,14 +552,16 @@ slaxIoStdioOutputCallback (const char *fmt, ...)
 
     va_start(vap, fmt);
     vfprintf(stderr, fmt, vap);
-    fflush(stderr);
+    if (!slaxIoBuffered)
+	fflush(stderr);
     va_end(vap);
 }
 
 static int
 slaxIoStdioRawwriteCallback (void *opaque UNUSED, const char *buf, int len)
 {
-    return write(fileno(stderr), buf, len);
+    /* Use stdio, so raw output stays in order with buffered output */
+    return fwrite(buf, 1, len, stderr);
 }
 
 static int
@@ -316,6 +597,12 @@ slaxIoUseStdio (unsigned flags)
 
     slaxIoRegister(slaxIoStdioInputCallback, slaxIoStdioOutputCallback,
 		   slaxIoStdioRawwriteCallback, slaxIoStdioErrorCallback);
+
+    /* Terminals stay line-buffered; see slaxIoFlush() */
+    slaxIoUnbuffered = (flags & SIF_UNBUFFERED) ? TRUE : FALSE;
+    if (!slaxIoUnbuffered && !slaxIoBuffered && !isatty(fileno(stderr))
+	    && setvbuf(stderr, NULL, _IOFBF, SLAX_IO_BUFSIZ) == 0)
+	slaxIoBuffered = TRUE;
 }
 
 static void
@@ -356,13 +643,16 @@ slaxProcTrace (void *vfp, xmlNodePtr nodep, const char *fmt, ...)
     }
 
     fprintf(fp, "\n");
-    fflush(fp);
+    if (slaxIoTraceFlush)
+	fflush(fp);
     va_end(vap);
 }
 
 void
 slaxTraceToFile (FILE *fp)
 {
+    slaxIoTraceFile = fp;
+    slaxIoTraceFlush = slaxIoUnbuffered || isatty(fileno(fp));
     slaxTraceEnable(slaxProcTrace, fp);
 }
 
@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Performance lint: look over a parsed script for patterns that are
+ * known to be expensive, and say where they are.  This is advice,
+ * not an error check; the patterns are all legal and sometimes
+ * needed.  We look at the XSLT form of the script, since that's what
+ * runs, so SLAX constructs appear in their compiled form ("_" is
+ * concat(), "for" is xsl:for-each, "while" is slax:while, etc).
+ *
+ * The expression checks are textual, but skip string literals and
+ * track predicate depth, which is enough for the patterns we want.
+ */
+
+#include "slaxinternals.h"
+#include <libslax/slax.h>
+#include <ctype.h>
+#include <stdarg.h>
+
+#include <libxslt/transform.h>
+#include <libxslt/imports.h>
+#include <libexslt/exslt.h>
+
+typedef struct slax_lint_s {
+    unsigned sl_count;		/* Number of warnings issued */
+} slax_lint_t;
+
+static void
+slaxLintWarn (slax_lint_t *slp, xmlNodePtr nodep, const char *fmt, ...)
+{
+    char buf[BUFSIZ];
+    va_list vap;
+
+    va_start(vap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, vap);
+    va_end(vap);
+
+    slaxError("%s:%ld: performance: %s",
+	      (nodep->doc && nodep->doc->URL)
+	          ? (const char *) nodep->doc->URL : "unknown",
+	      xmlGetLineNo(nodep), buf);
+    slp->sl_count += 1;
+}
+
+static int
+slaxLintIs (xmlNodePtr nodep, const char *uri, const char *name)
+{
+    return (nodep && nodep->type == XML_ELEMENT_NODE
+	    && nodep->ns && nodep->ns->href
+	    && streq((const char *) nodep->ns->href, uri)
+	    && streq((const char *) nodep->name, name));
+}
+
+/*
+ * Is this node inside the body of a loop?  The loop's own select or
+ * test is evaluated outside it, so we start with the parent.
+ */
+static int
+slaxLintInLoop (xmlNodePtr nodep)
+{
+    for (nodep = nodep->parent; nodep; nodep = nodep->parent) {
+	if (slaxLintIs(nodep, XSL_URI, ELT_FOR_EACH)
+	    || slaxLintIs(nodep, SLAX_URI, ELT_WHILE))
+	    return TRUE;
+
+	if (slaxLintIs(nodep, XSL_URI, ELT_TEMPLATE)
+	    || slaxLintIs(nodep, (const char *) FUNC_URI, ELT_FUNCTION))
+	    break;
+    }
+
+    return FALSE;
+}
+
+static inline int
+slaxLintNameChar (int ch)
+{
+    return (isalnum(ch) || ch == '-' || ch == '_' || ch == '.' || ch == ':');
+}
+
+/*
+ * Skip a string literal, returning the closing quote
+ */
+static const char *
+slaxLintSkipString (const char *cp)
+{
+    const char *ep = strchr(cp + 1, *cp);
+
+    return ep ?: cp + strlen(cp) - 1;
+}
+
+/*
+ * Return the ')' matching the '(' at "cp", or NULL
+ */
+static const char *
+slaxLintCloseParen (const char *cp)
+{
+    int depth = 0;
+
+    for ( ; *cp; cp++) {
+	if (*cp == '"' || *cp == '\'')
+	    cp = slaxLintSkipString(cp);
+	else if (*cp == '(')
+	    depth += 1;
+	else if (*cp == ')' && --depth == 0)
+	    return cp;
+    }
+
+    return NULL;
+}
+
+/*
+ * Is "cp" a zero, compared against?  Matches "0", "0.0", but not "01"
+ */
+static int
+slaxLintIsZero (const char *cp)
+{
+    if (*cp != '0')
+	return FALSE;
+    for (cp += 1; *cp == '0' || *cp == '.'; cp++)
+	continue;
+
+    return !isdigit((int) *cp);
+}
+
+/*
+ * Return the length of a comparison operator at "cp", or zero
+ */
+static int
+slaxLintCompareOp (const char *cp)
+{
+    if ((cp[0] == '!' || cp[0] == '<' || cp[0] == '>') && cp[1] == '=')
+	return 2;
+    if (cp[0] == '=' || cp[0] == '<' || cp[0] == '>')
+	return 1;
+    return 0;
+}
+
+static const char *
+slaxLintSkipSpace (const char *cp)
+{
+    while (isspace((int) *cp))
+	cp += 1;
+    return cp;
+}
+
+/*
+ * Is the argument list starting at "open" a single string literal?
+ */
+static int
+slaxLintConstantArg (const char *open, const char *close)
+{
+    const char *cp = slaxLintSkipSpace(open + 1);
+
+    if (*cp != '"' && *cp != '\'')
+	return FALSE;
+
+    cp = slaxLintSkipString(cp);
+    return (slaxLintSkipSpace(cp + 1) == close);
+}
+
+/*
+ * Does the prefix running from "sp" to "ep" map to "uri"?
+ */
+static int
+slaxLintPrefixIs (xmlNodePtr nodep, const char *sp, const char *ep,
+		  const char *uri)
+{
+    char prefix[BUFSIZ];
+    xmlNsPtr nsp;
+
+    if (sp == ep || ep - sp >= (int) sizeof(prefix))
+	return FALSE;
+
+    memcpy(prefix, sp, ep - sp);
+    prefix[ep - sp] = '\0';
+
+    nsp = xmlSearchNs(nodep->doc, nodep, (const xmlChar *) prefix);
+    return (nsp && nsp->href && streq((const char *) nsp->href, uri));
+}
+
+/*
+ * Check one XPath expression
+ */
+static void
+slaxLintExpr (slax_lint_t *slp, xmlNodePtr nodep, const char *expr)
+{
+    int in_loop = slaxLintInLoop(nodep);
+    int depth = 0, seen_scan = FALSE, seen_preceding = FALSE;
+    const char *cp, *ep;
+    int len;
+
+    for (cp = expr; *cp; cp++) {
+	if (*cp == '"' || *cp == '\'') {
+	    cp = slaxLintSkipString(cp);
+	    continue;
+	}
+
+	if (*cp == '[') {
+	    depth += 1;
+	    continue;
+	}
+
+	if (*cp == ']') {
+	    if (depth > 0)
+		depth -= 1;
+	    continue;
+	}
+
+	/* Only look at the start of names and operators */
+	if (cp > expr && slaxLintNameChar(cp[-1]) && slaxLintNameChar(*cp))
+	    continue;
+
+	if (in_loop && !seen_scan
+	    && ((cp[0] == '/' && cp[1] == '/')
+		|| strncmp(cp, "descendant::", 12) == 0
+		|| strncmp(cp, "descendant-or-self::", 20) == 0)) {
+	    slaxLintWarn(slp, nodep, "descendant scan ('//') inside a loop; "
+			 "consider a key or a variable set outside the loop");
+	    seen_scan = TRUE;
+	}
+
+	if (depth > 0 && !seen_preceding
+	    && (strncmp(cp, "preceding-sibling::", 19) == 0
+		|| strncmp(cp, "preceding::", 11) == 0)) {
+	    slaxLintWarn(slp, nodep, "preceding axis inside a predicate "
+			 "makes each test walk back over earlier nodes; "
+			 "consider a key or position()");
+	    seen_preceding = TRUE;
+	}
+
+	if (strncmp(cp, "count", 5) == 0 && *slaxLintSkipSpace(cp + 5) == '(') {
+	    /* count(...) = 0 */
+	    ep = slaxLintCloseParen(slaxLintSkipSpace(cp + 5));
+	    if (ep) {
+		ep = slaxLintSkipSpace(ep + 1);
+		len = slaxLintCompareOp(ep);
+		if (len && slaxLintIsZero(slaxLintSkipSpace(ep + len)))
+		    slaxLintWarn(slp, nodep, "count() compared to zero; "
+				 "test the node-set itself (or use not()), "
+				 "which stops at the first node");
+	    }
+
+	} else if (slaxLintIsZero(cp)) {
+	    /* 0 < count(...) */
+	    ep = slaxLintSkipSpace(cp + 1);
+	    len = slaxLintCompareOp(ep);
+	    if (len) {
+		ep = slaxLintSkipSpace(ep + len);
+		if (strncmp(ep, "count", 5) == 0
+		    && *slaxLintSkipSpace(ep + 5) == '(')
+		    slaxLintWarn(slp, nodep, "count() compared to zero; "
+				 "test the node-set itself (or use not()), "
+				 "which stops at the first node");
+	    }
+	}
+
+	/* A "prefix:evaluate(" function call */
+	for (ep = cp; slaxLintNameChar(*ep) && *ep != ':'; ep++)
+	    continue;
+	if (*ep == ':' && ep > cp && strncmp(ep + 1, "evaluate", 8) == 0
+	    && *slaxLintSkipSpace(ep + 9) == '('
+	    && (slaxLintPrefixIs(nodep, cp, ep, SLAX_URI)
+		|| slaxLintPrefixIs(nodep, cp, ep,
+				    (const char *) EXSLT_DYNAMIC_NAMESPACE))) {
+	    const char *open = slaxLintSkipSpace(ep + 9);
+
+	    ep = slaxLintCloseParen(open);
+	    if (ep && !slaxLintConstantArg(open, ep))
+		slaxLintWarn(slp, nodep, "evaluate() with a non-constant "
+			     "argument parses the expression at run time, "
+			     "on every call");
+	}
+    }
+}
+
+/*
+ * Look for string concatenation passed to a recursive call: each
+ * level of recursion copies the whole accumulated string, so building
+ * a string of N parts costs N-squared.
+ */
+static void
+slaxLintRecursion (slax_lint_t *slp, const char *name, xmlNodePtr nodep)
+{
+    xmlNodePtr childp, paramp;
+    char *select;
+
+    for (childp = nodep->children; childp; childp = childp->next) {
+	if (childp->type != XML_ELEMENT_NODE)
+	    continue;
+
+	if (slaxLintIs(childp, XSL_URI, ELT_CALL_TEMPLATE)) {
+	    char *callee = slaxGetAttrib(childp, ATT_NAME);
+
+	    if (callee && streq(callee, name)) {
+		for (paramp = childp->children; paramp;
+		     paramp = paramp->next) {
+		    if (!slaxLintIs(paramp, XSL_URI, ELT_WITH_PARAM))
+			continue;
+
+		    select = slaxGetAttrib(paramp, ATT_SELECT);
+		    if (select && strstr(select, "concat("))
+			slaxLintWarn(slp, paramp, "string concatenation in "
+				     "recursive template '%s' copies the "
+				     "accumulated string at every level",
+				     name);
+		    xmlFreeAndEasy(select);
+		}
+	    }
+
+	    xmlFreeAndEasy(callee);
+	}
+
+	slaxLintRecursion(slp, name, childp);
+    }
+}
+
+static void
+slaxLintNode (slax_lint_t *slp, xmlNodePtr nodep)
+{
+    xmlNodePtr childp;
+    char *value;
+
+    for (childp = nodep->children; childp; childp = childp->next) {
+	if (childp->type != XML_ELEMENT_NODE)
+	    continue;
+
+	if (childp->ns && childp->ns->href
+	    && (streq((const char *) childp->ns->href, XSL_URI)
+		|| streq((const char *) childp->ns->href, SLAX_URI))) {
+	    value = slaxGetAttrib(childp, ATT_SELECT);
+	    if (value)
+		slaxLintExpr(slp, childp, value);
+	    xmlFreeAndEasy(value);
+
+	    value = slaxGetAttrib(childp, ATT_TEST);
+	    if (value)
+		slaxLintExpr(slp, childp, value);
+	    xmlFreeAndEasy(value);
+	}
+
+	if (slaxLintIs(childp, SLAX_URI, ELT_APPEND_TO_VARIABLE)
+	    && slaxLintInLoop(childp))
+	    slaxLintWarn(slp, childp, "mvar append inside a loop; each "
+			 "append grows the variable's history, so build "
+			 "the value with a single for-each where possible");
+
+	if (slaxLintIs(childp, XSL_URI, ELT_TEMPLATE)) {
+	    value = slaxGetAttrib(childp, ATT_NAME);
+	    if (value)
+		slaxLintRecursion(slp, value, childp);
+	    xmlFreeAndEasy(value);
+	}
+
+	slaxLintNode(slp, childp);
+    }
+}
+
+static void
+slaxLintStylesheet (slax_lint_t *slp, xsltStylesheetPtr style)
+{
+    xsltDocumentPtr docp;
+
+    if (style->doc)
+	slaxLintNode(slp, (xmlNodePtr) style->doc);
+
+    /* Included files */
+    for (docp = style->docList; docp; docp = docp->next)
+	if (docp->doc && docp->doc != style->doc)
+	    slaxLintNode(slp, (xmlNodePtr) docp->doc);
+
+    /* Imported files (which have their own imports) */
+    for (style = style->imports; style; style = style->next)
+	slaxLintStylesheet(slp, style);
+}
+
+/**
+ * Report known-expensive patterns in a parsed script, as
+ * "file:line: performance: ..." messages via slaxError().
+ *
+ * @style the parsed script
+ * @returns the number of warnings issued
+ */
+unsigned
+slaxLintPerf (xsltStylesheetPtr style)
+{
+    slax_lint_t sl;
+
+    bzero(&sl, sizeof(sl));
+    slaxLintStylesheet(&sl, style);
+
+    return sl.sl_count;
+}
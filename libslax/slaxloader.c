@@ -27,6 +27,7 @@
 #include <libexslt/exslt.h>
 #include <libslax/slaxdata.h>
 #include <libslax/slaxdyn.h>
+#include "slaxext.h"
 
 static xsltDocLoaderFunc slaxOriginalXsltDocDefaultLoader;
 xmlExternalEntityLoader slaxOriginalEntityLoader;
@@ -1135,6 +1136,7 @@ void
 slaxEnable (int enable)
 {
     if (enable == SLAX_CLEANUP) {
+	slaxSyslogClose();
 	xsltSetLoaderFunc(NULL);
 	if (slaxIncludesInited)
 	    slaxDataListClean(&slaxIncludes);
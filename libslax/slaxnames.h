@@ -145,4 +145,6 @@
 /* Names for generated code */
 #define FOR_VARIABLE_PREFIX "$slax-dot-"
 #define FUNC_BUILD_SEQUENCE "build-sequence"
+#define FUNC_EMPTY_LAZY "is-empty-lazy"
+#define FUNC_FIRST_OF_LAZY "first-of-lazy"
 #define FUNC_MVAR_INIT "mvar-init"
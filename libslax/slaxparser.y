@@ -3072,10 +3072,16 @@ xpc_function_call :
 				newp = slaxWriteRedoConcat(slax_data, $$);
 				if (newp)
 				    $$ = newp;
+				else {
+				    newp = slaxWriteRedoLazy(slax_data, $$);
+				    if (newp)
+					$$ = newp;
+				}
 			    }
 			}
 		    } else {
 			$$ = STACK_LINK($1);
+			$$ = slaxLazyRewrite(slax_data, $$);
 		    }
 		}
 
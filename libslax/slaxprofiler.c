@@ -14,6 +14,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <ctype.h>
 #include <sys/types.h>
@@ -23,11 +24,16 @@
 #include <sys/queue.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <libxml/xmlsave.h>
 #include <libxml/xmlIO.h>
+#include <libxml/hash.h>
 #include <libxslt/variables.h>
 #include <libxslt/transform.h>
+#include <libxslt/extensions.h>
+#include <libexslt/exslt.h>
 
 #include "slaxinternals.h"
 #include <libslax/slax.h>
@@ -37,6 +43,9 @@ typedef struct slax_prof_entry_s {
     unsigned long spe_count; /* Number of times we've hit this line */
     unsigned long spe_user; /* Total number of user cycles we've spent */
     unsigned long spe_system; /* Total number of system cycles we've spent */
+    unsigned long spe_allocs; /* Number of allocations made by this line */
+    unsigned long spe_bytes; /* Number of bytes allocated by this line */
+    xmlNodePtr spe_owner;    /* Template or function holding this line */
 } slax_prof_entry_t;
 
 /*
@@ -48,12 +57,19 @@ typedef struct slax_prof_s {
     xmlDocPtr sp_docp;		/* Document pointer */
     unsigned sp_inst_line;	/* Current instruction line number*/
     unsigned sp_lines;		/* Number of lines in the file */
+    xmlNodePtr sp_mem_inst;	/* Instruction charged for allocations */
+    unsigned long sp_other_allocs; /* Allocations not charged to a line */
+    unsigned long sp_other_bytes; /* Bytes not charged to a line */
     slax_prof_entry_t sp_data[0]; /* Raw data, indexed by line number */
 } slax_prof_t;
 
 slax_prof_t *slax_profile;	/* Profiling data */
 psu_time_usecs_t slax_profile_time_user; /* Last user time from getrusage */
 unsigned long slax_profile_time_system; /* Last system time from getrusage */
+static int slax_profile_hooked; /* slaxProfMemOpen() installed our hooks */
+
+static void slaxProfHooksInstall (void);
+static void slaxProfHooksRemove (void);
 
 static unsigned
 slaxProfCountLines (xmlDocPtr docp)
@@ -116,6 +132,8 @@ slaxProfEnter (xmlNodePtr inst)
 
     slaxLog("profile:enter for %s", inst->name);
 
+    spp->sp_mem_inst = inst;	/* Charge allocations to this instruction */
+
     if (spp->sp_inst_line)
 	slaxLog("profile: warning: enter while still set");
 
@@ -284,6 +302,7 @@ slaxProfClear (void)
     slax_prof_t *spp = slax_profile;
 
     bzero(spp->sp_data, (spp->sp_lines + 1) * sizeof(spp->sp_data[0]));
+    spp->sp_other_allocs = spp->sp_other_bytes = 0;
 }
 
 /**
@@ -294,7 +313,803 @@ slaxProfClose (void)
 {
     slax_prof_t *spp = slax_profile;
 
+    slax_profile = NULL;	/* The allocator hooks look at this */
     xmlFree(spp);
 
+    if (slax_profile_hooked) {
+	slax_profile_hooked = FALSE;
+	slaxProfHooksRemove();
+    }
+
     slax_profile_time_user = slax_profile_time_system = 0; /* Not valid */
 }
+
+/*
+ * Memory statistics: counting wrappers around the libxml2 allocator,
+ * which libxml2, libxslt, and libslax all use, and the libpsu one,
+ * used by parrotdb and libxi.  The wrappers call the original
+ * functions, so memory allocated before they're installed can still
+ * be freed; it just isn't counted.
+ *
+ * When the profiler is open, each allocation is also charged to the
+ * line of the instruction being executed, giving a memory profile.
+ * Frees are not charged, since we'd need to track the size of each
+ * block; the profile shows where memory is allocated, not where it's
+ * held.
+ */
+static slax_mem_stats_t slax_mem_stats;
+static xmlFreeFunc slaxMemOrigFree;
+static xmlMallocFunc slaxMemOrigMalloc;
+static xmlReallocFunc slaxMemOrigRealloc;
+static xmlStrdupFunc slaxMemOrigStrdup;
+static psu_realloc_func_t slaxMemOrigPsuRealloc;
+
+/*
+ * Find the template or function an instruction lives in
+ */
+static xmlNodePtr
+slaxProfOwner (xmlNodePtr inst)
+{
+    for ( ; inst && inst->type == XML_ELEMENT_NODE; inst = inst->parent) {
+	if (inst->ns == NULL || inst->ns->href == NULL)
+	    continue;
+
+	if (streq((const char *) inst->name, ELT_TEMPLATE)
+	    && streq((const char *) inst->ns->href, XSL_URI))
+	    return inst;
+
+	if (streq((const char *) inst->name, ELT_FUNCTION)
+	    && streq((const char *) inst->ns->href, (const char *) FUNC_URI))
+	    return inst;
+    }
+
+    return NULL;
+}
+
+/*
+ * Charge an allocation to the current instruction
+ */
+static inline void
+slaxProfMemCharge (size_t size)
+{
+    slax_prof_t *spp = slax_profile;
+    xmlNodePtr inst;
+    unsigned line;
+
+    if (spp == NULL || (inst = spp->sp_mem_inst) == NULL)
+	return;
+
+    line = (inst->doc == spp->sp_docp) ? xmlGetLineNo(inst) : 0;
+    if (line == 0 || line > spp->sp_lines) {
+	spp->sp_other_allocs += 1;
+	spp->sp_other_bytes += size;
+	return;
+    }
+
+    slax_prof_entry_t *spep = &spp->sp_data[line];
+    spep->spe_allocs += 1;
+    spep->spe_bytes += size;
+    if (spep->spe_owner == NULL)
+	spep->spe_owner = slaxProfOwner(inst);
+}
+
+static void
+slaxMemFree (void *ptr)
+{
+    if (ptr)
+	slax_mem_stats.sms_frees += 1;
+    slaxMemOrigFree(ptr);
+}
+
+static void *
+slaxMemMalloc (size_t size)
+{
+    slax_mem_stats.sms_allocs += 1;
+    slax_mem_stats.sms_bytes += size;
+    slaxProfMemCharge(size);
+    return slaxMemOrigMalloc(size);
+}
+
+static void *
+slaxMemRealloc (void *ptr, size_t size)
+{
+    if (ptr)
+	slax_mem_stats.sms_reallocs += 1;
+    else
+	slax_mem_stats.sms_allocs += 1;
+    slax_mem_stats.sms_bytes += size;
+    slaxProfMemCharge(size);
+    return slaxMemOrigRealloc(ptr, size);
+}
+
+static char *
+slaxMemStrdup (const char *str)
+{
+    size_t size = strlen(str) + 1;
+
+    slax_mem_stats.sms_allocs += 1;
+    slax_mem_stats.sms_bytes += size;
+    slaxProfMemCharge(size);
+    return slaxMemOrigStrdup(str);
+}
+
+static void *
+slaxMemPsuRealloc (void *ptr, size_t size)
+{
+    if (ptr)
+	slax_mem_stats.sms_reallocs += 1;
+    else
+	slax_mem_stats.sms_allocs += 1;
+    slax_mem_stats.sms_bytes += size;
+    slaxProfMemCharge(size);
+    return slaxMemOrigPsuRealloc(ptr, size);
+}
+
+/**
+ * Start counting allocations.  Call this before xmlInitParser().
+ * @returns zero on success, -1 on failure
+ */
+int
+slaxMemStatsEnable (void)
+{
+    if (slaxMemOrigMalloc)
+	return 0;		/* Already enabled */
+
+    if (xmlMemGet(&slaxMemOrigFree, &slaxMemOrigMalloc,
+		  &slaxMemOrigRealloc, &slaxMemOrigStrdup) != 0)
+	return -1;
+
+    if (xmlMemSetup(slaxMemFree, slaxMemMalloc,
+		    slaxMemRealloc, slaxMemStrdup) != 0) {
+	slaxMemOrigMalloc = NULL;
+	return -1;
+    }
+
+    slaxMemOrigPsuRealloc = psu_realloc;
+    psu_set_allocator(slaxMemPsuRealloc, psu_free);
+
+    return 0;
+}
+
+/**
+ * Fetch the current statistics, including the peak resident set size
+ * @smsp the structure to fill in
+ */
+void
+slaxMemStatsGet (slax_mem_stats_t *smsp)
+{
+    struct rusage ru;
+
+    *smsp = slax_mem_stats;
+    smsp->sms_max_rss = 0;
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+	smsp->sms_max_rss = ru.ru_maxrss; /* Kilobytes on Linux */
+}
+
+/**
+ * Open the profiler for a non-interactive run, charging allocations
+ * to instructions.  The debugger uses slaxProfOpen() directly, since
+ * it has its own hooks.  slaxMemStatsEnable() must have been called.
+ *
+ * @docp document pointer for the script
+ * @returns TRUE is there was a problem
+ */
+int
+slaxProfMemOpen (xmlDocPtr docp)
+{
+    if (slaxMemOrigMalloc == NULL || slaxProfOpen(docp))
+	return TRUE;
+
+    slaxProfHooksInstall();
+    slax_profile_hooked = TRUE;
+    return FALSE;
+}
+
+/*
+ * Report lines go to a file, or through slaxOutput() for the debugger
+ */
+static void
+slaxProfPrint (FILE *fp, const char *fmt, ...)
+{
+    char buf[BUFSIZ];
+    va_list vap;
+
+    va_start(vap, fmt);
+    if (fp) {
+	vfprintf(fp, fmt, vap);
+	fputc('\n', fp);
+    } else {
+	vsnprintf(buf, sizeof(buf), fmt, vap);
+	slaxOutput("%s", buf);
+    }
+    va_end(vap);
+}
+
+static const char *
+slaxProfOwnerName (xmlNodePtr owner, char *buf, size_t bufsiz)
+{
+    char *name, *match;
+
+    if (owner == NULL) {
+	snprintf(buf, bufsiz, "[global]");
+	return buf;
+    }
+
+    name = slaxGetAttrib(owner, ATT_NAME);
+    match = slaxGetAttrib(owner, ATT_MATCH);
+
+    if (streq((const char *) owner->name, ELT_FUNCTION))
+	snprintf(buf, bufsiz, "%s()", name ?: "");
+    else if (name)
+	snprintf(buf, bufsiz, "%s", name);
+    else
+	snprintf(buf, bufsiz, "match %s", match ?: "");
+
+    xmlFreeAndEasy(name);
+    xmlFreeAndEasy(match);
+    return buf;
+}
+
+static int
+slaxProfMemCompare (const void *a, const void *b)
+{
+    slax_prof_entry_t *data = slax_profile->sp_data;
+    unsigned long abytes = data[*(const unsigned *) a].spe_bytes;
+    unsigned long bbytes = data[*(const unsigned *) b].spe_bytes;
+
+    if (abytes != bbytes)
+	return (abytes > bbytes) ? -1 : 1;
+
+    return (*(const unsigned *) a > *(const unsigned *) b) ? 1 : -1;
+}
+
+/*
+ * Read the script source, returning a buffer (to be freed) and
+ * filling in the start of each line
+ */
+static char *
+slaxProfReadSource (const char *filename, const char *buffer,
+		    const char **lines, unsigned max)
+{
+    char *source = NULL, *cp;
+    unsigned num;
+
+    if (buffer) {
+	source = (char *) xmlStrdup((const xmlChar *) buffer);
+    } else if (filename) {
+	FILE *fp = fopen(filename, "r");
+	if (fp) {
+	    size_t len = 0, size = BUFSIZ, rc;
+
+	    source = xmlMalloc(size + 1);
+	    while (source
+		   && (rc = fread(source + len, 1, size - len, fp)) > 0) {
+		len += rc;
+		if (len == size) {
+		    size *= 2;
+		    cp = xmlRealloc(source, size + 1);
+		    if (cp == NULL)
+			xmlFree(source);
+		    source = cp;
+		}
+	    }
+	    if (source)
+		source[len] = '\0';
+	    fclose(fp);
+	}
+    }
+
+    for (num = 1, cp = source; cp && num <= max; num++) {
+	lines[num] = cp;
+	cp = strchr(cp, '\n');
+	if (cp)
+	    *cp++ = '\0';
+    }
+
+    return source;
+}
+
+/**
+ * Report where memory was allocated, by line, sorted by bytes
+ *
+ * @fp file to write (or NULL to use slaxOutput())
+ * @buffer in-memory copy of the script (or NULL to read the file)
+ */
+void
+slaxProfMemReport (FILE *fp, const char *buffer)
+{
+    slax_prof_t *spp = slax_profile;
+    unsigned *order, count = 0, line, i;
+    unsigned long tot_allocs, tot_bytes;
+    const char **lines;
+    char *source;
+    char owner[BUFSIZ];
+
+    if (spp == NULL)
+	return;
+
+    if (slaxMemOrigMalloc == NULL) {
+	slaxProfPrint(fp, "memory profiling is not enabled");
+	return;
+    }
+
+    /* Don't charge our own allocations */
+    xmlNodePtr save_inst = spp->sp_mem_inst;
+    spp->sp_mem_inst = NULL;
+
+    order = xmlMalloc((spp->sp_lines + 1) * sizeof(*order));
+    lines = xmlMalloc((spp->sp_lines + 1) * sizeof(*lines));
+    if (order == NULL || lines == NULL) {
+	xmlFreeAndEasy(order);
+	xmlFreeAndEasy(lines);
+	spp->sp_mem_inst = save_inst;
+	return;
+    }
+
+    bzero(lines, (spp->sp_lines + 1) * sizeof(*lines));
+    source = slaxProfReadSource((const char *) spp->sp_docp->URL, buffer,
+				lines, spp->sp_lines);
+
+    tot_allocs = spp->sp_other_allocs;
+    tot_bytes = spp->sp_other_bytes;
+
+    for (line = 1; line <= spp->sp_lines; line++) {
+	if (spp->sp_data[line].spe_allocs) {
+	    order[count++] = line;
+	    tot_allocs += spp->sp_data[line].spe_allocs;
+	    tot_bytes += spp->sp_data[line].spe_bytes;
+	}
+    }
+
+    qsort(order, count, sizeof(*order), slaxProfMemCompare);
+
+    slaxProfPrint(fp, "%5s %8s %10s %8s %-20s %s",
+		  "Line", "Allocs", "Bytes", "B/Alloc", "Template", "Source");
+
+    for (i = 0; i < count; i++) {
+	slax_prof_entry_t *spep = &spp->sp_data[order[i]];
+
+	slaxProfPrint(fp, "%5u %8lu %10lu %8.1f %-20.20s %s",
+		      order[i], spep->spe_allocs, spep->spe_bytes,
+		      doublediv(spep->spe_bytes, spep->spe_allocs),
+		      slaxProfOwnerName(spep->spe_owner, owner, sizeof(owner)),
+		      lines[order[i]] ?: "");
+    }
+
+    if (spp->sp_other_allocs)
+	slaxProfPrint(fp, "%5s %8lu %10lu %8.1f %-20s %s", "-",
+		      spp->sp_other_allocs, spp->sp_other_bytes,
+		      doublediv(spp->sp_other_bytes, spp->sp_other_allocs),
+		      "-", "(other files and libxslt itself)");
+
+    slaxProfPrint(fp, "%5s %8lu %10lu %8s %-20s %s", "Total",
+		  tot_allocs, tot_bytes, "", "", "Total");
+
+    xmlFreeAndEasy(source);
+    xmlFree(lines);
+    xmlFree(order);
+
+    spp->sp_mem_inst = save_inst;
+}
+
+/*
+ * Call timeline: enter and exit events for templates, functions and
+ * extension functions, with monotonic timestamps, written as a
+ * Chrome/Perfetto trace-event file ("chrome://tracing" or
+ * ui.perfetto.dev).  Unlike the profiler above, which aggregates by
+ * line, this shows where wall time goes across nested calls.
+ *
+ * Templates and functions are seen via the libxslt debugger hooks,
+ * either our own or the debugger's when it's running.  Extension
+ * functions have no hook, so slaxRegisterFunction() registers
+ * slaxTimelineFunction() in their place, which looks up the real
+ * function by name.
+ */
+static FILE *slax_timeline_fp;	/* Output file (NULL if not enabled) */
+static struct timespec slax_timeline_start; /* Time zero */
+static unsigned slax_timeline_depth; /* Open "B" events */
+static unsigned long slax_timeline_events; /* Events written */
+static xmlHashTablePtr slax_timeline_functions; /* Real functions */
+
+static double
+slaxTimelineNow (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec - slax_timeline_start.tv_sec) * (double) USEC_PER_SEC
+	+ (ts.tv_nsec - slax_timeline_start.tv_nsec) / (double) NSEC_PER_USEC;
+}
+
+static void
+slaxTimelineString (FILE *fp, const char *str)
+{
+    const unsigned char *cp;
+
+    fputc('"', fp);
+    for (cp = (const unsigned char *) str; cp && *cp; cp++) {
+	if (*cp == '"' || *cp == '\\')
+	    fprintf(fp, "\\%c", *cp);
+	else if (*cp < 0x20)
+	    fprintf(fp, "\\u%04x", *cp);
+	else
+	    fputc(*cp, fp);
+    }
+    fputc('"', fp);
+}
+
+/*
+ * Write one event.  "B" (begin) events carry the name, category and
+ * source location; "E" (end) events close the most recent "B".
+ */
+static void
+slaxTimelineEvent (int phase, const char *cat, const char *name,
+		   const char *uri, xmlNodePtr inst)
+{
+    FILE *fp = slax_timeline_fp;
+
+    fprintf(fp, "%s\n{\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":1",
+	    slax_timeline_events++ ? "," : "", phase,
+	    slaxTimelineNow(), (int) getpid());
+
+    if (phase == 'B') {
+	fprintf(fp, ",\"cat\":\"%s\",\"name\":", cat);
+	slaxTimelineString(fp, name);
+	fprintf(fp, ",\"args\":{");
+	if (uri) {
+	    fprintf(fp, "\"uri\":");
+	    slaxTimelineString(fp, uri);
+	}
+	if (inst && inst->doc && inst->doc->URL) {
+	    fprintf(fp, "%s\"file\":", uri ? "," : "");
+	    slaxTimelineString(fp, (const char *) inst->doc->URL);
+	    fprintf(fp, ",\"line\":%ld", xmlGetLineNo(inst));
+	}
+	fprintf(fp, "}");
+	slax_timeline_depth += 1;
+
+    } else if (slax_timeline_depth > 0) {
+	slax_timeline_depth -= 1;
+    }
+
+    fprintf(fp, "}");
+}
+
+static int
+slaxTimelineIsFunction (xmlNodePtr node)
+{
+    return (node && node->type == XML_ELEMENT_NODE
+	    && node->ns && node->ns->href
+	    && streq((const char *) node->ns->href, (const char *) FUNC_URI)
+	    && streq((const char *) node->name, ELT_FUNCTION));
+}
+
+/**
+ * Called when a template or function is entered
+ *
+ * @template template being entered (NULL for functions and globals)
+ * @inst instruction node
+ */
+void
+slaxTimelineEnter (xsltTemplatePtr template, xmlNodePtr inst)
+{
+    char buf[BUFSIZ], *cp = buf, *ep = buf + sizeof(buf);
+    const char *cat = "instruction";
+
+    if (slax_timeline_fp == NULL)
+	return;
+
+    buf[0] = '\0';
+    if (template) {
+	cat = "template";
+	if (template->name)
+	    SNPRINTF(cp, ep, "template %s ", template->name);
+	if (template->match)
+	    SNPRINTF(cp, ep, "match %s", template->match);
+	if (cp > buf && cp[-1] == ' ')
+	    cp[-1] = '\0';
+
+    } else if (slaxTimelineIsFunction(inst)
+	       || (inst && slaxTimelineIsFunction(inst->parent))) {
+	/* A function call enters the first statement of its body */
+	xmlNodePtr fnode = slaxTimelineIsFunction(inst) ? inst : inst->parent;
+	xmlChar *name = xmlGetProp(fnode, (const xmlChar *) ATT_NAME);
+
+	cat = "function";
+	SNPRINTF(cp, ep, "function %s", name ? (char *) name : "");
+	xmlFreeAndEasy(name);
+
+    } else {
+	SNPRINTF(cp, ep, "<%s%s%s>",
+		 (inst && inst->ns && inst->ns->prefix)
+		     ? (const char *) inst->ns->prefix : "",
+		 (inst && inst->ns && inst->ns->prefix) ? ":" : "",
+		 inst ? (const char *) inst->name : "");
+    }
+
+    slaxTimelineEvent('B', cat, buf, NULL, inst);
+}
+
+/**
+ * Called when the most recently entered template or function exits
+ */
+void
+slaxTimelineExit (void)
+{
+    if (slax_timeline_fp)
+	slaxTimelineEvent('E', NULL, NULL, NULL, NULL);
+}
+
+/*
+ * Our own libxslt debugger hooks, used by the timeline and the
+ * memory profiler when the debugger isn't running (the debugger
+ * calls them itself).  As in slaxDebugAddFrame(), a template call
+ * gives two addFrame calls, and we skip the inner one, which follows
+ * a handler call for the same instruction.  When a frame is dropped,
+ * allocations are again charged to the instruction that made the
+ * call.
+ *
+ * libxslt has no way to fetch the current callbacks, so we keep
+ * track ourselves: if the debugger has installed its hooks, we leave
+ * them alone, and otherwise no one else has set any, and removing
+ * ours puts back the NULL callbacks and the status we found.
+ */
+static xmlNodePtr slax_hook_inst; /* Last instruction seen */
+static xmlNodePtr *slax_hook_callers; /* Stack of calling instructions */
+static unsigned slax_hook_depth; /* Number of frames on the stack */
+static unsigned slax_hook_max;	/* Size of slax_hook_callers */
+static unsigned slax_hook_users; /* Number of slaxProfHooksInstall() calls */
+static int slax_hook_installed;	/* Our callbacks are installed */
+static int slax_hook_status;	/* Debugger status before we installed */
+static int slax_hook_debugger;	/* The debugger's hooks are installed */
+
+static void
+slaxProfHookHandler (xmlNodePtr inst, xmlNodePtr node UNUSED,
+		     xsltTemplatePtr template UNUSED,
+		     xsltTransformContextPtr ctxt UNUSED)
+{
+    slax_hook_inst = inst;
+    if (slax_profile)
+	slax_profile->sp_mem_inst = inst;
+}
+
+static int
+slaxProfHookAddFrame (xsltTemplatePtr template, xmlNodePtr inst)
+{
+    if (inst == NULL)
+	return 0;
+
+    if (inst == slax_hook_inst
+	&& (streq((const char *) inst->name, ELT_CALL_TEMPLATE)
+	    || streq((const char *) inst->name, ELT_TEMPLATE)))
+	return 0;
+
+    if (slax_hook_depth >= slax_hook_max) {
+	unsigned max = slax_hook_max ? slax_hook_max * 2 : 64;
+
+	/* Plain realloc, so the memory profiler doesn't see us */
+	xmlNodePtr *callers = realloc(slax_hook_callers,
+				      max * sizeof(*callers));
+	if (callers == NULL)
+	    return 0;
+
+	slax_hook_callers = callers;
+	slax_hook_max = max;
+    }
+
+    slax_hook_callers[slax_hook_depth++] = slax_hook_inst;
+    slaxTimelineEnter(template, inst);
+
+    return 1;			/* Ask for slaxProfHookDropFrame() */
+}
+
+static void
+slaxProfHookDropFrame (void)
+{
+    if (slax_hook_depth > 0) {
+	slax_hook_inst = slax_hook_callers[--slax_hook_depth];
+	if (slax_profile)
+	    slax_profile->sp_mem_inst = slax_hook_inst;
+    }
+
+    slaxTimelineExit();
+}
+
+static void
+slaxProfHooksInstall (void)
+{
+    /* The debugger, if used, replaces these and calls us itself */
+    if (slax_hook_users++ > 0 || slax_hook_debugger)
+	return;
+
+    slax_hook_status = xsltGetDebuggerStatus();
+    xsltSetDebuggerCallbacksHelper(slaxProfHookHandler, slaxProfHookAddFrame,
+				   slaxProfHookDropFrame);
+    if (slax_hook_status == XSLT_DEBUG_NONE)
+	xsltSetDebuggerStatus(XSLT_DEBUG_CONT);
+    slax_hook_installed = TRUE;
+}
+
+static void
+slaxProfHooksRemove (void)
+{
+    if (slax_hook_users == 0 || --slax_hook_users > 0)
+	return;
+
+    if (slax_hook_installed && !slax_hook_debugger) {
+	xsltSetDebuggerCallbacksHelper(NULL, NULL, NULL);
+	xsltSetDebuggerStatus(slax_hook_status);
+    }
+    slax_hook_installed = FALSE;
+
+    free(slax_hook_callers);
+    slax_hook_callers = NULL;
+    slax_hook_depth = slax_hook_max = 0;
+    slax_hook_inst = NULL;
+}
+
+/**
+ * Note that the debugger has installed its own hooks, which call
+ * slaxTimelineEnter() and slaxTimelineExit() themselves
+ */
+void
+slaxProfHooksReplaced (void)
+{
+    slax_hook_debugger = TRUE;
+}
+
+/*
+ * Stand-in for every extension function registered while the
+ * timeline is open.  libxml2 sets the function's name and URI in the
+ * XPath context before calling it, so we can find the real one.
+ */
+static void
+slaxTimelineFunction (xmlXPathParserContextPtr ctxt, int nargs)
+{
+    const xmlChar *name = ctxt->context->function;
+    const xmlChar *uri = ctxt->context->functionURI;
+    xsltTransformContextPtr tctxt = xsltXPathGetTransformContext(ctxt);
+    xmlXPathFunction func;
+    char buf[BUFSIZ];
+
+    func = XML_CAST_FPTR(xmlHashLookup2(slax_timeline_functions, name, uri));
+    if (func == NULL) {
+	/*
+	 * After slaxTimelineClose(), the real function is registered
+	 * again, but compiled expressions may still point at us.
+	 */
+	func = xsltExtModuleFunctionLookup(name, uri);
+	if (func == slaxTimelineFunction)
+	    func = NULL;
+    }
+
+    if (func == NULL) {
+	xmlXPathErr(ctxt, XPATH_UNKNOWN_FUNC_ERROR);
+	return;
+    }
+
+    if (slax_timeline_fp == NULL) {
+	func(ctxt, nargs);
+	return;
+    }
+
+    snprintf(buf, sizeof(buf), "%s()", name ? (const char *) name : "");
+    slaxTimelineEvent('B', "extension", buf, (const char *) uri,
+		      tctxt ? tctxt->inst : NULL);
+    func(ctxt, nargs);
+    slaxTimelineEvent('E', NULL, NULL, NULL, NULL);
+}
+
+/**
+ * Wrap an extension function as it's registered, if the timeline is
+ * open.  Called from slaxRegisterFunction().
+ *
+ * @uri namespace URI of the function
+ * @fn name of the function
+ * @func the function
+ * @returns the function to register
+ */
+xmlXPathFunction
+slaxTimelineWrapFunction (const char *uri, const char *fn,
+			  xmlXPathFunction func)
+{
+    if (slax_timeline_fp == NULL || func == NULL)
+	return func;
+
+    if (slax_timeline_functions == NULL) {
+	slax_timeline_functions = xmlHashCreate(0);
+	if (slax_timeline_functions == NULL)
+	    return func;
+    }
+
+    if (xmlHashUpdateEntry2(slax_timeline_functions, (const xmlChar *) fn,
+			    (const xmlChar *) uri,
+			    XML_CAST_FPTR(func), NULL) != 0)
+	return func;
+
+    return slaxTimelineFunction;
+}
+
+/**
+ * Start writing a call timeline.  Call this before slaxEnable() so
+ * extension functions are wrapped as they are registered, and before
+ * the transform starts.
+ *
+ * @filename file to write (or "-" for stdout)
+ * @returns zero on success, -1 on failure
+ */
+int
+slaxTimelineOpen (const char *filename)
+{
+    FILE *fp;
+
+    if (slax_timeline_fp)
+	return 0;		/* Already open */
+
+    fp = slaxFilenameIsStd(filename) ? stdout : fopen(filename, "w");
+    if (fp == NULL)
+	return -1;
+
+    slax_timeline_fp = fp;
+    slax_timeline_depth = 0;
+    slax_timeline_events = 0;
+    clock_gettime(CLOCK_MONOTONIC, &slax_timeline_start);
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    slaxProfHooksInstall();
+
+    return 0;
+}
+
+/*
+ * Put back a real function in place of our stand-in, unless it's
+ * been unregistered or replaced since
+ */
+static void
+slaxTimelineRestoreFunction (void *payload, void *data UNUSED,
+			     const xmlChar *name, const xmlChar *uri,
+			     const xmlChar *unused UNUSED)
+{
+    xmlXPathFunction func = XML_CAST_FPTR(payload);
+
+    if (xsltExtModuleFunctionLookup(name, uri) == slaxTimelineFunction)
+	xsltRegisterExtModuleFunction(name, uri, func);
+}
+
+/**
+ * Finish the timeline, closing any calls left open (by an error or
+ * <xsl:message terminate="yes">), and close the file.  The real
+ * extension functions and the previous libxslt debugger callbacks and
+ * status are put back.
+ */
+void
+slaxTimelineClose (void)
+{
+    FILE *fp = slax_timeline_fp;
+
+    if (fp == NULL)
+	return;
+
+    while (slax_timeline_depth > 0)
+	slaxTimelineEvent('E', NULL, NULL, NULL, NULL);
+
+    fprintf(fp, "\n]}\n");
+
+    if (fp == stdout)
+	fflush(fp);
+    else
+	fclose(fp);
+
+    slax_timeline_fp = NULL;
+
+    if (slax_timeline_functions) {
+	xmlHashScanFull(slax_timeline_functions,
+			slaxTimelineRestoreFunction, NULL);
+	xmlHashFree(slax_timeline_functions, NULL);
+	slax_timeline_functions = NULL;
+    }
+
+    slaxProfHooksRemove();
+}
@@ -52,3 +52,45 @@ slaxProfClear (void);
  */
 void
 slaxProfClose (void);
+
+/**
+ * Open the profiler for a non-interactive run, charging allocations
+ * to instructions.  slaxMemStatsEnable() must have been called.
+ *
+ * @docp document pointer for the script
+ * @returns TRUE is there was a problem
+ */
+int
+slaxProfMemOpen (xmlDocPtr docp);
+
+/**
+ * Report where memory was allocated, by line, sorted by bytes
+ *
+ * @fp file to write (or NULL to use slaxOutput())
+ * @buffer in-memory copy of the script (or NULL to read the file)
+ */
+void
+slaxProfMemReport (FILE *fp, const char *buffer);
+
+/**
+ * Note that the debugger has installed its own libxslt hooks, which
+ * call slaxTimelineEnter() and slaxTimelineExit() themselves
+ */
+void
+slaxProfHooksReplaced (void);
+
+/**
+ * Called when a template or function is entered, if the call
+ * timeline is open (see slaxTimelineOpen())
+ *
+ * @template template being entered (NULL for functions and globals)
+ * @inst instruction node
+ */
+void
+slaxTimelineEnter (xsltTemplatePtr template, xmlNodePtr inst);
+
+/**
+ * Called when the most recently entered template or function exits
+ */
+void
+slaxTimelineExit (void);
@@ -840,6 +840,13 @@ slaxConcatRewrite (slax_data_t *sdp UNUSED, slax_string_t *left,
 	    ssp->ss_next = op;
 	    commap->ss_concat = op; /* Point to next marker */
 
+	    /*
+	     * The open paren's ss_concat is otherwise unused, so we
+	     * keep the closing paren there, letting a long chain of
+	     * "_" operators append in constant time.
+	     */
+	    openp->ss_concat = op;
+
 	    return conp;
 	}
 
@@ -861,8 +868,15 @@ slaxConcatRewrite (slax_data_t *sdp UNUSED, slax_string_t *left,
 	 * paren at the end, so we turn that into a comma for
 	 * the middle and add "op" as the new cparen.
 	 */
-	for (commap = left; commap->ss_next; commap = commap->ss_next)
-	    continue;
+	slax_string_t *openp = left->ss_next;
+
+	commap = (openp && openp->ss_ttype == L_OPAREN) ? openp->ss_concat
+	    : NULL;
+	if (commap == NULL || commap->ss_next != NULL
+		|| commap->ss_ttype != L_CPAREN)
+	    for (commap = left; commap->ss_next; commap = commap->ss_next)
+		continue;
+
 	if (commap->ss_ttype == L_CPAREN) {
 
 	    commap->ss_ttype = L_COMMA;
@@ -875,6 +889,8 @@ slaxConcatRewrite (slax_data_t *sdp UNUSED, slax_string_t *left,
 	    ssp->ss_next = op;
 
 	    commap->ss_concat = op; /* Point to next marker */
+	    if (openp && openp->ss_ttype == L_OPAREN)
+		openp->ss_concat = op;
 
 	    return left;
 		
@@ -950,6 +966,159 @@ slaxTernaryRewrite (slax_data_t *sdp UNUSED, slax_string_t *scond,
     return tsp;
 }
 
+/*
+ * Functions whose trailing arguments can be deferred, mapped to the
+ * generated functions that evaluate them lazily.
+ */
+static const char *slaxLazyFunctions[][2] = {
+    { SLAX_PREFIX ":first-of", SLAX_PREFIX ":" FUNC_FIRST_OF_LAZY },
+    { SLAX_PREFIX ":empty", SLAX_PREFIX ":" FUNC_EMPTY_LAZY },
+    { SLAX_PREFIX ":is-empty", SLAX_PREFIX ":" FUNC_EMPTY_LAZY },
+    { NULL, NULL }
+};
+
+/*
+ * Find the end of the argument starting at "start", which is the
+ * token before the next comma (or close paren) at the same depth.
+ */
+static slax_string_t *
+slaxLazyArgEnd (slax_string_t *start)
+{
+    slax_string_t *ssp;
+    int depth = 0;
+
+    for (ssp = start; ssp; ssp = ssp->ss_next) {
+	if (ssp->ss_ttype == L_OPAREN || ssp->ss_ttype == L_OBRACK)
+	    depth += 1;
+	else if (ssp->ss_ttype == L_CPAREN || ssp->ss_ttype == L_CBRACK)
+	    depth -= 1;
+
+	if (depth == 0 && ssp->ss_next
+	    && (ssp->ss_next->ss_ttype == L_COMMA
+		|| (ssp->ss_next->ss_ttype == L_CPAREN
+		    && ssp->ss_next->ss_next == NULL)))
+	    return ssp;
+    }
+
+    return NULL;
+}
+
+/*
+ * Can this argument be turned into a string?  Ternaries need hidden
+ * variables, so they can't be deferred, and the result must be
+ * expressible using a single style of quotes.
+ */
+static int
+slaxLazyArgOk (slax_string_t *start, slax_string_t *end)
+{
+    slax_string_t *ssp;
+    char *buf;
+    int ok;
+
+    for (ssp = start; ssp; ssp = ssp->ss_next) {
+	if (ssp->ss_ttype == M_TERNARY || ssp->ss_ttype == M_TERNARY_END)
+	    return FALSE;
+	if (ssp->ss_ttype == T_QUOTED && strchr(ssp->ss_token, '\\'))
+	    return FALSE;
+	if (ssp == end)
+	    break;
+    }
+
+    slax_string_t *save = end->ss_next;
+    end->ss_next = NULL;
+    buf = slaxStringAsChar(start, SSF_QUOTES);
+    end->ss_next = save;
+
+    if (buf == NULL)
+	return FALSE;
+
+    ok = !(strchr(buf, '\'') && strchr(buf, '"'));
+    xmlFree(buf);
+    return ok;
+}
+
+/*
+ * Rewrite calls to slax:first-of() and slax:is-empty() so that all
+ * arguments after the first are passed as strings, which the
+ * generated function compiles and evaluates only when the preceding
+ * arguments were empty.  This gives these functions the short-circuit
+ * behavior of "or", rather than evaluating every alternative.  If any
+ * argument can't be deferred, the call is left untouched.
+ *
+ * @param sdp main slax data structure (UNUSED)
+ * @param func the function call (name, paren, arguments, paren)
+ * @return the (possibly rewritten) function call
+ */
+slax_string_t *
+slaxLazyRewrite (slax_data_t *sdp UNUSED, slax_string_t *func)
+{
+    slax_string_t *openp, *start, *end, *prev, *newp, *save;
+    char *buf;
+    int i;
+
+    if (func == NULL || func->ss_ttype != T_FUNCTION_NAME)
+	return func;
+
+    for (i = 0; slaxLazyFunctions[i][0]; i++)
+	if (streq(func->ss_token, slaxLazyFunctions[i][0]))
+	    break;
+    if (slaxLazyFunctions[i][0] == NULL)
+	return func;
+
+    openp = func->ss_next;
+    if (openp == NULL || openp->ss_ttype != L_OPAREN || openp->ss_next == NULL)
+	return func;
+
+    /* Skip the first argument, which is always evaluated */
+    end = slaxLazyArgEnd(openp->ss_next);
+    if (end == NULL || end->ss_next->ss_ttype != L_COMMA)
+	return func;	/* Only one argument; nothing to defer */
+
+    /* Make sure we can handle all the remaining arguments */
+    for (prev = end->ss_next; prev->ss_ttype == L_COMMA;
+	 prev = end->ss_next) {
+	start = prev->ss_next;
+	end = slaxLazyArgEnd(start);
+	if (end == NULL || !slaxLazyArgOk(start, end))
+	    return func;
+    }
+
+    /* Replace each remaining argument with a quoted string */
+    end = slaxLazyArgEnd(openp->ss_next);
+    for (prev = end->ss_next; prev->ss_ttype == L_COMMA;
+	 prev = newp->ss_next) {
+	start = prev->ss_next;
+	end = slaxLazyArgEnd(start);
+
+	save = end->ss_next;
+	end->ss_next = NULL;
+	buf = slaxStringAsChar(start, SSF_QUOTES);
+	newp = buf ? slaxStringLiteral(buf, T_QUOTED) : NULL;
+	xmlFreeAndEasy(buf);
+	if (newp == NULL) {
+	    end->ss_next = save;
+	    return func;	/* Leave the rest alone */
+	}
+
+	newp->ss_next = save;
+	prev->ss_next = newp;
+	slaxStringFree(start);
+    }
+
+    newp = slaxStringLiteral(slaxLazyFunctions[i][1], T_FUNCTION_NAME);
+    if (newp == NULL)
+	return func;
+
+    slaxLog("slaxLazyRewrite: %s -> %s", func->ss_token, newp->ss_token);
+
+    newp->ss_flags = func->ss_flags | SSF_SLAXNS;
+    newp->ss_next = openp;
+    func->ss_next = NULL;
+    slaxStringFree(func);
+
+    return newp;
+}
+
 /**
  * Free a set of string segments.  The ss_next link is
  * followed and all contents are freed.
@@ -143,3 +143,9 @@ slaxConcatRewrite (struct slax_data_s *sdp, slax_string_t *,
 slax_string_t *
 slaxTernaryRewrite (struct slax_data_s *sdp, slax_string_t *, slax_string_t *,
 		    slax_string_t *, slax_string_t *, slax_string_t *);
+
+/*
+ * Defer the trailing arguments of slax:first-of() and slax:is-empty().
+ */
+slax_string_t *
+slaxLazyRewrite (struct slax_data_s *sdp, slax_string_t *);
@@ -1049,9 +1049,34 @@ slaxMoveImport (slax_data_t *sdp UNUSED, xmlNodePtr curp)
     }
 }
 
+/*
+ * Compile a SLAX (or XPath) expression for use with
+ * slaxXpathEvalCompiled().  The caller must free the result with
+ * xmlXPathFreeCompExpr().
+ */
+xmlXPathCompExprPtr
+slaxXpathCompile (xsltStylesheetPtr script, const char *expr)
+{
+    xmlXPathCompExprPtr comp;
+    char *sexpr;
+
+    sexpr = slaxSlaxToXpath("select", 1, (const char *) expr, NULL);
+    if (sexpr)
+	expr = sexpr;
+
+    comp = xsltXPathCompile(script, (const xmlChar *) expr);
+
+    xmlFreeAndEasy(sexpr);
+    return comp;
+}
+
+/*
+ * Evaluate a compiled expression with 'node' as the context node,
+ * using the namespaces in scope for 'inst'.
+ */
 xmlXPathObjectPtr
-slaxXpathEval (xmlNodePtr node, xmlNodePtr inst, xmlXPathContextPtr xpctxt,
-	       xsltStylesheetPtr script, const char *expr)
+slaxXpathEvalCompiled (xmlNodePtr node, xmlNodePtr inst,
+		       xmlXPathContextPtr xpctxt, xmlXPathCompExprPtr comp)
 {
     struct {
 	xmlDocPtr o_doc;
@@ -1064,22 +1089,8 @@ slaxXpathEval (xmlNodePtr node, xmlNodePtr inst, xmlXPathContextPtr xpctxt,
 
     xmlNsPtr *nsList;
     int nscount;
-    xmlXPathCompExprPtr comp;
     xmlXPathObjectPtr res;
 
-    char *sexpr = NULL;
-
-    
-    sexpr = slaxSlaxToXpath("select", 1, (const char *) expr, NULL);
-    if (sexpr)
-	expr = sexpr;
-
-    comp = xsltXPathCompile(script, (const xmlChar *) expr);
-    if (comp == NULL) {
-	xmlFreeAndEasy(sexpr);
-	return NULL;
-    }
-
     nsList = xmlGetNsList(inst->doc, inst);
     for (nscount = 0; nsList && nsList[nscount]; nscount++)
 	continue;
@@ -1108,13 +1119,29 @@ slaxXpathEval (xmlNodePtr node, xmlNodePtr inst, xmlXPathContextPtr xpctxt,
     xpctxt->nsNr = old.o_nscount;
     xpctxt->namespaces = old.o_nslist;
 
-    xmlFreeAndEasy(sexpr);
-    xmlXPathFreeCompExpr(comp);
     xmlFree(nsList);
 
     return res;
 }
 
+xmlXPathObjectPtr
+slaxXpathEval (xmlNodePtr node, xmlNodePtr inst, xmlXPathContextPtr xpctxt,
+	       xsltStylesheetPtr script, const char *expr)
+{
+    xmlXPathCompExprPtr comp;
+    xmlXPathObjectPtr res;
+
+    comp = slaxXpathCompile(script, expr);
+    if (comp == NULL)
+	return NULL;
+
+    res = slaxXpathEvalCompiled(node, inst, xpctxt, comp);
+
+    xmlXPathFreeCompExpr(comp);
+
+    return res;
+}
+
 xmlNodeSetPtr
 slaxXpathSelect (xmlDocPtr docp, xmlNodePtr nodep, const char *expr)
 {
@@ -224,6 +224,13 @@ slaxTernaryExpand (slax_data_t *, slax_string_t *, unsigned);
 void
 slaxMoveImport (slax_data_t *sdp, xmlNodePtr);
 
+xmlXPathCompExprPtr
+slaxXpathCompile (xsltStylesheetPtr script, const char *expr);
+
+xmlXPathObjectPtr
+slaxXpathEvalCompiled (xmlNodePtr node, xmlNodePtr inst,
+		       xmlXPathContextPtr xpctxt, xmlXPathCompExprPtr comp);
+
 xmlXPathObjectPtr
 slaxXpathEval (xmlNodePtr node, xmlNodePtr inst, xmlXPathContextPtr xpctxt,
 	       xsltStylesheetPtr script, const char *expr);
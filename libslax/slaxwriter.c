@@ -178,7 +178,7 @@ slaxWrite (slax_writer_t *swp, const char *fmt, ...)
 	    rc = vsnprintf(cp, len, fmt, vap);
 	    va_end(vap);
 
-	    if (rc <= len) {
+	    if (rc < len) {
 		swp->sw_cur += rc;
 		break;
 	    }
@@ -3819,6 +3819,91 @@ slaxWriteRedoConcat (slax_data_t *sdp UNUSED, slax_string_t *func)
     return ssp;
 }
 
+/*
+ * Turn a deferred argument (the XPath text of the expression, as
+ * stored by slaxLazyRewrite) back into SLAX tokens.  Returns NULL
+ * if the text can't be converted.
+ */
+static slax_string_t *
+slaxWriteLazyArgument (slax_data_t *sdp, slax_string_t *arg)
+{
+    slax_string_t *expr;
+    slax_writer_t sw;
+
+    bzero(&sw, sizeof(sw));
+    sw.sw_filename = sdp->sd_filename;
+
+    expr = slaxMakeExpressionString(&sw, sdp->sd_nodep, arg->ss_token);
+    sdp->sd_errors += sw.sw_errors;
+
+    return expr;
+}
+
+/*
+ * Undo slaxLazyRewrite: turn a call to one of the generated lazy
+ * functions back into the original function, with the deferred
+ * arguments restored from their quoted strings.
+ */
+slax_string_t *
+slaxWriteRedoLazy (slax_data_t *sdp, slax_string_t *func)
+{
+    slax_string_t *ssp, *newp, *arg, *expr, **tail;
+    const char *name;
+    int level = 0;
+
+    if (func == NULL || func->ss_ttype != T_FUNCTION_NAME
+	|| func->ss_next == NULL)
+	return NULL;
+
+    if (streq(func->ss_token, SLAX_PREFIX ":" FUNC_FIRST_OF_LAZY))
+	name = SLAX_PREFIX ":first-of";
+    else if (streq(func->ss_token, SLAX_PREFIX ":" FUNC_EMPTY_LAZY))
+	name = SLAX_PREFIX ":is-empty";
+    else
+	return NULL;
+
+    newp = slaxStringLiteral(name, T_FUNCTION_NAME);
+    if (newp == NULL)
+	return NULL;
+
+    for (ssp = func->ss_next; ssp->ss_next; ssp = ssp->ss_next) {
+	if (ssp->ss_ttype == L_OPAREN) {
+	    level += 1;
+	} else if (ssp->ss_ttype == L_CPAREN) {
+	    level -= 1;
+	} else if (ssp->ss_ttype == L_COMMA && level == 1) {
+	    /*
+	     * The deferred argument is the expression itself, in
+	     * XPath syntax, so convert it back to SLAX.  If that
+	     * fails, the XPath text is still a valid SLAX expression.
+	     */
+	    arg = ssp->ss_next;
+	    if (arg->ss_ttype != T_QUOTED)
+		continue;
+
+	    expr = slaxWriteLazyArgument(sdp, arg);
+	    if (expr == NULL) {
+		arg->ss_ttype = T_BARE;
+		continue;
+	    }
+
+	    for (tail = &expr; *tail; tail = &(*tail)->ss_next)
+		continue;
+	    *tail = arg->ss_next;
+	    ssp->ss_next = expr;
+
+	    arg->ss_next = NULL;
+	    slaxStringFree(arg);
+	}
+    }
+
+    newp->ss_next = func->ss_next;
+    func->ss_next = NULL;
+    slaxStringFree(func);
+
+    return newp;
+}
+
 /*
  * The logic in slaxWriteRedoConcat that unthreads concat() functions
  * into the "_" operator does not know if the resulting expression
@@ -99,9 +99,19 @@ xmlStrchru (xmlChar *str, xmlChar val)
     return NULL;
 }
 
+/*
+ * Returns a stand-in for "func" if the call timeline is open (see
+ * slaxTimelineOpen()), so the call can be timed
+ */
+xmlXPathFunction
+slaxTimelineWrapFunction (const char *uri, const char *fn,
+			  xmlXPathFunction func);
+
 static inline void
 slaxRegisterFunction (const char *uri, const char *fn, xmlXPathFunction func)
 {
+    func = slaxTimelineWrapFunction(uri, fn, func);
+
     if (xsltRegisterExtModuleFunction((const xmlChar *) fn,
 				      (const xmlChar *) uri,
 				      func))
@@ -24,6 +24,37 @@ typedef uint16_t xi_node_flags_t; /* Flags for a node (XNF_*) */
  */
 typedef pa_atom_t xi_name_id_t;	/* Element name identifier */
 typedef pa_atom_t xi_ns_id_t;	/* Namespace identifier */
+typedef pa_atom_t xi_node_id_t;	/* Node identifier (in xw_nodes) */
+
+/*
+ * Make alloc/free/addr functions for a type kept in a pa_fixed_t,
+ * where our identifier is a plain pa_atom_t (see above) rather than
+ * a wrapped atom.  The conversions to pa_fixed_atom_t happen here,
+ * so callers don't see them.
+ */
+#define XI_FIXED_FUNCTIONS(_id_type, _type, _base, _field,		\
+			   _alloc_fn, _free_fn, _addr_fn)		\
+static inline _type *							\
+_alloc_fn (_base *basep, _id_type *idp)					\
+{									\
+    pa_fixed_atom_t atom = pa_fixed_alloc_atom(basep->_field);		\
+									\
+    *idp = pa_fixed_atom_of(atom);					\
+    return pa_fixed_atom_addr(basep->_field, atom);			\
+}									\
+									\
+static inline void							\
+_free_fn (_base *basep, _id_type id)					\
+{									\
+    if (id != PA_NULL_ATOM)						\
+	pa_fixed_free_atom(basep->_field, pa_fixed_atom(id));		\
+}									\
+									\
+static inline _type *							\
+_addr_fn (_base *basep, _id_type id)					\
+{									\
+    return pa_fixed_atom_addr(basep->_field, pa_fixed_atom(id));	\
+}
 
 /* Wrapper for our "name" atom */
 PA_ATOM_TYPE(xi_name_atom_t, xi_name_atom_s, xna_atom,
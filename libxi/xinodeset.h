@@ -73,17 +73,16 @@ typedef struct xi_nodeset_s {
 
 #define xns_type xns_infop->xnsi_type
 #define xns_flags xns_infop->xnsi_flags
-#define xns_count xns_infop->xnsi_count
 #define xns_first xns_infop->xnsi_first
 #define xns_last xns_infop->xnsi_last
 
-PA_FIXED_FUNCTIONS(xi_nodeset_chunk_id_t, xi_nodeset_chunk_t, xi_nodeset_t,
+XI_FIXED_FUNCTIONS(xi_nodeset_chunk_id_t, xi_nodeset_chunk_t, xi_nodeset_t,
 		   xns_workspace->xw_nodeset_chunks,
 		   xi_nodeset_chunk_alloc, xi_nodeset_chunk_free,
 		   xi_nodeset_chunk_addr);
 
 typedef pa_atom_t xi_nodeset_info_id_t;
-PA_FIXED_FUNCTIONS(xi_nodeset_info_id_t, xi_nodeset_info_t, xi_workspace_t,
+XI_FIXED_FUNCTIONS(xi_nodeset_info_id_t, xi_nodeset_info_t, xi_workspace_t,
 		   xw_nodeset_info, xi_nodeset_info_alloc,
 		   xi_nodeset_info_free, xi_nodeset_info_addr);
 
@@ -205,6 +204,63 @@ xi_nodeset_free (xi_nodeset_t *nodeset)
     free(nodeset);
 }
 
+/*
+ * Return the number of members in a nodeset
+ */
+static inline uint32_t
+xi_nodeset_count (xi_nodeset_t *nodeset)
+{
+    xi_nodeset_chunk_t *chunkp;
+    xi_nodeset_chunk_id_t id;
+    uint32_t count = 0;
+
+    if (nodeset == NULL)
+	return 0;
+
+    for (id = nodeset->xns_first; id != PA_NULL_ATOM; id = chunkp->xnsc_next) {
+	chunkp = xi_nodeset_chunk_addr(nodeset, id);
+	if (chunkp == NULL)
+	    break;		/* Should not occur */
+	count += chunkp->xnsc_count;
+    }
+
+    return count;
+}
+
+/*
+ * Call a function for each member of a nodeset, in order.  A non-zero
+ * return value from the function stops the walk and is returned.
+ */
+typedef int (*xi_nodeset_func_t)(xi_nodeset_t *, pa_atom_t node_atom,
+				 void *opaque);
+
+static inline int
+xi_nodeset_foreach (xi_nodeset_t *nodeset, xi_nodeset_func_t func,
+		    void *opaque)
+{
+    xi_nodeset_chunk_t *chunkp;
+    xi_nodeset_chunk_id_t id;
+    uint32_t j;
+    int rc;
+
+    if (nodeset == NULL)
+	return 0;
+
+    for (id = nodeset->xns_first; id != PA_NULL_ATOM; id = chunkp->xnsc_next) {
+	chunkp = xi_nodeset_chunk_addr(nodeset, id);
+	if (chunkp == NULL)
+	    break;		/* Should not occur */
+
+	for (j = 0; j < chunkp->xnsc_count; j++) {
+	    rc = func(nodeset, chunkp->xnsc_nodes[j], opaque);
+	    if (rc != 0)
+		return rc;
+	}
+    }
+
+    return 0;
+}
+
 static inline void
 xi_nodeset_dump (xi_nodeset_t *nodeset)
 {
@@ -215,15 +271,15 @@ xi_nodeset_dump (xi_nodeset_t *nodeset)
     xi_nodeset_chunk_id_t id = nodeset->xns_first;
     uint32_t j;
 
-    slaxLog("nodeset dump for %u: [%u:%u]",
+    psu_log("nodeset dump for %u: [%u:%u]",
 	    nodeset->xns_info_atom, nodeset->xns_first, nodeset->xns_last);
 
     /* Visit all the chunks inside this nodeset */
     for (chunkp = xi_nodeset_chunk_addr(nodeset, id); chunkp;
 	 chunkp = xi_nodeset_chunk_addr(nodeset, id)) {
-	slaxLog("  nodeset chunk %u: (%d)", id, chunkp->xnsc_count);
+	psu_log("  nodeset chunk %u: (%d)", id, chunkp->xnsc_count);
 	for (j = 0; j < chunkp->xnsc_count; j++)
-	    slaxLog("    member %u", chunkp->xnsc_nodes[j]);
+	    psu_log("    member %u", chunkp->xnsc_nodes[j]);
 	id = chunkp->xnsc_next; /* Fetch before free */
     }
 }
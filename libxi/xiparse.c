@@ -28,9 +28,8 @@
 #include <ctype.h>
 #include <limits.h>
 
-#include "slaxconfig.h"
-#include <libslax/slaxdef.h>
-#include <libslax/slax.h>
+#include <libpsu/psucommon.h>
+#include <libpsu/psulog.h>
 #include <parrotdb/pacommon.h>
 #include <parrotdb/paconfig.h>
 #include <parrotdb/pammap.h>
@@ -63,9 +62,18 @@ xi_parse_open (pa_mmap_t *pmp, xi_workspace_t *workp, const char *name,
      * needs to be broken out in distinct functions.
      */
 
-    srcp = xi_source_open(input, flags);
-    if (srcp == NULL)
-	goto fail;
+    /*
+     * A NULL input means we're reopening a tree that was parsed
+     * earlier into a persistent workspace; "-" means stdin.
+     */
+    if (input != NULL) {
+	if (strcmp(input, "-") == 0)
+	    srcp = xi_source_create(0, flags);
+	else
+	    srcp = xi_source_open(input, flags);
+	if (srcp == NULL)
+	    goto fail;
+    }
 
     /* The xi_tree_t is the tree we'll be inserting into */
     xtp = calloc(1, sizeof(*xtp));
@@ -74,7 +82,8 @@ xi_parse_open (pa_mmap_t *pmp, xi_workspace_t *workp, const char *name,
 
     xtp->xt_infop = pa_mmap_header(pmp, xi_mk_name(namebuf, name, "tree"),
 				   PA_TYPE_TREE, 0, sizeof(*xtp->xt_infop));
-    xtp->xt_max_depth = 0;
+    if (xtp->xt_infop == NULL)
+	goto fail;
     xtp->xt_workspace = workp;
 
     /* The xi_insert_t is the point in the tree at which we are inserting */
@@ -96,17 +105,29 @@ xi_parse_open (pa_mmap_t *pmp, xi_workspace_t *workp, const char *name,
     parsep->xp_default_rule.xr_flags = XRF_MATCH_ALL;
     parsep->xp_default_rule.xr_action = XIA_SAVE;
 
-    nodep = xi_node_alloc(workp, &node_atom);
-    if (nodep == NULL)
-	goto fail;
-    nodep->xn_type = XI_TYPE_ROOT;
-    nodep->xn_depth = 0;
-    nodep->xn_ns_map = PA_NULL_ATOM;
-    nodep->xn_name = PA_NULL_ATOM;
-    nodep->xn_next = PA_NULL_ATOM;
-    nodep->xn_contents = PA_NULL_ATOM;
+    if (srcp == NULL && xtp->xt_root != PA_NULL_ATOM) {
+	/* Reuse the existing tree */
+	node_atom = xtp->xt_root;
+	nodep = xi_node_addr(workp, node_atom);
+	if (nodep == NULL)
+	    goto fail;
+
+    } else {
+	nodep = xi_node_alloc(workp, &node_atom);
+	if (nodep == NULL)
+	    goto fail;
+	nodep->xn_type = XI_TYPE_ROOT;
+	nodep->xn_depth = 0;
+	nodep->xn_flags = 0;
+	nodep->xn_ns_map = PA_NULL_ATOM;
+	nodep->xn_name = PA_NULL_ATOM;
+	nodep->xn_next = PA_NULL_ATOM;
+	nodep->xn_contents = PA_NULL_ATOM;
+
+	xtp->xt_root = node_atom;
+	xtp->xt_max_depth = 0;
+    }
 
-    xtp->xt_root = node_atom;
     xip->xi_stack[xip->xi_depth].xs_atom = node_atom;
     xip->xi_stack[xip->xi_depth].xs_node = nodep;
 
@@ -125,9 +146,20 @@ xi_parse_open (pa_mmap_t *pmp, xi_workspace_t *workp, const char *name,
 }
 
 void
-xi_parse_destroy (xi_parse_t *parsep UNUSED)
+xi_parse_destroy (xi_parse_t *parsep)
 {
-    return;
+    if (parsep == NULL)
+	return;
+
+    if (parsep->xp_srcp)
+	xi_source_destroy(parsep->xp_srcp);
+
+    if (parsep->xp_insert) {
+	free(parsep->xp_insert->xi_tree);
+	free(parsep->xp_insert);
+    }
+
+    free(parsep);
 }
 
 pa_atom_t
@@ -142,26 +174,57 @@ xi_parse_namepool_string (xi_parse_t *parsep, pa_atom_t atom)
     return xi_namepool_string(xi_parse_workspace(parsep), atom);
 }
 
-static void
-xi_insert_push (xi_insert_t *xip, pa_atom_t atom, xi_node_t *nodep)
+/*
+ * Push a new level on the insertion stack.  A NULL nodep means the
+ * element is being discarded; its children will be hoisted into the
+ * nearest saved ancestor (see xi_insert_target).
+ */
+static xi_istack_t *
+xi_insert_push (xi_insert_t *xip, pa_atom_t atom, xi_node_t *nodep,
+		xi_action_type_t action)
 {
     /* We reuse the current rule state */
     xi_rstate_t *statep = xip->xi_stack[xip->xi_depth].xs_statep;
+    xi_istack_t *xsp;
+
+    if (xip->xi_depth + 1 >= XI_DEPTH_MAX)
+	return NULL;
 
     xip->xi_depth += 1;
-    xip->xi_stack[xip->xi_depth].xs_atom = atom;
-    xip->xi_stack[xip->xi_depth].xs_node = nodep;
-    xip->xi_stack[xip->xi_depth].xs_statep = statep;
+    xsp = &xip->xi_stack[xip->xi_depth];
+    bzero(xsp, sizeof(*xsp));
+
+    xsp->xs_atom = atom;
+    xsp->xs_node = nodep;
+    xsp->xs_action = action;
+    xsp->xs_statep = statep;
+
+    return xsp;
 }
 
 static void
 xi_insert_pop (xi_insert_t *xip)
 {
-    xip->xi_stack[xip->xi_depth].xs_atom = PA_NULL_ATOM;
-    xip->xi_stack[xip->xi_depth].xs_node = NULL;
+    bzero(&xip->xi_stack[xip->xi_depth], sizeof(xip->xi_stack[0]));
     xip->xi_depth -= 1;
 }
 
+/*
+ * Return the stack entry for the node that new nodes should be
+ * appended to, which is the innermost level that wasn't discarded.
+ * The top of the stack (the root node) is always saved.
+ */
+static inline xi_istack_t *
+xi_insert_target (xi_insert_t *xip)
+{
+    xi_depth_t depth = xip->xi_depth;
+
+    while (depth > 0 && xip->xi_stack[depth].xs_node == NULL)
+	depth -= 1;
+
+    return &xip->xi_stack[depth];
+}
+
 /*
  * Insert a node into the insertion point
  */
@@ -175,19 +238,22 @@ xi_insert_node (xi_insert_t *xip, const char *msg,
     if (nodep == NULL)
 	return PA_NULL_ATOM;
 
+    xi_istack_t *xsp = xi_insert_target(xip);
+
     /* Initialize our fields */
     nodep->xn_type = type;
+    nodep->xn_flags = 0;
     nodep->xn_ns_map = PA_NULL_ATOM;
     nodep->xn_name = name_atom;
     nodep->xn_contents = contents;
+    nodep->xn_depth = xsp->xs_node->xn_depth + 1;
 
-    slaxLog("%s: [%.*s] %u / %u (depth %u)", msg, len, data,
-	    name_atom, contents, xip->xi_depth + 1);
+    slaxLog("%s: [%.*s] %u / %u (depth %u)", msg, (int) len, data,
+	    name_atom, contents, nodep->xn_depth);
 
     /*
      * If we don't have a child, make one.  Otherwise append it.
      */
-    xi_istack_t *xsp = &xip->xi_stack[xip->xi_depth];
     if (xsp->xs_node->xn_contents == PA_NULL_ATOM) {
 	/* Record us as the child of the current stack node */
 	xsp->xs_node->xn_contents = node_atom;
@@ -205,9 +271,6 @@ xi_insert_node (xi_insert_t *xip, const char *msg,
     xsp->xs_last_atom = node_atom;
     xsp->xs_last_node = nodep;
 
-    /* Set our depth */
-    nodep->xn_depth = xip->xi_depth + 1;
-
     /* Update xi_maxdepth */
     if (nodep->xn_depth > xip->xi_maxdepth)
 	xip->xi_maxdepth = nodep->xn_depth;
@@ -216,7 +279,9 @@ xi_insert_node (xi_insert_t *xip, const char *msg,
 }
 
 /*
- * Insert a namespace node after the given "last" position
+ * Insert a namespace node after the given "last" position.  Namespace
+ * nodes are kept at the front of the element's children, so we only
+ * become the "last" child if there's nothing after us.
  */
 static pa_atom_t *
 xi_insert_ns_node (xi_insert_t *xip, const char *msg,
@@ -230,26 +295,28 @@ xi_insert_ns_node (xi_insert_t *xip, const char *msg,
     if (nodep == NULL)
 	return NULL;
 
+    xi_istack_t *xsp = &xip->xi_stack[xip->xi_depth];
+
     /* Initialize our fields */
     nodep->xn_type = type;
+    nodep->xn_flags = 0;
     nodep->xn_ns_map = PA_NULL_ATOM;
     nodep->xn_name = name_atom;
     nodep->xn_contents = contents;
+    nodep->xn_depth = xsp->xs_node->xn_depth + 1;
 
-    slaxLog("%s: [%.*s] %u / %u (depth %u)", msg, len, data,
-	    name_atom, contents, xip->xi_depth + 1);
+    slaxLog("%s: [%.*s] %u / %u (depth %u)", msg, (int) len, data,
+	    name_atom, contents, nodep->xn_depth);
 
     nodep->xn_next = (*lastp == PA_NULL_ATOM) ? parent_atom : *lastp;
     *lastp = node_atom;
     lastp = &nodep->xn_next;
 
-    /* Mark the "last" as us */
-    xi_istack_t *xsp = &xip->xi_stack[xip->xi_depth];
-    xsp->xs_last_atom = node_atom;
-    xsp->xs_last_node = nodep;
-
-    /* Set our depth */
-    nodep->xn_depth = xip->xi_depth + 1;
+    /* If we're the end of the list, mark the "last" as us */
+    if (nodep->xn_next == parent_atom) {
+	xsp->xs_last_atom = node_atom;
+	xsp->xs_last_node = nodep;
+    }
 
     /* Update xi_maxdepth */
     if (nodep->xn_depth > xip->xi_maxdepth)
@@ -353,22 +420,18 @@ static void
 xi_insert_attribs (xi_parse_t *parsep, xi_node_t *nodep, const char *data)
 {
     xi_insert_t *xip = parsep->xp_insert;
-    pa_arb_t *prp = xip->xi_tree->xt_workspace->xw_textpool;
+    xi_workspace_t *xwp = xip->xi_tree->xt_workspace;
     size_t len = strlen(data);
-    pa_atom_t data_atom = pa_arb_alloc(prp, len + 1);
-    char *cp = pa_arb_atom_addr(prp, data_atom);
+    pa_atom_t data_atom = xi_textpool_alloc(xwp, data, len);
 
-    if (cp == NULL)
+    if (data_atom == PA_NULL_ATOM)
 	return;
 
-    memcpy(cp, data, len);
-    cp[len] = '\0';
-
     pa_atom_t node_atom;
     node_atom = xi_insert_node(xip, "xi_insert_attribs", data, len,
 			       XI_TYPE_ATSTR, PA_NULL_ATOM, data_atom);
     if (node_atom == PA_NULL_ATOM) {
-	pa_arb_free_atom(prp, data_atom);
+	xi_textpool_free(xwp, data_atom);
 	return;
     }
 
@@ -408,12 +471,12 @@ xi_parse_next_attrib (char **content, char *endp,
 
     cp += 1;			/* Move over '=' */
 
-    char *value = xi_skipws(cp, cp - endp, 1);
+    char *value = xi_skipws(cp, endp - cp, 1);
     if (value == NULL || value[1] == '\0')
 	return "invalid attribute; missing value";
 
     char quote = *value++; /* Record and skip leading quote character */
-    cp = memchr(value, quote, value - endp);
+    cp = memchr(value, quote, endp - value);
     if (cp == NULL)
 	return "invalid attribute; missing trailing quote";
 
@@ -471,7 +534,6 @@ xi_insert_attribs_extract (xi_parse_t *parsep, pa_atom_t node_atom,
 {
     xi_insert_t *xip = parsep->xp_insert;
     xi_workspace_t *xwp = xip->xi_tree->xt_workspace;
-    pa_arb_t *prp = xwp->xw_textpool;
     size_t len = strlen(attrib);
     char *content = attrib, *endp = content + len, *name, *value;
     size_t namelen, valuelen;
@@ -525,7 +587,7 @@ xi_insert_attribs_extract (xi_parse_t *parsep, pa_atom_t node_atom,
 					 name, name ? strlen(name) : 0,
 					 node_atom, last_nsp,
 					 XI_TYPE_NS, PA_NULL_ATOM, ns_atom);
-	    if (last_nsp == PA_NULL_ATOM) {
+	    if (last_nsp == NULL) {
 		xi_source_failure(parsep->xp_srcp, 0,
 				  "attribute insert (ns) failed");
 		break;
@@ -553,7 +615,7 @@ xi_insert_attribs_extract (xi_parse_t *parsep, pa_atom_t node_atom,
 	    if (name_atom == PA_NULL_ATOM)
 		break;
 
-	    value_atom = pa_arb_alloc_string(prp, value);
+	    value_atom = xi_textpool_alloc(xwp, value, valuelen);
 	    if (value_atom == PA_NULL_ATOM)
 		break;
 
@@ -563,7 +625,7 @@ xi_insert_attribs_extract (xi_parse_t *parsep, pa_atom_t node_atom,
 	    if (attrib_atom == PA_NULL_ATOM) {
 		xi_source_failure(parsep->xp_srcp, 0,
 				  "attribute insert failed");
-		pa_arb_free_atom(prp, value_atom);
+		xi_textpool_free(xwp, value_atom);
 		break;
 	    }
 
@@ -582,7 +644,7 @@ xi_insert_attribs_extract (xi_parse_t *parsep, pa_atom_t node_atom,
 		if (stash_atom == PA_NULL_ATOM) {
 		    xi_source_failure(parsep->xp_srcp, 0,
 				      "attribute (stash) insert failed");
-		    pa_arb_free_atom(prp, value_atom);
+		    xi_textpool_free(xwp, value_atom);
 		    break;
 		}
 	    }
@@ -598,21 +660,24 @@ xi_insert_attribs_extract (xi_parse_t *parsep, pa_atom_t node_atom,
      * finish that off, finding the real mapping and recording it,
      * discarding the NSPREF node.
      */
+    xi_istack_t *xsp = &xip->xi_stack[xip->xi_depth];
     xi_node_t *childp, *prev = NULL;
+    pa_atom_t child_atom, next_atom, prev_atom = PA_NULL_ATOM;
     pa_atom_t ns_atom;
 
-    for (childp = xi_node_addr(xwp, nodep->xn_contents); childp;
-	 childp = xi_node_addr(xwp, childp->xn_next)) {
-	if (nodep->xn_type == XI_TYPE_NS) {
-	    /* Skip namespace defs */
+    for (child_atom = nodep->xn_contents;
+	 child_atom != PA_NULL_ATOM && child_atom != node_atom;
+	 child_atom = next_atom) {
+	childp = xi_node_addr(xwp, child_atom);
+	if (childp == NULL)
+	    break;		/* Should not occur */
 
-	} else if (!xi_parse_is_attrib(nodep->xn_type)) {
-	    break;		/* End of attributes == done */
+	next_atom = childp->xn_next;
 
-	} else if (prev == NULL) {
-	    /* Can't handle not having a previous node */
+	if (childp->xn_type == XI_TYPE_NSPREF) {
+	    if (prev == NULL)
+		continue;	/* Can't handle not having a previous node */
 
-	} else if (childp->xn_type == XI_TYPE_NSPREF) {
 	    /*
 	     * An XI_TYPE_NSPREF node means the previous node needs an
 	     * accurate name mapping.  We'll find one and discard the
@@ -621,20 +686,30 @@ xi_insert_attribs_extract (xi_parse_t *parsep, pa_atom_t node_atom,
 	    ns_atom = xi_parse_find_ns_atom(parsep, nodep, childp->xn_contents);
 	    if (ns_atom == PA_NULL_ATOM) {
 		const char *prefix = xi_namepool_string(xwp, childp->xn_contents);
+		const char *local = xi_namepool_string(xwp, prev->xn_name);
 		xi_source_failure(parsep->xp_srcp, 0,
 				  "namespace mapping not found for %s:%s",
-				  prefix ?: "", name);
+				  prefix ?: "", local ?: "");
 	    }
 
-	    /* Set the namespace mapping */
-	    prev->xn_ns_map = ns_atom; /* Assign mapping */
-	    prev->xn_next = childp->xn_next; /* Remove node from list */
+	    /* Set the namespace mapping and remove the node from the list */
+	    prev->xn_ns_map = ns_atom;
+	    prev->xn_next = next_atom;
+
+	    if (xsp->xs_last_atom == child_atom) {
+		xsp->xs_last_atom = prev_atom;
+		xsp->xs_last_node = prev;
+	    }
 
-	    xi_node_free(xwp, prev->xn_next); /* Free node */
-	    childp = prev;		   /* childp is dead; resume logic */
+	    xi_node_free(xwp, child_atom);
+	    continue;		/* childp is dead; prev stays */
+
+	} else if (!xi_parse_is_attrib(childp->xn_type)) {
+	    break;		/* End of attributes == done */
 	}
 
 	prev = childp;
+	prev_atom = child_atom;
     }
 
     /* Mark the attributes as present and extracted */
@@ -642,27 +717,38 @@ xi_insert_attribs_extract (xi_parse_t *parsep, pa_atom_t node_atom,
 	nodep->xn_flags |= XNF_ATTRIBS_PRESENT | XNF_ATTRIBS_EXTRACTED;
 }
 
-static void
+/*
+ * Open an element, pushing it on the insertion stack.  Returns the
+ * new stack entry, or NULL on failure, in which case nothing was pushed.
+ */
+static xi_istack_t *
 xi_insert_open (xi_parse_t *parsep, pa_atom_t name_atom,
 		const char *prefix, const char *name, char *attribs,
 		xi_action_type_t type)
 {
     xi_insert_t *xip = parsep->xp_insert;
+    xi_istack_t *xsp;
 
     if (name_atom == PA_NULL_ATOM)
-	return;
+	return NULL;
+
+    if (xip->xi_depth + 1 >= XI_DEPTH_MAX) {
+	xi_source_failure(parsep->xp_srcp, 0, "maximum depth exceeded: %s",
+			  name);
+	return NULL;
+    }
 
     pa_atom_t node_atom;
     node_atom = xi_insert_node(xip, "xi_insert_open",
 			       name, strlen(name),
 			       XI_TYPE_ELT, name_atom, PA_NULL_ATOM);
     if (node_atom == PA_NULL_ATOM)
-	return;
+	return NULL;
 
     xi_node_t *nodep = xi_node_addr(xip->xi_tree->xt_workspace, node_atom);
 
     /* Push our node on the stack */
-    xi_insert_push(xip, node_atom, nodep);
+    xsp = xi_insert_push(xip, node_atom, nodep, type);
 
     if (attribs) {
 	enum { SAVE_NONE, SAVE_NS, SAVE_STRING, SAVE_FULL } save = SAVE_NONE;
@@ -704,6 +790,29 @@ xi_insert_open (xi_parse_t *parsep, pa_atom_t name_atom,
 			      "namespace mapping not found for %s:%s",
 			      prefix, name);
     }
+
+    return xsp;
+}
+
+/*
+ * Push a placeholder for a discarded element, so its children are
+ * hoisted into the nearest saved ancestor and its close tag can be
+ * matched.  Returns NULL if the stack is full.
+ */
+static xi_istack_t *
+xi_insert_discard (xi_parse_t *parsep, pa_atom_t name_atom, const char *name)
+{
+    xi_istack_t *xsp;
+
+    xsp = xi_insert_push(parsep->xp_insert, PA_NULL_ATOM, NULL, XIA_DISCARD);
+    if (xsp == NULL) {
+	xi_source_failure(parsep->xp_srcp, 0, "maximum depth exceeded: %s",
+			  name);
+	return NULL;
+    }
+
+    xsp->xs_old_name = name_atom;
+    return xsp;
 }
 
 static void
@@ -724,22 +833,21 @@ xi_insert_close (xi_parse_t *parsep, const char *prefix UNUSED, const char *name
 
     xi_istack_t *xsp = &xip->xi_stack[xip->xi_depth];
 
-    if (xip->xi_depth == 0 || xsp->xs_node == NULL) {
+    if (xip->xi_depth == 0) {
 	xi_source_failure(parsep->xp_srcp, 0,
 			  "close for open that doesn't exist: %s", name);
 	return;
-    } else if (xsp->xs_old_name != 0) {
+    } else if (xsp->xs_old_name != PA_NULL_ATOM) {
 	if (xsp->xs_old_name != name_atom) {
 	    xi_source_failure(parsep->xp_srcp, 0,
 			      "close doesn't match original: %s", name);
 	    return;
 	}
-    } else if (xsp->xs_node->xn_name != name_atom) {
+    } else if (xsp->xs_node == NULL || xsp->xs_node->xn_name != name_atom) {
 	xi_source_failure(parsep->xp_srcp, 0, "close doesn't match: %s", name);
 	return;
     }
 
-    bzero(xsp, sizeof(*xsp));
     xi_insert_pop(xip);
 }
 
@@ -748,56 +856,79 @@ xi_insert_text (xi_parse_t *parsep, const char *data, size_t len,
 		xi_node_type_t type)
 {
     xi_insert_t *xip = parsep->xp_insert;
-    pa_arb_t *prp = xip->xi_tree->xt_workspace->xw_textpool;
-    pa_atom_t data_atom = pa_arb_alloc(prp, len + 1);
-    char *cp = pa_arb_atom_addr(prp, data_atom);
+    xi_workspace_t *xwp = xip->xi_tree->xt_workspace;
+    pa_atom_t data_atom;
 
-    if (cp == NULL)
+    /*
+     * Text inside a discarded element is discarded with it, and
+     * text outside the document element can only be whitespace.
+     */
+    if (xip->xi_stack[xip->xi_depth].xs_node == NULL
+	    || xi_insert_target(xip) == &xip->xi_stack[0])
 	return;
 
-    memcpy(cp, data, len);
-    cp[len] = '\0';
+    data_atom = xi_textpool_alloc(xwp, data, len);
+    if (data_atom == PA_NULL_ATOM)
+	return;
 
     pa_atom_t node_atom;
     node_atom = xi_insert_node(xip, "xi_insert_text", data, len,
 			       type, PA_NULL_ATOM, data_atom);
     if (node_atom == PA_NULL_ATOM) {
-	pa_arb_free_atom(prp, data_atom);
+	xi_textpool_free(xwp, data_atom);
 	return;
     }
 }
 
 static void
 xi_parse_handle_rule (xi_parse_t *parsep, pa_atom_t name_atom,
-		      const char *prefix UNUSED, const char *name,
+		      const char *prefix, const char *name,
 		      char *attribs, xi_rule_t *xrp)
 {
-    xi_insert_t *xip = parsep->xp_insert;
+    xi_rulebook_t *xrbp = parsep->xp_rulebook;
     xi_action_type_t act = xrp->xr_action;
     pa_atom_t use_tag = xrp->xr_use_tag;
-    pa_atom_t save_name_atom = name_atom;
+    xi_istack_t *xsp = NULL;
+    xi_rule_t *defp;
 
-    /* Use a different tag is directed */
-    if (use_tag)
-	name_atom = use_tag;
+    /* A rule without an action uses the default for the current state */
+    if (act == XIA_NONE) {
+	xi_rstate_t *statep = xi_parse_stack_state(parsep);
+
+	defp = (xrbp && statep && statep->xrbs_default_rule != PA_NULL_ATOM)
+	    ? xi_rulebook_rule(xrbp, statep->xrbs_default_rule) : NULL;
+	act = (defp && defp->xr_action != XIA_NONE) ? defp->xr_action
+	    : parsep->xp_default_rule.xr_action;
+    }
 
     switch (act) {
     case XIA_SAVE:
     case XIA_SAVE_ATSTR:
     case XIA_SAVE_ATTRIB:
-	xi_insert_open(parsep, name_atom, prefix, name, attribs, act);
-	break;
-
     case XIA_EMIT:
-    case XIA_DISCARD:
-	/* XXX */
+    case XIA_RETURN:
+	/* Use a different tag if directed */
+	xsp = xi_insert_open(parsep, use_tag ?: name_atom, prefix, name,
+			     attribs, act);
+	if (xsp && use_tag)
+	    xsp->xs_old_name = name_atom;
 	break;
     }
 
-    if (use_tag) {
-	xi_istack_t *xsp = &xip->xi_stack[xip->xi_depth];
-	xsp->xs_old_name = save_name_atom;
+    /*
+     * Anything we didn't save (either by choice or by failure) still
+     * needs a place on the stack, so its children can be handled and
+     * its close tag matched.
+     */
+    if (xsp == NULL) {
+	xsp = xi_insert_discard(parsep, name_atom, name);
+	if (xsp == NULL)
+	    return;
     }
+
+    /* Move into the new state, if directed */
+    if (xrbp && xrp->xr_new_state != XI_STATE_EOL)
+	xsp->xs_statep = xi_rulebook_state(xrbp, xrp->xr_new_state);
 }
 
 int
@@ -806,11 +937,16 @@ xi_parse (xi_parse_t *parsep)
     xi_source_t *srcp = parsep->xp_srcp;
     char *data, *rest, *localp;
     xi_node_type_t type;
-    xi_boolean_t opt_quiet = PSU_BIT_TEST(parsep->xp_flags, XI_PF_DEBUG);
-    xi_boolean_t opt_unescape = 0;
+    xi_boolean_t debug = PSU_BIT_TEST(parsep->xp_flags, XI_PF_DEBUG);
     pa_atom_t name_atom;
     xi_rule_t *rulep;
     xi_insert_t *xip = parsep->xp_insert;
+    xi_tree_t *xtp = xip->xi_tree;
+    xi_rstate_t *statep;
+    int rc = 0;
+
+    if (srcp == NULL)		/* Reopened tree; nothing to parse */
+	return 0;
 
     for (;;) {
 
@@ -818,32 +954,29 @@ xi_parse (xi_parse_t *parsep)
 
 	switch (type) {
 	case XI_TYPE_NONE:	/* Unknown type */
-	    return 1;
+	    rc = 1;
+	    goto done;
 
 	case XI_TYPE_EOF:	/* End of file */
-	    return 0;
+	    goto done;
 
 	case XI_TYPE_FAIL:	/* Failure mode */
-	    return -1;
+	    rc = -1;
+	    goto done;
 
 	case XI_TYPE_TEXT:	/* Text content */
-	    type = XI_TYPE_UNESC; /* UNESC (aka CDATA) is unescaped text */
-	    if (!opt_quiet) {
-		int len;
-		if (opt_unescape && data && rest) {
-		    len = xi_source_unescape(srcp, data, rest - data);
-		    type = XI_TYPE_TEXT; /* TEXT is escaped */
-		} else {
-		    len = rest - data;
-		}
-		slaxLog("text [%.*s] (%u)", len, data, type);
-	    }
-	    xi_insert_text(parsep, data, rest - data, type);
+	    /*
+	     * We keep text in its escaped form, which is cheaper to
+	     * store and can be emitted as-is.
+	     */
+	    if (debug)
+		slaxLog("text [%.*s]", (int)(rest - data), data);
+	    xi_insert_text(parsep, data, rest - data, XI_TYPE_TEXT);
 	    break;
 
 	case XI_TYPE_OPEN:	/* Open tag */
 	case XI_TYPE_EMPTY:	/* Empty tag */
-	    if (!opt_quiet)
+	    if (debug)
 		slaxLog("open tag [%s] [%s]", data ?: "", rest ?: "");
 	    localp = strchr(data, ':');
 	    if (localp)
@@ -854,13 +987,12 @@ xi_parse (xi_parse_t *parsep)
 	    }
 
 	    /* We need an atom to do the indexing to find rules */
-	    name_atom = xi_namepool_atom(xip->xi_tree->xt_workspace,
-					 localp, TRUE);
+	    name_atom = xi_namepool_atom(xtp->xt_workspace, localp, TRUE);
 
 	    /*
 	     * We've got incoming data; find out what to do with it
 	     */
-	    xi_rstate_t *statep = xi_parse_stack_state(parsep);
+	    statep = xi_parse_stack_state(parsep);
 	    rulep = xi_rulebook_find(parsep, parsep->xp_rulebook,
 				     statep,
 				     name_atom, data, localp, rest);
@@ -886,10 +1018,14 @@ xi_parse (xi_parse_t *parsep)
 	     */
 	    if (type == XI_TYPE_EMPTY)
 		xi_insert_close(parsep, data, localp);
+
+	    /* A "return" rule hands control back to our caller */
+	    if (rulep->xr_action == XIA_RETURN)
+		goto done;
 	    break;
 
 	case XI_TYPE_CLOSE:	/* Close tag */
-	    if (!opt_quiet)
+	    if (debug)
 		slaxLog("close tag [%s] [%s]", data ?: "", rest ?: "");
 	    localp = strchr(data, ':');
 	    if (localp)
@@ -903,28 +1039,33 @@ xi_parse (xi_parse_t *parsep)
 	    break;
 
 	case XI_TYPE_PI:	/* Processing instruction */
-	    if (!opt_quiet)
+	    if (debug)
 		slaxLog("pi [%s] [%s]", data ?: "", rest ?: "");
 	    break;
 
 	case XI_TYPE_DTD:	/* DTD nonsense */
-	    if (!opt_quiet)
+	    if (debug)
 		slaxLog("dtd [%s] [%s]", data ?: "", rest ?: "");
 	    break;
 
 	case XI_TYPE_COMMENT:	/* Comment */
-	    if (!opt_quiet)
+	    if (debug)
 		slaxLog("comment [%s] [%s]", data ?: "", rest ?: "");
 	    break;
 
 	case XI_TYPE_UNESC:	/* unescaped/cdata */
-	    if (!opt_quiet)
+	    if (debug)
 		slaxLog("cdata [%.*s]", (int)(rest - data), data);
+	    xi_insert_text(parsep, data, rest - data, XI_TYPE_UNESC);
 	    break;
 	}
     }
 
-    return 0;
+ done:
+    if (xip->xi_maxdepth > xtp->xt_max_depth)
+	xtp->xt_max_depth = xip->xi_maxdepth;
+
+    return rc;
 }
 
 static const char *xi_type_names[] = {
@@ -1065,10 +1206,47 @@ xi_parse_dump (xi_parse_t *parsep)
 typedef struct xi_xml_output_s {
     FILE *xx_out;		/* Output file descriptor */
     unsigned xx_indent;		/* Current indent amount */
-    unsigned xx_incr;		/* Indent increment */
+    unsigned xx_incr;		/* Indent increment (0 means "as parsed") */
     xi_node_type_t xx_last_type; /* Last type seen */
 } xi_xml_output_t;
 
+/*
+ * Write text that was stored unescaped (e.g. cdata), escaping it
+ */
+static void
+xi_parse_emit_escaped (FILE *out, const char *data)
+{
+    const char *cp;
+
+    for (cp = data; *cp; cp++) {
+	switch (*cp) {
+	case '<':
+	    fputs("&lt;", out);
+	    break;
+	case '>':
+	    fputs("&gt;", out);
+	    break;
+	case '&':
+	    fputs("&amp;", out);
+	    break;
+	default:
+	    putc(*cp, out);
+	}
+    }
+}
+
+static const char *
+xi_parse_emit_prefix (xi_workspace_t *xwp, xi_node_t *nodep)
+{
+    xi_ns_map_t *ns_map;
+
+    if (nodep->xn_ns_map == PA_NULL_ATOM)
+	return NULL;
+
+    ns_map = xi_ns_map_addr(xwp, nodep->xn_ns_map);
+    return ns_map ? xi_namepool_string(xwp, ns_map->xnm_prefix) : NULL;
+}
+
 static int
 xi_parse_emit_xml_cb (xi_parse_t *parsep, xi_node_type_t type,
 		      pa_atom_t node_atom UNUSED, xi_node_t *nodep,
@@ -1077,6 +1255,7 @@ xi_parse_emit_xml_cb (xi_parse_t *parsep, xi_node_type_t type,
     xi_xml_output_t *xmlp = opaque;
     FILE *out = xmlp->xx_out;
     xi_workspace_t *xwp = parsep->xp_insert->xi_tree->xt_workspace;
+    xi_boolean_t pretty = (xmlp->xx_incr != 0);
     xi_ns_map_t *ns_map;
     const char *cp;
     int indent;
@@ -1084,22 +1263,16 @@ xi_parse_emit_xml_cb (xi_parse_t *parsep, xi_node_type_t type,
 
     switch (type) {
     case XI_TYPE_ROOT:
-	fprintf(out, "<!-- start of output>\n");
 	break;
 
     case XI_TYPE_OPEN:
-	if (xmlp->xx_last_type != XI_TYPE_ROOT
+	if (pretty && xmlp->xx_last_type != XI_TYPE_NONE
+	    && xmlp->xx_last_type != XI_TYPE_ROOT
 	    && xmlp->xx_last_type != XI_TYPE_CLOSE)
 	    fprintf(out, "\n");
 
-	pref = NULL;
-	if (nodep->xn_ns_map != PA_NULL_ATOM) {
-	    ns_map = xi_ns_map_addr(xwp, nodep->xn_ns_map);
-	    if (ns_map != NULL)
-		pref = xi_namepool_string(xwp, ns_map->xnm_prefix);
-	}
-
-	fprintf(out, "%*s<%s%s%s", xmlp->xx_indent, "",
+	pref = xi_parse_emit_prefix(xwp, nodep);
+	fprintf(out, "%*s<%s%s%s", pretty ? xmlp->xx_indent : 0, "",
 		pref ?: "", pref ? ":" : "", data);
 	xmlp->xx_indent += xmlp->xx_incr;
 	break;
@@ -1109,7 +1282,7 @@ xi_parse_emit_xml_cb (xi_parse_t *parsep, xi_node_type_t type,
 	break;
 
     case XI_TYPE_EOL_EMPTY:
-	fprintf(out, "/>\n");
+	fprintf(out, pretty ? "/>\n" : "/>");
 	break;
 
     case XI_TYPE_CLOSE:
@@ -1117,35 +1290,32 @@ xi_parse_emit_xml_cb (xi_parse_t *parsep, xi_node_type_t type,
 
 	if (data != NULL) {
 	    if (xmlp->xx_last_type != XI_TYPE_EOL_EMPTY) {
-		pref = NULL;
-
-		if (nodep->xn_ns_map != PA_NULL_ATOM) {
-		    ns_map = xi_ns_map_addr(xwp, nodep->xn_ns_map);
-		    if (ns_map != NULL)
-			pref = xi_namepool_string(xwp, ns_map->xnm_prefix);
-		}
-
-		indent = (xmlp->xx_last_type == XI_TYPE_CLOSE)
+		pref = xi_parse_emit_prefix(xwp, nodep);
+		indent = (pretty && xmlp->xx_last_type == XI_TYPE_CLOSE)
 		    ? xmlp->xx_indent : 0;
-		fprintf(out, "%*s</%s%s%s>\n", indent, "",
-			pref ?: "", pref ? ":" : "", data);
+		fprintf(out, "%*s</%s%s%s>%s", indent, "",
+			pref ?: "", pref ? ":" : "", data,
+			pretty ? "\n" : "");
 	    }
 	}
 	break;
 
-    case XI_TYPE_TEXT:		/* XXX Text needs to be escaped */
-    case XI_TYPE_UNESC:
+    case XI_TYPE_TEXT:		/* Kept in escaped form */
 	fprintf(out, "%s", data);
 	break;
 
+    case XI_TYPE_UNESC:		/* Needs escaping */
+	xi_parse_emit_escaped(out, data);
+	break;
+
     case XI_TYPE_ATSTR:
 	fprintf(out, " %s", data);
 	break;
 
     case XI_TYPE_ATTRIB:
-	cp = xi_namepool_string(parsep->xp_insert->xi_tree->xt_workspace,
-				     nodep->xn_name);
-	fprintf(out, " %s=\"%s\"", cp, data);
+	cp = xi_namepool_string(xwp, nodep->xn_name);
+	pref = xi_parse_emit_prefix(xwp, nodep);
+	fprintf(out, " %s%s%s=\"%s\"", pref ?: "", pref ? ":" : "", cp, data);
 	break;
 
     case XI_TYPE_NS:
@@ -1161,7 +1331,9 @@ xi_parse_emit_xml_cb (xi_parse_t *parsep, xi_node_type_t type,
 	break;
 
     case XI_TYPE_EOF:
-	fprintf(out, "<!-- end of output>\n");
+	if (!pretty && xmlp->xx_last_type != XI_TYPE_NONE
+	    && xmlp->xx_last_type != XI_TYPE_ROOT)
+	    fprintf(out, "\n");
 	break;
     }
 
@@ -1169,29 +1341,50 @@ xi_parse_emit_xml_cb (xi_parse_t *parsep, xi_node_type_t type,
     return 0;
 }
 
+/*
+ * Emit the node (and its descendants) as XML.  An "indent" of zero
+ * means to emit the data as it was parsed, adding no whitespace.
+ */
 void
-xi_parse_emit_xml (xi_parse_t *parsep, FILE *out)
+xi_parse_emit_xml_node (xi_parse_t *parsep, xi_node_id_t node_atom,
+			FILE *out, unsigned indent)
 {
     xi_xml_output_t xml;
 
     bzero(&xml, sizeof(xml));
     xml.xx_out = out;
-    xml.xx_incr = 3;
+    xml.xx_incr = indent;
 
-    xi_parse_emit(parsep, xi_parse_emit_xml_cb, &xml);
+    xi_parse_emit_node(parsep, node_atom, xi_parse_emit_xml_cb, &xml);
 }
 
 void
-xi_parse_emit (xi_parse_t *parsep, xi_parse_emit_fn func, void *opaque)
+xi_parse_emit_xml (xi_parse_t *parsep, FILE *out)
+{
+    xi_parse_emit_xml_node(parsep, parsep->xp_insert->xi_tree->xt_root,
+			   out, 3);
+}
+
+/*
+ * Walk the hierarchy under a node, making callbacks for each step.
+ * We follow xn_contents down and xn_next across; since the last
+ * sibling's xn_next is its parent, a decrease in depth means we're
+ * closing that parent.  When we close (or step past) our starting
+ * node, we're done.
+ */
+void
+xi_parse_emit_node (xi_parse_t *parsep, xi_node_id_t top_atom,
+		    xi_parse_emit_fn func, void *opaque)
 {
     xi_insert_t *xip = parsep->xp_insert;
     xi_tree_t *xtp = xip->xi_tree;
     xi_workspace_t *xwp = xtp->xt_workspace;
     const char *cp;
-    pa_atom_t node_atom = xtp->xt_root;
+    pa_atom_t node_atom = top_atom;
     pa_atom_t next_node_atom;
     xi_node_t *nodep;
     xi_depth_t last_depth = 0;
+    xi_boolean_t started = FALSE;
     unsigned need_eol_attrib = FALSE;
 
     while (node_atom != PA_NULL_ATOM) {
@@ -1203,7 +1396,7 @@ xi_parse_emit (xi_parse_t *parsep, xi_parse_emit_fn func, void *opaque)
 
 	/* If this is the first non-attrib, let the emitter know */
 	if (need_eol_attrib && !xi_parse_is_attrib(nodep->xn_type)) {
-	    if (last_depth && last_depth > nodep->xn_depth) {
+	    if (started && last_depth > nodep->xn_depth) {
 		func(parsep, XI_TYPE_EOL_EMPTY, node_atom, nodep,
 		     NULL, opaque);
 	    } else {
@@ -1216,15 +1409,19 @@ xi_parse_emit (xi_parse_t *parsep, xi_parse_emit_fn func, void *opaque)
 	}
 
 	/* We're looking at the first step out of layer of hierarchy */
-	if (last_depth && last_depth > nodep->xn_depth) {
+	if (started && last_depth > nodep->xn_depth) {
 	    cp = xi_namepool_string(xwp, nodep->xn_name);
 	    func(parsep, XI_TYPE_CLOSE, node_atom, nodep, cp, opaque);
+	    if (node_atom == top_atom)
+		break;
+
 	    node_atom = nodep->xn_next;
 	    last_depth = nodep->xn_depth;
 	    continue;
 	}
 
 	need_eol_attrib = FALSE; /* Don't need it (yet) */
+	started = TRUE;
 
 	if (nodep->xn_type == XI_TYPE_ROOT) {
 	    next_node_atom = nodep->xn_contents ?: nodep->xn_next;
@@ -1245,6 +1442,8 @@ xi_parse_emit (xi_parse_t *parsep, xi_parse_emit_fn func, void *opaque)
 		func(parsep, XI_TYPE_EOL_EMPTY, node_atom, nodep,
 		     NULL, opaque);
 		func(parsep, XI_TYPE_CLOSE, node_atom, nodep, NULL, opaque);
+		if (node_atom == top_atom)
+		    break;
 	    } else {
 		need_eol_attrib = TRUE;
 		next_node_atom = nodep->xn_contents;
@@ -1257,13 +1456,13 @@ xi_parse_emit (xi_parse_t *parsep, xi_parse_emit_fn func, void *opaque)
 	    func(parsep, nodep->xn_type, node_atom, nodep, cp, opaque);
 
 	} else if (nodep->xn_type == XI_TYPE_ATSTR) {
-	    cp = pa_arb_atom_addr(xwp->xw_textpool, nodep->xn_contents);
+	    cp = xi_textpool_string(xwp, nodep->xn_contents);
 	    next_node_atom = nodep->xn_next;
 	    func(parsep, nodep->xn_type, node_atom, nodep, cp, opaque);
 	    need_eol_attrib = TRUE;
 
 	} else if (nodep->xn_type == XI_TYPE_ATTRIB) {
-	    cp = pa_arb_atom_addr(xwp->xw_textpool, nodep->xn_contents);
+	    cp = xi_textpool_string(xwp, nodep->xn_contents);
 	    next_node_atom = nodep->xn_next;
 	    func(parsep, nodep->xn_type, node_atom, nodep, cp, opaque);
 	    need_eol_attrib = TRUE;
@@ -1278,6 +1477,11 @@ xi_parse_emit (xi_parse_t *parsep, xi_parse_emit_fn func, void *opaque)
 	    next_node_atom = PA_NULL_ATOM;
 	}
 
+	/* A leaf at the top means there's nothing more to visit */
+	if (node_atom == top_atom && nodep->xn_type != XI_TYPE_ELT
+	    && nodep->xn_type != XI_TYPE_ROOT)
+	    break;
+
 	node_atom = next_node_atom;
 	last_depth = nodep->xn_depth;
     }
@@ -1285,6 +1489,13 @@ xi_parse_emit (xi_parse_t *parsep, xi_parse_emit_fn func, void *opaque)
     func(parsep, XI_TYPE_EOF, PA_NULL_ATOM, NULL, NULL, opaque);
 }
 
+void
+xi_parse_emit (xi_parse_t *parsep, xi_parse_emit_fn func, void *opaque)
+{
+    xi_parse_emit_node(parsep, parsep->xp_insert->xi_tree->xt_root,
+		       func, opaque);
+}
+
 #if 0
 typedef struct xi_parse_as_source_s {
     xi_node_type_t xps_type;	/* Current type (XI_TYPE_*) */
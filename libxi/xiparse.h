@@ -57,9 +57,17 @@ xi_parse_dump (xi_parse_t *parsep);
 void
 xi_parse_emit (xi_parse_t *parsep, xi_parse_emit_fn func, void *opaque);
 
+void
+xi_parse_emit_node (xi_parse_t *parsep, xi_node_id_t node_atom,
+		    xi_parse_emit_fn func, void *opaque);
+
 void
 xi_parse_emit_xml (xi_parse_t *parsep, FILE *out);
 
+void
+xi_parse_emit_xml_node (xi_parse_t *parsep, xi_node_id_t node_atom,
+			FILE *out, unsigned indent);
+
 void
 xi_parse_set_rulebook (xi_parse_t *parsep, xi_rulebook_t *rulebook);
 
@@ -28,9 +28,8 @@
 #include <ctype.h>
 #include <limits.h>
 
-#include "slaxconfig.h"
-#include <libslax/slaxdef.h>
-#include <libslax/slax.h>
+#include <libpsu/psucommon.h>
+#include <libpsu/psulog.h>
 #include <parrotdb/pacommon.h>
 #include <parrotdb/paconfig.h>
 #include <parrotdb/pammap.h>
@@ -127,9 +126,9 @@ xi_rule_bitmap_add (xi_rulebook_t *xrbp, xi_rule_t *xrp, const char *tag)
 	return;
 
     /* We need to allocate a bitmap for this rule, if we haven't already */
-    if (xrp->xr_bitmap == PA_NULL_ATOM) {
+    if (pa_bitmap_is_null(xrp->xr_bitmap)) {
 	xrp->xr_bitmap = pa_bitmap_alloc(xrbp->xrb_bitmaps);
-	if (xrp->xr_bitmap == PA_NULL_ATOM)
+	if (pa_bitmap_is_null(xrp->xr_bitmap))
 	    return;
     }
 
@@ -206,7 +205,11 @@ xi_rulebook_prep_cb (xi_parse_t *parsep, xi_node_type_t type,
 		    XX(id), XX(action));
 
 	    /* Valid input requires a good state id number */
-	    xi_state_id_t sid = strtol(id, NULL, 0);
+	    xi_state_id_t sid = id ? strtol(id, NULL, 0) : XI_STATE_EOL;
+	    if (sid == XI_STATE_EOL) {
+		slaxLog("state id missing or invalid: %s", XX(id));
+		break;
+	    }
 	    if (sid > pa_fixed_max_atoms(xrbp->xrb_states)) {
 		slaxLog("state id > max: %u .vs. %u",
 			sid, pa_fixed_max_atoms(xrbp->xrb_states));
@@ -250,6 +253,12 @@ xi_rulebook_prep_cb (xi_parse_t *parsep, xi_node_type_t type,
 	    slaxLog("prep: open: rule: [%s/%s/%s/%s]",
 		    XX(tag), XX(action), XX(new_state), XX(use_tag));
 
+	    /* A rule outside a state has nowhere to go */
+	    if (stackp->xrps_nextp == NULL) {
+		slaxLog("prep: rule outside of state: %s", XX(tag));
+		break;
+	    }
+
 	    xi_rule_id_t rid;
 	    xi_rule_t *xrp = xi_rule_alloc(xrbp, &rid);
 	    if (xrp == NULL)
@@ -335,7 +344,10 @@ xi_rulebook_find (xi_parse_t *parsep UNUSED, xi_rulebook_t *xrbp,
 	    continue;
 
 	/* See if our tag is in the bitmap for this rule */
-	if (!pa_bitmap_test(xrbp->xrb_bitmaps, xrp->xr_bitmap, name_atom))
+	if (!(xrp->xr_flags & XRF_MATCH_ALL)
+	    && (pa_bitmap_is_null(xrp->xr_bitmap)
+		|| !pa_bitmap_test(xrbp->xrb_bitmaps, xrp->xr_bitmap,
+				   name_atom)))
 	    continue;
 
 	slaxLog("rule match: %u/'%s' rule %u: action %u/%s, flags %#x, "
@@ -347,6 +359,10 @@ xi_rulebook_find (xi_parse_t *parsep UNUSED, xi_rulebook_t *xrbp,
 	return xrp;		/* Success! */
     }
 
+    /* Nothing matched, so the state's default rule (if any) applies */
+    if (statep->xrbs_default_rule != PA_NULL_ATOM)
+	return xi_rulebook_rule(xrbp, statep->xrbs_default_rule);
+
     return NULL;
 }
 
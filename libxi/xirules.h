@@ -92,7 +92,7 @@ xi_rulebook_state (xi_rulebook_t *xrbp, xi_state_id_t sid)
 static inline xi_rule_t *
 xi_rulebook_rule (xi_rulebook_t *xrbp, xi_rule_id_t rid)
 {
-    return pa_fixed_atom_addr(xrbp->xrb_rules, rid);
+    return pa_fixed_atom_addr(xrbp->xrb_rules, pa_fixed_atom(rid));
 }
 
 xi_rulebook_t *
@@ -115,7 +115,7 @@ xi_rulebook_prep (xi_parse_t *input, const char *name);
 void
 xi_rulebook_dump (xi_rulebook_t *xrbp);
 
-PA_FIXED_FUNCTIONS(xi_rule_id_t, xi_rule_t, xi_rulebook_t, xrb_rules,
+XI_FIXED_FUNCTIONS(xi_rule_id_t, xi_rule_t, xi_rulebook_t, xrb_rules,
 		   xi_rule_alloc, xi_rule_free, xi_rule_addr);
 
 #endif /* LIBSLAX_XI_RULES_H */
@@ -150,8 +150,12 @@ xi_source_destroy (xi_source_t *srcp)
     if (srcp->xps_filename != NULL)
 	free(srcp->xps_filename);
 
-    if (srcp->xps_curp != NULL)
-	free(srcp->xps_curp);
+    if (srcp->xps_bufp != NULL) {
+	if (srcp->xps_flags & XPSF_MMAP_INPUT)
+	    munmap(srcp->xps_bufp, srcp->xps_size);
+	else
+	    free(srcp->xps_bufp);
+    }
 
     if (srcp->xps_flags & XPSF_CLOSE_FD)
 	close(srcp->xps_fd);
@@ -276,7 +280,7 @@ xi_source_read (xi_source_t *srcp, int min)
 	 * If we've got data left to copy and we're close to the end,
 	 * copy it.
 	 */
-	memcpy(srcp->xps_bufp, srcp->xps_curp, left);
+	memmove(srcp->xps_bufp, srcp->xps_curp, left); /* May overlap */
 	srcp->xps_len = left;
 	srcp->xps_curp = srcp->xps_bufp;
     }
@@ -345,9 +349,11 @@ xi_source_find (xi_source_t *srcp, int ch, xi_offset_t offset)
 
     for (;;) {
 	if (offset >= srcp->xps_len) {
+	    /* Reading can move the data, so keep 'offset' relative to curp */
+	    xi_offset_t rel = offset - xi_source_offset(srcp);
 	    if (xi_source_read(srcp, 0) < 0)
 		return -1;
-	    offset = xi_source_offset(srcp); /* Recalculate our offset */
+	    offset = xi_source_offset(srcp) + rel;
 	}
 
 	cur = psu_memchr(srcp->xps_bufp + offset, ch, srcp->xps_len - offset);
@@ -360,6 +366,53 @@ xi_source_find (xi_source_t *srcp, int ch, xi_offset_t offset)
     }
 }
 
+/*
+ * Find the '>' that ends a tag, skipping any that appear inside
+ * quoted attribute values.  We track our progress relative to
+ * xps_curp, since reading more data can move the buffer.
+ */
+static xi_offset_t
+xi_source_find_tag_end (xi_source_t *srcp)
+{
+    xi_offset_t seen = 0, off;
+    char quote = 0;
+    char *cp, *ep;
+
+    for (;;) {
+	off = xi_source_find(srcp, '>', xi_source_offset(srcp) + seen);
+	if (off < 0)
+	    return -1;
+
+	ep = &srcp->xps_bufp[off];
+	for (cp = srcp->xps_curp + seen; cp < ep; cp++) {
+	    if (quote) {
+		if (*cp == quote)
+		    quote = 0;
+	    } else if (*cp == '"' || *cp == '\'') {
+		quote = *cp;
+	    }
+	}
+
+	if (quote == 0)
+	    return off;
+
+	seen = ep + 1 - srcp->xps_curp; /* Quoted '>'; keep going */
+    }
+}
+
+/*
+ * Return the first whitespace character in the string, or NULL
+ */
+static char *
+xi_source_findws (char *cp, char *ep)
+{
+    for ( ; cp < ep && *cp; cp++)
+	if (xi_isspace(*cp))
+	    return cp;
+
+    return NULL;
+}
+
 /*
  * Deal with comments.
  *
@@ -552,10 +605,6 @@ xi_source_token_bracket (xi_source_t *srcp, char **datap UNUSED,
 	return XI_TYPE_FAIL;
     }
 
-    char *dp = srcp->xps_curp;
-    int cdata = (strncmp(dp, "<![CDATA[", 9) == 0);
-    dp += 9;
-
     xi_offset_t off = xi_source_offset(srcp) + 3; /* Skip "<![" */
     char *cp = xi_source_find_brklt2(srcp, off);
     if (cp == NULL) {
@@ -563,6 +612,14 @@ xi_source_token_bracket (xi_source_t *srcp, char **datap UNUSED,
 	return XI_TYPE_FAIL;
     }
 
+    /*
+     * Finding the end may have read more data and moved the buffer,
+     * so only now can we look at the whole leader.
+     */
+    char *dp = srcp->xps_curp;
+    int cdata = (cp - dp >= 11 && strncmp(dp, "<![CDATA[", 9) == 0);
+    dp += 9;
+
     cp[-2] = '\0';
     xi_source_move_curp(srcp, cp + 1);
 
@@ -624,19 +681,23 @@ xi_source_token_pi (xi_source_t *srcp, char **datap,
 	return XI_TYPE_FAIL;
     }
 
-    xi_offset_t off = xi_source_find(srcp, '>', xi_source_offset(srcp));
-    if (off < 0) {
-	xi_source_failure(srcp, 0, "missing termination of " XI_PI);
-	return XI_TYPE_FAIL;
-    }
+    /* The data can contain '>', so we need the full "?>" */
+    xi_offset_t off = xi_source_offset(srcp) + 2; /* Skip "<?" */
+    char *dp, *cp, *ep;
 
-    char *dp = srcp->xps_curp + 2;
-    char *cp = &srcp->xps_bufp[off];
-    char *ep = cp;
+    for (;;) {
+	off = xi_source_find(srcp, '>', off);
+	if (off < 0) {
+	    xi_source_failure(srcp, 0, "missing termination of " XI_PI);
+	    return XI_TYPE_FAIL;
+	}
 
-    if (ep < dp + 2 || ep[-1] != '?') {
-	xi_source_failure(srcp, 0, "invalid termination of " XI_PI);
-	return XI_TYPE_FAIL;
+	dp = srcp->xps_curp + 2;
+	cp = ep = &srcp->xps_bufp[off];
+	if (ep >= dp + 2 && ep[-1] == '?')
+	    break;
+
+	off += 1;
     }
 
     *--ep = '\0';		/* Whach the '?' */
@@ -653,7 +714,7 @@ xi_source_token_pi (xi_source_t *srcp, char **datap,
     /*
      * Find the attributes, but don't bother parsing them.  Trim whitespace.
      */
-    char *rp = psu_memchr(dp, ' ', ep - dp);
+    char *rp = xi_source_findws(dp, ep);
     if (rp != NULL) {
 	*rp++ = '\0';
 	rp = xi_skipws(rp, ep - rp, 1);
@@ -672,7 +733,7 @@ xi_source_token_open (xi_source_t *srcp, char **datap, char **restp)
 {
     xi_node_type_t token = XI_TYPE_OPEN;
 
-    xi_offset_t off = xi_source_find(srcp, '>', xi_source_offset(srcp));
+    xi_offset_t off = xi_source_find_tag_end(srcp);
     if (off < 0) {
 	xi_source_failure(srcp, 0, "missing termination of open tag");
 	return XI_TYPE_FAIL;
@@ -692,7 +753,7 @@ xi_source_token_open (xi_source_t *srcp, char **datap, char **restp)
     /*
      * Find the attributes, but don't bother parsing them.  Trim whitespace.
      */
-    char *rp = psu_memchr(dp, ' ', cp - dp);
+    char *rp = xi_source_findws(dp, cp);
     if (rp != NULL) {
 	*rp++ = '\0';
 	rp = xi_skipws(rp, cp - rp, 1);
@@ -717,6 +778,9 @@ xi_source_token_close (xi_source_t *srcp, char **datap)
 
     char *dp = srcp->xps_curp + 2; /* Skip "</" */
     char *cp = &srcp->xps_bufp[off];
+    char *wp = xi_source_findws(dp, cp); /* Spec allows "</name >" */
+    if (wp != NULL)
+	*wp = '\0';
     *cp++ = '\0';		/* Whack the '>' */
     xi_source_move_curp(srcp, cp); /* Save as next starting point */
 
@@ -771,12 +835,19 @@ xi_source_ignorews (xi_source_t *srcp)
     xi_offset_t off = xi_source_offset(srcp); /* Starting point */
     char *cp;
 
-    for (cp = &srcp->xps_bufp[off]; xi_isspace(*cp); cp++, off++) {
+    for (;;) {
 	if (off >= srcp->xps_len) {
+	    /* Reading can move the buffer, so we work with offsets */
+	    off -= xi_source_offset(srcp);
 	    if (xi_source_read(srcp, 0) < 0)
 		return;
-	    cp = &srcp->xps_bufp[off]; /* Refresh */
+	    off += xi_source_offset(srcp);
 	}
+
+	cp = &srcp->xps_bufp[off];
+	if (!xi_isspace(*cp))
+	    break;
+	off += 1;
     }
 
     if (*cp != '<')
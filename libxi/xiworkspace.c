@@ -28,9 +28,8 @@
 #include <ctype.h>
 #include <limits.h>
 
-#include "slaxconfig.h"
-#include <libslax/slaxdef.h>
-#include <libslax/slax.h>
+#include <libpsu/psucommon.h>
+#include <libpsu/psulog.h>
 #include <parrotdb/pacommon.h>
 #include <parrotdb/paconfig.h>
 #include <parrotdb/pammap.h>
@@ -47,6 +46,17 @@
 #include <libxi/xinodeset.h>
 #include <libxi/xiparse.h>
 
+/*
+ * The text index is keyed by the string itself; the data atoms in
+ * the patricia tree are arb atoms in the text pool.
+ */
+static const psu_byte_t *
+xi_textpool_key_func (pa_pat_t *pp, pa_pat_data_atom_t datom)
+{
+    pa_arb_atom_t atom = pa_arb_atom(pa_pat_data_atom_of(datom));
+    return pa_arb_atom_addr(pp->pp_data, atom);
+}
+
 xi_workspace_t *
 xi_workspace_open (pa_mmap_t *pmp, const char *name)
 {
@@ -57,6 +67,7 @@ xi_workspace_open (pa_mmap_t *pmp, const char *name)
     pa_istr_t *pip = NULL;
     pa_arb_t *pap = NULL;
     pa_pat_t *ppp = NULL;
+    pa_pat_t *text_index = NULL;
     xi_node_t *nodep = NULL;
     pa_fixed_t *nodes = NULL;
     xi_workspace_t *workp = NULL;
@@ -83,6 +94,17 @@ xi_workspace_open (pa_mmap_t *pmp, const char *name)
     if (pap == NULL)
 	goto fail;
 
+    /*
+     * The text index is opened even when interning is off, so that
+     * atoms interned by an earlier user of a persistent workspace
+     * are released properly.
+     */
+    text_index = pa_pat_open(pmp, xi_mk_name(namebuf, name, "text-index"),
+			     pap, xi_textpool_key_func, XI_TEXT_INTERN_MAX,
+			     XI_SHIFT, XI_MAX_ATOMS);
+    if (text_index == NULL)
+	goto fail;
+
     nodeset_chunks = pa_fixed_open(pmp,
 			xi_mk_name(namebuf, name, "nodeset-chunks"), XI_SHIFT,
 			XI_NODESET_CHUNK_SIZE, XI_MAX_ATOMS);
@@ -112,6 +134,7 @@ xi_workspace_open (pa_mmap_t *pmp, const char *name)
     workp->xw_ns_map = ns_map;
     workp->xw_ns_map_index = ns_map_index;
     workp->xw_textpool = pap;
+    workp->xw_text_index = text_index;
     workp->xw_nodeset_chunks = nodeset_chunks;
     workp->xw_nodeset_info = nodeset_info;
 
@@ -122,6 +145,8 @@ xi_workspace_open (pa_mmap_t *pmp, const char *name)
 	pa_fixed_close(nodeset_chunks);
     if (nodeset_info != NULL)
 	pa_fixed_close(nodeset_info);
+    if (text_index != NULL)
+	pa_pat_close(text_index);
     if (pap != NULL)
 	pa_arb_close(pap);
     if (pip != NULL)
@@ -142,6 +167,100 @@ xi_workspace_open (pa_mmap_t *pmp, const char *name)
     return NULL;
 }
 
+/*
+ * Release the transient side of a workspace.  The contents live on
+ * in the mmap segment, which the caller still owns.
+ */
+void
+xi_workspace_close (xi_workspace_t *xwp)
+{
+    if (xwp == NULL)
+	return;
+
+    pa_fixed_close(xwp->xw_nodeset_info);
+    pa_fixed_close(xwp->xw_nodeset_chunks);
+    pa_pat_close(xwp->xw_text_index);
+    pa_arb_close(xwp->xw_textpool);
+    pa_fixed_close(xwp->xw_nodes);
+    pa_pat_close(xwp->xw_ns_map_index);
+    pa_fixed_close(xwp->xw_ns_map);
+    pa_pat_close(xwp->xw_names_index);
+    pa_istr_close(xwp->xw_names);
+
+    free(xwp);
+}
+
+/*
+ * Make a copy-on-write snapshot of a workspace, giving an isolated,
+ * writable view that shares its pages with the original until they
+ * are written.  The workspace must be kept in a file (see
+ * pa_mmap_snapshot), and "name" must be the one it was opened with.
+ * The original must not be changed while the snapshot is open.
+ * Finish with either xi_workspace_merge or xi_workspace_discard.
+ */
+xi_workspace_t *
+xi_workspace_snapshot (xi_workspace_t *xwp, const char *name)
+{
+    pa_mmap_t *snap = pa_mmap_snapshot(xwp->xw_mmap);
+    xi_workspace_t *snapp;
+
+    if (snap == NULL)
+	return NULL;
+
+    snapp = xi_workspace_open(snap, name);
+    if (snapp == NULL) {
+	pa_mmap_close(snap);
+	return NULL;
+    }
+
+    snapp->xw_flags = xwp->xw_flags;
+    return snapp;
+}
+
+/*
+ * Write a snapshot's changes back into the original workspace and
+ * release the snapshot.  The original's xi_workspace_t (and the trees
+ * opened on it) remain valid.  Returns the number of pages written,
+ * or -1 on failure, in which case the snapshot is discarded.
+ */
+int
+xi_workspace_merge (xi_workspace_t *snapp)
+{
+    pa_mmap_t *snap = snapp->xw_mmap;
+    int rc;
+
+    xi_workspace_close(snapp);
+
+    rc = pa_mmap_snapshot_merge(snap);
+    if (rc < 0)
+	pa_mmap_close(snap);
+
+    return rc;
+}
+
+/*
+ * Throw away a snapshot and all changes made to it
+ */
+void
+xi_workspace_discard (xi_workspace_t *snapp)
+{
+    pa_mmap_t *snap = snapp->xw_mmap;
+
+    xi_workspace_close(snapp);
+    pa_mmap_close(snap);
+}
+
+/*
+ * The names index is keyed by the string itself; the data atoms in
+ * the patricia tree are istr atoms.
+ */
+static const psu_byte_t *
+xi_namepool_key_func (pa_pat_t *pp, pa_pat_data_atom_t datom)
+{
+    pa_istr_atom_t atom = pa_istr_atom(pa_pat_data_atom_of(datom));
+    return (const psu_byte_t *) pa_istr_atom_string(pp->pp_data, atom);
+}
+
 void
 xi_namepool_open (pa_mmap_t *pmap, const char *basename,
 		  pa_istr_t **namesp, pa_pat_t **names_indexp)
@@ -157,7 +276,7 @@ xi_namepool_open (pa_mmap_t *pmap, const char *basename,
 	return;
 
     ppp = pa_pat_open(pmap, xi_mk_name(namebuf, basename, "index"),
-		      pip, pa_pat_istr_key_func,
+		      pip, xi_namepool_key_func,
 		      PA_PAT_MAXKEY, XI_SHIFT, XI_MAX_ATOMS);
     if (ppp == NULL) {
 	pa_istr_close(pip);
@@ -168,10 +287,11 @@ xi_namepool_open (pa_mmap_t *pmap, const char *basename,
     *names_indexp = ppp;
 }
 
-static const uint8_t *
-xi_ns_key_func (pa_pat_t *pp, pa_pat_node_t *node)
+static const psu_byte_t *
+xi_ns_key_func (pa_pat_t *pp, pa_pat_data_atom_t datom)
 {
-    return pa_fixed_atom_addr(pp->pp_data, node->ppn_data);
+    return pa_fixed_atom_addr(pp->pp_data,
+			      pa_fixed_atom(pa_pat_data_atom_of(datom)));
 }
 
 void
@@ -206,7 +326,7 @@ xi_ns_open (pa_mmap_t *pmap, const char *basename,
  * It's some ugly "atom smashing" that keeps us type safe.  Think of it
  * as lead shielding.
  */
-xi_name_atom_t
+pa_atom_t
 xi_namepool_atom (xi_workspace_t *xwp, const char *data, xi_boolean_t createp)
 {
     uint16_t len = strlen(data) + 1;
@@ -216,22 +336,135 @@ xi_namepool_atom (xi_workspace_t *xwp, const char *data, xi_boolean_t createp)
     if (pa_pat_data_is_null(datom) && createp) {
 	/* Allocate the name from our pool and add it to the tree */
 	pa_istr_atom_t iatom = pa_istr_string(xwp->xw_names, data);
-	datom = pa_pat_data_atom(pa_istr_atom_of(iatom));
-	if (pa_istr_is_null(atom))
+	if (pa_istr_is_null(iatom)) {
 	    pa_warning(0, "namepool create key failed for key '%s'", data);
-	else if (!pa_pat_add(ppp, datom, len))
+	    return PA_NULL_ATOM;
+	}
+
+	datom = pa_pat_data_atom(pa_istr_atom_of(iatom));
+	if (!pa_pat_add(ppp, datom, len))
 	    pa_warning(0, "duplicate key: %s", data);
     }
 
-    xi_name_atom_t atom = xi_name_atom_t(pa_pat_data_atom_of(datom));
-    return atom;
+    return pa_pat_data_atom_of(datom);
+}
+
+/*
+ * An interned value is stored with its reference count following the
+ * trailing NUL, so the string itself reads like any other text pool
+ * value.  The count is unaligned, so we memcpy it.  A count that
+ * reaches UINT32_MAX is pinned, leaving the value forever.
+ */
+static inline char *
+xi_textpool_refs (char *cp, size_t len)
+{
+    return cp + len + 1;
+}
+
+/*
+ * Return a shared atom for the given data, creating it if needed.
+ * Called from xi_textpool_alloc when XWF_INTERN_TEXT is set.
+ */
+pa_atom_t
+xi_textpool_intern (xi_workspace_t *xwp, const char *data, size_t len)
+{
+    char key[XI_TEXT_INTERN_MAX];
+    pa_pat_t *ppp = xwp->xw_text_index;
+    pa_pat_data_atom_t datom;
+    pa_arb_atom_t atom;
+    uint32_t refs;
+    char *cp;
+
+    /* The caller's data isn't terminated, but our keys are */
+    memcpy(key, data, len);
+    key[len] = '\0';
+
+    xwp->xw_text_stats.xts_values += 1;
+    xwp->xw_text_stats.xts_bytes += len + 1;
+
+    datom = pa_pat_get_atom(ppp, len + 1, key);
+    if (!pa_pat_data_is_null(datom)) {
+	atom = pa_arb_atom(pa_pat_data_atom_of(datom));
+	cp = pa_arb_atom_addr(xwp->xw_textpool, atom);
+	if (cp == NULL)
+	    return PA_NULL_ATOM;
+
+	cp = xi_textpool_refs(cp, len);
+	memcpy(&refs, cp, sizeof(refs));
+	if (refs != UINT32_MAX) {
+	    refs += 1;
+	    memcpy(cp, &refs, sizeof(refs));
+	}
+
+	xwp->xw_text_stats.xts_shared += 1;
+	xwp->xw_text_stats.xts_bytes_saved += len + 1;
+	return pa_arb_atom_of(atom);
+    }
+
+    atom = pa_arb_alloc(xwp->xw_textpool, len + 1 + sizeof(refs));
+    cp = pa_arb_atom_addr(xwp->xw_textpool, atom);
+    if (cp == NULL)
+	return PA_NULL_ATOM;
+
+    memcpy(cp, key, len + 1);
+    refs = 1;
+    memcpy(xi_textpool_refs(cp, len), &refs, sizeof(refs));
+
+    if (!pa_pat_add(ppp, pa_pat_data_atom(pa_arb_atom_of(atom)), len + 1))
+	pa_warning(0, "textpool index add failed for '%s'", key);
+
+    return pa_arb_atom_of(atom);
+}
+
+/*
+ * Release a text pool atom when the index isn't empty.  If the atom
+ * is the one in the index for its string, it's interned and we drop
+ * a reference; otherwise it's a private copy and is freed directly.
+ */
+void
+xi_textpool_release (xi_workspace_t *xwp, pa_atom_t atom)
+{
+    pa_pat_t *ppp = xwp->xw_text_index;
+    pa_arb_atom_t aatom = pa_arb_atom(atom);
+    char *cp = pa_arb_atom_addr(xwp->xw_textpool, aatom);
+    pa_pat_node_t *node;
+    uint32_t refs;
+    size_t len;
+
+    if (cp == NULL)
+	return;
+
+    len = strlen(cp);
+    if (len < XI_TEXT_INTERN_MAX) {
+	node = pa_pat_get(ppp, len + 1, cp);
+	if (pa_pat_data_atom_of(pa_pat_node_data(ppp, node)) == atom) {
+	    memcpy(&refs, xi_textpool_refs(cp, len), sizeof(refs));
+	    if (refs == UINT32_MAX)
+		return;		/* Pinned */
+
+	    refs -= 1;
+	    if (refs != 0) {
+		memcpy(xi_textpool_refs(cp, len), &refs, sizeof(refs));
+		return;
+	    }
+
+	    pa_pat_delete(ppp, node);
+	}
+    }
+
+    pa_arb_free_atom(xwp->xw_textpool, aatom);
+}
+
+void
+xi_textpool_stats (xi_workspace_t *xwp, xi_textpool_stats_t *statsp)
+{
+    *statsp = xwp->xw_text_stats;
 }
 
 pa_atom_t
 xi_get_attrib (xi_workspace_t *xwp, xi_node_t *nodep, pa_atom_t name_atom)
 {
     pa_atom_t node_atom;
-    int attrib_seen = FALSE;
     xi_depth_t depth = nodep->xn_depth;
 
     if (!(nodep->xn_flags & XNF_ATTRIBS_PRESENT))
@@ -254,8 +487,6 @@ xi_get_attrib (xi_workspace_t *xwp, xi_node_t *nodep, pa_atom_t name_atom)
 	if (nodep->xn_type != XI_TYPE_ATTRIB)
 	    continue;
 
-	attrib_seen = TRUE;
-
 	if (nodep->xn_name == name_atom)
 	    return nodep->xn_contents;
     }
@@ -300,7 +531,7 @@ xi_ns_find (xi_workspace_t *xwp, const char *prefix, const char *uri,
 
     pa_pat_t *ppp = xwp->xw_ns_map_index;
     xi_ns_map_t ns = { prefix_atom, uri_atom };
-    pa_atom_t atom = pa_pat_get_atom(ppp, sizeof(ns), &ns);
+    pa_atom_t atom = pa_pat_data_atom_of(pa_pat_get_atom(ppp, sizeof(ns), &ns));
     if (atom == PA_NULL_ATOM && createp) {
 	xi_ns_map_t *nsp = xi_ns_map_alloc(xwp, &atom);
 	if (nsp == NULL) {
@@ -312,7 +543,7 @@ xi_ns_find (xi_workspace_t *xwp, const char *prefix, const char *uri,
 	*nsp = ns;		/* Initialize newly allocated ns_map entry */
 
 	/* Add it to the patricia tree */
-	if (!pa_pat_add(ppp, atom, sizeof(ns))) {
+	if (!pa_pat_add(ppp, pa_pat_data_atom(atom), sizeof(ns))) {
 	    xi_ns_map_free(xwp, atom);
 
 	    pa_warning(0, "duplicate key failure for namespace '%s%s%s'",
@@ -33,6 +33,29 @@ typedef struct xi_ns_map_s {
     pa_atom_t xnm_uri;		/* Atom of URL string (in namepool) */
 } xi_ns_map_t;
 
+/*
+ * Text pool statistics.  These are transient, covering only the
+ * allocations made by this process.  The dedup ratio is the number
+ * of values stored over the number of atoms needed to hold them.
+ */
+typedef struct xi_textpool_stats_s {
+    unsigned long xts_values;	/* Values stored in the text pool */
+    unsigned long xts_shared;	/* Values that reused an interned atom */
+    unsigned long xts_bytes;	/* Bytes of text (with NULs) stored */
+    unsigned long xts_bytes_saved; /* Bytes not allocated due to sharing */
+} xi_textpool_stats_t;
+
+typedef uint32_t xi_workspace_flags_t; /* Flags for a workspace (XWF_*) */
+
+/* Flags for xw_flags */
+#define XWF_INTERN_TEXT	(1<<0)	/* Share atoms for identical short text */
+
+/*
+ * Only values shorter than this are interned; longer ones are rarely
+ * repeated and would only bloat the index.
+ */
+#define XI_TEXT_INTERN_MAX	64
+
 typedef struct xi_workspace_s {
     pa_mmap_t *xw_mmap;	/* Base memory information */
     pa_fixed_t *xw_nodes;	/* Pool of nodes (xi_node_t) */
@@ -41,6 +64,9 @@ typedef struct xi_workspace_s {
     pa_fixed_t *xw_ns_map; /* Map from prefixes to URLs (xi_ns_map_t) */
     pa_pat_t *xw_ns_map_index;	/* Index of xw_ns_map entries */
     pa_arb_t *xw_textpool;	/* Text data values */
+    pa_pat_t *xw_text_index;	/* Index of interned xw_textpool values */
+    xi_workspace_flags_t xw_flags; /* Flags for this workspace (XWF_*) */
+    xi_textpool_stats_t xw_text_stats; /* Text pool statistics */
     pa_fixed_t *xw_nodeset_chunks; /* Pool of chunks for nodesets node lists */
     pa_fixed_t *xw_nodeset_info; /* Pool of chunks for nodeset "info" data */
 } xi_workspace_t;
@@ -48,6 +74,18 @@ typedef struct xi_workspace_s {
 xi_workspace_t *
 xi_workspace_open (pa_mmap_t *pmp, const char *name);
 
+void
+xi_workspace_close (xi_workspace_t *xwp);
+
+xi_workspace_t *
+xi_workspace_snapshot (xi_workspace_t *xwp, const char *name);
+
+int
+xi_workspace_merge (xi_workspace_t *snapp);
+
+void
+xi_workspace_discard (xi_workspace_t *snapp);
+
 void
 xi_namepool_open (pa_mmap_t *pmap, const char *basename,
 		  pa_istr_t **namesp, pa_pat_t **names_indexp);
@@ -60,7 +98,7 @@ pa_atom_t
 xi_ns_find (xi_workspace_t *xwp, const char *prefix, const char *uri,
 	    xi_boolean_t createp);
 
-PA_FIXED_FUNCTIONS(xi_node_atom_t, xi_node_t, xi_workspace_t, xw_nodes,
+XI_FIXED_FUNCTIONS(xi_node_id_t, xi_node_t, xi_workspace_t, xw_nodes,
 		   xi_node_alloc, xi_node_free, xi_node_addr);
 
 pa_atom_t
@@ -69,7 +107,7 @@ xi_namepool_atom (xi_workspace_t *xwp, const char *data, xi_boolean_t createp);
 static inline const char *
 xi_namepool_string (xi_workspace_t *xwp, pa_atom_t name_atom)
 {
-    return pa_istr_atom_string(xwp->xw_names, name_atom);
+    return pa_istr_atom_string(xwp->xw_names, pa_istr_atom(name_atom));
 }
 
 pa_atom_t
@@ -78,7 +116,71 @@ xi_get_attrib (xi_workspace_t *xwp, xi_node_t *nodep, pa_atom_t name_atom);
 static inline const char *
 xi_textpool_string (xi_workspace_t *xwp, pa_atom_t atom)
 {
-    return pa_arb_atom_addr(xwp->xw_textpool, atom);
+    return pa_arb_atom_addr(xwp->xw_textpool, pa_arb_atom(atom));
+}
+
+static inline void
+xi_workspace_set_flags (xi_workspace_t *xwp, xi_workspace_flags_t flags)
+{
+    xwp->xw_flags |= flags;
+}
+
+static inline void
+xi_workspace_clear_flags (xi_workspace_t *xwp, xi_workspace_flags_t flags)
+{
+    xwp->xw_flags &= ~flags;
+}
+
+pa_atom_t
+xi_textpool_intern (xi_workspace_t *xwp, const char *data, size_t len);
+
+void
+xi_textpool_release (xi_workspace_t *xwp, pa_atom_t atom);
+
+void
+xi_textpool_stats (xi_workspace_t *xwp, xi_textpool_stats_t *statsp);
+
+/*
+ * Copy "len" bytes of data into the text pool, adding a trailing NUL,
+ * and return its atom (or PA_NULL_ATOM on failure).  With
+ * XWF_INTERN_TEXT, short values share a single atom.
+ */
+static inline pa_atom_t
+xi_textpool_alloc (xi_workspace_t *xwp, const char *data, size_t len)
+{
+    if ((xwp->xw_flags & XWF_INTERN_TEXT) && len < XI_TEXT_INTERN_MAX)
+	return xi_textpool_intern(xwp, data, len);
+
+    pa_arb_atom_t atom = pa_arb_alloc(xwp->xw_textpool, len + 1);
+    char *cp = pa_arb_atom_addr(xwp->xw_textpool, atom);
+
+    if (cp == NULL)
+	return PA_NULL_ATOM;
+
+    memcpy(cp, data, len);
+    cp[len] = '\0';
+
+    xwp->xw_text_stats.xts_values += 1;
+    xwp->xw_text_stats.xts_bytes += len + 1;
+
+    return pa_arb_atom_of(atom);
+}
+
+/*
+ * Free a text pool atom.  The index is consulted whenever it's not
+ * empty, since the atom may have been interned by an earlier user of
+ * a persistent workspace.
+ */
+static inline void
+xi_textpool_free (xi_workspace_t *xwp, pa_atom_t atom)
+{
+    if (atom == PA_NULL_ATOM)
+	return;
+
+    if (pa_pat_isempty(xwp->xw_text_index))
+	pa_arb_free_atom(xwp->xw_textpool, pa_arb_atom(atom));
+    else
+	xi_textpool_release(xwp, atom);
 }
 
 static inline const char *
@@ -89,12 +191,8 @@ xi_get_attrib_string (xi_workspace_t *xwp, xi_node_t *nodep,
     return (atom == PA_NULL_ATOM) ? NULL : xi_textpool_string(xwp, atom);
 }
 
-PA_ATOM_TYPE(xi_ns_map_id_t, xi_ns_map_id_s, xnm_atom, xi_ns_map_id_is_null,
-	     xi_ns_map_id, xi_ns_map_null_atom);
-
-PA_FIXED_FUNCTIONS(xi_ns_map_id_t, xi_ns_map_t, xi_workspace_t, xw_ns_map,
-		   xi_ns_map_alloc, xi_ns_map_free, xi_ns_map_addr,
-		   xi_ns_map_id_is_null, xi_ns_map_id);
+XI_FIXED_FUNCTIONS(xi_ns_id_t, xi_ns_map_t, xi_workspace_t, xw_ns_map,
+		   xi_ns_map_alloc, xi_ns_map_free, xi_ns_map_addr);
 
 #endif /* LIBSLAX_XI_WORKSPACE_H */
 
@@ -167,8 +167,11 @@ pa_arb_alloc (pa_arb_t *prp, size_t size)
 
     } else {
 	pa_warning(0, "pa_arb: allocation size limit exceeded: %lu", size);
+	return atom;
     }
 
+    pa_trace(PA_TRACE_ALLOC, PA_TYPE_ARB, &prhp[1], size);
+
     return atom;
 }
 
@@ -224,6 +227,8 @@ pa_arb_free_atom (pa_arb_t *prp, pa_arb_atom_t atom)
     if (addr == NULL)		/* Should not occur */
 	return;
 
+    pa_trace(PA_TRACE_FREE, PA_TYPE_ARB, addr, 0);
+
     pa_arb_free_atom_addr(prp, atom, addr);
 }
 
@@ -269,30 +274,50 @@ pa_arb_close (pa_arb_t *prp)
     psu_free(prp);
 }
 
+/*
+ * Return the number of chunks on the free list for the given slot
+ */
+unsigned
+pa_arb_free_count (pa_arb_t *prp, unsigned slot)
+{
+    pa_arb_atom_t atom;
+    pa_arb_header_t *prhp;
+    unsigned count = 0;
+
+    if (slot > PA_ARB_MAX_POW2)
+	return 0;
+
+    atom = prp->pr_infop->pri_free[slot];
+    if (pa_arb_is_null(atom))
+	return 0;
+
+    for (prhp = pa_arb_header(prp, atom); prhp != NULL;
+	 prhp = pa_arb_header(prp, atom)) {
+	if (prhp->prh_magic != PRH_MAGIC_SMALL_FREE)
+	    break;
+	count += 1;
+	atom = prhp->prh_next_free[0];
+    }
+
+    return count;
+}
+
 void
 pa_arb_dump (pa_arb_t *prp)
 {
     pa_arb_slot_t slot;
-    pa_arb_atom_t atom, saved_atom;
+    pa_arb_atom_t atom;
     pa_arb_header_t *prhp;
     unsigned count;
 
     psu_log("begin dumping pa_arb_t");
 
     for (slot = 0; slot <= PA_ARB_MAX_POW2; slot++) {
-	saved_atom = atom = prp->pr_infop->pri_free[slot];
+	atom = prp->pr_infop->pri_free[slot];
 	if (pa_arb_is_null(atom))
 	    continue;
 
-	for (count = 0, prhp = pa_arb_header(prp, atom); prhp != NULL;
-	     prhp = pa_arb_header(prp, atom)) {
-	    if (prhp->prh_magic == PRH_MAGIC_SMALL_FREE) {
-		count += 1;
-		atom = prhp->prh_next_free[0];
-	    } else
-		break;
-	}
-	atom = saved_atom;
+	count = pa_arb_free_count(prp, slot);
 
 	psu_log("  slot:%u %#x (%u)", slot, pa_arb_atom_of(atom), count);
 	for (prhp = pa_arb_header(prp, atom); prhp != NULL;
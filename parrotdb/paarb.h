@@ -192,6 +192,9 @@ pa_arb_open (pa_mmap_t *pmp, const char *name);
 void
 pa_arb_close (pa_arb_t *prp);
 
+unsigned
+pa_arb_free_count (pa_arb_t *prp, unsigned slot);
+
 void
 pa_arb_dump (pa_arb_t *prp);
 
@@ -19,6 +19,9 @@
 
 #include <parrotdb/pacommon.h>
 
+/* Our allocation trace function, if any */
+pa_trace_func_t pa_trace_func;
+
 /*
  * Cheesy breakpoint for memory allocation failure
  */
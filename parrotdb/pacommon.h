@@ -162,6 +162,36 @@ pa_alloc_failed (const char *msg);
 void
 pa_warning (int errnum, const char *fmt, ...);
 
+/*
+ * Allocation tracing: when a trace function is set, each allocation
+ * and free made through pa_fixed, pa_arb, and pa_istr is reported
+ * to it, with the address of the memory and the size requested
+ * (zero for frees).
+ * This lets tools record the allocation pattern of a real workload
+ * and replay it against other allocators (see tests/pa/pabench.c).
+ * The pa_mmap calls that back these allocators are not reported.
+ */
+#define PA_TRACE_ALLOC	'a'	/* Memory was allocated */
+#define PA_TRACE_FREE	'f'	/* Memory was freed */
+
+typedef void (*pa_trace_func_t)(int op, unsigned type,
+				void *addr, size_t size);
+
+extern pa_trace_func_t pa_trace_func;
+
+static inline void
+pa_trace (int op, unsigned type, void *addr, size_t size)
+{
+    if (pa_trace_func)
+	pa_trace_func(op, type, addr, size);
+}
+
+static inline void
+pa_trace_set_func (pa_trace_func_t func)
+{
+    pa_trace_func = func;
+}
+
 /*
  * Allocating strings of length zero or one is a waste.  Instead,
  * we use a simple array containing each byte and a trailing NUL.
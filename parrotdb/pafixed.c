@@ -118,7 +118,14 @@ pa_fixed_init (pa_mmap_t *pmp, pa_fixed_t *pfp, const char *name,
     /* Round max_atoms up to the next page size */
     max_atoms = pa_roundup_shift32(max_atoms, shift);
 
-    /* No base is NULL, allocate it, zero it and init the free list */
+    /*
+     * If the info block already records a page table (as when reopening
+     * a persistent mmap file), just map it.  Otherwise allocate it,
+     * zero it and init the free list.
+     */
+    if (pfp->pf_base == NULL && !pa_mmap_is_null(pfp->pf_infop->pfi_base))
+	pfp->pf_base = pa_mmap_addr(pmp, pfp->pf_infop->pfi_base);
+
     if (pfp->pf_base == NULL) {
 	size_t size = (max_atoms >> shift) * sizeof(uint8_t *);
 
@@ -175,6 +182,30 @@ pa_fixed_open (pa_mmap_t *pmp, const char *name, pa_shift_t shift,
     return pa_fixed_setup(pmp, pfip, name, shift, atom_size, max_atoms);
 }
 
+/*
+ * Return the number of atoms on the free list.  Atoms in pages that
+ * have not been allocated yet aren't counted.
+ */
+unsigned
+pa_fixed_free_count (pa_fixed_t *pfp)
+{
+    pa_fixed_atom_t atom;
+    pa_fixed_atom_t *addr;
+    unsigned count = 0;
+
+    if (pfp->pf_base == NULL)
+	return 0;
+
+    for (atom = pfp->pf_free; !pa_fixed_is_null(atom); atom = *addr) {
+	addr = pa_fixed_atom_addr(pfp, atom);
+	if (addr == NULL || count >= pfp->pf_max_atoms)
+	    break;
+	count += 1;
+    }
+
+    return count;
+}
+
 void
 pa_fixed_close (pa_fixed_t *pfp)
 {
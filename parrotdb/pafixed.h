@@ -189,6 +189,8 @@ pa_fixed_alloc_atom (pa_fixed_t *pfp)
     if (pfp->pf_flags & PFF_INIT_ZERO)
 	bzero(addr, pfp->pf_atom_size);
 
+    pa_trace(PA_TRACE_ALLOC, PA_TYPE_FIXED, addr, pfp->pf_atom_size);
+
     return atom;
 }
 
@@ -245,6 +247,8 @@ pa_fixed_free_atom (pa_fixed_t *pfp, pa_fixed_atom_t atom)
     if (addr == NULL)
 	return;
 
+    pa_trace(PA_TRACE_FREE, PA_TYPE_FIXED, addr, 0);
+
     /* Add the atom to the front of the free list */
     *addr = pfp->pf_free;
     pfp->pf_free = atom;
@@ -266,6 +270,9 @@ pa_fixed_t *
 pa_fixed_open (pa_mmap_t *pmp, const char *name, pa_shift_t shift,
 	       uint16_t atom_size, uint32_t max_atoms);
 
+unsigned
+pa_fixed_free_count (pa_fixed_t *pfp);
+
 void
 pa_fixed_close (pa_fixed_t *pfp);
 
@@ -81,6 +81,7 @@ pa_istr_nstring_alloc (pa_istr_t *pip, const char *string, size_t len)
     if (data) {
 	memcpy(data, string, len);
 	data[len] = '\0';
+	pa_trace(PA_TRACE_ALLOC, PA_TYPE_ISTR, data, len + 1);
     }
 
     return pa_istr_atom_to_index(pip, atom);
@@ -109,6 +110,10 @@ pa_istr_init (pa_mmap_t *pmp, pa_istr_t *pip, const char *name,
     /* Round max_atoms up to the next page size */
     max_atoms = pa_roundup_shift32(max_atoms, shift);
 
+    /* Reuse an existing page table, as when reopening a mmap file */
+    if (pip->pi_base == NULL && !pa_mmap_is_null(pip->pi_datap->pid_base))
+	pip->pi_base = pa_mmap_addr(pmp, pip->pi_datap->pid_base);
+
     /* No base is NULL, allocate it, zero it and init the free list */
     if (pip->pi_base == NULL) {
 	size_t size = (max_atoms >> shift) * sizeof(uint8_t *);
@@ -238,6 +238,7 @@ pa_istr_nstring (pa_istr_t *pip, const char *string, size_t len)
 	if (data) {
 	    memcpy(data, string, len);
 	    data[len] = '\0';
+	    pa_trace(PA_TRACE_ALLOC, PA_TYPE_ISTR, data, len + 1);
 	}
 
 	/* Allocate an istr to hold our istr_data */
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/palz.h>
+
+#define PA_LZ_HASH_BITS	12	/* Size of the match finder's table */
+#define PA_LZ_EXTEND	15	/* Nibble value meaning "more follows" */
+
+static inline uint32_t
+pa_lz_read32 (const psu_byte_t *cp)
+{
+    uint32_t val;
+
+    memcpy(&val, cp, sizeof(val));
+    return val;
+}
+
+static inline unsigned
+pa_lz_hash (uint32_t val)
+{
+    return (val * 2654435761U) >> (32 - PA_LZ_HASH_BITS);
+}
+
+/*
+ * Write a length extension: a run of 255s and a final remainder
+ */
+static inline psu_byte_t *
+pa_lz_put_length (psu_byte_t *dp, psu_byte_t *dend, size_t len)
+{
+    for (; len >= 255; len -= 255) {
+	if (dp >= dend)
+	    return NULL;
+	*dp++ = 255;
+    }
+
+    if (dp >= dend)
+	return NULL;
+    *dp++ = len;
+
+    return dp;
+}
+
+/*
+ * Emit one sequence: literals from "lit" and, if "mlen" is non-zero,
+ * a match "offset" bytes back.
+ */
+static psu_byte_t *
+pa_lz_put_sequence (psu_byte_t *dp, psu_byte_t *dend,
+		    const psu_byte_t *lit, size_t llen,
+		    size_t offset, size_t mlen)
+{
+    psu_byte_t *tokenp = dp++;
+    size_t mcode = mlen ? mlen - PA_LZ_MIN_MATCH : 0;
+
+    if (tokenp >= dend)
+	return NULL;
+
+    *tokenp = ((llen < PA_LZ_EXTEND) ? llen : PA_LZ_EXTEND) << 4;
+    if (llen >= PA_LZ_EXTEND) {
+	dp = pa_lz_put_length(dp, dend, llen - PA_LZ_EXTEND);
+	if (dp == NULL)
+	    return NULL;
+    }
+
+    if ((size_t) (dend - dp) < llen)
+	return NULL;
+    memcpy(dp, lit, llen);
+    dp += llen;
+
+    if (mlen == 0)
+	return dp;
+
+    if (dend - dp < 2)
+	return NULL;
+    *dp++ = offset & 0xff;
+    *dp++ = offset >> 8;
+
+    *tokenp |= (mcode < PA_LZ_EXTEND) ? mcode : PA_LZ_EXTEND;
+    if (mcode >= PA_LZ_EXTEND)
+	dp = pa_lz_put_length(dp, dend, mcode - PA_LZ_EXTEND);
+
+    return dp;
+}
+
+size_t
+pa_lz_compress (const psu_byte_t *src, size_t len,
+		psu_byte_t *dst, size_t dst_max)
+{
+    uint32_t table[1 << PA_LZ_HASH_BITS];
+    psu_byte_t *dp = dst, *dend = dst + dst_max;
+    size_t ip = 0, anchor = 0, ref, mlen;
+    unsigned hash;
+
+    /* Positions are stored plus one, so zero means "empty" */
+    memset(table, 0, sizeof(table));
+
+    while (ip + PA_LZ_MIN_MATCH <= len) {
+	hash = pa_lz_hash(pa_lz_read32(src + ip));
+	ref = table[hash];
+	table[hash] = ip + 1;
+
+	if (ref == 0 || ip - (ref - 1) > PA_LZ_MAX_OFFSET
+	    || pa_lz_read32(src + ref - 1) != pa_lz_read32(src + ip)) {
+	    ip += 1;
+	    continue;
+	}
+
+	ref -= 1;
+	for (mlen = PA_LZ_MIN_MATCH; ip + mlen < len; mlen++)
+	    if (src[ref + mlen] != src[ip + mlen])
+		break;
+
+	dp = pa_lz_put_sequence(dp, dend, src + anchor, ip - anchor,
+				ip - ref, mlen);
+	if (dp == NULL)
+	    return 0;
+
+	ip += mlen;
+	anchor = ip;
+    }
+
+    /* Trailing literals */
+    dp = pa_lz_put_sequence(dp, dend, src + anchor, len - anchor, 0, 0);
+    if (dp == NULL)
+	return 0;
+
+    return dp - dst;
+}
+
+/*
+ * Read a length extension, returning NULL if we run off the end
+ */
+static inline const psu_byte_t *
+pa_lz_get_length (const psu_byte_t *sp, const psu_byte_t *send, size_t *lenp)
+{
+    psu_byte_t val;
+
+    do {
+	if (sp >= send)
+	    return NULL;
+	val = *sp++;
+	*lenp += val;
+    } while (val == 255);
+
+    return sp;
+}
+
+size_t
+pa_lz_decompress (const psu_byte_t *src, size_t clen,
+		  psu_byte_t *dst, size_t dst_len)
+{
+    const psu_byte_t *sp = src, *send = src + clen;
+    psu_byte_t *dp = dst, *dend = dst + dst_len;
+    size_t llen, mlen, offset;
+    psu_byte_t token;
+
+    while (sp < send) {
+	token = *sp++;
+
+	llen = token >> 4;
+	if (llen == PA_LZ_EXTEND) {
+	    sp = pa_lz_get_length(sp, send, &llen);
+	    if (sp == NULL)
+		return 0;
+	}
+
+	if ((size_t) (send - sp) < llen || (size_t) (dend - dp) < llen)
+	    return 0;
+	memcpy(dp, sp, llen);
+	sp += llen;
+	dp += llen;
+
+	if (sp == send)
+	    break;		/* Last sequence has no match */
+
+	if (send - sp < 2)
+	    return 0;
+	offset = sp[0] | (sp[1] << 8);
+	sp += 2;
+	if (offset == 0 || offset > (size_t) (dp - dst))
+	    return 0;
+
+	mlen = token & 0xf;
+	if (mlen == PA_LZ_EXTEND) {
+	    sp = pa_lz_get_length(sp, send, &mlen);
+	    if (sp == NULL)
+		return 0;
+	}
+	mlen += PA_LZ_MIN_MATCH;
+
+	if ((size_t) (dend - dp) < mlen)
+	    return 0;
+
+	/* Matches may overlap their output, so copy a byte at a time */
+	for (; mlen > 0; mlen--, dp++)
+	    *dp = *(dp - offset);
+    }
+
+    return dp - dst;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ */
+
+#ifndef PARROTDB_PALZ_H
+#define PARROTDB_PALZ_H
+
+/*
+ * A small LZ77 block codec, used to store cold pa_mmap pages.  Each
+ * block is compressed independently, so any page can be read without
+ * its neighbors.  The format follows the LZ4 block layout: a token
+ * byte holds the literal count (high nibble) and the match length
+ * less PA_LZ_MIN_MATCH (low nibble), either of which is extended by
+ * following bytes when it's 15.  The literals follow, then a two byte
+ * little-endian offset back into the output.  The last sequence has
+ * literals only.
+ *
+ * It's built for speed over ratio, and for not needing anything we
+ * can't ship in the tree.  Both functions are pure computation, so
+ * they're safe to call from a signal handler.
+ */
+
+#define PA_LZ_MIN_MATCH	4	/* Shortest match we encode */
+#define PA_LZ_MAX_OFFSET 65535	/* Furthest we look back */
+
+/*
+ * Compress "len" bytes from "src" into "dst", which has room for
+ * "dst_max" bytes.  Returns the compressed length, or zero if the
+ * result won't fit (so the caller should store the block raw).
+ */
+size_t
+pa_lz_compress (const psu_byte_t *src, size_t len,
+		psu_byte_t *dst, size_t dst_max);
+
+/*
+ * Decompress "clen" bytes from "src" into "dst", which has room for
+ * "dst_len" bytes.  Returns the decompressed length, or zero if the
+ * data is corrupt.
+ */
+size_t
+pa_lz_decompress (const psu_byte_t *src, size_t clen,
+		  psu_byte_t *dst, size_t dst_len);
+
+#endif /* PARROTDB_PALZ_H */
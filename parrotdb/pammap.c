@@ -20,12 +20,20 @@
 #include <sys/mman.h>
 #include <errno.h>
 #include <stddef.h>
+#include <signal.h>
 
 #include <libpsu/psualloc.h>
 #include <libpsu/psulog.h>
 #include <parrotdb/pacommon.h>
 #include <parrotdb/paconfig.h>
 #include <parrotdb/pammap.h>
+#include <parrotdb/palz.h>
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif /* HAVE_SYS_SYSCALL_H */
+#ifdef HAVE_LINUX_MEMPOLICY_H
+#include <linux/mempolicy.h>
+#endif /* HAVE_LINUX_MEMPOLICY_H */
 #include <libpsu/psualloc.h>
 
 #define PA_VERS_MAJOR		1 /* Major numbers are mutually incompatible */
@@ -112,68 +120,77 @@ pa_mmap_list_add (pa_mmap_t *pmp, pa_mmap_atom_t atom, unsigned size)
     *lastp = atom;
 }
 
+static int
+pa_mmap_zgrow (pa_mmap_zone_t *zp, size_t new_len);
+
 /*
- * Allocate a chunk of memory and return its offset.
+ * Set the NUMA policy for a range of memory.  With "move", pages
+ * already placed are migrated to match.  Policies only steer
+ * anonymous and shared-anonymous memory; for pages of a plain file,
+ * the page cache follows the policy of the thread that reads them.
  */
-pa_mmap_atom_t
-pa_mmap_alloc (pa_mmap_t *pmp, size_t size)
+static int
+pa_mmap_mbind (void *addr, size_t len, unsigned policy,
+	       pa_numa_mask_t nodes, psu_boolean_t move)
 {
-    if (size == 0) {
-	pa_warning(0, "pa_mmap_alloc called with zero size");
-	return pa_mmap_null_atom();
+#if defined(HAVE_LINUX_MEMPOLICY_H) && defined(SYS_mbind)
+    unsigned long mask[sizeof(nodes) / sizeof(unsigned long)];
+    int mode;
+
+    switch (policy) {
+    case PA_NUMA_BIND:
+	mode = MPOL_BIND;
+	break;
+    case PA_NUMA_INTERLEAVE:
+	mode = MPOL_INTERLEAVE;
+	break;
+    case PA_NUMA_PREFERRED:
+	mode = MPOL_PREFERRED;
+	break;
+    default:
+	mode = MPOL_DEFAULT;
+	break;
     }
 
-    pa_mmap_atom_t fa;		/* Free atom number */
-    unsigned count = (size + PA_MMAP_ATOM_SIZE - 1) >> PA_MMAP_ATOM_SHIFT;
-    unsigned new_count;
-    pa_mmap_free_t *pmfp;
-    pa_mmap_atom_t *lastp = &pmp->pm_infop->pmi_free;
+    memcpy(mask, &nodes, sizeof(mask));
 
-    for (fa = *lastp; !pa_mmap_is_null(fa); fa = *lastp) {
-	pmfp = pa_mmap_addr(pmp, fa);
+    /* The kernel reads one less bit than maxnode says */
+    if (syscall(SYS_mbind, addr, len, mode,
+		(mode == MPOL_DEFAULT) ? NULL : mask,
+		(mode == MPOL_DEFAULT) ? 0 : PA_NUMA_MAX_NODES + 1,
+		move ? MPOL_MF_MOVE : 0) < 0) {
+	pa_warning(errno, "mbind failed");
+	return -1;
+    }
 
-	if (pmfp->pmf_size >= count) {
-	    /*
-	     * We "cheat", allocating from the end so we don't need to
-	     * touch the current by_addr list.  We'll still have to mung
-	     * the by_size list.
-	     */
-	    if (count < pmfp->pmf_size) {
-		pmfp->pmf_size -= count;
-		fa.pma_atom += pmfp->pmf_size; /* Reference end of the chunk */
-	    } else
-		*lastp = pmfp->pmf_next; /* Unlink this chunk */
+    return 0;
 
-	    return fa;		/* Return offset */
-	}
+#else /* HAVE_LINUX_MEMPOLICY_H && SYS_mbind */
+    static int warned;
 
-	lastp = &pmfp->pmf_next;
+    if (policy != PA_NUMA_DEFAULT && !warned) {
+	warned = TRUE;
+	pa_warning(0, "NUMA placement is not supported here");
     }
 
-    /*
-     * Okay, so there's nothing but enough to fit this, but we do
-     * know that *lastp is the end of the free list.  So we grow our
-     * database, and toss the excess onto the free list.
-     */
-    if (count < PA_DEFAULT_COUNT)
-	new_count = PA_DEFAULT_COUNT;
-    else
-	new_count = pa_roundup32(count, PA_DEFAULT_COUNT);
+    return (policy == PA_NUMA_DEFAULT) ? 0 : -1;
+#endif /* HAVE_LINUX_MEMPOLICY_H && SYS_mbind */
+}
 
-    size_t new_len = pmp->pm_len + (new_count << PA_MMAP_ATOM_SHIFT);
+/*
+ * Grow the mapped segment to new_len bytes, in place.  The caller
+ * records the new length.
+ */
+static int
+pa_mmap_grow (pa_mmap_t *pmp, size_t new_len)
+{
     size_t old_len = pmp->pm_len;
 
-    if (pmp->pm_infop->pmi_max_size != 0
-	&& new_len > pmp->pm_infop->pmi_max_size) {
-	pa_warning(0, "max size reached");
-	return pa_mmap_null_atom();
-    }
-
     /* If we've got a file attached, we need to extend the file */
     if (pmp->pm_fd > 0) {
 	if (ftruncate(pmp->pm_fd, new_len) < 0) {
 	    pa_warning(errno, "cannot extend memory file to %d", new_len);
-	    return pa_mmap_null_atom();
+	    return -1;
 	}
 
 	/* Re-mmap the segment */
@@ -182,12 +199,12 @@ pa_mmap_alloc (pa_mmap_t *pmp, size_t size)
 			  pmp->pm_fd, 0);
 	if (addr == NULL || addr == MAP_FAILED) {
 	    pa_warning(errno, "mmap failed");
-	    return pa_mmap_null_atom();
+	    return -1;
 	}
 
 	if (addr != pmp->pm_addr) {
 	    pa_warning(0, "mmap was moved (%p:%p)", pmp->pm_addr, addr);
-	    return pa_mmap_null_atom();
+	    return -1;
 	}
 
     } else {
@@ -201,17 +218,16 @@ pa_mmap_alloc (pa_mmap_t *pmp, size_t size)
 	target += old_len;
 
 	void *addr = mmap(target, new_len - old_len, pmp->pm_mmap_prot,
-			  pmp->pm_mmap_flags | MAP_FIXED | MAP_SHARED,
-			  pmp->pm_fd, 0);
+			  pmp->pm_mmap_flags | MAP_FIXED, pmp->pm_fd, 0);
 	if (addr == NULL || addr == MAP_FAILED) {
 	    pa_warning(errno, "mmap failed");
-	    return pa_mmap_null_atom();
+	    return -1;
 	}
 
 	if (addr != target) {
 	    pa_warning(0, "mmap was moved (%p:%p:%p)",
 		       pmp->pm_addr, target, addr);
-	    return pa_mmap_null_atom();
+	    return -1;
 	}
 
 	pa_mmap_record_t *pmrp = psu_calloc(sizeof(*pmrp));
@@ -221,9 +237,80 @@ pa_mmap_alloc (pa_mmap_t *pmp, size_t size)
 	    pmrp->pmr_next = pmp->pm_record;
 	    pmp->pm_record = pmrp;
 	}
+
+	if (pmp->pm_zone && pa_mmap_zgrow(pmp->pm_zone, new_len) < 0)
+	    return -1;
+    }
+
+    if (pmp->pm_numa_policy != PA_NUMA_DEFAULT)
+	pa_mmap_mbind(pmp->pm_addr + old_len, new_len - old_len,
+		      pmp->pm_numa_policy, pmp->pm_numa_nodes, FALSE);
+
+    return 0;
+}
+
+/*
+ * Allocate a chunk of memory and return its offset.
+ */
+pa_mmap_atom_t
+pa_mmap_alloc (pa_mmap_t *pmp, size_t size)
+{
+    if (size == 0) {
+	pa_warning(0, "pa_mmap_alloc called with zero size");
+	return pa_mmap_null_atom();
+    }
+
+    pa_mmap_atom_t fa;		/* Free atom number */
+    unsigned count = (size + PA_MMAP_ATOM_SIZE - 1) >> PA_MMAP_ATOM_SHIFT;
+    unsigned new_count;
+    pa_mmap_free_t *pmfp;
+    pa_mmap_atom_t *lastp = &pmp->pm_infop->pmi_free;
+
+    for (fa = *lastp; !pa_mmap_is_null(fa); fa = *lastp) {
+	pmfp = pa_mmap_addr(pmp, fa);
+
+	if (pmfp->pmf_size >= count) {
+	    /*
+	     * We "cheat", allocating from the end so we don't need to
+	     * touch the current by_addr list.  We'll still have to mung
+	     * the by_size list.
+	     */
+	    if (count < pmfp->pmf_size) {
+		pmfp->pmf_size -= count;
+		fa.pma_atom += pmfp->pmf_size; /* Reference end of the chunk */
+	    } else
+		*lastp = pmfp->pmf_next; /* Unlink this chunk */
+
+	    return fa;		/* Return offset */
+	}
+
+	lastp = &pmfp->pmf_next;
+    }
+
+    /*
+     * Okay, so there's nothing but enough to fit this, but we do
+     * know that *lastp is the end of the free list.  So we grow our
+     * database, and toss the excess onto the free list.
+     */
+    if (count < PA_DEFAULT_COUNT)
+	new_count = PA_DEFAULT_COUNT;
+    else
+	new_count = pa_roundup32(count, PA_DEFAULT_COUNT);
+
+    size_t new_len = pmp->pm_len + (new_count << PA_MMAP_ATOM_SHIFT);
+    size_t old_len = pmp->pm_len;
+
+    if (pmp->pm_infop->pmi_max_size != 0
+	&& new_len > pmp->pm_infop->pmi_max_size) {
+	pa_warning(0, "max size reached");
+	return pa_mmap_null_atom();
     }
 
+    if (pa_mmap_grow(pmp, new_len) < 0)
+	return pa_mmap_null_atom();
+
     pmp->pm_len = new_len;	/* Record our new length */
+    pmp->pm_infop->pmi_len = new_len;
     /* We'll use the first chunk for this allocation */
     fa = pa_mmap_atom(old_len >> PA_MMAP_ATOM_SHIFT);
 
@@ -259,6 +346,552 @@ pa_mmap_free (pa_mmap_t *pmp, pa_mmap_atom_t atom, unsigned size)
     pa_mmap_list_add(pmp, atom, count);
 }
 
+/*
+ * Map a new segment at the next free address in our address range.
+ * Each segment gets its own stretch of address space, so that it can
+ * grow in place.
+ */
+static psu_byte_t *
+pa_mmap_map (size_t len, int prot, int mmap_flags, int fd)
+{
+    psu_byte_t *addr;
+
+    for (;;) {
+	if (pa_mmap_next_address > (psu_byte_t *) PA_ADDR_MAX)
+	    return NULL;
+
+	addr = mmap(pa_mmap_next_address, len, prot, mmap_flags, fd, 0);
+	if (addr == pa_mmap_next_address) /* Success */
+	    break;
+
+	if (addr == NULL || addr == MAP_FAILED) {
+	    pa_warning(errno, "mmap failed (%p.vs.%p)",
+		       addr, pa_mmap_next_address);
+	    if (errno != EINVAL)
+		return NULL;
+
+	    pa_mmap_next_address += pa_mmap_incr_address;
+	    continue;
+	} else if (addr != pa_mmap_next_address) {
+	    pa_warning(errno, "mmap returns wrong address (%p.vs.%p)",
+		       addr, pa_mmap_next_address);
+	    munmap(addr, len);
+	    return NULL;
+	}
+    }
+
+    pa_mmap_next_address += pa_mmap_incr_address;
+
+    return addr;
+}
+
+/*
+ * Compressed segments (PMF_COMPRESSED) keep their file as a series
+ * of independently compressed pages, with an index giving each
+ * page's offset and length, so any page can be read on its own.  In
+ * memory, the segment is anonymous and starts out inaccessible.  The
+ * first touch of a page faults; our SIGSEGV handler reads and
+ * decompresses the page and makes it readable ("clean").  A write
+ * faults again and makes it writable ("dirty").  pa_mmap_checkpoint
+ * writes the segment back: dirty and clean pages are compressed
+ * afresh, while cold pages' compressed blocks are copied over as-is.
+ *
+ * Page zero is an all-zeros page and takes no space in the file.
+ *
+ * A page becomes accessible while it's being filled, and a fault
+ * can't tell us whether it was a read or a write, so a segment must
+ * be used by one thread at a time.  The list of zones is shared, so
+ * the handler, and anything that changes a zone's pages or the list,
+ * holds pa_mmap_zlock.
+ */
+#define PA_ZMAGIC_NUMBER	0x50415a31 /* "PAZ1" in our endian-ness */
+#define PA_ZVERS		1	/* File format version */
+#define PA_ZONE_MAX		16	/* Max open compressed segments */
+
+#define PZS_COLD	0	/* Not yet read from the file */
+#define PZS_CLEAN	1	/* Read, unchanged (PROT_READ) */
+#define PZS_DIRTY	2	/* Changed since read (PROT_READ|WRITE) */
+
+typedef struct pa_mmap_zheader_s {
+    uint32_t pzh_magic;		/* Magic number */
+    uint16_t pzh_vers;		/* Version number */
+    uint16_t pzh_shift;		/* Page size (as a shift) */
+    uint32_t pzh_pages;		/* Number of pages in the index */
+    uint32_t pzh_pad;		/* Padding */
+} pa_mmap_zheader_t;
+
+typedef struct pa_mmap_zindex_s {
+    uint64_t pzi_offset;	/* Offset of the page's block in the file */
+    uint32_t pzi_len;		/* Block length (0 = zeros, page size = raw) */
+    uint32_t pzi_pad;		/* Padding */
+} pa_mmap_zindex_t;
+
+struct pa_mmap_zone_s {
+    char *pmz_filename;		/* Name of our file */
+    unsigned pmz_mode;		/* File permissions */
+    int pmz_fd;			/* Current file (or -1 if not yet written) */
+    int pmz_read_only;		/* Opened read-only */
+    uint32_t pmz_pages;		/* Number of pages in pmz_index */
+    pa_mmap_zindex_t *pmz_index; /* Index from our file */
+    size_t pmz_file_len;	/* Length of our file */
+    psu_byte_t *pmz_addr;	/* Base address of our segment */
+    uint32_t pmz_npages;	/* Number of pages mapped */
+    uint8_t *pmz_state;		/* State of each page (PZS_*) */
+}; /* pa_mmap_zone_t */
+
+static pa_mmap_zone_t *pa_mmap_zones[PA_ZONE_MAX];
+static struct sigaction pa_mmap_zold; /* SIGSEGV action before ours */
+static int pa_mmap_zinstalled;	/* Our handler is installed */
+static char pa_mmap_zlock;	/* Serializes fault handling */
+
+static inline void
+pa_mmap_zlock_acquire (void)
+{
+    while (__atomic_test_and_set(&pa_mmap_zlock, __ATOMIC_ACQUIRE))
+	continue;
+}
+
+static inline void
+pa_mmap_zlock_release (void)
+{
+    __atomic_clear(&pa_mmap_zlock, __ATOMIC_RELEASE);
+}
+
+/*
+ * Read a cold page from the file into memory, which the caller has
+ * made writable.  Called from our signal handler, so we stick to
+ * pread and computation.
+ */
+static psu_boolean_t
+pa_mmap_zload (pa_mmap_zone_t *zp, uint32_t page, psu_byte_t *addr)
+{
+    psu_byte_t buf[PA_MMAP_ATOM_SIZE];
+    pa_mmap_zindex_t *zip;
+
+    if (page >= zp->pmz_pages || zp->pmz_index[page].pzi_len == 0)
+	return TRUE;		/* Anonymous memory is already zeroed */
+
+    zip = &zp->pmz_index[page];
+    if (zip->pzi_len == PA_MMAP_ATOM_SIZE)
+	return pread(zp->pmz_fd, addr, PA_MMAP_ATOM_SIZE, zip->pzi_offset)
+	    == PA_MMAP_ATOM_SIZE;
+
+    if (pread(zp->pmz_fd, buf, zip->pzi_len, zip->pzi_offset)
+	    != (ssize_t) zip->pzi_len)
+	return FALSE;
+
+    return pa_lz_decompress(buf, zip->pzi_len, addr, PA_MMAP_ATOM_SIZE)
+	== PA_MMAP_ATOM_SIZE;
+}
+
+/*
+ * Handle a fault on one of our pages, moving it one step along from
+ * cold to clean to dirty.  Returns FALSE if the fault isn't ours to
+ * fix.
+ */
+static psu_boolean_t
+pa_mmap_zfix (pa_mmap_zone_t *zp, psu_byte_t *addr)
+{
+    static const char msg[] = "pa_mmap: could not load compressed page\n";
+    uint32_t page = (addr - zp->pmz_addr) >> PA_MMAP_ATOM_SHIFT;
+    psu_byte_t *pagep = zp->pmz_addr + ((size_t) page << PA_MMAP_ATOM_SHIFT);
+
+    if (page >= zp->pmz_npages)
+	return FALSE;
+
+    switch (zp->pmz_state[page]) {
+    case PZS_COLD:
+	if (mprotect(pagep, PA_MMAP_ATOM_SIZE, PROT_READ | PROT_WRITE) < 0)
+	    return FALSE;
+
+	if (!pa_mmap_zload(zp, page, pagep)) {
+	    if (write(2, msg, sizeof(msg) - 1) < 0) {
+		/* Nothing more we can do */
+	    }
+	    abort();
+	}
+
+	mprotect(pagep, PA_MMAP_ATOM_SIZE, PROT_READ);
+	zp->pmz_state[page] = PZS_CLEAN;
+	return TRUE;
+
+    case PZS_CLEAN:
+	if (zp->pmz_read_only)
+	    return FALSE;
+
+	if (mprotect(pagep, PA_MMAP_ATOM_SIZE, PROT_READ | PROT_WRITE) < 0)
+	    return FALSE;
+
+	zp->pmz_state[page] = PZS_DIRTY;
+	return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+pa_mmap_zfault (int sig, siginfo_t *sip, void *ucp)
+{
+    psu_byte_t *addr = sip->si_addr;
+    pa_mmap_zone_t *zp;
+    psu_boolean_t fixed = FALSE;
+    struct sigaction sa;
+    int i;
+
+    pa_mmap_zlock_acquire();
+
+    for (i = 0; i < PA_ZONE_MAX; i++) {
+	zp = pa_mmap_zones[i];
+	if (zp && addr >= zp->pmz_addr
+	    && addr < zp->pmz_addr
+		   + ((size_t) zp->pmz_npages << PA_MMAP_ATOM_SHIFT)) {
+	    fixed = pa_mmap_zfix(zp, addr);
+	    break;
+	}
+    }
+
+    pa_mmap_zlock_release();
+
+    if (fixed)
+	return;
+
+    /*
+     * Not ours: pass it to the previous handler, staying installed
+     * for our other faults.  If there wasn't one, put back the
+     * default action and return, so the faulting instruction is
+     * retried and the process gets the default treatment.  (An
+     * ignored SIGSEGV would just fault again, so it's treated the
+     * same way.)
+     */
+    if (pa_mmap_zold.sa_flags & SA_SIGINFO) {
+	pa_mmap_zold.sa_sigaction(sig, sip, ucp);
+
+    } else if (pa_mmap_zold.sa_handler != SIG_DFL
+	       && pa_mmap_zold.sa_handler != SIG_IGN) {
+	pa_mmap_zold.sa_handler(sig);
+
+    } else {
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = SIG_DFL;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGSEGV, &sa, NULL);
+	pa_mmap_zinstalled = FALSE;
+    }
+}
+
+static void
+pa_mmap_zclose (pa_mmap_zone_t *zp)
+{
+    int i;
+
+    pa_mmap_zlock_acquire();
+    for (i = 0; i < PA_ZONE_MAX; i++)
+	if (pa_mmap_zones[i] == zp)
+	    pa_mmap_zones[i] = NULL;
+    pa_mmap_zlock_release();
+
+    if (zp->pmz_fd >= 0)
+	close(zp->pmz_fd);
+
+    psu_free(zp->pmz_state);
+    psu_free(zp->pmz_index);
+    psu_free(zp->pmz_filename);
+    psu_free(zp);
+}
+
+/*
+ * Open a compressed file and read its index, returning the length
+ * of the segment it holds.  If the file doesn't exist, we'll create
+ * it at the first checkpoint.
+ */
+static pa_mmap_zone_t *
+pa_mmap_zopen (const char *filename, const char *base,
+	       pa_mmap_flags_t flags, unsigned mode, unsigned *lenp)
+{
+    pa_mmap_zone_t *zp;
+    pa_mmap_zheader_t zh;
+    struct stat st;
+    size_t size;
+    uint32_t i;
+
+    if (sysconf(_SC_PAGESIZE) != PA_MMAP_ATOM_SIZE) {
+	pa_warning(0, "compressed files need %d byte pages",
+		   (int) PA_MMAP_ATOM_SIZE);
+	return NULL;
+    }
+
+    zp = psu_calloc(sizeof(*zp));
+    if (zp == NULL)
+	return NULL;
+
+    zp->pmz_filename = strdup(filename);
+    zp->pmz_mode = mode;
+    zp->pmz_read_only = (flags & PMF_READ_ONLY) ? TRUE : FALSE;
+    zp->pmz_fd = open(filename, O_RDONLY);
+
+    if (zp->pmz_fd < 0) {
+	if (errno != ENOENT || zp->pmz_read_only) {
+	    pa_warning(errno, "could not open file: '%s'", filename);
+	    goto fail;
+	}
+
+	*lenp = pa_config_value32(base, "size", PA_DEFAULT_SIZE);
+	return zp;
+    }
+
+    if (fstat(zp->pmz_fd, &st) < 0
+	    || pread(zp->pmz_fd, &zh, sizeof(zh), 0) != sizeof(zh)) {
+	pa_warning(errno, "could not read file: '%s'", filename);
+	goto fail;
+    }
+
+    if (zh.pzh_magic != PA_ZMAGIC_NUMBER || zh.pzh_vers != PA_ZVERS
+	    || zh.pzh_shift != PA_MMAP_ATOM_SHIFT || zh.pzh_pages == 0) {
+	pa_warning(0, "not a compressed file (or wrong version): '%s'",
+		   filename);
+	goto fail;
+    }
+
+    size = zh.pzh_pages * sizeof(*zp->pmz_index);
+    zp->pmz_index = psu_calloc(size);
+    if (zp->pmz_index == NULL)
+	goto fail;
+
+    if (pread(zp->pmz_fd, zp->pmz_index, size, sizeof(zh)) != (ssize_t) size) {
+	pa_warning(errno, "could not read index: '%s'", filename);
+	goto fail;
+    }
+
+    for (i = 0; i < zh.pzh_pages; i++) {
+	pa_mmap_zindex_t *zip = &zp->pmz_index[i];
+
+	if (zip->pzi_len > PA_MMAP_ATOM_SIZE
+		|| zip->pzi_offset + zip->pzi_len > (uint64_t) st.st_size) {
+	    pa_warning(0, "corrupt index entry %u: '%s'", i, filename);
+	    goto fail;
+	}
+    }
+
+    zp->pmz_pages = zh.pzh_pages;
+    zp->pmz_file_len = st.st_size;
+    *lenp = zh.pzh_pages << PA_MMAP_ATOM_SHIFT;
+
+    return zp;
+
+ fail:
+    pa_mmap_zclose(zp);
+    return NULL;
+}
+
+/*
+ * Hook a zone up to its freshly mapped segment and start handling
+ * its faults.  A new file's pages start out dirty.
+ */
+static int
+pa_mmap_zattach (pa_mmap_zone_t *zp, psu_byte_t *addr, size_t len)
+{
+    struct sigaction sa;
+    int i, rc = -1;
+
+    zp->pmz_addr = addr;
+    zp->pmz_npages = len >> PA_MMAP_ATOM_SHIFT;
+    zp->pmz_state = psu_calloc(zp->pmz_npages);
+    if (zp->pmz_state == NULL)
+	return -1;
+
+    if (zp->pmz_index == NULL)
+	memset(zp->pmz_state, PZS_DIRTY, zp->pmz_npages);
+
+    pa_mmap_zlock_acquire();
+
+    for (i = 0; i < PA_ZONE_MAX; i++)
+	if (pa_mmap_zones[i] == NULL)
+	    break;
+
+    if (i == PA_ZONE_MAX) {
+	pa_warning(0, "too many compressed files open");
+	goto done;
+    }
+
+    if (!pa_mmap_zinstalled) {
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = pa_mmap_zfault;
+	sa.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+
+	if (sigaction(SIGSEGV, &sa, &pa_mmap_zold) < 0) {
+	    pa_warning(errno, "could not install fault handler");
+	    goto done;
+	}
+
+	pa_mmap_zinstalled = TRUE;
+    }
+
+    pa_mmap_zones[i] = zp;
+    rc = 0;
+
+ done:
+    pa_mmap_zlock_release();
+    return rc;
+}
+
+/*
+ * Record pages added by pa_mmap_grow; they start out dirty
+ */
+static int
+pa_mmap_zgrow (pa_mmap_zone_t *zp, size_t new_len)
+{
+    uint32_t npages = new_len >> PA_MMAP_ATOM_SHIFT;
+    uint8_t *state;
+    int rc = -1;
+
+    pa_mmap_zlock_acquire();
+
+    state = psu_realloc(zp->pmz_state, npages);
+    if (state) {
+	memset(state + zp->pmz_npages, PZS_DIRTY, npages - zp->pmz_npages);
+	zp->pmz_state = state;
+	zp->pmz_npages = npages;
+	rc = 0;
+    }
+
+    pa_mmap_zlock_release();
+    return rc;
+}
+
+/*
+ * Parse a list of NUMA nodes, in the kernel's format ("0-3,6").
+ * Returns 0 on success.
+ */
+int
+pa_numa_parse (const char *list, pa_numa_mask_t *maskp)
+{
+    pa_numa_mask_t mask = 0;
+    unsigned long first, last;
+    char *ep;
+
+    while (*list != '\0' && *list != '\n') {
+	first = strtoul(list, &ep, 10);
+	if (ep == list)
+	    return -1;
+
+	last = first;
+	if (*ep == '-') {
+	    list = ep + 1;
+	    last = strtoul(list, &ep, 10);
+	    if (ep == list)
+		return -1;
+	}
+
+	if (last < first || last >= PA_NUMA_MAX_NODES)
+	    return -1;
+
+	for (; first <= last; first++)
+	    mask |= ((pa_numa_mask_t) 1) << first;
+
+	list = ep;
+	if (*list == ',')
+	    list += 1;
+    }
+
+    *maskp = mask;
+    return 0;
+}
+
+/*
+ * Find the set of online NUMA nodes.  Systems without NUMA (or
+ * without a way to tell) have just node zero.
+ */
+int
+pa_numa_online (pa_numa_mask_t *maskp)
+{
+    char buf[256];
+    FILE *fp;
+    int rc = -1;
+
+    fp = fopen("/sys/devices/system/node/online", "r");
+    if (fp) {
+	if (fgets(buf, sizeof(buf), fp))
+	    rc = pa_numa_parse(buf, maskp);
+	fclose(fp);
+    }
+
+    if (rc < 0)
+	*maskp = 1;
+
+    return 0;
+}
+
+/*
+ * Set the NUMA policy for a segment.  It's applied to the memory we
+ * have now (migrating pages already placed) and to every later
+ * growth.
+ */
+int
+pa_mmap_numa_set (pa_mmap_t *pmp, unsigned policy, pa_numa_mask_t nodes)
+{
+    if (policy != PA_NUMA_DEFAULT && nodes == 0)
+	pa_numa_online(&nodes);
+
+    pmp->pm_numa_policy = policy;
+    pmp->pm_numa_nodes = nodes;
+
+    return pa_mmap_mbind(pmp->pm_addr, pmp->pm_len, policy, nodes, TRUE);
+}
+
+/*
+ * Set the NUMA policy for a range of a segment, such as the pages
+ * of one pool, overriding the segment's policy for those pages.
+ */
+int
+pa_mmap_numa_range (pa_mmap_t *pmp, pa_mmap_atom_t atom, size_t size,
+		    unsigned policy, pa_numa_mask_t nodes)
+{
+    if (policy != PA_NUMA_DEFAULT && nodes == 0)
+	pa_numa_online(&nodes);
+
+    size = pa_roundup32(size, PA_MMAP_ATOM_SIZE);
+
+    return pa_mmap_mbind(pa_mmap_addr(pmp, atom), size, policy, nodes, TRUE);
+}
+
+/*
+ * Apply the NUMA policy from our config, if any: "<base>.numa-policy"
+ * is one of "bind", "interleave", "preferred", or "default", and
+ * "<base>.numa-nodes" is the node list (defaulting to all nodes).
+ */
+static void
+pa_mmap_numa_config (pa_mmap_t *pmp, const char *base)
+{
+    const char *cp = pa_config_value(base, "numa-policy");
+    pa_numa_mask_t nodes = 0;
+    unsigned policy;
+
+    if (cp == NULL)
+	return;
+
+    if (strcmp(cp, "bind") == 0)
+	policy = PA_NUMA_BIND;
+    else if (strcmp(cp, "interleave") == 0)
+	policy = PA_NUMA_INTERLEAVE;
+    else if (strcmp(cp, "preferred") == 0)
+	policy = PA_NUMA_PREFERRED;
+    else if (strcmp(cp, "default") == 0)
+	return;
+    else {
+	pa_warning(0, "unknown numa policy for '%s': '%s'", base, cp);
+	return;
+    }
+
+    cp = pa_config_value(base, "numa-nodes");
+    if (cp && pa_numa_parse(cp, &nodes) < 0) {
+	pa_warning(0, "invalid numa node list for '%s': '%s'", base, cp);
+	return;
+    }
+
+    pa_mmap_numa_set(pmp, policy, nodes);
+}
+
 pa_mmap_t *
 pa_mmap_open (const char *filename, const char *base,
 	      pa_mmap_flags_t flags, unsigned mode)
@@ -273,6 +906,8 @@ pa_mmap_open (const char *filename, const char *base,
     int created = 0;
     unsigned len = 0;
     psu_byte_t *addr = NULL;
+    pa_mmap_zone_t *zp = NULL;
+    int map_prot;
 
     if (flags & PMF_READ_ONLY) {
 	prot = PROT_READ;
@@ -281,7 +916,20 @@ pa_mmap_open (const char *filename, const char *base,
 	oflags = O_RDWR;
     }
 
-    if (filename) {
+    if (filename && (flags & PMF_COMPRESSED)) {
+	if (mode == 0)
+	    mode = pa_config_value32(base, "perm", 0644);
+
+	/* The file is read a page at a time, into anonymous memory */
+	zp = pa_mmap_zopen(filename, base, flags, mode, &len);
+	if (zp == NULL)
+	    goto fail;
+
+	fd = -1;
+	mmap_flags |= MAP_ANON;
+	created = (zp->pmz_index == NULL);
+
+    } else if (filename) {
 	if (mode == 0)
 	    mode = pa_config_value32(base, "perm", 0644);
 
@@ -326,31 +974,15 @@ pa_mmap_open (const char *filename, const char *base,
 	created = 1;
     }
 
-    for (;;) {
-	if (pa_mmap_next_address > (psu_byte_t *) PA_ADDR_MAX)
-	    goto fail;
-
-	addr = mmap(pa_mmap_next_address, len, prot, mmap_flags | MAP_SHARED,
-		    fd, 0);
-	if (addr == pa_mmap_next_address) /* Success */
-	    break;
-
-	if (addr == NULL || addr == MAP_FAILED) {
-	    pa_warning(errno, "mmap failed (%p.vs.%p)",
-		       addr, pa_mmap_next_address);
-	    if (errno != EINVAL)
-		goto fail;
+    /* Compressed pages are inaccessible until they are loaded */
+    map_prot = (zp && !created) ? PROT_NONE : prot;
 
-	    pa_mmap_next_address += pa_mmap_incr_address;
-	    continue;
-	} else if (addr != pa_mmap_next_address) {
-	    pa_warning(errno, "mmap returns wrong address (%p.vs.%p)",
-		       addr, pa_mmap_next_address);
-	    goto fail;
-	}
-    }
+    addr = pa_mmap_map(len, map_prot, mmap_flags, fd);
+    if (addr == NULL)
+	goto fail;
 
-    pa_mmap_next_address += pa_mmap_incr_address;
+    if (zp && pa_mmap_zattach(zp, addr, len) < 0)
+	goto fail;
 
     pmip = (void *) addr;
     if (created) {
@@ -415,6 +1047,9 @@ pa_mmap_open (const char *filename, const char *base,
     pmp->pm_infop = pmip;
     pmp->pm_mmap_flags = mmap_flags;
     pmp->pm_mmap_prot = prot;
+    pmp->pm_zone = zp;
+
+    pa_mmap_numa_config(pmp, base);
 
     if (fd < 0) {
 	pa_mmap_record_t *pmrp = psu_calloc(sizeof(*pmrp));
@@ -428,6 +1063,8 @@ pa_mmap_open (const char *filename, const char *base,
     return pmp;
 
  fail:
+    if (zp != NULL)
+	pa_mmap_zclose(zp);
     if (addr != NULL)
 	munmap(addr, len);
     if (fd > 0)
@@ -442,6 +1079,12 @@ pa_mmap_open (const char *filename, const char *base,
 void
 pa_mmap_close (pa_mmap_t *pmp)
 {
+    if (pmp->pm_zone) {
+	if (!(pmp->pm_flags & PMF_READ_ONLY))
+	    pa_mmap_checkpoint(pmp);
+	pa_mmap_zclose(pmp->pm_zone);
+    }
+
     if (pmp->pm_record) {
 	pa_mmap_record_t *pmrp = pmp->pm_record, *nextp;
 	for (; pmrp; pmrp = nextp) {
@@ -460,6 +1103,420 @@ pa_mmap_close (pa_mmap_t *pmp)
     psu_free(pmp);
 }
 
+/*
+ * Copy the pages of "src" that differ from "dst", returning the number
+ * copied.  Page zero holds the segment header and the allocators'
+ * headers, so we write it last, after the pages they describe.
+ */
+static int
+pa_mmap_copy_pages (psu_byte_t *dst, const psu_byte_t *src, size_t len)
+{
+    size_t off;
+    int count = 0;
+
+    for (off = len; off > 0; off -= PA_MMAP_ATOM_SIZE) {
+	if (memcmp(dst + off - PA_MMAP_ATOM_SIZE, src + off - PA_MMAP_ATOM_SIZE,
+		   PA_MMAP_ATOM_SIZE) != 0) {
+	    memcpy(dst + off - PA_MMAP_ATOM_SIZE,
+		   src + off - PA_MMAP_ATOM_SIZE, PA_MMAP_ATOM_SIZE);
+	    count += 1;
+	}
+    }
+
+    return count;
+}
+
+/*
+ * Make a copy-on-write snapshot of a file-backed segment.  The file
+ * is mapped MAP_PRIVATE at a fresh address, so the snapshot shares
+ * every page with the original until it writes that page.  Growth
+ * comes from private anonymous memory, leaving the file untouched.
+ * Since all our data is addressed by atoms (offsets), the caller can
+ * open the same named allocators on the snapshot.
+ *
+ * Changes made to the original while a snapshot is open may be seen
+ * in the snapshot's unwritten pages, so the original must be treated
+ * as read-only until the snapshot is merged or discarded.
+ */
+pa_mmap_t *
+pa_mmap_snapshot (pa_mmap_t *pmp)
+{
+    int prot = PROT_READ | PROT_WRITE;
+    psu_byte_t *addr;
+    pa_mmap_t *snap;
+
+    if (pmp->pm_fd <= 0) {
+	pa_warning(0, "snapshot requires a file-backed segment");
+	return NULL;
+    }
+
+    addr = pa_mmap_map(pmp->pm_len, prot,
+		       MAP_PRIVATE | MAP_FIXED | MAP_FILE, pmp->pm_fd);
+    if (addr == NULL)
+	return NULL;
+
+    snap = psu_calloc(sizeof(*snap));
+    if (snap == NULL) {
+	pa_warning(errno, "could not allocate memory for pa_mmap_t");
+	munmap(addr, pmp->pm_len);
+	return NULL;
+    }
+
+    snap->pm_fd = -1;
+    snap->pm_addr = addr;
+    snap->pm_len = pmp->pm_len;
+    snap->pm_flags = PMF_SNAPSHOT;
+    snap->pm_infop = (void *) addr;
+    snap->pm_mmap_flags = MAP_PRIVATE | MAP_ANON;
+    snap->pm_mmap_prot = prot;
+    snap->pm_parent = pmp;
+
+    snap->pm_record = psu_calloc(sizeof(*snap->pm_record));
+    if (snap->pm_record == NULL) {
+	psu_free(snap);
+	munmap(addr, pmp->pm_len);
+	return NULL;
+    }
+
+    snap->pm_record->pmr_addr = addr;
+    snap->pm_record->pmr_len = pmp->pm_len;
+
+    return snap;
+}
+
+/*
+ * Write a snapshot's changes back into the segment it was taken from,
+ * then close the snapshot.  We compare page by page and copy only the
+ * pages that differ, so the original's untouched pages stay clean.
+ * Returns the number of pages written, or -1 on failure (in which
+ * case the snapshot is left open).  To discard a snapshot instead,
+ * just close it.
+ */
+int
+pa_mmap_snapshot_merge (pa_mmap_t *snap)
+{
+    pa_mmap_t *pmp = snap->pm_parent;
+    int count;
+
+    if (!(snap->pm_flags & PMF_SNAPSHOT) || pmp == NULL) {
+	pa_warning(0, "merge requires a snapshot");
+	return -1;
+    }
+
+    if (pmp->pm_flags & PMF_READ_ONLY) {
+	pa_warning(0, "cannot merge into a read-only segment");
+	return -1;
+    }
+
+    if (snap->pm_len > pmp->pm_len) {
+	if (pa_mmap_grow(pmp, snap->pm_len) < 0)
+	    return -1;
+	pmp->pm_len = snap->pm_len;
+    }
+
+    count = pa_mmap_copy_pages(pmp->pm_addr, snap->pm_addr, snap->pm_len);
+
+    pa_mmap_close(snap);
+
+    return count;
+}
+
+/*
+ * Make a copy of a segment whose memory is bound to one NUMA
+ * node, so readers running on that node can open the same named
+ * pools on it and never leave their node.  Use it for read-mostly
+ * data, such as a name pool and its index; pa_mmap_replica_sync
+ * brings it up to date after the original changes.  The replica
+ * stays writable, since opening a pool rewrites its info block,
+ * but nothing should change it: a sync puts back any page that
+ * differs from the original.  Without NUMA support, the copy is
+ * left unbound.
+ */
+pa_mmap_t *
+pa_mmap_replica (pa_mmap_t *pmp, unsigned node)
+{
+    psu_byte_t *addr;
+    pa_mmap_t *rep;
+
+    if (node >= PA_NUMA_MAX_NODES) {
+	pa_warning(0, "invalid numa node: %u", node);
+	return NULL;
+    }
+
+    addr = pa_mmap_map(pmp->pm_len, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1);
+    if (addr == NULL)
+	return NULL;
+
+    rep = psu_calloc(sizeof(*rep));
+    if (rep == NULL)
+	goto fail;
+
+    rep->pm_record = psu_calloc(sizeof(*rep->pm_record));
+    if (rep->pm_record == NULL)
+	goto fail;
+
+    rep->pm_fd = -1;
+    rep->pm_addr = addr;
+    rep->pm_len = pmp->pm_len;
+    rep->pm_flags = PMF_READ_ONLY | PMF_REPLICA;
+    rep->pm_infop = (void *) addr;
+    rep->pm_mmap_flags = MAP_PRIVATE | MAP_ANON;
+    rep->pm_mmap_prot = PROT_READ | PROT_WRITE;
+    rep->pm_parent = pmp;
+    rep->pm_record->pmr_addr = addr;
+    rep->pm_record->pmr_len = pmp->pm_len;
+
+    /*
+     * Bind before the copy touches (and so places) the pages.  If
+     * we can't (no NUMA support here), an unbound copy still works;
+     * it just isn't any closer to its readers.
+     */
+    rep->pm_numa_policy = PA_NUMA_BIND;
+    rep->pm_numa_nodes = ((pa_numa_mask_t) 1) << node;
+    if (pa_mmap_mbind(addr, rep->pm_len, rep->pm_numa_policy,
+		      rep->pm_numa_nodes, FALSE) < 0) {
+	pa_warning(0, "replica is not bound to numa node %u", node);
+	rep->pm_numa_policy = PA_NUMA_DEFAULT;
+	rep->pm_numa_nodes = 0;
+    }
+
+    memcpy(addr, pmp->pm_addr, rep->pm_len);
+
+    return rep;
+
+ fail:
+    if (rep) {
+	psu_free(rep->pm_record);
+	psu_free(rep);
+    }
+    munmap(addr, pmp->pm_len);
+    return NULL;
+}
+
+/*
+ * Bring a replica up to date with its original, copying the pages
+ * that differ.  Returns the number of pages copied, or -1.  Readers
+ * must not be using the replica while it's synced.
+ */
+int
+pa_mmap_replica_sync (pa_mmap_t *rep)
+{
+    pa_mmap_t *pmp = rep->pm_parent;
+
+    if (!(rep->pm_flags & PMF_REPLICA) || pmp == NULL) {
+	pa_warning(0, "sync requires a replica");
+	return -1;
+    }
+
+    if (pmp->pm_len > rep->pm_len) {
+	if (pa_mmap_grow(rep, pmp->pm_len) < 0)
+	    return -1;
+	rep->pm_len = pmp->pm_len;
+    }
+
+    return pa_mmap_copy_pages(rep->pm_addr, pmp->pm_addr, rep->pm_len);
+}
+
+static psu_boolean_t
+pa_mmap_zero_page (const psu_byte_t *cp)
+{
+    const uint64_t *lp = (const uint64_t *) cp;
+    unsigned i;
+
+    for (i = 0; i < PA_MMAP_ATOM_SIZE / sizeof(*lp); i++)
+	if (lp[i] != 0)
+	    return FALSE;
+
+    return TRUE;
+}
+
+/*
+ * Write a compressed segment back to its file.  We build a new file
+ * beside the old one and rename it into place, so a failure leaves
+ * the old file intact.  Cold pages are copied from the old file
+ * without decompressing them.  Afterwards, dirty pages are clean
+ * again.
+ */
+static int
+pa_mmap_zwrite (pa_mmap_t *pmp)
+{
+    pa_mmap_zone_t *zp = pmp->pm_zone;
+    uint32_t pages = pmp->pm_len >> PA_MMAP_ATOM_SHIFT;
+    pa_mmap_zheader_t zh;
+    pa_mmap_zindex_t *index = NULL, *zip;
+    psu_byte_t *buf = NULL, *pagep, *datap;
+    char *tmpname = NULL;
+    uint64_t off;
+    uint32_t i, len;
+    int fd = -1;
+
+    if (zp->pmz_read_only) {
+	pa_warning(0, "cannot checkpoint a read-only file");
+	return -1;
+    }
+
+    tmpname = psu_calloc(strlen(zp->pmz_filename) + sizeof(".tmp"));
+    index = psu_calloc(pages * sizeof(*index));
+    buf = psu_calloc(PA_MMAP_ATOM_SIZE);
+    if (tmpname == NULL || index == NULL || buf == NULL)
+	goto fail;
+
+    strcpy(tmpname, zp->pmz_filename);
+    strcat(tmpname, ".tmp");
+
+    fd = open(tmpname, O_CREAT | O_TRUNC | O_RDWR, zp->pmz_mode);
+    if (fd < 0) {
+	pa_warning(errno, "could not create file: '%s'", tmpname);
+	goto fail;
+    }
+
+    off = sizeof(zh) + pages * sizeof(*index);
+
+    for (i = 0; i < pages; i++) {
+	pagep = pmp->pm_addr + ((size_t) i << PA_MMAP_ATOM_SHIFT);
+	zip = &index[i];
+
+	if (zp->pmz_state[i] == PZS_COLD) {
+	    /* Copy the block as-is; touching the page would load it */
+	    len = (i < zp->pmz_pages) ? zp->pmz_index[i].pzi_len : 0;
+	    if (len != 0 && pread(zp->pmz_fd, buf, len,
+			zp->pmz_index[i].pzi_offset) != (ssize_t) len) {
+		pa_warning(errno, "could not read page %u", i);
+		goto fail;
+	    }
+	    datap = buf;
+
+	} else if (pa_mmap_zero_page(pagep)) {
+	    len = 0;
+	    datap = NULL;
+
+	} else {
+	    len = pa_lz_compress(pagep, PA_MMAP_ATOM_SIZE,
+				 buf, PA_MMAP_ATOM_SIZE - 1);
+	    datap = buf;
+	    if (len == 0) {	/* Didn't compress; store it raw */
+		len = PA_MMAP_ATOM_SIZE;
+		datap = pagep;
+	    }
+	}
+
+	if (len == 0)
+	    continue;
+
+	if (pwrite(fd, datap, len, off) != (ssize_t) len) {
+	    pa_warning(errno, "could not write page %u", i);
+	    goto fail;
+	}
+
+	zip->pzi_offset = off;
+	zip->pzi_len = len;
+	off += len;
+    }
+
+    memset(&zh, 0, sizeof(zh));
+    zh.pzh_magic = PA_ZMAGIC_NUMBER;
+    zh.pzh_vers = PA_ZVERS;
+    zh.pzh_shift = PA_MMAP_ATOM_SHIFT;
+    zh.pzh_pages = pages;
+
+    if (pwrite(fd, &zh, sizeof(zh), 0) != sizeof(zh)
+	    || pwrite(fd, index, pages * sizeof(*index), sizeof(zh))
+		!= (ssize_t) (pages * sizeof(*index))) {
+	pa_warning(errno, "could not write index");
+	goto fail;
+    }
+
+    /* The new file must be on disk before it replaces the old one */
+    if (fsync(fd) < 0) {
+	pa_warning(errno, "could not sync '%s'", tmpname);
+	goto fail;
+    }
+
+    if (rename(tmpname, zp->pmz_filename) < 0) {
+	pa_warning(errno, "could not rename '%s'", tmpname);
+	goto fail;
+    }
+
+    /* Switch to the new file; cold pages now refer to it */
+    if (zp->pmz_fd >= 0)
+	close(zp->pmz_fd);
+    psu_free(zp->pmz_index);
+
+    zp->pmz_fd = fd;
+    zp->pmz_index = index;
+    zp->pmz_pages = pages;
+    zp->pmz_file_len = off;
+
+    for (i = 0; i < pages; i++) {
+	if (zp->pmz_state[i] == PZS_DIRTY) {
+	    mprotect(pmp->pm_addr + ((size_t) i << PA_MMAP_ATOM_SHIFT),
+		     PA_MMAP_ATOM_SIZE, PROT_READ);
+	    zp->pmz_state[i] = PZS_CLEAN;
+	}
+    }
+
+    psu_free(buf);
+    psu_free(tmpname);
+    return 0;
+
+ fail:
+    if (fd >= 0) {
+	close(fd);
+	unlink(tmpname);
+    }
+    psu_free(buf);
+    psu_free(index);
+    psu_free(tmpname);
+    return -1;
+}
+
+/*
+ * Make the segment's contents durable.  For a compressed segment,
+ * that means writing it back to its file; for a plain file, it's
+ * an msync.  Memory-only segments have nothing to do.
+ */
+int
+pa_mmap_checkpoint (pa_mmap_t *pmp)
+{
+    if (pmp->pm_zone)
+	return pa_mmap_zwrite(pmp);
+
+    if (pmp->pm_fd > 0 && msync(pmp->pm_addr, pmp->pm_len, MS_SYNC) < 0) {
+	pa_warning(errno, "msync failed");
+	return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Report the number of pages of a compressed segment that are cold
+ * (still only in the file), clean, and dirty, and the length of its
+ * file as of the last checkpoint.
+ */
+void
+pa_mmap_zone_stats (pa_mmap_t *pmp, unsigned *coldp, unsigned *cleanp,
+		    unsigned *dirtyp, size_t *file_lenp)
+{
+    pa_mmap_zone_t *zp = pmp->pm_zone;
+    unsigned count[PZS_DIRTY + 1] = { 0, 0, 0 };
+    uint32_t i;
+
+    if (zp)
+	for (i = 0; i < zp->pmz_npages; i++)
+	    count[zp->pmz_state[i]] += 1;
+
+    if (coldp)
+	*coldp = count[PZS_COLD];
+    if (cleanp)
+	*cleanp = count[PZS_CLEAN];
+    if (dirtyp)
+	*dirtyp = count[PZS_DIRTY];
+    if (file_lenp)
+	*file_lenp = zp ? zp->pmz_file_len : 0;
+}
+
 /*
  * Find or add a header in the first page (page 0) of the mmap file.
  * If 'size' == 0, we don't add it; the caller's just checking.
@@ -541,6 +1598,34 @@ pa_mmap_next_header (pa_mmap_t *pmp, void *header)
     return NULL;
 }
 
+/*
+ * Report the number of segments on the free list and the number of
+ * atoms they hold.  The free list is never coalesced, so a long list
+ * of short segments is a sign of fragmentation.
+ */
+void
+pa_mmap_free_stats (pa_mmap_t *pmp, unsigned *countp, pa_atom_t *atomsp)
+{
+    pa_mmap_atom_t fa;
+    pa_mmap_free_t *pmfp;
+    unsigned count = 0;
+    pa_atom_t atoms = 0;
+
+    for (fa = pmp->pm_infop->pmi_free; !pa_mmap_is_null(fa);
+	 fa = pmfp->pmf_next) {
+	pmfp = pa_mmap_addr(pmp, fa);
+	if (pmfp->pmf_magic != PA_MMAP_FREE_MAGIC)
+	    break;
+	count += 1;
+	atoms += pmfp->pmf_size;
+    }
+
+    if (countp)
+	*countp = count;
+    if (atomsp)
+	*atomsp = atoms;
+}
+
 /**
  * Dump the internal state of a pa_mmap table
  */
@@ -39,6 +39,32 @@ typedef struct pa_mmap_info_s pa_mmap_info_t; /* Opaque type */
 typedef uint32_t pa_mmap_flags_t; /* Flag values */
 /* Flags for pa_mmap_flags_t */
 #define PMF_READ_ONLY	(1<<0)	/* Open read-only */
+#define PMF_SNAPSHOT	(1<<1)	/* Copy-on-write snapshot (pa_mmap_snapshot) */
+#define PMF_COMPRESSED	(1<<2)	/* File holds compressed pages */
+#define PMF_REPLICA	(1<<3)	/* Node-local copy (pa_mmap_replica) */
+
+/*
+ * A compressed segment (PMF_COMPRESSED) is loaded a page at a time by
+ * a SIGSEGV handler, which makes each page accessible as it fills it.
+ * Each compressed segment must be used by one thread at a time (and
+ * so without concurrent pa_pat readers); different segments can be
+ * used from different threads.
+ */
+
+/*
+ * NUMA placement policies for a segment's memory.  By default, pages
+ * land on the node of the thread that first touches them.
+ */
+#define PA_NUMA_DEFAULT		0 /* First touch */
+#define PA_NUMA_BIND		1 /* Only on the given nodes */
+#define PA_NUMA_INTERLEAVE	2 /* Round-robin across the given nodes */
+#define PA_NUMA_PREFERRED	3 /* On the given node, if there's room */
+
+#define PA_NUMA_MAX_NODES	64 /* Bits in pa_numa_mask_t */
+typedef uint64_t pa_numa_mask_t; /* Set of NUMA nodes (bit per node) */
+
+struct pa_mmap_zone_s;
+typedef struct pa_mmap_zone_s pa_mmap_zone_t; /* Opaque type */
 
 /* Record of mmap'd segments */
 typedef struct pa_mmap_record_s {
@@ -60,6 +86,10 @@ typedef struct pa_mmap_s {
     size_t pm_len;		/* Current mapped len */
     pa_mmap_info_t *pm_infop;	/* Mmap segment header */
     pa_mmap_record_t *pm_record; /* Record of mmap'd segments */
+    struct pa_mmap_s *pm_parent; /* Segment we're a snapshot of (or NULL) */
+    pa_mmap_zone_t *pm_zone;	/* Compressed page state (PMF_COMPRESSED) */
+    unsigned pm_numa_policy;	/* NUMA placement policy (PA_NUMA_*) */
+    pa_numa_mask_t pm_numa_nodes; /* Nodes for pm_numa_policy */
 } pa_mmap_t;
 
 static inline void *
@@ -82,6 +112,38 @@ pa_mmap_open (const char *filename, const char *base,
 void
 pa_mmap_close (pa_mmap_t *pmp);
 
+pa_mmap_t *
+pa_mmap_snapshot (pa_mmap_t *pmp);
+
+int
+pa_mmap_snapshot_merge (pa_mmap_t *snap);
+
+int
+pa_mmap_checkpoint (pa_mmap_t *pmp);
+
+void
+pa_mmap_zone_stats (pa_mmap_t *pmp, unsigned *coldp, unsigned *cleanp,
+		    unsigned *dirtyp, size_t *file_lenp);
+
+int
+pa_numa_parse (const char *list, pa_numa_mask_t *maskp);
+
+int
+pa_numa_online (pa_numa_mask_t *maskp);
+
+int
+pa_mmap_numa_set (pa_mmap_t *pmp, unsigned policy, pa_numa_mask_t nodes);
+
+int
+pa_mmap_numa_range (pa_mmap_t *pmp, pa_mmap_atom_t atom, size_t size,
+		    unsigned policy, pa_numa_mask_t nodes);
+
+pa_mmap_t *
+pa_mmap_replica (pa_mmap_t *pmp, unsigned node);
+
+int
+pa_mmap_replica_sync (pa_mmap_t *replica);
+
 void *
 pa_mmap_addr (pa_mmap_t *pmp, pa_mmap_atom_t atom);
 
@@ -92,6 +154,9 @@ pa_mmap_header (pa_mmap_t *pmp, const char *name,
 void *
 pa_mmap_next_header (pa_mmap_t *pmp, void *header);
 
+void
+pa_mmap_free_stats (pa_mmap_t *pmp, unsigned *countp, pa_atom_t *atomsp);
+
 void
 pa_mmap_dump (pa_mmap_t *pmp, psu_boolean_t full);
 
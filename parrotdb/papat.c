@@ -14,7 +14,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stddef.h>
-#include <assert.h>
+#include <sched.h>
 
 #include <parrotdb/pacommon.h>
 #include <parrotdb/paconfig.h>
@@ -141,15 +141,15 @@ static inline pa_pat_atom_t
 pa_pat_search (pa_pat_t *root, uint16_t keylen, const uint8_t *key)
 {
     uint16_t bit = PA_PAT_NOBIT;
-    pa_pat_atom_t atom = root->pp_root;
+    pa_pat_atom_t atom = pa_pat_load(&root->pp_root);
     pa_pat_node_t *node = pa_pat_node(root, atom);
 
-    while (bit < node->ppn_bit) {
+    while (node && bit < node->ppn_bit) {
 	bit = node->ppn_bit;
 	if (bit < keylen && pat_key_test(key, bit)) {
-	    atom = node->ppn_right;
+	    atom = pa_pat_load(&node->ppn_right);
 	} else {
-	    atom = node->ppn_left;
+	    atom = pa_pat_load(&node->ppn_left);
 	}
 	node = pa_pat_node(root, atom);
     }
@@ -197,7 +197,7 @@ pa_pat_find_leftmost (pa_pat_t *root, uint16_t bit, pa_pat_node_t *node)
 {
     while (node && bit < node->ppn_bit) {
 	bit = node->ppn_bit;
-	node = pa_pat_node(root, node->ppn_left);
+	node = pa_pat_node(root, pa_pat_load(&node->ppn_left));
     }
 
     return node;
@@ -212,7 +212,7 @@ pa_pat_find_rightmost (pa_pat_t *root, uint16_t bit, pa_pat_node_t *node)
 {
     while (node && bit < node->ppn_bit) {
 	bit = node->ppn_bit;
-	node = pa_pat_node(root, node->ppn_right);
+	node = pa_pat_node(root, pa_pat_load(&node->ppn_right));
     }
 
     return node;
@@ -233,14 +233,18 @@ pa_pat_root_init (pa_pat_t *root, pa_pat_info_t *ppip, pa_mmap_t *pmp,
 	root = pa_pat_root_alloc();
 
     if (root) {
+	/*
+	 * The info block lives in the mmap header; a fresh one is zero
+	 * (the null atom) and a reopened one keeps its existing tree.
+	 */
 	root->pp_infop = ppip;
-	root->pp_root = pa_pat_null_atom();
 	root->pp_key_bytes = klen;
 
 	root->pp_mmap = pmp;
 	root->pp_nodes = nodes;
 	root->pp_data = data_store;
 	root->pp_key_func = key_func;
+	root->pp_rcu = NULL;
     }
 
     return root;
@@ -286,9 +290,13 @@ pa_pat_open (pa_mmap_t *pmp, const char *name,
     return pa_pat_open_nodes(pmp, namebuf, pfp, data_store, key_func, klen);
 }
 
+static void pa_pat_rcu_free (pa_pat_t *root);
+
 void
 pa_pat_close (pa_pat_t *ppp)
 {
+    if (ppp)
+	pa_pat_rcu_free(ppp);
     pa_pat_root_free(ppp);
 }
 
@@ -374,8 +382,9 @@ pa_pat_add_node (pa_pat_t *root, pa_pat_atom_t atom, pa_pat_node_t *node)
      * leaves greater freedom in the choice of bit formats.
      */
     if (pa_pat_is_null(root->pp_root)) {
-	root->pp_root = node->ppn_left = node->ppn_right = atom;
+	node->ppn_left = node->ppn_right = atom;
 	node->ppn_bit = PA_PAT_NOBIT;
+	pa_pat_store(&root->pp_root, atom);
 	return TRUE;
     }
 
@@ -422,7 +431,9 @@ pa_pat_add_node (pa_pat_t *root, pa_pat_atom_t atom, pa_pat_node_t *node)
     }
 
     /*
-     * This is our insertion point.  Do the deed.
+     * This is our insertion point.  Do the deed.  The node is
+     * complete before the store that links it in, so readers see
+     * either the old tree or the new one.
      */
     node->ppn_bit = diff_bit;
     if (pat_key_test(key, diff_bit)) {
@@ -433,7 +444,7 @@ pa_pat_add_node (pa_pat_t *root, pa_pat_atom_t atom, pa_pat_node_t *node)
 	node->ppn_left = atom;
     }
 
-    *ptr = atom;
+    pa_pat_store(ptr, atom);
     return TRUE;
 }
 
@@ -451,6 +462,24 @@ pa_pat_add (pa_pat_t *root, pa_pat_data_atom_t datom, uint16_t key_bytes)
     return pa_pat_add_node(root, atom, node);
 }
 
+/*
+ * Run a walk of the tree for a reader.  With concurrent readers
+ * enabled, a walk that overlapped a delete may have seen half-rewired
+ * nodes, so we redo it.  Additions never force a retry.
+ */
+#define PA_PAT_READ(_root, _res, _walk)					\
+    do {								\
+	uint32_t _seq;							\
+	if ((_root)->pp_rcu == NULL) {					\
+	    _res = _walk;						\
+	    break;							\
+	}								\
+	do {								\
+	    _seq = pa_pat_read_begin(_root);				\
+	    _res = _walk;						\
+	} while (pa_pat_read_retry(_root, _seq));			\
+    } while (0)
+
 /*
  * pa_pat_get()
  * Given a key and its length, find a node which matches.
@@ -458,29 +487,224 @@ pa_pat_add (pa_pat_t *root, pa_pat_data_atom_t datom, uint16_t key_bytes)
 pa_pat_node_t *
 pa_pat_get (pa_pat_t *root, uint16_t key_bytes, const void *key)
 {
-    return pa_pat_get_inline(root, key_bytes, key);
+    pa_pat_node_t *node;
+
+    PA_PAT_READ(root, node, pa_pat_get_inline(root, key_bytes, key));
+    return node;
+}
+
+/*
+ * pa_pat_rcu_init()
+ * Turn on concurrent readers (see papat.h for the rules).
+ */
+psu_boolean_t
+pa_pat_rcu_init (pa_pat_t *root, unsigned max_readers)
+{
+    pa_pat_rcu_t *prcp;
+    void *readers;
+
+    if (root->pp_rcu)
+	return TRUE;
+
+    if (max_readers == 0)
+	max_readers = 1;
+
+    prcp = psu_calloc(sizeof(*prcp));
+    if (prcp == NULL)
+	return FALSE;
+
+    if (posix_memalign(&readers, PA_PAT_CACHE_LINE,
+		       max_readers * sizeof(pa_pat_reader_t)) != 0) {
+	psu_free(prcp);
+	return FALSE;
+    }
+
+    bzero(readers, max_readers * sizeof(pa_pat_reader_t));
+
+    prcp->prc_epoch = 1;	/* Zero means "not reading" */
+    prcp->prc_max_readers = max_readers;
+    prcp->prc_readers = readers;
+
+    __atomic_store_n(&root->pp_rcu, prcp, __ATOMIC_RELEASE);
+    return TRUE;
+}
+
+int
+pa_pat_read_register (pa_pat_t *root)
+{
+    pa_pat_rcu_t *prcp = root->pp_rcu;
+    uint32_t slot;
+
+    if (prcp == NULL)
+	return -1;
+
+    slot = __atomic_fetch_add(&prcp->prc_num_readers, 1, __ATOMIC_RELAXED);
+    if (slot >= prcp->prc_max_readers)
+	return -1;
+
+    return slot;
+}
+
+/*
+ * Free retired nodes that no reader can still be looking at.  A node
+ * unlinked in epoch E is safe once every reader is either outside or
+ * entered in a later epoch, since those readers read the tree after
+ * the unlink.
+ */
+static void
+pa_pat_rcu_reclaim (pa_pat_t *root)
+{
+    pa_pat_rcu_t *prcp = root->pp_rcu;
+    uint64_t oldest = UINT64_MAX, epoch;
+    uint32_t i, kept;
+
+    if (prcp->prc_num_retired == 0)
+	return;
+
+    /* Pairs with the fence in pa_pat_read_enter() */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    for (i = 0; i < prcp->prc_max_readers; i++) {
+	epoch = __atomic_load_n(&prcp->prc_readers[i].ppr_epoch,
+				__ATOMIC_ACQUIRE);
+	if (epoch != 0 && epoch < oldest)
+	    oldest = epoch;
+    }
+
+    for (i = kept = 0; i < prcp->prc_num_retired; i++) {
+	if (prcp->prc_retired[i].ppt_epoch < oldest)
+	    pa_fixed_free_atom(root->pp_nodes,
+			       pa_pat_to_fixed(prcp->prc_retired[i].ppt_atom));
+	else
+	    prcp->prc_retired[kept++] = prcp->prc_retired[i];
+    }
+
+    prcp->prc_num_retired = kept;
+}
+
+void
+pa_pat_rcu_synchronize (pa_pat_t *root)
+{
+    pa_pat_rcu_t *prcp = root->pp_rcu;
+    uint64_t target, epoch;
+    uint32_t i;
+
+    if (prcp == NULL)
+	return;
+
+    target = __atomic_add_fetch(&prcp->prc_epoch, 1, __ATOMIC_SEQ_CST);
+
+    for (i = 0; i < prcp->prc_max_readers; i++) {
+	for (;;) {
+	    epoch = __atomic_load_n(&prcp->prc_readers[i].ppr_epoch,
+				    __ATOMIC_ACQUIRE);
+	    if (epoch == 0 || epoch >= target)
+		break;
+	    sched_yield();
+	}
+    }
+
+    pa_pat_rcu_reclaim(root);
+}
+
+static void
+pa_pat_rcu_free (pa_pat_t *root)
+{
+    pa_pat_rcu_t *prcp = root->pp_rcu;
+    uint32_t i;
+
+    if (prcp == NULL)
+	return;
+
+    /* No readers are left by now, so everything can go */
+    for (i = 0; i < prcp->prc_num_retired; i++)
+	pa_fixed_free_atom(root->pp_nodes,
+			   pa_pat_to_fixed(prcp->prc_retired[i].ppt_atom));
+
+    psu_free(prcp->prc_retired);
+    free(prcp->prc_readers);
+    psu_free(prcp);
+    root->pp_rcu = NULL;
+}
+
+/*
+ * Free a node that's been unlinked from the tree, or queue it until
+ * readers are done with it.
+ */
+static void
+pa_pat_node_retire (pa_pat_t *root, pa_pat_atom_t atom)
+{
+    pa_pat_rcu_t *prcp = root->pp_rcu;
+    pa_pat_retired_t *retired;
+    uint32_t max;
+
+    if (prcp == NULL) {
+	pa_fixed_free_atom(root->pp_nodes, pa_pat_to_fixed(atom));
+	return;
+    }
+
+    if (prcp->prc_num_retired == prcp->prc_max_retired) {
+	max = prcp->prc_max_retired ? prcp->prc_max_retired * 2 : 64;
+	retired = psu_realloc(prcp->prc_retired, max * sizeof(*retired));
+	if (retired == NULL) {
+	    /* Better to wait for readers than to leak the node */
+	    pa_pat_rcu_synchronize(root);
+	    pa_fixed_free_atom(root->pp_nodes, pa_pat_to_fixed(atom));
+	    return;
+	}
+
+	prcp->prc_retired = retired;
+	prcp->prc_max_retired = max;
+    }
+
+    retired = &prcp->prc_retired[prcp->prc_num_retired++];
+    retired->ppt_atom = atom;
+    retired->ppt_epoch = __atomic_fetch_add(&prcp->prc_epoch, 1,
+					    __ATOMIC_SEQ_CST);
+
+    pa_pat_rcu_reclaim(root);
+}
+
+/*
+ * Bracket the in-place rewiring done by pa_pat_delete(), so
+ * concurrent readers know to retry.
+ */
+static inline void
+pa_pat_write_begin (pa_pat_t *root)
+{
+    pa_pat_rcu_t *prcp = root->pp_rcu;
+
+    if (prcp) {
+	__atomic_store_n(&prcp->prc_seq, prcp->prc_seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+}
+
+static inline void
+pa_pat_write_end (pa_pat_t *root)
+{
+    pa_pat_rcu_t *prcp = root->pp_rcu;
+
+    if (prcp)
+	__atomic_store_n(&prcp->prc_seq, prcp->prc_seq + 1, __ATOMIC_RELEASE);
 }
 
-#ifdef NOT_YET
 /*
  * pa_pat_delete()
  * Delete a node from a patricia tree.
  */
 psu_boolean_t
-pa_pat_delete_node (pa_pat_t *root, pa_atom_t atom)
+pa_pat_delete (pa_pat_t *root, pa_pat_node_t *node)
 {
     uint16_t bit;
     const uint8_t *key;
-    pa_atom_t *downptr, *upptr, *parent, current;
-    pa_pat_node_t *node = pa_pat_node(root, atom);
+    pa_pat_atom_t *downptr, *upptr, *parent, current, up;
+    pa_pat_node_t *cur_node, *up_node;
 
     /*
      * Is there even a tree?  Is the node in a tree?
      */
-    assert(node->ppn_left && node->ppn_right);
-
-    current = root->pp_root;
-    if (!current)
+    if (node == NULL || pa_pat_is_null(root->pp_root))
 	return FALSE;
 
     /*
@@ -495,37 +719,42 @@ pa_pat_delete_node (pa_pat_t *root, pa_atom_t atom)
      */
     downptr = upptr = NULL;
     parent = &root->pp_root;
+    current = root->pp_root;
+    cur_node = pa_pat_node(root, current);
     bit = PA_PAT_NOBIT;
     key = pa_pat_key(root, node);
 
-    while (bit < current->ppn_bit) {
-	bit = current->ppn_bit;
-	if (current == node) {
+    while (cur_node && bit < cur_node->ppn_bit) {
+	bit = cur_node->ppn_bit;
+	if (cur_node == node)
 	    downptr = parent;
-	}
 	upptr = parent;
 	if (bit < node->ppn_length && pat_key_test(key, bit)) {
-	    parent = &current->ppn_right;
+	    parent = &cur_node->ppn_right;
 	} else {
-	    parent = &current->ppn_left;
+	    parent = &cur_node->ppn_left;
 	}
 	current = *parent;
+	cur_node = pa_pat_node(root, current);
     }
 
     /*
      * If the guy we found, `current', is not our node then it isn't
      * in the tree.
      */
-    if (current != node)
+    if (cur_node != node)
 	return FALSE;
 
+    pa_pat_write_begin(root);
+
     /*
      * If there's no upptr we're the only thing in the tree.
      * Otherwise we'll need to work a bit.
      */
     if (upptr == NULL) {
 	assert(node->ppn_bit == PA_PAT_NOBIT);
-	root->pp_root = NULL;
+	pa_pat_store(&root->pp_root, pa_pat_null_atom());
+
     } else {
 	/*
 	 * One pointer in the node upptr points at points at us,
@@ -536,50 +765,51 @@ pa_pat_delete_node (pa_pat_t *root, pa_atom_t atom)
 	 * we're trying to remove, in which case we're all done.  If
 	 * not, however, we'll catch that below.
 	 */
-	current = *upptr;
-	if (parent == &current->ppn_left) {
-	    *upptr = current->ppn_right;
+	up = *upptr;
+	up_node = pa_pat_node(root, up);
+	if (parent == &up_node->ppn_left) {
+	    pa_pat_store(upptr, up_node->ppn_right);
 	} else {
-	    *upptr = current->ppn_left;
+	    pa_pat_store(upptr, up_node->ppn_left);
 	}
 
-	if (!downptr) {
+	if (downptr == NULL) {
 	    /*
 	     * We were the no-bit node.  We make our parent the
 	     * no-bit node.
 	     */
 	    assert(node->ppn_bit == PA_PAT_NOBIT);
-	    current->ppn_left = current->ppn_right = current;
-	    current->ppn_bit = PA_PAT_NOBIT;
+	    pa_pat_store(&up_node->ppn_left, up);
+	    pa_pat_store(&up_node->ppn_right, up);
+	    up_node->ppn_bit = PA_PAT_NOBIT;
 
-	} else if (current != node) {
+	} else if (up_node != node) {
 	    /*
 	     * We were not our own `up node', which means we need to
 	     * remove ourselves from the tree as in internal node.  Replace
-	     * us with `current', which we freed above.
+	     * us with the up node, whose internal spot we just freed.
 	     */
-	    current->ppn_left = node->ppn_left;
-	    current->ppn_right = node->ppn_right;
-	    current->ppn_bit = node->ppn_bit;
-	    *downptr = current;
+	    pa_pat_store(&up_node->ppn_left, node->ppn_left);
+	    pa_pat_store(&up_node->ppn_right, node->ppn_right);
+	    up_node->ppn_bit = node->ppn_bit;
+	    pa_pat_store(downptr, up);
 	}
     }
 
+    pa_pat_write_end(root);
+
     /*
-     * Clean out the node.
+     * Clean out the node, unless readers may still be walking it.
      */
-    node->ppn_left = node->ppn_right = NULL;
-    node->ppn_bit = PA_PAT_NOBIT;
+    if (root->pp_rcu == NULL) {
+	node->ppn_left = node->ppn_right = pa_pat_null_atom();
+	node->ppn_bit = PA_PAT_NOBIT;
+    }
 
+    pa_pat_node_retire(root, current);
     return TRUE;
 }
 
-psu_boolean_t
-pa_pat_delete (pa_pat_t *root, void *key, uint16_t key_bytes)
-{
-}
-#endif /* 0 */
-
 /*
  * pa_pat_find_next()
  * Given a node, find the lexical next node in the tree.  If the
@@ -587,8 +817,8 @@ pa_pat_delete (pa_pat_t *root, void *key, uint16_t key_bytes)
  * Returns NULL if the tree is empty or it falls off the right.  Asserts
  * if the node isn't in the tree.
  */
-pa_pat_node_t *
-pa_pat_find_next (pa_pat_t *root, pa_pat_node_t *node)
+static pa_pat_node_t *
+pa_pat_find_next_walk (pa_pat_t *root, pa_pat_node_t *node)
 {
     uint16_t bit;
     const uint8_t *key;
@@ -597,9 +827,9 @@ pa_pat_find_next (pa_pat_t *root, pa_pat_node_t *node)
     /*
      * If there's nothing in the tree we're done.
      */
-    current = root->pp_root;
+    current = pa_pat_load(&root->pp_root);
     if (pa_pat_is_null(current)) {
-	assert(node == NULL);
+	assert(node == NULL || root->pp_rcu);
 	return NULL;
     }
 
@@ -621,22 +851,27 @@ pa_pat_find_next (pa_pat_t *root, pa_pat_node_t *node)
     while (bit < cur_node->ppn_bit) {
 	bit = cur_node->ppn_bit;
 	if (bit < node->ppn_length && pat_key_test(key, bit)) {
-	    current = cur_node->ppn_right;
+	    current = pa_pat_load(&cur_node->ppn_right);
 	} else {
 	    lastleft = current;
-	    current = cur_node->ppn_left;
+	    current = pa_pat_load(&cur_node->ppn_left);
 	}
 	cur_node = pa_pat_node(root, current);
     }
-    assert(cur_node == node);
+    if (cur_node != node) {
+	/* Only a concurrent delete can get us here */
+	assert(root->pp_rcu);
+	return NULL;
+    }
 
     /*
      * If we found a left turn go right from there.  Otherwise barf.
      */
     if (!pa_pat_is_null(lastleft)) {
 	node = pa_pat_node(root, lastleft);
+	current = pa_pat_load(&node->ppn_right);
 	return pa_pat_find_leftmost(root, node->ppn_bit,
-				    pa_pat_node(root, node->ppn_right));
+				    pa_pat_node(root, current));
     }
 
     return NULL;
@@ -713,8 +948,8 @@ pa_pat_cons_subtree_next (const pa_pat_t *root,
  * Returns NULL if the tree is empty or it falls off the left.  Asserts
  * if the node isn't in the tree.
  */
-pa_pat_node_t *
-pa_pat_find_prev (pa_pat_t *root, pa_pat_node_t *node)
+static pa_pat_node_t *
+pa_pat_find_prev_walk (pa_pat_t *root, pa_pat_node_t *node)
 {
     uint16_t bit;
     const uint8_t *key;
@@ -723,9 +958,9 @@ pa_pat_find_prev (pa_pat_t *root, pa_pat_node_t *node)
     /*
      * If there's nothing in the tree we're done.
      */
-    current = root->pp_root;
+    current = pa_pat_load(&root->pp_root);
     if (pa_pat_is_null(current)) {
-	assert(node == NULL);
+	assert(node == NULL || root->pp_rcu);
 	return NULL;
     }
 
@@ -748,21 +983,26 @@ pa_pat_find_prev (pa_pat_t *root, pa_pat_node_t *node)
 	bit = cur_node->ppn_bit;
 	if (bit < node->ppn_length && pat_key_test(key, bit)) {
 	    lastright = current;
-	    current = cur_node->ppn_right;
+	    current = pa_pat_load(&cur_node->ppn_right);
 	} else {
-	    current = cur_node->ppn_left;
+	    current = pa_pat_load(&cur_node->ppn_left);
 	}
 	cur_node = pa_pat_node(root, current);
     }
-    assert(cur_node == node);
+    if (cur_node != node) {
+	/* Only a concurrent delete can get us here */
+	assert(root->pp_rcu);
+	return NULL;
+    }
 
     /*
      * If we found a right turn go right from there.  Otherwise barf.
      */
     if (!pa_pat_is_null(lastright)) {
 	node = pa_pat_node(root, lastright);
+	current = pa_pat_load(&node->ppn_left);
 	return pa_pat_find_rightmost(root, node->ppn_bit,
-				     pa_pat_node(root, node->ppn_left));
+				     pa_pat_node(root, current));
     }
 
     return NULL;
@@ -774,9 +1014,9 @@ pa_pat_find_prev (pa_pat_t *root, pa_pat_node_t *node)
  * many bits of prefix.  Return the leftmost guy for which this
  * is a prefix of the node's key.
  */
-pa_pat_node_t *
-pa_pat_subtree_match (pa_pat_t *root, uint16_t plen,
-		      const void *v_prefix)
+static pa_pat_node_t *
+pa_pat_subtree_match_walk (pa_pat_t *root, uint16_t plen,
+			   const void *v_prefix)
 {
     uint16_t diff_bit, p_bit;
     pa_pat_atom_t current;
@@ -788,7 +1028,7 @@ pa_pat_subtree_match (pa_pat_t *root, uint16_t plen,
      */
     assert(plen && plen <= (PA_PAT_MAXKEY * 8));
 
-    current = root->pp_root;
+    current = pa_pat_load(&root->pp_root);
     if (pa_pat_is_null(current))
 	return NULL;
 
@@ -827,8 +1067,9 @@ pa_pat_subtree_match (pa_pat_t *root, uint16_t plen,
  * common to nodes in the subtree, return the lexical next node in the
  * subtree.  assert()'s if the node isn't in the tree.
  */
-pa_pat_node_t *
-pa_pat_subtree_next (pa_pat_t *root, pa_pat_node_t *node, uint16_t plen)
+static pa_pat_node_t *
+pa_pat_subtree_next_walk (pa_pat_t *root, pa_pat_node_t *node,
+			  uint16_t plen)
 {
     const psu_byte_t *prefix;
     uint16_t bit, p_bit;
@@ -838,8 +1079,11 @@ pa_pat_subtree_next (pa_pat_t *root, pa_pat_node_t *node, uint16_t plen)
     /*
      * Make sure this is reasonable.
      */
-    current = root->pp_root;
-    assert(plen && !pa_pat_is_null(current));
+    current = pa_pat_load(&root->pp_root);
+    assert(plen && (!pa_pat_is_null(current) || root->pp_rcu));
+    if (pa_pat_is_null(current))
+	return NULL;
+
     p_bit = pa_pat_plen_to_bit(plen);
     assert(node->ppn_length >= p_bit);
 
@@ -851,10 +1095,10 @@ pa_pat_subtree_next (pa_pat_t *root, pa_pat_node_t *node, uint16_t plen)
     while (bit < cur_node->ppn_bit) {
 	bit = cur_node->ppn_bit;
 	if (bit < node->ppn_length && pat_key_test(prefix, bit)) {
-	    current = cur_node->ppn_right;
+	    current = pa_pat_load(&cur_node->ppn_right);
 	} else {
 	    lastleft = current;
-	    current = cur_node->ppn_left;
+	    current = pa_pat_load(&cur_node->ppn_left);
 	}
 	cur_node = pa_pat_node(root, current);
     }
@@ -864,13 +1108,18 @@ pa_pat_subtree_next (pa_pat_t *root, pa_pat_node_t *node, uint16_t plen)
      * we've fallen off the end of the subtree.  Otherwise step right
      * and return the leftmost guy over there.
      */
-    assert(cur_node == node);
+    if (cur_node != node) {
+	/* Only a concurrent delete can get us here */
+	assert(root->pp_rcu);
+	return NULL;
+    }
     node = pa_pat_node(root, lastleft);
     if (node == NULL || node->ppn_bit < p_bit)
 	return NULL;
 
+    current = pa_pat_load(&node->ppn_right);
     return pa_pat_find_leftmost(root, node->ppn_bit,
-				pa_pat_node(root, node->ppn_right));
+				pa_pat_node(root, current));
 }
 
 
@@ -884,9 +1133,9 @@ pa_pat_subtree_next (pa_pat_t *root, pa_pat_node_t *node, uint16_t plen)
  * Some more documentation for this function.
  *  Let's see what Doxygen does with it.
  */
-pa_pat_node_t *
-pa_pat_getnext (pa_pat_t *root, uint16_t klen,
-		const void *v_key, psu_boolean_t eq)
+static pa_pat_node_t *
+pa_pat_getnext_walk (pa_pat_t *root, uint16_t klen,
+		     const void *v_key, psu_boolean_t eq)
 {
     uint16_t bit, bit_len, diff_bit;
     pa_pat_atom_t current, lastleft, lastright;
@@ -898,7 +1147,7 @@ pa_pat_getnext (pa_pat_t *root, uint16_t klen,
     /*
      * If nothing in tree, nothing to find.
      */
-    current = root->pp_root;
+    current = pa_pat_load(&root->pp_root);
     cur_node = pa_pat_node(root, current);
     if (cur_node == NULL)
 	return NULL;
@@ -914,10 +1163,10 @@ pa_pat_getnext (pa_pat_t *root, uint16_t klen,
 	bit = cur_node->ppn_bit;
 	if (bit < bit_len && pat_key_test(key, bit)) {
 	    lastright = current;
-	    current = cur_node->ppn_right;
+	    current = pa_pat_load(&cur_node->ppn_right);
 	} else {
 	    lastleft = current;
-	    current = cur_node->ppn_left;
+	    current = pa_pat_load(&cur_node->ppn_left);
 	}
 	cur_node = pa_pat_node(root, current);
     }
@@ -957,15 +1206,16 @@ pa_pat_getnext (pa_pat_t *root, uint16_t klen,
 	pa_pat_node_t *lastleft_node = pa_pat_node(root, lastleft);
 	if (lastleft_node && lastleft_node->ppn_bit > diff_bit) {
 	    bit = PA_PAT_NOBIT;
-	    current = root->pp_root;
+	    current = pa_pat_load(&root->pp_root);
+	    cur_node = pa_pat_node(root, current);
 	    lastleft = pa_pat_null_atom();
 	    while (bit < cur_node->ppn_bit && cur_node->ppn_bit < diff_bit) {
 		bit = cur_node->ppn_bit;
 		if (pat_key_test(key, bit)) {
-		    current = cur_node->ppn_right;
+		    current = pa_pat_load(&cur_node->ppn_right);
 		} else {
 		    lastleft = current;
-		    current = cur_node->ppn_left;
+		    current = pa_pat_load(&cur_node->ppn_left);
 		}
 		cur_node = pa_pat_node(root, current);
 	    }
@@ -994,13 +1244,85 @@ pa_pat_getnext (pa_pat_t *root, uint16_t klen,
      */
     if (!pa_pat_is_null(lastleft)) {
 	pa_pat_node_t *lastleft_node = pa_pat_node(root, lastleft);
+	current = pa_pat_load(&lastleft_node->ppn_right);
 	return pa_pat_find_leftmost(root, lastleft_node->ppn_bit,
-			    pa_pat_node(root, lastleft_node->ppn_right));
+				    pa_pat_node(root, current));
     }
 
     return NULL;
 }
 
+/*
+ * Public faces of the walks above, retried if they overlapped a delete
+ */
+pa_pat_node_t *
+pa_pat_find_next (pa_pat_t *root, pa_pat_node_t *node)
+{
+    pa_pat_node_t *res;
+
+    PA_PAT_READ(root, res, pa_pat_find_next_walk(root, node));
+
+    /*
+     * If the node was deleted under us, the walk can't find it, so
+     * pick up from its key instead.  Its key outlives the reader.
+     */
+    if (res == NULL && node && root->pp_rcu)
+	res = pa_pat_getnext(root, pa_pat_length(node),
+			     pa_pat_key(root, node), FALSE);
+
+    return res;
+}
+
+pa_pat_node_t *
+pa_pat_find_prev (pa_pat_t *root, pa_pat_node_t *node)
+{
+    pa_pat_node_t *res;
+
+    PA_PAT_READ(root, res, pa_pat_find_prev_walk(root, node));
+    return res;
+}
+
+pa_pat_node_t *
+pa_pat_subtree_match (pa_pat_t *root, uint16_t plen, const void *prefix)
+{
+    pa_pat_node_t *res;
+
+    PA_PAT_READ(root, res, pa_pat_subtree_match_walk(root, plen, prefix));
+    return res;
+}
+
+pa_pat_node_t *
+pa_pat_subtree_next (pa_pat_t *root, pa_pat_node_t *node, uint16_t plen)
+{
+    pa_pat_node_t *res;
+
+    PA_PAT_READ(root, res, pa_pat_subtree_next_walk(root, node, plen));
+
+    /* As with pa_pat_find_next(), restart a walk from a deleted node */
+    if (res == NULL && root->pp_rcu) {
+	const uint8_t *prefix = pa_pat_key(root, node);
+	uint16_t p_bit = pa_pat_plen_to_bit(plen);
+
+	res = pa_pat_getnext(root, pa_pat_length(node), prefix, FALSE);
+	if (res && (res->ppn_length < p_bit
+		    || pa_pat_mismatch(prefix, pa_pat_key(root, res),
+				       p_bit) < p_bit))
+	    res = NULL;		/* Past the end of the subtree */
+    }
+
+    return res;
+}
+
+pa_pat_node_t *
+pa_pat_getnext (pa_pat_t *root, uint16_t klen,
+		const void *key, psu_boolean_t eq)
+{
+    pa_pat_node_t *res;
+
+    PA_PAT_READ(root, res, pa_pat_getnext_walk(root, klen, key, eq));
+    return res;
+}
+
 int
 pa_pat_compare_nodes (pa_pat_t *root, pa_pat_node_t *node1,
 		      pa_pat_node_t *node2)
@@ -83,18 +83,68 @@ struct pa_pat_s;		/* Forward declaration */
 typedef const psu_byte_t *(*pa_pat_key_func_t)(struct pa_pat_s *,
 					       pa_pat_data_atom_t);
 
+/*
+ * Concurrent readers (see pa_pat_rcu_init()).  Each reader thread
+ * owns a slot recording the epoch it entered in; slots are padded to
+ * a cache line so readers never write to a line another reader reads.
+ */
+#define PA_PAT_CACHE_LINE	64
+
+typedef struct pa_pat_reader_s {
+    uint64_t ppr_epoch;		/* Epoch at entry, or zero if outside */
+    uint8_t ppr_pad[PA_PAT_CACHE_LINE - sizeof(uint64_t)];
+} pa_pat_reader_t;
+
+typedef struct pa_pat_retired_s {
+    pa_pat_atom_t ppt_atom;	/* Unlinked node, not yet freed */
+    uint64_t ppt_epoch;		/* Epoch in which it was unlinked */
+} pa_pat_retired_t;
+
+typedef struct pa_pat_rcu_s {
+    uint64_t prc_epoch;		/* Global epoch (never zero) */
+    uint32_t prc_seq;		/* Odd while the writer rewires nodes */
+    uint32_t prc_max_readers;	/* Number of reader slots */
+    uint32_t prc_num_readers;	/* Number of slots handed out */
+    uint32_t prc_num_retired;	/* Number of entries in prc_retired */
+    uint32_t prc_max_retired;	/* Allocated size of prc_retired */
+    pa_pat_retired_t *prc_retired; /* Nodes waiting on readers */
+    pa_pat_reader_t *prc_readers; /* Reader slots */
+} pa_pat_rcu_t;
+
 typedef struct pa_pat_s {
     pa_pat_info_t *pp_infop;	/* Pointer to root info */
     pa_mmap_t *pp_mmap;		/* Underlaying mmap */
     pa_fixed_t *pp_nodes;	/* Fixed paged array of nodes */
     void *pp_data;		/* Opaque data tree */
     pa_pat_key_func_t pp_key_func; /* Find the key for a node */
+    pa_pat_rcu_t *pp_rcu;	/* Concurrent reader state (or NULL) */
 } pa_pat_t;
 
 /* Shorthand for fields */
 #define pp_root pp_infop->ppi_root
 #define pp_key_bytes pp_infop->ppi_key_bytes
 
+/*
+ * Links between nodes are read with acquire semantics and written
+ * with release semantics, so a reader that follows a link always
+ * sees a fully built node.  These are plain loads and stores on
+ * x86; elsewhere they cost a barrier.
+ */
+static inline pa_pat_atom_t
+pa_pat_load (const pa_pat_atom_t *ptr)
+{
+    pa_pat_atom_t atom;
+
+    __atomic_load(ptr, &atom, __ATOMIC_ACQUIRE);
+    return atom;
+}
+
+static inline void
+pa_pat_store (pa_pat_atom_t *ptr, pa_pat_atom_t atom)
+{
+    __atomic_store(ptr, &atom, __ATOMIC_RELEASE);
+}
+
 static inline pa_fixed_atom_t
 pa_pat_to_fixed (pa_pat_atom_t atom)
 {
@@ -215,7 +265,12 @@ pa_pat_add (pa_pat_t *root, pa_pat_data_atom_t datom, uint16_t key_bytes);
 
 /**
  * @brief
- * Deletes a node from the tree.
+ * Deletes a node from the tree and frees it.
+ *
+ * @note With concurrent readers enabled, the free is deferred until
+ *       readers that might hold the node have left.  The node's data
+ *       (and so its key) must outlive them too; see
+ *       pa_pat_rcu_synchronize().
  *
  * @param[in] root
  *     Pointer to patricia tree root
@@ -613,6 +668,9 @@ pa_pat_length_to_bit (uint16_t length)
 /**
  * @brief
  * Finds an exact match for the specified key and key length.
+ *
+ * @note This has no retry for concurrent deletes; with concurrent
+ *       readers enabled (pa_pat_rcu_init()), use pa_pat_get().
  * 
  * @param[in] root
  *     Pointer to patricia tree root
@@ -635,7 +693,7 @@ pa_pat_get_inline (pa_pat_t *root, uint16_t key_bytes, const void *v_key)
     if (key_bytes == 0)
 	abort();
 
-    current = root->pp_root;
+    current = pa_pat_load(&root->pp_root);
     if (pa_pat_is_null(current))
 	return NULL;
 
@@ -646,15 +704,12 @@ pa_pat_get_inline (pa_pat_t *root, uint16_t key_bytes, const void *v_key)
     bit_len = pa_pat_length_to_bit(key_bytes);
 
     pa_pat_node_t *node = pa_pat_node(root, current);
-    while (bit < node->ppn_bit) {
-	if (node == NULL)
-	    return NULL;
-
+    while (node && bit < node->ppn_bit) {
 	bit = node->ppn_bit;
 	if (bit < bit_len && pat_key_test(key, bit)) {
-	    current = node->ppn_right;
+	    current = pa_pat_load(&node->ppn_right);
 	} else {
-	    current = node->ppn_left;
+	    current = pa_pat_load(&node->ppn_left);
 	}
 	node = pa_pat_node(root, current);
     }
@@ -662,7 +717,7 @@ pa_pat_get_inline (pa_pat_t *root, uint16_t key_bytes, const void *v_key)
     /*
      * If the lengths don't match we're screwed.  Otherwise do a compare.
      */
-    if (node->ppn_length != bit_len
+    if (node == NULL || node->ppn_length != bit_len
 	|| bcmp(pa_pat_key(root, node), key, key_bytes))
 	return NULL;
 
@@ -682,7 +737,119 @@ pa_pat_get_inline (pa_pat_t *root, uint16_t key_bytes, const void *v_key)
 static inline psu_boolean_t
 pa_pat_isempty (pa_pat_t *root)
 {
-    return pa_pat_is_null(root->pp_root);
+    return pa_pat_is_null(pa_pat_load(&root->pp_root));
+}
+
+/**
+ * @brief
+ * Enables concurrent readers for a patricia tree.
+ *
+ * Once enabled, any number of threads can look things up while a
+ * single writer adds and deletes nodes, without locks.  Additions
+ * publish each new node with one release store, so readers never
+ * wait for them.  pa_pat_delete() rewires nodes in place, so it
+ * bumps a sequence count that readers check, retrying a lookup that
+ * overlapped a delete, and it defers freeing the deleted node until
+ * every reader that might hold it has left (epoch-based reclamation).
+ *
+ * Each reader thread needs a slot from pa_pat_read_register(), and
+ * brackets its lookups with pa_pat_read_enter() and
+ * pa_pat_read_exit(); nodes returned inside the bracket stay valid
+ * until the exit.  The reader state lives in process memory, so the
+ * readers must be threads of the process that owns the writer.
+ *
+ * Readers must use pa_pat_get(), not pa_pat_get_inline(), since only
+ * the former retries a lookup that overlapped a delete.  A walk with
+ * pa_pat_find_next() or pa_pat_subtree_next() can continue from a
+ * node deleted since the reader found it; the walk picks up from
+ * that node's key.  pa_pat_find_prev() can't, and returns @c NULL.
+ *
+ * @param[in] root
+ *     Pointer to patricia tree root
+ * @param[in] max_readers
+ *     Number of reader slots
+ *
+ * @return
+ *     @c TRUE on success, @c FALSE if memory can't be allocated.
+ */
+psu_boolean_t
+pa_pat_rcu_init (pa_pat_t *root, unsigned max_readers);
+
+/**
+ * @brief
+ * Allocates a reader slot for the calling thread.
+ *
+ * @return
+ *     The slot number, or -1 if all slots are in use.
+ */
+int
+pa_pat_read_register (pa_pat_t *root);
+
+/**
+ * @brief
+ * Waits until every reader that entered before the call has left,
+ * then frees deleted nodes.  Callers use this before freeing data
+ * that a deleted node's key pointed to.
+ */
+void
+pa_pat_rcu_synchronize (pa_pat_t *root);
+
+/**
+ * @brief
+ * Enters a read-side section.  Readers never block here; they just
+ * record the current epoch in their slot.
+ */
+static inline void
+pa_pat_read_enter (pa_pat_t *root, int reader)
+{
+    pa_pat_rcu_t *prcp = root->pp_rcu;
+    uint64_t epoch;
+
+    if (prcp == NULL)
+	return;
+
+    epoch = __atomic_load_n(&prcp->prc_epoch, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&prcp->prc_readers[reader].ppr_epoch, epoch,
+		     __ATOMIC_RELAXED);
+
+    /* Our slot must be visible before we read any links */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief
+ * Leaves a read-side section.  Nodes found inside it must not be
+ * used after this.
+ */
+static inline void
+pa_pat_read_exit (pa_pat_t *root, int reader)
+{
+    pa_pat_rcu_t *prcp = root->pp_rcu;
+
+    if (prcp == NULL)
+	return;
+
+    __atomic_store_n(&prcp->prc_readers[reader].ppr_epoch, 0,
+		     __ATOMIC_RELEASE);
+}
+
+/*
+ * Sequence count checks around a single walk of the tree.  A walk
+ * that saw an odd count, or a count that changed, overlapped a
+ * delete and must be redone.
+ */
+static inline uint32_t
+pa_pat_read_begin (pa_pat_t *root)
+{
+    return __atomic_load_n(&root->pp_rcu->prc_seq, __ATOMIC_ACQUIRE);
+}
+
+static inline psu_boolean_t
+pa_pat_read_retry (pa_pat_t *root, uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (seq & 1)
+	|| __atomic_load_n(&root->pp_rcu->prc_seq, __ATOMIC_RELAXED) != seq;
 }
 
 
@@ -46,6 +46,7 @@ static char **opt_args;
 static char *opt_show_variable; /* Variable (in script) to show */
 static char *opt_show_select;   /* Expression (in script) to show */
 static char *opt_xpath;		/* XPath expresion to match on */
+static char *opt_profile_memory; /* File for memory profile report */
 
 static int opt_html;		/* Parse input as HTML */
 static int opt_indent;		/* Indent the output (pretty print) */
@@ -56,6 +57,7 @@ static int opt_slax_output;	/* Make output in SLAX format */
 static int opt_json_tagging;	/* Tag JSON output */
 static int opt_json_flags;	/* Flags for JSON conversion */
 static int opt_keep_text;	/* Don't add a rule to discard text values */
+static int opt_lint_perf;	/* Report known-expensive script patterns */
 
 static const char *
 get_filename (const char *filename, char ***pargv, int outp)
@@ -418,6 +420,38 @@ buildEmptyFile (void)
     return docp;
 }
 
+/*
+ * Run the script with the memory profiler on, writing the report
+ * requested by --profile-memory
+ */
+static void
+write_memory_profile (xsltStylesheetPtr script, xmlDocPtr indoc,
+		      xmlDocPtr *resp)
+{
+    FILE *fp;
+
+    if (slaxProfMemOpen(script->doc))
+	errx(1, "could not start the memory profiler");
+
+    *resp = xsltApplyStylesheet(script, indoc, params);
+
+    if (slaxFilenameIsStd(opt_profile_memory))
+	fp = stderr;
+    else {
+	fp = fopen(opt_profile_memory, "w");
+	if (fp == NULL)
+	    err(1, "could not open memory profile file: '%s'",
+		opt_profile_memory);
+    }
+
+    slaxProfMemReport(fp, mini_docp ? mini_buffer : NULL);
+
+    if (fp != stderr)
+	fclose(fp);
+
+    slaxProfClose();
+}
+
 static int
 do_run (const char *name, const char *output, const char *input, char **argv)
 {
@@ -478,6 +512,8 @@ do_run (const char *name, const char *output, const char *input, char **argv)
 	res = slaxDebugApplyStylesheet(scriptname, script,
 				 slaxFilenameIsStd(input) ? NULL : input,
 				 indoc, params);
+    } else if (opt_profile_memory) {
+	write_memory_profile(script, indoc, &res);
     } else {
 	res = xsltApplyStylesheet(script, indoc, params);
     }
@@ -624,7 +660,16 @@ do_check (const char *name, const char *output UNUSED,
 	errx(1, "%d errors parsing script: '%s'",
 	     script ? script->errors : 1, scriptname);
 
-    fprintf(stderr, "script check succeeds\n");
+    if (opt_lint_perf) {
+	unsigned count = slaxLintPerf(script);
+
+	if (count)
+	    fprintf(stderr, "script check succeeds (%u performance warning%s)\n",
+		    count, (count == 1) ? "" : "s");
+	else
+	    fprintf(stderr, "script check succeeds\n");
+    } else
+	fprintf(stderr, "script check succeeds\n");
 
     xsltFreeStylesheet(script);
 
@@ -720,9 +765,12 @@ print_help (void)
 "\t--include <dir> OR -I <dir>: search directory for includes/imports\n"
 "\t--indent OR -g: indent output ala output-method/indent\n"
 "\t--input <file> OR -i <file>: take input from the given file\n"
+"\t--input-file <file>: answer input prompts from the given file\n"
+"\t--input-value <prompt>=<answer>: answer the given input prompt\n"
 "\t--json-tagging: tag json-style input with the 'json' attribute\n"
 "\t--keep-text: mini-templates should not discard text\n"
 "\t--lib <dir> OR -L <dir>: search directory for extension libraries\n"
+"\t--lint-perf: with --check, report known-expensive script patterns\n"
 "\t--log <file>: use given log file\n"
 "\t--mini-template <code> OR -m <code>: wrap template code in a script\n"
 "\t--name <file> OR -n <file>: read the script from the given file\n"
@@ -732,8 +780,14 @@ print_help (void)
 "\t--output <file> OR -o <file>: make output into the given file\n"
 "\t--param <name> <value> OR -a <name> <value>: pass parameters\n"
 "\t--partial OR -p: allow partial SLAX input to --slax-to-xslt\n"
+"\t--profile-memory <file>: report memory allocated by each script line\n"
 "\t--slax-output OR -S: Write the result using SLAX-style XML (braces, etc)\n"
+"\t--stats <file>: write run time and memory statistics to a file\n"
+"\t--syslog-buffer <bytes>[:<msecs>]: buffer syslog messages\n"
+"\t--syslog-socket <path>: send syslog messages to the given socket\n"
 "\t--trace <file> OR -t <file>: write trace data to a file\n"
+"\t--trace-timeline <file>: write a call timeline in Chrome trace format\n"
+"\t--unbuffered: flush output and trace data after every message\n"
 "\t--verbose OR -v: enable debugging output (slaxLog())\n"
 "\t--version OR -V: show version information (and exit)\n"
 "\t--write-version <version> OR -w <version>: write in version\n"
@@ -741,6 +795,41 @@ print_help (void)
 "\n");
 }
 
+/*
+ * Write the statistics requested by --stats, one "name value" pair per
+ * line, so they're easy to pick apart in a shell script
+ */
+static void
+write_stats (const char *filename, struct timeval *start)
+{
+    slax_mem_stats_t sms;
+    struct timeval now;
+    unsigned long msecs;
+    FILE *fp;
+
+    gettimeofday(&now, NULL);
+    msecs = (now.tv_sec - start->tv_sec) * 1000
+	+ (now.tv_usec - start->tv_usec) / 1000;
+
+    slaxMemStatsGet(&sms);
+
+    fp = slaxFilenameIsStd(filename) ? stderr : fopen(filename, "w");
+    if (fp == NULL) {
+	warn("could not open stats file: '%s'", filename);
+	return;
+    }
+
+    fprintf(fp, "wall-ms %lu\n", msecs);
+    fprintf(fp, "max-rss-kb %lu\n", sms.sms_max_rss);
+    fprintf(fp, "allocs %lu\n", sms.sms_allocs);
+    fprintf(fp, "reallocs %lu\n", sms.sms_reallocs);
+    fprintf(fp, "frees %lu\n", sms.sms_frees);
+    fprintf(fp, "alloc-bytes %lu\n", sms.sms_bytes);
+
+    if (fp != stderr)
+	fclose(fp);
+}
+
 static char *
 check_arg (const char *name, char ***argvp)
 {
@@ -771,6 +860,16 @@ main (int argc UNUSED, char **argv)
     unsigned ioflags = 0;
     int opt_ignore_arguments = FALSE;
     char *opt_log_file = NULL;
+    char *opt_syslog_socket = NULL;
+    size_t syslog_bytes = 0;
+    unsigned syslog_msecs = 0;
+    int use_syslog = FALSE;
+    int use_batch = FALSE;
+    char *opt_stats_file = NULL;
+    char *opt_timeline_file = NULL;
+    struct timeval start_time;
+
+    gettimeofday(&start_time, NULL);
 
     slaxDataListInit(&plist);
     slaxDataListInit(&mini_templates);
@@ -845,6 +944,8 @@ main (int argc UNUSED, char **argv)
 /* Non-mode flags start here */
 	} else if (streq(cp, "--debug") || streq(cp, "-d")) {
 	    opt_debugger = TRUE;
+	    /* For "profile report memory"; harmless otherwise */
+	    slaxMemStatsEnable();
 
 	} else if (streq(cp, "--empty") || streq(cp, "-E")) {
 	    opt_empty_input = TRUE;
@@ -876,6 +977,17 @@ main (int argc UNUSED, char **argv)
 	} else if (streq(cp, "--input") || streq(cp, "-i")) {
 	    input = check_arg("input file", &argv);
 
+	} else if (streq(cp, "--input-file")) {
+	    cp = check_arg("input answer file", &argv);
+	    if (slaxIoBatchLoad(cp) < 0)
+		err(1, "could not read input answer file: '%s'", cp);
+	    use_batch = TRUE;
+
+	} else if (streq(cp, "--input-value")) {
+	    if (slaxIoBatchAdd(check_arg("input answer", &argv)) < 0)
+		errx(1, "out of memory");
+	    use_batch = TRUE;
+
 	} else if (streq(cp, "--json-tagging")) {
 	    opt_json_tagging = TRUE;
 
@@ -885,6 +997,9 @@ main (int argc UNUSED, char **argv)
 	} else if (streq(cp, "--lib") || streq(cp, "-L")) {
 	    slaxDynAdd(check_arg("library path", &argv));
 
+	} else if (streq(cp, "--lint-perf")) {
+	    opt_lint_perf = TRUE;
+
 	} else if (streq(cp, "--log") || streq(cp, "-l")) {
 	    opt_log_file = check_arg("log file name", &argv);
 
@@ -931,12 +1046,43 @@ main (int argc UNUSED, char **argv)
 	} else if (streq(cp, "--partial") || streq(cp, "-p")) {
 	    opt_partial = TRUE;
 
+	} else if (streq(cp, "--profile-memory")) {
+	    opt_profile_memory = check_arg("memory profile file name", &argv);
+	    if (slaxMemStatsEnable() < 0)
+		errx(1, "could not enable memory statistics");
+
 	} else if (streq(cp, "--slax-output") || streq(cp, "-S")) {
 	    opt_slax_output = TRUE;
 
+	} else if (streq(cp, "--stats")) {
+	    opt_stats_file = check_arg("stats file name", &argv);
+	    if (slaxMemStatsEnable() < 0)
+		errx(1, "could not enable memory statistics");
+
+	} else if (streq(cp, "--syslog-buffer")) {
+	    char *ep;
+
+	    cp = check_arg("buffer size", &argv);
+	    syslog_bytes = strtoul(cp, &ep, 0);
+	    if (*ep == ':')
+		syslog_msecs = strtoul(ep + 1, &ep, 0);
+	    if (*ep != '\0')
+		errx(1, "invalid syslog buffer size: '%s'", cp);
+	    use_syslog = TRUE;
+
+	} else if (streq(cp, "--syslog-socket")) {
+	    opt_syslog_socket = check_arg("socket path", &argv);
+	    use_syslog = TRUE;
+
 	} else if (streq(cp, "--trace") || streq(cp, "-t")) {
 	    trace_file = check_arg("trace file name", &argv);
 
+	} else if (streq(cp, "--trace-timeline")) {
+	    opt_timeline_file = check_arg("timeline file name", &argv);
+
+	} else if (streq(cp, "--unbuffered")) {
+	    ioflags |= SIF_UNBUFFERED;
+
 	} else if (streq(cp, "--verbose") || streq(cp, "-v")) {
 	    logger = TRUE;
 
@@ -979,7 +1125,7 @@ main (int argc UNUSED, char **argv)
     params[i] = NULL;
 
     if (func == NULL)
-	func = do_run; /* the default action */
+	func = opt_lint_perf ? do_check : do_run; /* the default action */
 
     /*
      * Seed the random number generator.  This is optional to allow
@@ -994,8 +1140,15 @@ main (int argc UNUSED, char **argv)
      */
     xmlInitParser();
     xsltInit();
+
+    /* Must precede slaxEnable(), so extension functions are timed */
+    if (opt_timeline_file && slaxTimelineOpen(opt_timeline_file) < 0)
+	err(1, "could not open timeline file: '%s'", opt_timeline_file);
+
     slaxEnable(SLAX_ENABLE);
     slaxIoUseStdio(ioflags);
+    if (use_batch)
+	slaxIoUseBatch();
 
     if (opt_json_tagging)
 	slaxJsonTagging(TRUE);
@@ -1028,6 +1181,13 @@ main (int argc UNUSED, char **argv)
 	slaxTraceToFile(trace_fp);
     }
 
+    if (use_syslog) {
+	if (slaxSyslogOpen(opt_syslog_socket, "slaxproc",
+			   syslog_bytes, syslog_msecs) < 0)
+	    errx(1, "could not open syslog socket: '%s'",
+		 opt_syslog_socket ?: "default");
+    }
+
     if (opt_ignore_arguments) {
 	static char *null_argv[] = { NULL };
 	argv = null_argv;
@@ -1038,9 +1198,23 @@ main (int argc UNUSED, char **argv)
 
     func(name, output, input, argv);
 
+    slaxIoFlush();
+
+    if (opt_timeline_file)
+	slaxTimelineClose();
+
+    if (use_syslog)
+	slaxSyslogClose();
+
+    if (use_batch)
+	slaxIoBatchClean();
+
     if (trace_fp && trace_fp != stderr)
 	fclose(trace_fp);
 
+    if (opt_stats_file)
+	write_stats(opt_stats_file, &start_time);
+
     slaxDynClean();
     xsltCleanupGlobals();
     xmlCleanupParser();
@@ -0,0 +1,345 @@
+#!/bin/sh
+#
+# Copyright 2026, Juniper Networks, Inc.
+# All rights reserved.
+# This SOFTWARE is licensed under the LICENSE provided in the
+# ../Copyright file. By downloading, installing, copying, or otherwise
+# using the SOFTWARE, you agree to be bound by the terms of that
+# LICENSE.
+#
+# Benchmark jig: generate large inputs (in out/, or the directory
+# given with -o) and time slaxproc running each bench-*.slax script
+# against them.  The generated files are reused between runs, so
+# delete the directory to change their size.
+#
+# Each run records the wall time, peak RSS, and allocation count (via
+# "slaxproc --stats") in out/bench.results, which is compared against
+# saved/bench.baseline.  A peak RSS or allocation count that is more
+# than $TOLERANCE percent over its baseline is reported as a regression,
+# and the jig exits non-zero.  Wall times depend on the machine, so
+# they are reported and recorded but never compared.  "bench.sh accept"
+# saves the last results as the baseline.
+#
+
+SRCDIR=.
+OUT=out
+SLAXPROC=slaxproc
+SIZE=64
+BLOB_SIZE=256
+ROUTES=500000
+DEPTH=32
+TOLERANCE=20
+ECHO=/bin/echo
+
+#
+# Generate a text log of roughly $SIZE megabytes, with DOS-style
+# line endings and the occasional non-xml character.
+#
+gen_log () {
+    file=$1
+
+    [ -f $file ] && return
+
+    ${ECHO} "... generating $file ($SIZE MB) ..."
+    awk -v size=$SIZE 'BEGIN {
+        limit = size * 1024 * 1024;
+        for (i = 0; total < limit; i++) {
+            line = sprintf("%08d: interface ge-0/0/%d is up, " \
+                           "input %d bytes, output %d bytes%s\r",
+                           i, i % 48, i * 1500, i * 512,
+                           (i % 1000) ? "" : "\001");
+            print line;
+            total += length(line) + 1;
+        }
+    }' > $file
+}
+
+gen_base64 () {
+    file=$1
+    from=$2
+
+    [ -f $file ] && return
+
+    ${ECHO} "... generating $file ..."
+    base64 -w 76 < $from > $file
+}
+
+#
+# Generate $BLOB_SIZE megabytes of binary data
+#
+gen_blob () {
+    file=$1
+
+    [ -f $file ] && return
+
+    ${ECHO} "... generating $file ($BLOB_SIZE MB) ..."
+    dd if=/dev/urandom of=$file bs=1048576 count=$BLOB_SIZE 2> /dev/null
+}
+
+#
+# Wrap base64 data in an XML document, one line per element, the
+# way a large attachment usually arrives
+#
+gen_base64_xml () {
+    file=$1
+    from=$2
+
+    [ -f $file ] && return
+
+    ${ECHO} "... generating $file ..."
+    base64 -w 76 < $from \
+        | awk 'BEGIN { print "<attachment>" }
+               { print "<line>" $0 "</line>" }
+               END { print "</attachment>" }' > $file
+}
+
+#
+# Generate an XML configuration of roughly $SIZE megabytes, made
+# of many small interface records.
+#
+gen_config () {
+    file=$1
+
+    [ -f $file ] && return
+
+    ${ECHO} "... generating $file ($SIZE MB) ..."
+    awk -v size=$SIZE 'BEGIN {
+        limit = size * 1024 * 1024;
+        print "<configuration>";
+        for (i = 0; total < limit; i++) {
+            rec = sprintf("  <interface name=\"ge-%d/0/%d\" mtu=\"%d\">\n" \
+                          "    <description>link %d</description>\n" \
+                          "    <unit><name>0</name>" \
+                          "<address>10.%d.%d.1/24</address></unit>\n" \
+                          "  </interface>",
+                          i / 48, i % 48, (i % 7) ? 1500 : 9192, i,
+                          (i / 256) % 256, i % 256);
+            print rec;
+            total += length(rec) + 1;
+        }
+        print "</configuration>";
+    }' > $file
+}
+
+#
+# Generate a routing table of $ROUTES routes, spread over a few
+# hundred next-hops, some of which have no next-hop at all.
+#
+gen_routes () {
+    file=$1
+
+    [ -f $file ] && return
+
+    ${ECHO} "... generating $file ($ROUTES routes) ..."
+    awk -v routes=$ROUTES 'BEGIN {
+        print "<route-information>";
+        for (i = 0; i < routes; i++) {
+            printf("  <route><name>%d.%d.%d.0/24</name>",
+                   10 + i / 65536, (i / 256) % 256, i % 256);
+            if (i % 97)
+                printf("<next-hop>192.168.%d.%d</next-hop>",
+                       (i % 251) / 64, (i % 251) % 64 + 1);
+            printf("<protocol>%s</protocol></route>\n",
+                   (i % 5) ? "bgp" : "static");
+        }
+        print "</route-information>";
+    }' > $file
+}
+
+#
+# Generate a deeply nested XML document of roughly $SIZE / 4
+# megabytes: blocks of groups nested $DEPTH levels deep, with a few
+# leaves at each level.
+#
+gen_deep () {
+    file=$1
+
+    [ -f $file ] && return
+
+    ${ECHO} "... generating $file (depth $DEPTH) ..."
+    awk -v size=$SIZE -v depth=$DEPTH 'BEGIN {
+        limit = size * 1024 * 1024 / 4;
+        print "<configuration>";
+        for (i = 0; total < limit; i++) {
+            for (d = 0; d < depth; d++) {
+                line = sprintf("<group name=\"g%d-%d\">" \
+                               "<apply-flags>omit</apply-flags>" \
+                               "<leaf>%d</leaf>", i, d, i * depth + d);
+                printf("%s", line);
+                total += length(line);
+            }
+            for (d = 0; d < depth; d++)
+                printf("</group>");
+            printf("\n");
+            total += depth * 8 + 1;
+        }
+        print "</configuration>";
+    }' > $file
+}
+
+#
+# Generate the JSON equivalent of bench-config.xml, with the same
+# records, for the JSON parser and writer
+#
+gen_json () {
+    file=$1
+
+    [ -f $file ] && return
+
+    ${ECHO} "... generating $file ($SIZE MB) ..."
+    awk -v size=$SIZE 'BEGIN {
+        limit = size * 1024 * 1024;
+        print "{ \"configuration\": { \"interface\": [";
+        for (i = 0; total < limit; i++) {
+            rec = sprintf("%s{ \"name\": \"ge-%d/0/%d\", \"mtu\": %d, " \
+                          "\"description\": \"link %d\", " \
+                          "\"unit\": { \"name\": 0, " \
+                          "\"address\": \"10.%d.%d.1/24\" } }",
+                          i ? ",\n  " : "  ",
+                          i / 48, i % 48, (i % 7) ? 1500 : 9192, i,
+                          (i / 256) % 256, i % 256);
+            printf("%s", rec);
+            total += length(rec);
+        }
+        print "\n] } }";
+    }' > $file
+}
+
+generate () {
+    gen_log $OUT/bench-log.txt
+    gen_config $OUT/bench-config.xml
+    gen_base64 $OUT/bench-log.b64 $OUT/bench-log.txt
+    gen_base64_xml $OUT/bench-log-b64.xml $OUT/bench-log.txt
+    gen_blob $OUT/bench-blob.bin
+    gen_routes $OUT/bench-routes.xml
+    gen_deep $OUT/bench-deep.xml
+    gen_json $OUT/bench-config.json
+}
+
+#
+# Record the statistics from $OUT/$name.stats and compare them
+# against the baseline
+#
+report () {
+    name=$1
+
+    if [ ! -s $OUT/$name.stats ]; then
+        ${ECHO} "... $name ... FAILED (see $OUT/$name.err)"
+        regressions=`expr $regressions + 1`
+        return
+    fi
+
+    awk -v name=$name -v tolerance=$TOLERANCE \
+        -v baseline=${SRCDIR}/saved/bench.baseline \
+        -v results=$OUT/bench.results '
+        { stats[$1] = $2 }
+        END {
+            res = sprintf("%s wall-ms %d max-rss-kb %d allocs %d",
+                          name, stats["wall-ms"], stats["max-rss-kb"],
+                          stats["allocs"]);
+            print res >> results;
+
+            line = sprintf("... %s ... %d ms, %d KB, %d allocs", name,
+                           stats["wall-ms"], stats["max-rss-kb"],
+                           stats["allocs"]);
+
+            while ((getline base < baseline) > 0) {
+                n = split(base, f, " ");
+                if (f[1] != name)
+                    continue;
+                for (i = 2; i < n; i += 2) {
+                    old = f[i + 1];
+                    new = stats[f[i]];
+                    if (f[i] == "wall-ms")
+                        continue;
+                    if (new > old * (100 + tolerance) / 100) {
+                        line = line sprintf(" [REGRESSION: %s %d -> %d]",
+                                            f[i], old, new);
+                        bad = 1;
+                    }
+                }
+            }
+
+            print line;
+            exit bad;
+        }' $OUT/$name.stats || regressions=`expr $regressions + 1`
+}
+
+run_one () {
+    test=$1
+    base=`basename $test .slax`
+
+    rm -f $OUT/$base.stats
+    ${SLAXPROC} --run --empty --stats $OUT/$base.stats \
+        --param dir `cd $OUT ; pwd` ${SRCDIR}/$test \
+        > $OUT/$base.out 2> $OUT/$base.err
+    report $base
+}
+
+#
+# Time the JSON parser and writer, which have no script
+#
+run_json () {
+    rm -f $OUT/json-to-xml.stats $OUT/xml-to-json.stats
+    ${SLAXPROC} --json-to-xml --stats $OUT/json-to-xml.stats \
+        $OUT/bench-config.json > $OUT/json-to-xml.out 2> $OUT/json-to-xml.err
+    report json-to-xml
+
+    # Convert the typed XML back, so the JSON round-trips
+    ${SLAXPROC} --xml-to-json --stats $OUT/xml-to-json.stats \
+        $OUT/json-to-xml.out > $OUT/xml-to-json.out 2> $OUT/xml-to-json.err
+    report xml-to-json
+}
+
+while [ $# -gt 0 ]
+do
+    case "$1" in
+    -b) BLOB_SIZE=$2; shift;;
+    -d) SRCDIR=$2; shift;;
+    -o) OUT=$2; shift;;
+    -p) SLAXPROC=$2; shift;;
+    -r) ROUTES=$2; shift;;
+    -s) SIZE=$2; shift;;
+    -t) TOLERANCE=$2; shift;;
+    -*) echo "unknown option" >&2; exit 1;;
+    *) break;;
+    esac
+    shift
+done
+
+verb=$1
+shift
+
+case $verb in
+    run)
+	mkdir -p $OUT
+	generate
+	rm -f $OUT/bench.results
+	regressions=0
+	for test in "$@"; do
+	    run_one $test
+	done
+	run_json
+	if [ $regressions -gt 0 ]; then
+	    ${ECHO} "... $regressions failure(s) or regression(s)" \
+		"over ${TOLERANCE}% ..."
+	    exit 1
+	fi
+    ;;
+
+    accept)
+	mkdir -p ${SRCDIR}/saved
+	cp $OUT/bench.results ${SRCDIR}/saved/bench.baseline
+    ;;
+
+    generate)
+	mkdir -p $OUT
+	generate
+    ;;
+
+    *)
+        ${ECHO} "unknown verb: $verb" 1>&2
+	;;
+esac
+
+exit 0
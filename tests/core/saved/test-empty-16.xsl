@@ -44,7 +44,7 @@ and finally, line five
         </xsl:for-each>
       </sequence>
       <first>
-        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:first-of($bad, worse, $good, &quot;huh&quot;)"/>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:first-of-lazy($bad, &quot;worse&quot;, &quot;$good&quot;, '&quot;huh&quot;')"/>
       </first>
       <break-lines>
         <xsl:variable xmlns:slax="http://xml.libslax.org/slax" name="bl" select="slax:break-lines($data)"/>
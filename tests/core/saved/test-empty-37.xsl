@@ -0,0 +1,52 @@
+<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<xsl:stylesheet xmlns:xsl="http://www.w3.org/1999/XSL/Transform" xmlns:redirect="org.apache.xalan.xslt.extensions.Redirect" xmlns:slax="http://xml.libslax.org/slax" version="1.0" extension-element-prefixes="redirect slax">
+  <xsl:variable name="base64">
+    <format>base64</format>
+  </xsl:variable>
+  <xsl:variable name="retain">
+    <retain-returns/>
+  </xsl:variable>
+  <xsl:template match="/">
+    <out>
+      <!-- base64 content broken across lines, with DOS line endings -->
+      <redirect:write href="hello37.txt" method="text">
+        <xsl:text>TWFu&#13;
+TWFu&#13;
+TWFu&#13;
+RmlzaCBT&#13;
+YXVjZQ==&#13;
+</xsl:text>
+      </redirect:write>
+      <test1>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:document(&quot;hello37.txt&quot;, $base64)"/>
+      </test1>
+      <test2>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:document(&quot;hello37.txt&quot;)"/>
+      </test2>
+      <test3>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="string-length(slax:document(&quot;hello37.txt&quot;, $retain))"/>
+      </test3>
+      <!-- Data that isn't base64 is returned as-is -->
+      <redirect:write href="hello37.txt" method="text">
+        <xsl:text>TWFu*TWFu
+</xsl:text>
+      </redirect:write>
+      <test5>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:document(&quot;hello37.txt&quot;, $base64)"/>
+      </test5>
+      <redirect:write href="hello37.txt" method="text">
+        <xsl:text>TQ==TWFu
+</xsl:text>
+      </redirect:write>
+      <test6>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:document(&quot;hello37.txt&quot;, $base64)"/>
+      </test6>
+      <redirect:write href="hello37.txt" method="text">
+        <xsl:text></xsl:text>
+      </redirect:write>
+      <test4>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:document(&quot;hello37.txt&quot;)"/>
+      </test4>
+    </out>
+  </xsl:template>
+</xsl:stylesheet>
@@ -0,0 +1,66 @@
+<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<xsl:stylesheet xmlns:xsl="http://www.w3.org/1999/XSL/Transform" xmlns:slax-ext="http://xmlsoft.org/XSLT/namespace" xmlns:slax="http://xml.libslax.org/slax" version="1.0" extension-element-prefixes="slax-ext slax">
+  <xsl:variable name="text" select="&quot;one&#10;two&#13;&#10;three&#10;&#10;five&#10;six&#10;&quot;"/>
+  <xsl:variable name="output-temp-1">
+    <output>alpha
+beta
+gamma</output>
+    <output>delta
+epsilon
+</output>
+  </xsl:variable>
+  <xsl:variable xmlns:slax-ext="http://xmlsoft.org/XSLT/namespace" name="output" select="slax-ext:node-set($output-temp-1)"/>
+  <xsl:template match="/">
+    <out>
+      <break-lines>
+        <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:break-lines($text)">
+          <line position="{position()}">
+            <xsl:value-of select="."/>
+          </line>
+        </xsl:for-each>
+        <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:break-lines($output/output)">
+          <line position="{position()}" name="{name()}">
+            <xsl:value-of select="."/>
+          </line>
+        </xsl:for-each>
+      </break-lines>
+      <range>
+        <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:break-lines-range($text, 2, 3)">
+          <line position="{position()}">
+            <xsl:value-of select="."/>
+          </line>
+        </xsl:for-each>
+        <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:break-lines-range($output/output, 3, 2)">
+          <line position="{position()}" name="{name()}">
+            <xsl:value-of select="."/>
+          </line>
+        </xsl:for-each>
+        <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:break-lines-range($text, 5)">
+          <tail position="{position()}">
+            <xsl:value-of select="."/>
+          </tail>
+        </xsl:for-each>
+        <empty>
+          <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="count(slax:break-lines-range($text, 1, 0))"/>
+        </empty>
+        <past>
+          <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="count(slax:break-lines-range($text, 10, 5))"/>
+        </past>
+      </range>
+      <count>
+        <text>
+          <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:line-count($text)"/>
+        </text>
+        <output>
+          <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:line-count($output/output)"/>
+        </output>
+        <none>
+          <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:line-count(&quot;&quot;)"/>
+        </none>
+        <single>
+          <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:line-count(&quot;just one&quot;)"/>
+        </single>
+      </count>
+    </out>
+  </xsl:template>
+</xsl:stylesheet>
@@ -0,0 +1,48 @@
+<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<xsl:stylesheet xmlns:xsl="http://www.w3.org/1999/XSL/Transform" xmlns:slax="http://xml.libslax.org/slax" version="1.0" extension-element-prefixes="slax">
+  <xsl:variable name="csv" select="&quot;one,two,,four,five,&quot;"/>
+  <xsl:template match="/">
+    <out>
+      <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:split(&quot;,&quot;, $csv)">
+        <comma position="{position()}">
+          <xsl:value-of select="."/>
+        </comma>
+      </xsl:for-each>
+      <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:split(&quot;,&quot;, $csv, 3)">
+        <limit position="{position()}">
+          <xsl:value-of select="."/>
+        </limit>
+      </xsl:for-each>
+      <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:split(&quot;::&quot;, &quot;a::b:c::::d&quot;)">
+        <colons position="{position()}">
+          <xsl:value-of select="."/>
+        </colons>
+      </xsl:for-each>
+      <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:split(&quot;\.&quot;, &quot;10.0.0.1&quot;)">
+        <quoted position="{position()}">
+          <xsl:value-of select="."/>
+        </quoted>
+      </xsl:for-each>
+      <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:split(&quot; -- &quot;, &quot;no match here&quot;)">
+        <none position="{position()}">
+          <xsl:value-of select="."/>
+        </none>
+      </xsl:for-each>
+      <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:split(&quot;,&quot;, &quot;,lead&quot;)">
+        <lead position="{position()}">
+          <xsl:value-of select="."/>
+        </lead>
+      </xsl:for-each>
+      <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:split(&quot;[,;]&quot;, &quot;a,b;c&quot;)">
+        <regex position="{position()}">
+          <xsl:value-of select="."/>
+        </regex>
+      </xsl:for-each>
+      <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:split(&quot;o\&gt;&quot;, &quot;foo boo bar&quot;)">
+        <word position="{position()}">
+          <xsl:value-of select="."/>
+        </word>
+      </xsl:for-each>
+    </out>
+  </xsl:template>
+</xsl:stylesheet>
@@ -0,0 +1,75 @@
+<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<xsl:stylesheet xmlns:xsl="http://www.w3.org/1999/XSL/Transform" xmlns:p="urn:example:digest" xmlns:q="urn:example:digest" xmlns:slax-ext="http://xmlsoft.org/XSLT/namespace" xmlns:slax="http://xml.libslax.org/slax" version="1.0" extension-element-prefixes="slax-ext slax">
+  <xsl:variable name="one-temp-1">
+    <config>
+      <p:interface name="ge-0/0/0" mtu="1500">
+        <unit>0</unit>
+      </p:interface>
+      <p:interface name="ge-0/0/1" mtu="9000">
+        <unit>0</unit>
+      </p:interface>
+    </config>
+  </xsl:variable>
+  <xsl:variable xmlns:slax-ext="http://xmlsoft.org/XSLT/namespace" name="one" select="slax-ext:node-set($one-temp-1)"/>
+  <xsl:variable name="two-temp-2">
+    <config>
+      <q:interface mtu="1500" name="ge-0/0/0">
+        <unit>0</unit>
+      </q:interface>
+      <q:interface mtu="9192" name="ge-0/0/1">
+        <unit>0</unit>
+      </q:interface>
+    </config>
+  </xsl:variable>
+  <xsl:variable xmlns:slax-ext="http://xmlsoft.org/XSLT/namespace" name="two" select="slax-ext:node-set($two-temp-2)"/>
+  <xsl:variable name="spaced">
+    <config>
+      <unit>0</unit>
+      <unit>
+        <xsl:text> </xsl:text>
+      </unit>
+    </config>
+  </xsl:variable>
+  <xsl:variable name="plain">
+    <config>
+      <unit>0</unit>
+      <unit/>
+    </config>
+  </xsl:variable>
+  <xsl:template match="/">
+    <out>
+      <sha256>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:digest(&quot;abc&quot;)"/>
+      </sha256>
+      <fnv1a64>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:digest(&quot;abc&quot;, &quot;fnv1a64&quot;)"/>
+      </fnv1a64>
+      <first>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:digest($one/config/*[1]) = slax:digest($two/config/*[1])"/>
+      </first>
+      <second>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:digest($one/config/*[2]) = slax:digest($two/config/*[2])"/>
+      </second>
+      <strip>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:digest($spaced, &quot;sha256&quot;, &quot;s&quot;) = slax:digest($plain, &quot;sha256&quot;, &quot;s&quot;)"/>
+      </strip>
+      <nostrip>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:digest($spaced) = slax:digest($plain)"/>
+      </nostrip>
+      <fast>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="string-length(slax:digest($one, &quot;fnv1a64&quot;))"/>
+      </fast>
+      <xsl:variable xmlns:slax="http://xml.libslax.org/slax" xmlns:slax-ext="http://xmlsoft.org/XSLT/namespace" name="a" select="slax-ext:node-set(slax:digest($one/config, &quot;fnv1a64&quot;, &quot;c&quot;))"/>
+      <xsl:variable xmlns:slax="http://xml.libslax.org/slax" xmlns:slax-ext="http://xmlsoft.org/XSLT/namespace" name="b" select="slax-ext:node-set(slax:digest($two/config, &quot;fnv1a64&quot;, &quot;c&quot;))"/>
+      <xsl:for-each select="$a">
+        <xsl:variable name="pos" select="@position"/>
+        <xsl:if test=". != $b[@position = $pos]">
+          <changed name="{@name}" position="{@position}"/>
+        </xsl:if>
+      </xsl:for-each>
+      <bad>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:digest(&quot;abc&quot;, &quot;crc-42&quot;)"/>
+      </bad>
+    </out>
+  </xsl:template>
+</xsl:stylesheet>
@@ -0,0 +1,76 @@
+<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<xsl:stylesheet xmlns:xsl="http://www.w3.org/1999/XSL/Transform" xmlns:slax-ext="http://xmlsoft.org/XSLT/namespace" xmlns:slax="http://xml.libslax.org/slax" version="1.0" extension-element-prefixes="slax-ext slax">
+  <xsl:variable name="items-temp-1">
+    <item id="1">one</item>
+    <item id="2" name="second">two</item>
+    <item id="3">three</item>
+  </xsl:variable>
+  <xsl:variable xmlns:slax-ext="http://xmlsoft.org/XSLT/namespace" name="items" select="slax-ext:node-set($items-temp-1)"/>
+  <xsl:variable name="none" select="/nothing"/>
+  <xsl:variable name="blank" select="&quot;&quot;"/>
+  <xsl:template match="/">
+    <top>
+      <!-- Later alternatives are only evaluated when needed -->
+      <first>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:first-of-lazy(&quot;alpha&quot;, 'slax:output(&quot;not reached 1&quot;)', '&quot;x&quot;')"/>
+      </first>
+      <second>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:first-of-lazy($none, &quot;$blank&quot;, 'slax:output(&quot;reached 2&quot;)', '&quot;beta&quot;')"/>
+      </second>
+      <third>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:first-of-lazy($none, &quot;$blank&quot;)"/>
+      </third>
+      <!-- Node identity survives, so paths work on the result -->
+      <fourth>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:first-of-lazy($items/missing, '$items/item[@id = &quot;2&quot;]')/@name"/>
+      </fourth>
+      <!-- Deferred arguments see the caller's context node -->
+      <xsl:for-each select="$items/item">
+        <item>
+          <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:first-of-lazy(@name, &quot;@id&quot;, '&quot;none&quot;')"/>
+        </item>
+      </xsl:for-each>
+      <!-- Both quote styles in separate arguments -->
+      <quotes>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:first-of($none, &quot;it's&quot;, 'say &quot;hi&quot;')"/>
+      </quotes>
+      <quotes>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:first-of($none, $blank, 'say &quot;hi&quot;')"/>
+      </quotes>
+      <!-- Deferred arguments keep their SLAX operators -->
+      <ops>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:first-of-lazy($none, 'concat($blank, &quot;-cat&quot;)', '$blank = &quot;b&quot;')"/>
+      </ops>
+      <ops>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:is-empty-lazy($none, '$blank != &quot;&quot;', '$items/item[@id = &quot;1&quot;]')"/>
+      </ops>
+      <!-- A ternary argument is evaluated normally -->
+      <ternary>
+        <xsl:variable name="slax-ternary-1">
+          <xsl:choose>
+            <xsl:when test="$blank">
+              <xsl:copy-of select="&quot;yes&quot;"/>
+            </xsl:when>
+            <xsl:otherwise>
+              <xsl:copy-of select="&quot;no&quot;"/>
+            </xsl:otherwise>
+          </xsl:choose>
+        </xsl:variable>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:first-of($none, slax:value($slax-ternary-1))"/>
+      </ternary>
+      <!-- slax:is-empty stops at the first non-empty argument -->
+      <empty>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:is-empty-lazy($none, &quot;$blank&quot;)"/>
+      </empty>
+      <empty>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:is-empty-lazy($none, &quot;$items&quot;, 'slax:output(&quot;not reached 3&quot;)')"/>
+      </empty>
+      <empty>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:is-empty-lazy($none, 'slax:output(&quot;reached 4&quot;)')"/>
+      </empty>
+      <empty>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:empty($items/item)"/>
+      </empty>
+    </top>
+  </xsl:template>
+</xsl:stylesheet>
@@ -0,0 +1,75 @@
+<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<xsl:stylesheet xmlns:xsl="http://www.w3.org/1999/XSL/Transform" xmlns:slax-ext="http://xmlsoft.org/XSLT/namespace" xmlns:slax="http://xml.libslax.org/slax" version="1.0" extension-element-prefixes="slax-ext slax">
+  <xsl:variable name="parts-temp-1">
+    <p>TWFu</p>
+    <p>
+      <q>TW</q>
+      <q>Fu
+</q>
+    </p>
+    <p>TWE=</p>
+  </xsl:variable>
+  <xsl:variable xmlns:slax-ext="http://xmlsoft.org/XSLT/namespace" name="parts" select="slax-ext:node-set($parts-temp-1)"/>
+  <xsl:variable name="odd-temp-2">
+    <p>a</p>
+    <p>bc</p>
+    <p>d</p>
+  </xsl:variable>
+  <xsl:variable xmlns:slax-ext="http://xmlsoft.org/XSLT/namespace" name="odd" select="slax-ext:node-set($odd-temp-2)"/>
+  <xsl:variable name="file" select="&quot;out/test-empty-42.bin&quot;"/>
+  <xsl:template match="/">
+    <top>
+      <!-- Node-sets are coded from their text nodes, in document order -->
+      <decode>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-decode($parts)"/>
+      </decode>
+      <encode>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-encode($odd)"/>
+      </encode>
+      <encode>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-encode($odd/p[2])"/>
+      </encode>
+      <utf8>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-encode(&quot;café&quot;)"/>
+      </utf8>
+      <utf8>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-decode(slax:base64-encode(&quot;café&quot;))"/>
+      </utf8>
+      <lines>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-decode(&quot;TWFu&#10;TWFu&#13;&#10;TWFu&#10;&quot;)"/>
+      </lines>
+      <!-- Padding is only allowed at the end -->
+      <padding>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-decode(&quot;TWE=&#10;&quot;)"/>
+      </padding>
+      <padding>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-decode(&quot;TQ==TWFu&quot;)"/>
+      </padding>
+      <!-- Decode to a file and encode it back -->
+      <written>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-decode-file($parts, $file)"/>
+      </written>
+      <read>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-encode-file($file)"/>
+      </read>
+      <written>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-decode-file(&quot;AAEC/w==&quot;, $file)"/>
+      </written>
+      <read>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-encode-file($file)"/>
+      </read>
+      <written>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-decode-file(&quot;&quot;, $file)"/>
+      </written>
+      <read>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-encode-file($file)"/>
+      </read>
+      <invalid>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-decode-file(&quot;not base64!&quot;, $file)"/>
+      </invalid>
+      <missing>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="slax:base64-encode-file(&quot;out/no-such-file.bin&quot;)"/>
+      </missing>
+    </top>
+  </xsl:template>
+</xsl:stylesheet>
@@ -0,0 +1,84 @@
+<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<xsl:stylesheet xmlns:xsl="http://www.w3.org/1999/XSL/Transform" xmlns:slax-ext="http://xmlsoft.org/XSLT/namespace" xmlns:slax="http://xml.libslax.org/slax" version="1.0" extension-element-prefixes="slax-ext slax">
+  <xsl:variable name="routes-temp-1">
+    <route>
+      <name>10.0.0.0/8</name>
+      <next-hop>192.168.1.1</next-hop>
+    </route>
+    <route>
+      <name>10.1.0.0/16</name>
+      <next-hop>192.168.1.2</next-hop>
+    </route>
+    <route>
+      <name>10.2.0.0/16</name>
+      <next-hop>192.168.1.1</next-hop>
+    </route>
+    <route>
+      <name>10.3.0.0/16</name>
+    </route>
+    <route>
+      <name>10.4.0.0/16</name>
+      <next-hop>192.168.1.2</next-hop>
+    </route>
+    <route>
+      <name>10.5.0.0/16</name>
+      <next-hop>192.168.1.1</next-hop>
+    </route>
+  </xsl:variable>
+  <xsl:variable xmlns:slax-ext="http://xmlsoft.org/XSLT/namespace" name="routes" select="slax-ext:node-set($routes-temp-1)"/>
+  <xsl:template match="/">
+    <top>
+      <!-- String values, first occurrence wins -->
+      <distinct>
+        <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:distinct($routes/route/next-hop)">
+          <hop>
+            <xsl:value-of select="."/>
+          </hop>
+        </xsl:for-each>
+      </distinct>
+      <!-- A key expression, evaluated against each node -->
+      <distinct-by-key>
+        <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:distinct($routes/route, &quot;next-hop&quot;)">
+          <first>
+            <xsl:value-of select="name"/>
+          </first>
+        </xsl:for-each>
+      </distinct-by-key>
+      <!-- Results are in document order, regardless of argument order -->
+      <order>
+        <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:distinct($routes/route[5] | $routes/route[2] | $routes/route[1], &quot;next-hop&quot;)">
+          <first>
+            <xsl:value-of select="name"/>
+          </first>
+        </xsl:for-each>
+      </order>
+      <group-by>
+        <xsl:for-each xmlns:slax="http://xml.libslax.org/slax" select="slax:group-by($routes/route, &quot;next-hop&quot;)">
+          <hop name="{@key}" count="{@count}">
+            <xsl:for-each select="route">
+              <route>
+                <xsl:value-of select="name"/>
+              </route>
+            </xsl:for-each>
+          </hop>
+        </xsl:for-each>
+      </group-by>
+      <count-by>
+        <xsl:copy-of xmlns:slax="http://xml.libslax.org/slax" select="slax:count-by($routes/route, &quot;next-hop&quot;)"/>
+      </count-by>
+      <count-by-value>
+        <xsl:copy-of xmlns:slax="http://xml.libslax.org/slax" select="slax:count-by($routes/route/next-hop)"/>
+      </count-by-value>
+      <!-- Keys can be computed -->
+      <count-by-prefix>
+        <xsl:copy-of xmlns:slax="http://xml.libslax.org/slax" select="slax:count-by($routes/route, &quot;substring-after(name, '/')&quot;)"/>
+      </count-by-prefix>
+      <empty>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="count(slax:distinct($routes/nothing))"/>
+      </empty>
+      <bad>
+        <xsl:value-of xmlns:slax="http://xml.libslax.org/slax" select="count(slax:distinct(&quot;not a node-set&quot;))"/>
+      </bad>
+    </top>
+  </xsl:template>
+</xsl:stylesheet>
@@ -0,0 +1,119 @@
+#!/bin/sh
+#
+# Copyright 2026, Juniper Networks, Inc.
+# All rights reserved.
+# This SOFTWARE is licensed under the LICENSE provided in the
+# ../Copyright file. By downloading, installing, copying, or otherwise
+# using the SOFTWARE, you agree to be bound by the terms of that
+# LICENSE.
+#
+# Build the seed corpora for the fuzzing harnesses in out/corpus/:
+# the test inputs from tests/core and tests/xi, plus generated
+# pathological inputs (deep nesting, huge attribute lists, long CDATA,
+# keys sharing long prefixes) of $SIZE bytes.
+#
+# Usage: fuzz-gen.sh [-d srcdir] [-p slaxproc] [-s size]
+#
+
+SRCDIR=.
+SLAXPROC=slaxproc
+SIZE=65536
+OUT=out/corpus
+
+while [ $# -gt 0 ]
+do
+    case "$1" in
+    -d) SRCDIR=$2; shift;;
+    -p) SLAXPROC=$2; shift;;
+    -s) SIZE=$2; shift;;
+    *) echo "unknown option: $1" >&2; exit 1;;
+    esac
+    shift
+done
+
+CORE=${SRCDIR}/../core
+XI=${SRCDIR}/../xi
+
+rm -rf ${OUT}
+mkdir -p ${OUT}/slax ${OUT}/json ${OUT}/xi ${OUT}/pat
+
+#
+# Repeat a string until it's $SIZE bytes long
+#
+repeat () {
+    awk -v str="$1" -v size=$SIZE 'BEGIN {
+        for (n = 0; n < size; n += length(str))
+            printf("%s", str);
+    }'
+}
+
+#
+# Seeds from the test suites
+#
+cp ${CORE}/*.slax ${OUT}/slax/
+for file in ${CORE}/*.xml ${XI}/*.xml ${XI}/xi*.in; do
+    cp $file ${OUT}/xi/
+done
+
+for file in ${CORE}/*.xml; do
+    base=`basename $file .xml`
+    ${SLAXPROC} --xml-to-json $file > ${OUT}/json/$base.json 2> /dev/null
+    [ -s ${OUT}/json/$base.json ] || rm -f ${OUT}/json/$base.json
+done
+
+# Element names and text from the tests make keys for the tree
+for file in ${CORE}/*.xml ${XI}/*.xml; do
+    base=`basename $file .xml`
+    tr '<>/=" ' '\n\n\n\n\n\n' < $file | sort -u > ${OUT}/pat/$base.keys
+done
+
+#
+# Pathological inputs
+#
+{ repeat '<a>'; repeat '</a>'; } > ${OUT}/xi/deep.xml
+{ echo '<a'; repeat ' b="c"'; echo '/>'; } > ${OUT}/xi/attributes.xml
+{ echo '<a'; awk -v size=$SIZE 'BEGIN {
+        for (i = 0; n < size; i++) {
+            attr = sprintf(" a%d=\"%d\"", i, i);
+            printf("%s", attr);
+            n += length(attr);
+        }
+    }'; echo '/>'; } > ${OUT}/xi/distinct-attributes.xml
+{ echo '<a><![CDATA['; repeat ']]'; echo ']]></a>'; } > ${OUT}/xi/cdata.xml
+{ echo '<a>'; repeat '&amp;&lt;&gt;&quot;'; echo '</a>'; } > ${OUT}/xi/entities.xml
+{ echo '<a><!--'; repeat '- -'; echo '--></a>'; } > ${OUT}/xi/comment.xml
+
+{ echo 'version 1.2; main <top> {'; repeat '<a> {';
+  repeat '}'; echo '}'; } > ${OUT}/slax/deep.slax
+{ echo 'version 1.2; main <top> { <a'; repeat ' b="c"';
+  echo '>; }'; } > ${OUT}/slax/attributes.slax
+{ echo 'version 1.2; main <top> { expr '; repeat '(';
+  repeat ')'; echo '; }'; } > ${OUT}/slax/parens.slax
+{ echo 'version 1.2; main <top> { expr "'; repeat 'a\\';
+  echo '"; }'; } > ${OUT}/slax/string.slax
+{ echo 'version 1.2; main <top> { expr 1'; repeat ' _ 1';
+  echo '; }'; } > ${OUT}/slax/concat.slax
+
+{ repeat '['; repeat ']'; } > ${OUT}/json/deep-array.json
+{ repeat '{ "a": '; echo '1'; repeat '}'; } > ${OUT}/json/deep-object.json
+{ echo '{'; repeat '"a": 1, '; echo '"b": 2 }'; } > ${OUT}/json/members.json
+{ echo '{ "a": "'; repeat '\\u0041\\n'; echo '" }'; } > ${OUT}/json/string.json
+
+awk -v size=$SIZE 'BEGIN {
+    prefix = sprintf("%0200d", 0);
+    for (i = 0; n < size; i++) {
+        key = sprintf("%s%d", prefix, i);
+        print key;
+        n += length(key) + 1;
+    }
+}' > ${OUT}/pat/prefix.keys
+awk -v size=$SIZE 'BEGIN {
+    for (i = 1; n < size; i++) {
+        key = sprintf("%*s", i % 250 + 1, "");
+        gsub(/ /, "a", key);
+        print key;
+        n += length(key) + 1;
+    }
+}' > ${OUT}/pat/nested.keys
+
+exit 0
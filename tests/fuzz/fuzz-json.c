@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Fuzz the JSON parser (slaxJsonDataToXml), which shares the SLAX
+ * lexer but builds its XML directly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slaxinternals.h"
+#include <libslax/slax.h>
+#include <libslax/jsonlexer.h>
+
+#include "fuzz.h"
+
+static void
+fuzz_json_error (void *ctx UNUSED, const char *msg UNUSED, ...)
+{
+    return;			/* Errors are expected; keep quiet */
+}
+
+static void
+fuzz_json_init (void)
+{
+    slaxMemStatsEnable();
+    xmlInitParser();
+    xsltInit();
+    slaxEnable(SLAX_ENABLE);
+    xmlSetGenericErrorFunc(NULL, fuzz_json_error);
+}
+
+static void
+fuzz_json_run (const uint8_t *data, size_t size)
+{
+    xmlDocPtr docp;
+    char *cp;
+
+    cp = fuzz_string(data, size);
+    if (cp == NULL)
+	return;
+
+    docp = slaxJsonDataToXml(cp, NULL, 0);
+    if (docp)
+	xmlFreeDoc(docp);
+}
+
+static unsigned long
+fuzz_json_alloc_bytes (void)
+{
+    slax_mem_stats_t sms;
+
+    slaxMemStatsGet(&sms);
+    return sms.sms_bytes;
+}
+
+fuzz_target_t fuzz_target = {
+    .ft_name = "fuzz-json",
+    .ft_init = fuzz_json_init,
+    .ft_run = fuzz_json_run,
+    .ft_alloc_bytes = fuzz_json_alloc_bytes,
+};
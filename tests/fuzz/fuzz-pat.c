@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Fuzz the parrotdb patricia tree (pa_pat).  Each line of the input
+ * is a key; the keys are added, looked up, and walked in both
+ * directions in a fresh in-memory database.  Then every other key is
+ * deleted, with lookups around each delete, the tree is walked
+ * again, and the rest are deleted.  Keys sharing long prefixes are
+ * the interesting case.  A deleted key that can still be found, or a
+ * tree that isn't empty at the end, aborts.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/paarb.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/papat.h>
+
+#include "fuzz.h"
+
+#define FUZZ_PAT_SHIFT		8
+#define FUZZ_PAT_MAX_ATOMS	(1 << 20)
+
+static unsigned long fuzz_pat_bytes; /* Growth of the mmap segment */
+static unsigned fuzz_pat_count;	/* Keys seen by fuzz_pat_delete() */
+static unsigned fuzz_pat_every;	/* Delete every Nth key */
+
+static const uint8_t *
+fuzz_pat_key_func (pa_pat_t *root, pa_pat_data_atom_t datom)
+{
+    pa_istr_atom_t atom = pa_istr_atom(pa_pat_data_atom_of(datom));
+    return (const uint8_t *) pa_istr_atom_string(root->pp_data, atom);
+}
+
+static void
+fuzz_pat_init (void)
+{
+    fuzz_psu_count_allocs();
+}
+
+/*
+ * Call func for each key (line) in the input, skipping empty lines
+ * and trimming keys to the maximum key length
+ */
+static void
+fuzz_pat_keys (char *buf, size_t size, pa_pat_t *ppp,
+	       void (*func)(pa_pat_t *, char *, size_t))
+{
+    char *cp, *ep = buf + size, *nl;
+    size_t len;
+
+    for (cp = buf; cp < ep; cp = nl + 1) {
+	nl = memchr(cp, '\n', ep - cp);
+	if (nl == NULL)
+	    nl = ep;
+
+	len = strnlen(cp, nl - cp);
+	if (len >= PA_PAT_MAXKEY)
+	    len = PA_PAT_MAXKEY - 1;
+	if (len == 0)
+	    continue;
+
+	func(ppp, cp, len);
+    }
+}
+
+static void
+fuzz_pat_add (pa_pat_t *ppp, char *key, size_t len)
+{
+    pa_istr_atom_t atom;
+    char save = key[len];
+
+    key[len] = '\0';
+    atom = pa_istr_string(ppp->pp_data, key);
+    if (!pa_istr_is_null(atom))
+	pa_pat_add(ppp, pa_pat_data_atom(pa_istr_atom_of(atom)), len + 1);
+    key[len] = save;
+}
+
+static void
+fuzz_pat_get (pa_pat_t *ppp, char *key, size_t len)
+{
+    char save = key[len];
+
+    key[len] = '\0';
+    pa_pat_get(ppp, len + 1, key);
+    pa_pat_subtree_match(ppp, len * NBBY, key);
+    key[len] = save;
+}
+
+static void
+fuzz_pat_delete (pa_pat_t *ppp, char *key, size_t len)
+{
+    pa_pat_node_t *node;
+    char save = key[len];
+
+    key[len] = '\0';
+    node = pa_pat_get(ppp, len + 1, key);
+    if (node && fuzz_pat_count++ % fuzz_pat_every == 0) {
+	pa_pat_getnext(ppp, len + 1, key, FALSE);
+
+	if (!pa_pat_delete(ppp, node)
+		|| pa_pat_get(ppp, len + 1, key) != NULL)
+	    abort();
+
+	pa_pat_getnext(ppp, len + 1, key, TRUE);
+	pa_pat_subtree_match(ppp, len * NBBY, key);
+    }
+    key[len] = save;
+}
+
+static void
+fuzz_pat_run (const uint8_t *data, size_t size)
+{
+    pa_mmap_t *pmp;
+    pa_istr_t *pip;
+    pa_pat_t *ppp;
+    pa_pat_node_t *node = NULL;
+    char *buf;
+
+    buf = fuzz_string(data, size);
+    if (buf == NULL)
+	return;
+
+    pmp = pa_mmap_open(NULL, "fuzz", 0, 0);
+    if (pmp == NULL)
+	return;
+
+    pip = pa_istr_open(pmp, "istr", FUZZ_PAT_SHIFT, 2, FUZZ_PAT_MAX_ATOMS);
+    ppp = pip ? pa_pat_open(pmp, "pat", pip, fuzz_pat_key_func,
+			    PA_PAT_MAXKEY, FUZZ_PAT_SHIFT,
+			    FUZZ_PAT_MAX_ATOMS) : NULL;
+    if (ppp) {
+	fuzz_pat_keys(buf, size, ppp, fuzz_pat_add);
+	fuzz_pat_keys(buf, size, ppp, fuzz_pat_get);
+
+	while ((node = pa_pat_find_next(ppp, node)) != NULL)
+	    continue;
+	while ((node = pa_pat_find_prev(ppp, node)) != NULL)
+	    continue;
+
+	fuzz_pat_count = 0;
+	fuzz_pat_every = 2;
+	fuzz_pat_keys(buf, size, ppp, fuzz_pat_delete);
+
+	while ((node = pa_pat_find_next(ppp, node)) != NULL)
+	    continue;
+
+	fuzz_pat_every = 1;
+	fuzz_pat_keys(buf, size, ppp, fuzz_pat_delete);
+
+	if (pa_pat_find_next(ppp, NULL) != NULL)
+	    abort();
+
+	pa_pat_close(ppp);
+    }
+
+    if (pip)
+	pa_istr_close(pip);
+
+    fuzz_pat_bytes += pmp->pm_len;
+    pa_mmap_close(pmp);
+}
+
+static unsigned long
+fuzz_pat_alloc_bytes (void)
+{
+    return fuzz_psu_alloc_bytes() + fuzz_pat_bytes;
+}
+
+fuzz_target_t fuzz_target = {
+    .ft_name = "fuzz-pat",
+    .ft_init = fuzz_pat_init,
+    .ft_run = fuzz_pat_run,
+    .ft_alloc_bytes = fuzz_pat_alloc_bytes,
+};
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Fuzz the SLAX lexer and parser.  The input is read through a stdio
+ * stream, so slaxGetInput() refills the lexer's buffer as it would for
+ * a script file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slaxinternals.h"
+#include <libslax/slax.h>
+
+#include "fuzz.h"
+
+static void
+fuzz_slax_error (void *ctx UNUSED, const char *msg UNUSED, ...)
+{
+    return;			/* Errors are expected; keep quiet */
+}
+
+static void
+fuzz_slax_init (void)
+{
+    slaxMemStatsEnable();
+    xmlInitParser();
+    xsltInit();
+    slaxEnable(SLAX_ENABLE);
+    xmlSetGenericErrorFunc(NULL, fuzz_slax_error);
+}
+
+static void
+fuzz_slax_run (const uint8_t *data, size_t size)
+{
+    xmlDocPtr docp;
+    FILE *fp;
+    char *buf;
+
+    if (size == 0)
+	return;
+
+    /* fmemopen wants a writable buffer, even for reading */
+    buf = fuzz_string(data, size);
+    if (buf == NULL)
+	return;
+
+    fp = fmemopen(buf, size, "r");
+    if (fp == NULL)
+	return;
+
+    docp = slaxLoadFile("fuzz.slax", fp, NULL, FALSE);
+    if (docp)
+	xmlFreeDoc(docp);
+
+    fclose(fp);
+}
+
+static unsigned long
+fuzz_slax_alloc_bytes (void)
+{
+    slax_mem_stats_t sms;
+
+    slaxMemStatsGet(&sms);
+    return sms.sms_bytes;
+}
+
+fuzz_target_t fuzz_target = {
+    .ft_name = "fuzz-slax",
+    .ft_init = fuzz_slax_init,
+    .ft_run = fuzz_slax_run,
+    .ft_alloc_bytes = fuzz_slax_alloc_bytes,
+};
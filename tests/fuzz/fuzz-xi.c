@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Fuzz the libxi tokenizer (xi_source_next_token).  The first byte of
+ * the input picks the source flags, so the fuzzer can reach the
+ * whitespace, comment, and DTD handling.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <libpsu/psucommon.h>
+#include <parrotdb/pacommon.h>
+#include <libxi/xicommon.h>
+#include <libxi/xisource.h>
+
+#include "fuzz.h"
+
+static unsigned long fuzz_xi_bytes; /* Input buffer growth */
+
+static void
+fuzz_xi_init (void)
+{
+    fuzz_psu_count_allocs();
+}
+
+static void
+fuzz_xi_run (const uint8_t *data, size_t size)
+{
+    xi_source_flags_t flags = 0;
+    xi_source_t *srcp;
+    xi_node_type_t type;
+    char *cp, *rest;
+    FILE *fp;
+
+    if (size > 0) {
+	if (data[0] & 0x01)
+	    flags |= XPSF_IGNORE_WS;
+	if (data[0] & 0x02)
+	    flags |= XPSF_IGNORE_COMMENTS;
+	if (data[0] & 0x04)
+	    flags |= XPSF_IGNORE_DTD;
+	if (data[0] & 0x08)
+	    flags |= XPSF_TRIM_WS;
+	if (data[0] & 0x10)
+	    flags |= XPSF_LINE_NO;
+    }
+
+    /* xi_source_t reads from a file descriptor */
+    fp = tmpfile();
+    if (fp == NULL)
+	return;
+    if (size > 0 && fwrite(data, 1, size, fp) != size) {
+	fclose(fp);
+	return;
+    }
+    fflush(fp);
+    rewind(fp);
+
+    srcp = xi_source_create(fileno(fp), flags);
+    if (srcp == NULL) {
+	fclose(fp);
+	return;
+    }
+
+    for (;;) {
+	type = xi_source_next_token(srcp, &cp, &rest);
+	if (type == XI_TYPE_EOF || type == XI_TYPE_FAIL
+		|| type == XI_TYPE_NONE)
+	    break;
+
+	if (type == XI_TYPE_TEXT && cp && rest)
+	    xi_source_unescape(srcp, cp, rest - cp);
+    }
+
+    fuzz_xi_bytes += srcp->xps_size;
+
+    xi_source_destroy(srcp);	/* Leaves the fd alone */
+    fclose(fp);
+}
+
+static unsigned long
+fuzz_xi_alloc_bytes (void)
+{
+    return fuzz_psu_alloc_bytes() + fuzz_xi_bytes;
+}
+
+fuzz_target_t fuzz_target = {
+    .ft_name = "fuzz-xi",
+    .ft_init = fuzz_xi_init,
+    .ft_run = fuzz_xi_run,
+    .ft_alloc_bytes = fuzz_xi_alloc_bytes,
+};
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Common bits for the fuzzing harnesses.  Each harness supplies a
+ * fuzz_target_t describing the parser under test; fuzzmain.c turns
+ * that into both a libFuzzer entry point (LLVMFuzzerTestOneInput) and
+ * a standalone driver (for AFL and for running a corpus by hand).
+ *
+ * Beyond crashes, each input is held to a linear budget: the CPU time
+ * and the bytes allocated must stay below "base + per-byte * size".
+ * An input that goes over budget is reported, and under a fuzzer it
+ * aborts, so the fuzzer saves it like any other crash.
+ */
+
+#ifndef TESTS_FUZZ_FUZZ_H
+#define TESTS_FUZZ_FUZZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct fuzz_target_s {
+    const char *ft_name;	/* Name of the harness */
+    void (*ft_init)(void);	/* Called once, before any input */
+    void (*ft_run)(const uint8_t *data, size_t size); /* Parse an input */
+    unsigned long (*ft_alloc_bytes)(void); /* Bytes allocated so far */
+} fuzz_target_t;
+
+extern fuzz_target_t fuzz_target; /* Supplied by each harness */
+
+/*
+ * Counting allocator for psu_realloc/psu_free users (libxi, parrotdb)
+ */
+void fuzz_psu_count_allocs (void);
+unsigned long fuzz_psu_alloc_bytes (void);
+
+/*
+ * Return a NUL-terminated copy of the input, since most of our
+ * parsers want a C string.  The buffer is reused between calls.
+ */
+char *fuzz_string (const uint8_t *data, size_t size);
+
+int LLVMFuzzerInitialize (int *argcp, char ***argvp);
+int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size);
+
+#endif /* TESTS_FUZZ_FUZZ_H */
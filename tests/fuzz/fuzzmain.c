@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Driver for the fuzzing harnesses: the libFuzzer entry point, the
+ * linear budget check, and (unless built with -DFUZZ_LIBFUZZER) a
+ * main() that runs a set of files and directories through the target.
+ * The standalone driver works with AFL ("fuzz-xxx @@") and is what
+ * "make tests" uses to run the seed corpora.
+ *
+ * The budget is tuned with environment variables:
+ *     FUZZ_CPU_BASE_US      CPU time allowed for any input (usecs)
+ *     FUZZ_CPU_NS_PER_BYTE  additional CPU time per input byte (nsecs)
+ *     FUZZ_ALLOC_BASE       bytes allocated for any input
+ *     FUZZ_ALLOC_PER_BYTE   additional bytes allocated per input byte
+ *     FUZZ_ABORT            abort() on an over-budget input
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <err.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <libpsu/psucommon.h>
+#include <libpsu/psualloc.h>
+
+#include "fuzz.h"
+
+static unsigned long fuzz_cpu_base_us = 50000;
+static unsigned long fuzz_cpu_ns_per_byte = 5000;
+static unsigned long fuzz_alloc_base = 4 * 1024 * 1024;
+static unsigned long fuzz_alloc_per_byte = 512;
+static int fuzz_abort;
+static int fuzz_initialized;
+
+static unsigned long fuzz_psu_bytes;
+
+static void *
+fuzz_psu_realloc (void *ptr, size_t size)
+{
+    fuzz_psu_bytes += size;
+    return realloc(ptr, size);
+}
+
+/*
+ * Count the bytes requested through psu_realloc()
+ */
+void
+fuzz_psu_count_allocs (void)
+{
+    psu_set_allocator(fuzz_psu_realloc, free);
+}
+
+unsigned long
+fuzz_psu_alloc_bytes (void)
+{
+    return fuzz_psu_bytes;
+}
+
+char *
+fuzz_string (const uint8_t *data, size_t size)
+{
+    static char *buf;
+    static size_t bufsiz;
+
+    if (size + 1 > bufsiz) {
+	char *cp = realloc(buf, size + 1);
+	if (cp == NULL)
+	    return NULL;
+	buf = cp;
+	bufsiz = size + 1;
+    }
+
+    memcpy(buf, data, size);
+    buf[size] = '\0';
+    return buf;
+}
+
+static unsigned long
+fuzz_env (const char *name, unsigned long def)
+{
+    const char *cp = getenv(name);
+
+    return cp ? strtoul(cp, NULL, 0) : def;
+}
+
+static void
+fuzz_init (void)
+{
+    if (fuzz_initialized)
+	return;
+    fuzz_initialized = TRUE;
+
+    fuzz_cpu_base_us = fuzz_env("FUZZ_CPU_BASE_US", fuzz_cpu_base_us);
+    fuzz_cpu_ns_per_byte = fuzz_env("FUZZ_CPU_NS_PER_BYTE",
+				    fuzz_cpu_ns_per_byte);
+    fuzz_alloc_base = fuzz_env("FUZZ_ALLOC_BASE", fuzz_alloc_base);
+    fuzz_alloc_per_byte = fuzz_env("FUZZ_ALLOC_PER_BYTE",
+				   fuzz_alloc_per_byte);
+    fuzz_abort = getenv("FUZZ_ABORT") ? TRUE : FALSE;
+
+    if (fuzz_target.ft_init)
+	fuzz_target.ft_init();
+}
+
+static unsigned long
+fuzz_cpu_usecs (void)
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) < 0)
+	return 0;
+
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000UL
+	+ ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+/*
+ * Run one input, returning the CPU time it took and the bytes it
+ * allocated
+ */
+static void
+fuzz_measure (const uint8_t *data, size_t size,
+	      unsigned long *cpup, unsigned long *allocp)
+{
+    unsigned long cpu, alloc;
+
+    cpu = fuzz_cpu_usecs();
+    alloc = fuzz_target.ft_alloc_bytes ? fuzz_target.ft_alloc_bytes() : 0;
+
+    fuzz_target.ft_run(data, size);
+
+    *cpup = fuzz_cpu_usecs() - cpu;
+    *allocp = fuzz_target.ft_alloc_bytes
+	? fuzz_target.ft_alloc_bytes() - alloc : 0;
+}
+
+/*
+ * Run one input, returning TRUE if it went over budget.  CPU time
+ * is noisy on a busy machine, so an input that's only over on time
+ * gets a second run, and the faster run counts.
+ */
+static int
+fuzz_one (const char *name, const uint8_t *data, size_t size, int verbose)
+{
+    unsigned long cpu, alloc, cpu_budget, alloc_budget, cpu2, alloc2;
+    int over;
+
+    cpu_budget = fuzz_cpu_base_us + (fuzz_cpu_ns_per_byte * size) / 1000;
+    alloc_budget = fuzz_alloc_base + fuzz_alloc_per_byte * size;
+
+    fuzz_measure(data, size, &cpu, &alloc);
+
+    if (cpu > cpu_budget && alloc <= alloc_budget) {
+	fuzz_measure(data, size, &cpu2, &alloc2);
+	if (cpu2 < cpu)
+	    cpu = cpu2;
+    }
+
+    over = (cpu > cpu_budget || alloc > alloc_budget);
+
+    if (over || verbose)
+	fprintf(stderr, "%s: %s: %zu bytes, cpu %lu us (budget %lu), "
+		"alloc %lu bytes (budget %lu)%s\n",
+		fuzz_target.ft_name, name, size, cpu, cpu_budget,
+		alloc, alloc_budget, over ? ": over budget" : "");
+
+    if (over && fuzz_abort)
+	abort();
+
+    return over;
+}
+
+int
+LLVMFuzzerInitialize (int *argcp UNUSED, char ***argvp UNUSED)
+{
+    fuzz_init();
+    return 0;
+}
+
+int
+LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+    fuzz_init();
+    fuzz_abort = TRUE;		/* Let the fuzzer save the input */
+    fuzz_one("input", data, size, FALSE);
+    return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+static int fuzz_inputs, fuzz_over;
+
+static void
+fuzz_file (const char *filename, int verbose)
+{
+    struct stat st;
+    uint8_t *data;
+    ssize_t len;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+	warn("could not open file: '%s'", filename);
+	if (fd >= 0)
+	    close(fd);
+	return;
+    }
+
+    data = malloc(st.st_size + 1);
+    if (data == NULL)
+	errx(1, "out of memory");
+
+    len = read(fd, data, st.st_size);
+    close(fd);
+
+    if (len < 0) {
+	warn("could not read file: '%s'", filename);
+	free(data);
+	return;
+    }
+
+    fuzz_inputs += 1;
+    if (fuzz_one(filename, data, len, verbose))
+	fuzz_over += 1;
+
+    free(data);
+}
+
+static void
+fuzz_path (const char *path, int verbose)
+{
+    struct stat st;
+    struct dirent *dp;
+    DIR *dirp;
+    char *full;
+
+    if (stat(path, &st) < 0 || !S_ISDIR(st.st_mode)) {
+	fuzz_file(path, verbose);
+	return;
+    }
+
+    dirp = opendir(path);
+    if (dirp == NULL) {
+	warn("could not open directory: '%s'", path);
+	return;
+    }
+
+    while ((dp = readdir(dirp)) != NULL) {
+	if (dp->d_name[0] == '.')
+	    continue;
+
+	if (asprintf(&full, "%s/%s", path, dp->d_name) < 0)
+	    errx(1, "out of memory");
+	fuzz_path(full, verbose);
+	free(full);
+    }
+
+    closedir(dirp);
+}
+
+int
+main (int argc, char **argv)
+{
+    int verbose = FALSE, quiet = FALSE;
+    int i;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+	if (strcmp(argv[i], "-v") == 0)
+	    verbose = TRUE;
+	else if (strcmp(argv[i], "-q") == 0)
+	    quiet = TRUE;
+	else
+	    errx(1, "usage: %s [-q] [-v] file-or-directory ...", argv[0]);
+    }
+
+    fuzz_init();
+
+    for ( ; i < argc; i++)
+	fuzz_path(argv[i], verbose);
+
+    if (!quiet || fuzz_over)
+	printf("%s: %d inputs, %d over budget\n",
+	       fuzz_target.ft_name, fuzz_inputs, fuzz_over);
+
+    return fuzz_over ? 1 : 0;
+}
+
+#endif /* FUZZ_LIBFUZZER */
@@ -0,0 +1,416 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Patricia tree deletes and concurrent readers.  Keys are added ("k")
+ * and deleted ("f") by slot.  With "threads N", the tree runs with
+ * concurrent readers enabled, and closing runs a stress test: N
+ * reader threads look up every key left in the tree while the writer
+ * adds and deletes other keys underneath them.  Readers must never
+ * miss a key, see a node with the wrong key, or get a getnext answer
+ * that isn't larger than the key asked about.  "s next <key>" adds
+ * the key, deletes it, and walks on from the deleted node, which
+ * only works with concurrent readers enabled.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/papat.h>
+
+#define NEED_KEY
+#define NEED_OTHER
+#include "pamain.h"
+
+#define STRESS_ROUNDS	200	/* Writer rounds */
+#define STRESS_BATCH	64	/* Keys added and deleted per round */
+
+pa_mmap_t *pmp;
+pa_istr_t *pip;
+pa_pat_t *ppp;
+
+typedef struct stress_reader_s {
+    pthread_t sr_tid;		/* Our thread */
+    const char **sr_keys;	/* Keys that must always be found */
+    unsigned sr_count;		/* Number of sr_keys */
+    unsigned long sr_passes;	/* Passes over sr_keys */
+    unsigned long sr_misses;	/* Stable keys not found */
+    unsigned long sr_bad;	/* Nodes with the wrong key */
+    unsigned long sr_order;	/* getnext answers out of order */
+} stress_reader_t;
+
+static volatile int stress_done;
+
+void
+test_init (void)
+{
+    return;
+}
+
+static const uint8_t *
+test_key_func (pa_pat_t *root, pa_pat_data_atom_t datom)
+{
+    pa_istr_atom_t atom = pa_istr_atom(pa_pat_data_atom_of(datom));
+    return (const uint8_t *) pa_istr_atom_string(root->pp_data, atom);
+}
+
+static const char *
+test_node_key (pa_pat_node_t *node)
+{
+    return node ? (const char *) pa_pat_key(ppp, node) : NULL;
+}
+
+void
+test_open (void)
+{
+    pmp = pa_mmap_open(opt_filename, "pa08", 0, 0644);
+    assert(pmp);
+
+    pip = pa_istr_open(pmp, "istr", opt_shift, 2, opt_max_atoms);
+    assert(pip);
+
+    ppp = pa_pat_open(pmp, "pat", pip, test_key_func,
+		      PA_PAT_MAXKEY, opt_shift, opt_max_atoms);
+    assert(ppp);
+
+    /* One extra reader slot, for test_next() */
+    if (opt_threads && !pa_pat_rcu_init(ppp, opt_threads + 1))
+	pa_warning(0, "could not enable concurrent readers");
+}
+
+void
+test_alloc (unsigned slot UNUSED, unsigned this_size UNUSED)
+{
+    return;
+}
+
+static psu_boolean_t
+test_add (const char *key)
+{
+    pa_istr_atom_t atom = pa_istr_string(pip, key);
+
+    if (pa_istr_is_null(atom))
+	return FALSE;
+
+    return pa_pat_add(ppp, pa_pat_data_atom(pa_istr_atom_of(atom)),
+		      strlen(key) + 1);
+}
+
+static psu_boolean_t
+test_delete (const char *key)
+{
+    pa_pat_node_t *node = pa_pat_get(ppp, strlen(key) + 1, key);
+
+    return node ? pa_pat_delete(ppp, node) : FALSE;
+}
+
+void
+test_key (unsigned slot, const char *key)
+{
+    size_t len = key ? strlen(key) : 0;
+    test_t *tp;
+
+    if (len == 0 || trec[slot])
+	return;
+
+    tp = calloc(1, sizeof(*tp) + len + 1);
+    if (tp == NULL)
+	return;
+
+    tp->t_magic = opt_magic;
+    tp->t_slot = slot;
+    memcpy(tp->t_val, key, len + 1);
+
+    if (!test_add(key)) {
+	printf("in %u : %s -> duplicate\n", slot, key);
+	free(tp);
+	return;
+    }
+
+    trec[slot] = tp;
+
+    if (!opt_quiet)
+	printf("in %u : %s\n", slot, key);
+}
+
+void
+test_free (unsigned slot)
+{
+    test_t *tp = trec[slot];
+
+    if (tp == NULL) {
+	printf("%u : free\n", slot);
+	return;
+    }
+
+    if (!test_delete((const char *) tp->t_val)) {
+	printf("free %u : %s -> not found\n", slot, (char *) tp->t_val);
+	return;
+    }
+
+    if (!opt_quiet)
+	printf("free %u : %s\n", slot, (char *) tp->t_val);
+
+    free(tp);
+    trec[slot] = NULL;
+}
+
+void
+test_print (unsigned slot)
+{
+    test_t *tp = trec[slot];
+    const char *key;
+
+    if (tp == NULL) {
+	printf("%u : free\n", slot);
+	return;
+    }
+
+    key = (const char *) tp->t_val;
+    printf("%u : %s -> %s\n", slot, key,
+	   pa_pat_get(ppp, strlen(key) + 1, key) ? "found" : "missing");
+}
+
+void
+test_list (const char *key)
+{
+    uint16_t plen = strlen(key) * PA_NBBY;
+    pa_pat_node_t *node;
+
+    node = pa_pat_subtree_match(ppp, plen, key);
+    for ( ; node; node = pa_pat_subtree_next(ppp, node, plen))
+	printf("  [%s]\n", test_node_key(node));
+}
+
+void
+test_dump (void)
+{
+    pa_pat_node_t *node = NULL;
+    const char *last = NULL, *key;
+    unsigned count = 0;
+
+    while ((node = pa_pat_find_next(ppp, node)) != NULL) {
+	key = test_node_key(node);
+	printf("  [%s]%s\n", key,
+	       (last && strcmp(last, key) >= 0) ? " out of order" : "");
+	last = key;
+	count += 1;
+    }
+
+    printf("dump: %u nodes\n", count);
+}
+
+/*
+ * Walk on from a node deleted after we found it, as a reader would
+ * if the writer deleted the node under it
+ */
+static void
+test_next (const char *key)
+{
+    static int reader = -1;
+    uint16_t plen = 2 * PA_NBBY;
+    pa_pat_node_t *node, *next, *subnext;
+
+    if (ppp->pp_rcu == NULL) {
+	printf("next %s: needs concurrent readers\n", key);
+	return;
+    }
+
+    if (reader < 0)
+	reader = pa_pat_read_register(ppp);
+    if (reader < 0 || strlen(key) < 2 || !test_add(key))
+	return;
+
+    pa_pat_read_enter(ppp, reader);
+
+    node = pa_pat_get(ppp, strlen(key) + 1, key);
+    if (node && pa_pat_delete(ppp, node)) {
+	next = pa_pat_find_next(ppp, node);
+	subnext = pa_pat_subtree_next(ppp, node, plen);
+	printf("next %s: [%s], in subtree [%s]\n", key,
+	       next ? test_node_key(next) : "",
+	       subnext ? test_node_key(subnext) : "");
+    }
+
+    pa_pat_read_exit(ppp, reader);
+}
+
+void
+test_other (char *buf)
+{
+    if (*buf++ != 's')
+	return;
+
+    while (isspace((int) *buf))
+	buf += 1;
+
+    if (strncmp(buf, "next ", 5) == 0)
+	test_next(buf + 5);
+    else
+	printf("unknown command: '%s'\n", buf);
+}
+
+static void *
+stress_reader (void *arg)
+{
+    stress_reader_t *srp = arg;
+    pa_pat_node_t *node;
+    const char *key, *next;
+    char vkey[64];
+    int reader, last = FALSE;
+    unsigned i;
+
+    reader = pa_pat_read_register(ppp);
+    if (reader < 0)
+	return NULL;
+
+    while (!last) {
+	/* Always finish with a full pass after the writer is done */
+	last = stress_done;
+
+	for (i = 0; i < srp->sr_count; i++) {
+	    key = srp->sr_keys[i];
+
+	    pa_pat_read_enter(ppp, reader);
+
+	    node = pa_pat_get(ppp, strlen(key) + 1, key);
+	    if (node == NULL)
+		srp->sr_misses += 1;
+	    else if (strcmp(test_node_key(node), key) != 0)
+		srp->sr_bad += 1;
+
+	    node = pa_pat_getnext(ppp, strlen(key) + 1, key, FALSE);
+	    next = test_node_key(node);
+	    if (next && strcmp(next, key) <= 0)
+		srp->sr_order += 1;
+
+	    /*
+	     * Keys the writer is churning may or may not be there, but
+	     * a node we found must stay intact (not be freed and reused
+	     * for another key) until we leave, even if we let the
+	     * writer run.
+	     */
+	    snprintf(vkey, sizeof(vkey), "~stress %u", i % STRESS_BATCH);
+	    node = pa_pat_getnext(ppp, strlen(vkey) + 1, vkey, TRUE);
+	    next = test_node_key(node);
+	    if (next && strcmp(next, vkey) < 0)
+		srp->sr_order += 1;
+
+	    if (node && (i & 7) == 0) {
+		sched_yield();
+		if (test_node_key(node) != next)
+		    srp->sr_bad += 1;
+	    }
+
+	    pa_pat_read_exit(ppp, reader);
+	}
+
+	srp->sr_passes += 1;
+    }
+
+    return NULL;
+}
+
+static void
+stress_writer (void)
+{
+    char key[64];
+    unsigned round, i, failed = 0;
+
+    for (round = 0; round < STRESS_ROUNDS; round++) {
+	for (i = 0; i < STRESS_BATCH; i++) {
+	    snprintf(key, sizeof(key), "~stress %u", i);
+	    if (!test_add(key))
+		failed += 1;
+	}
+
+	for (i = 0; i < STRESS_BATCH; i++) {
+	    snprintf(key, sizeof(key), "~stress %u", i);
+	    if (!test_delete(key))
+		failed += 1;
+	}
+    }
+
+    if (failed)
+	printf("stress: writer failed %u times\n", failed);
+}
+
+static void
+stress_test (void)
+{
+    stress_reader_t *readers;
+    const char **keys;
+    unsigned slot, count = 0, i;
+    unsigned long misses = 0, bad = 0, order = 0;
+
+    keys = calloc(opt_count, sizeof(*keys));
+    readers = calloc(opt_threads, sizeof(*readers));
+    if (keys == NULL || readers == NULL)
+	return;
+
+    for (slot = 0; slot < opt_count; slot++)
+	if (trec[slot])
+	    keys[count++] = (const char *) trec[slot]->t_val;
+
+    stress_done = FALSE;
+    for (i = 0; i < opt_threads; i++) {
+	readers[i].sr_keys = keys;
+	readers[i].sr_count = count;
+	if (pthread_create(&readers[i].sr_tid, NULL,
+			   stress_reader, &readers[i]))
+	    pa_warning(0, "could not create reader thread");
+    }
+
+    stress_writer();
+    stress_done = TRUE;
+
+    for (i = 0; i < opt_threads; i++) {
+	pthread_join(readers[i].sr_tid, NULL);
+	misses += readers[i].sr_misses;
+	bad += readers[i].sr_bad;
+	order += readers[i].sr_order;
+    }
+
+    printf("stress: %u readers, %u keys, %u rounds of %u adds and deletes\n",
+	   opt_threads, count, STRESS_ROUNDS, STRESS_BATCH);
+    printf("stress: %lu misses, %lu bad nodes, %lu out of order\n",
+	   misses, bad, order);
+
+    pa_pat_rcu_synchronize(ppp);
+    printf("stress: %u nodes awaiting free\n",
+	   ppp->pp_rcu ? ppp->pp_rcu->prc_num_retired : 0);
+
+    free(readers);
+    free(keys);
+}
+
+void
+test_close (void)
+{
+    if (opt_threads)
+	stress_test();
+
+    test_dump();
+
+    pa_pat_close(ppp);
+    pa_istr_close(pip);
+    pa_mmap_close(pmp);
+}
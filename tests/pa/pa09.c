@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Copy-on-write snapshots of a pa_mmap segment.  Besides the usual
+ * commands, "s snap" takes a snapshot and makes it the current view,
+ * "s merge" writes it back into the original, and "s discard" drops
+ * it.  Allocations and frees apply to whichever view is current.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+
+#define NEED_OTHER
+#include "pamain.h"
+
+pa_mmap_t *pmp;			/* The original segment */
+pa_fixed_t *pfp;
+pa_mmap_t *snap;		/* The snapshot (or NULL) */
+pa_fixed_t *snap_pfp;
+pa_atom_t *ids;			/* Atom for each slot in the current view */
+pa_atom_t *saved_ids;		/* The original's atoms, while snapped */
+
+static pa_fixed_t *
+test_pool (void)
+{
+    return snap ? snap_pfp : pfp;
+}
+
+/*
+ * Rebuild trec[] for the current view; the atoms are the same in
+ * every view, but the addresses are not.
+ */
+static void
+test_remap (void)
+{
+    unsigned slot;
+
+    for (slot = 0; slot < opt_count; slot++)
+	trec[slot] = ids[slot] ? pa_fixed_atom_addr(test_pool(),
+					pa_fixed_atom(ids[slot])) : NULL;
+}
+
+void
+test_init (void)
+{
+    return;
+}
+
+void
+test_open (void)
+{
+    pmp = pa_mmap_open(opt_filename, "pa09", 0, 0644);
+    assert(pmp != NULL);
+
+    pfp = pa_fixed_open(pmp, "pa_09", opt_shift, opt_size, opt_max_atoms);
+    assert(pfp != NULL);
+
+    ids = psu_calloc(opt_count * sizeof(*ids));
+    saved_ids = psu_calloc(opt_count * sizeof(*saved_ids));
+    assert(ids != NULL && saved_ids != NULL);
+}
+
+void
+test_alloc (unsigned slot, unsigned size UNUSED)
+{
+    pa_fixed_atom_t atom = pa_fixed_alloc_atom(test_pool());
+    test_t *tp = pa_fixed_atom_addr(test_pool(), atom);
+
+    trec[slot] = tp;
+    ids[slot] = pa_fixed_atom_of(atom);
+    if (tp) {
+	tp->t_magic = opt_magic;
+	tp->t_id = pa_fixed_atom_of(atom);
+	tp->t_slot = slot;
+    }
+
+    if (!opt_quiet)
+	printf("in %u : %u%s\n", slot, pa_fixed_atom_of(atom),
+	       snap ? " (snapshot)" : "");
+}
+
+void
+test_free (unsigned slot)
+{
+    if (trec[slot] == NULL)
+	return;
+
+    printf("free %u : %u%s\n", slot, ids[slot], snap ? " (snapshot)" : "");
+
+    pa_fixed_free_atom(test_pool(), pa_fixed_atom(ids[slot]));
+    trec[slot] = NULL;
+    ids[slot] = 0;
+}
+
+void
+test_print (unsigned slot)
+{
+    test_t *tp = trec[slot];
+
+    if (tp == NULL)
+	return;
+
+    printf("%u : %u%s%s%s\n", slot, ids[slot],
+	   (tp->t_magic != opt_magic) ? " bad-magic" : "",
+	   (tp->t_slot != slot) ? " bad-slot" : "",
+	   (tp->t_id != ids[slot]) ? " bad-id" : "");
+}
+
+void
+test_dump (void)
+{
+    unsigned slot;
+
+    printf("dumping%s: (%u)\n", snap ? " snapshot" : "", opt_count);
+
+    for (slot = 0; slot < opt_count; slot++)
+	test_print(slot);
+}
+
+void
+test_other (char *buf)
+{
+    int rc;
+
+    if (*buf++ != 's')
+	return;
+
+    while (isspace((int) *buf))
+	buf += 1;
+
+    if (strcmp(buf, "snap") == 0) {
+	if (snap != NULL) {
+	    printf("snapshot already open\n");
+	    return;
+	}
+
+	snap = pa_mmap_snapshot(pmp);
+	if (snap == NULL) {
+	    printf("snapshot failed\n");
+	    return;
+	}
+
+	snap_pfp = pa_fixed_open(snap, "pa_09", opt_shift, opt_size,
+				 opt_max_atoms);
+	assert(snap_pfp != NULL);
+
+	memcpy(saved_ids, ids, opt_count * sizeof(*ids));
+	printf("snapshot (len %zu)\n", snap->pm_len);
+
+    } else if (strcmp(buf, "merge") == 0 || strcmp(buf, "discard") == 0) {
+	if (snap == NULL) {
+	    printf("no snapshot\n");
+	    return;
+	}
+
+	pa_fixed_close(snap_pfp);
+	snap_pfp = NULL;
+
+	if (buf[0] == 'm') {
+	    rc = pa_mmap_snapshot_merge(snap);
+	    printf("merged %d pages (len %zu)\n", rc, pmp->pm_len);
+	} else {
+	    pa_mmap_close(snap);
+	    memcpy(ids, saved_ids, opt_count * sizeof(*ids));
+	    printf("discarded\n");
+	}
+
+	snap = NULL;
+
+    } else {
+	printf("unknown snapshot command: '%s'\n", buf);
+	return;
+    }
+
+    test_remap();
+}
+
+void
+test_close (void)
+{
+    if (snap) {
+	pa_fixed_close(snap_pfp);
+	pa_mmap_close(snap);
+    }
+
+    pa_fixed_close(pfp);
+    pa_mmap_close(pmp);
+
+    psu_free(saved_ids);
+    psu_free(ids);
+}
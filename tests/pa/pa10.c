@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Compressed pa_mmap files.  Besides the usual commands, "s ckpt"
+ * checkpoints the file, "s reopen" closes and reopens it (leaving
+ * every page cold), and "s stats" reports the page states.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+
+#define NEED_OTHER
+#include "pamain.h"
+
+pa_mmap_t *pmp;
+pa_fixed_t *pfp;
+pa_atom_t *ids;			/* Atom for each slot */
+
+void
+test_init (void)
+{
+    return;
+}
+
+void
+test_open (void)
+{
+    unsigned slot;
+
+    pmp = pa_mmap_open(opt_filename, "pa10", PMF_COMPRESSED, 0644);
+    assert(pmp != NULL);
+
+    pfp = pa_fixed_open(pmp, "pa_10", opt_shift, opt_size, opt_max_atoms);
+    assert(pfp != NULL);
+
+    if (ids == NULL) {
+	ids = psu_calloc(opt_count * sizeof(*ids));
+	assert(ids != NULL);
+    }
+
+    /* Addresses are the same each time, so this touches nothing */
+    for (slot = 0; slot < opt_count; slot++)
+	trec[slot] = ids[slot] ? pa_fixed_atom_addr(pfp,
+					pa_fixed_atom(ids[slot])) : NULL;
+}
+
+void
+test_alloc (unsigned slot, unsigned size UNUSED)
+{
+    pa_fixed_atom_t atom = pa_fixed_alloc_atom(pfp);
+    test_t *tp = pa_fixed_atom_addr(pfp, atom);
+
+    trec[slot] = tp;
+    ids[slot] = pa_fixed_atom_of(atom);
+    if (tp) {
+	tp->t_magic = opt_magic;
+	tp->t_id = pa_fixed_atom_of(atom);
+	tp->t_slot = slot;
+	memset(tp->t_val, slot & 0xff, opt_size - sizeof(*tp));
+    }
+
+    if (!opt_quiet)
+	printf("in %u : %u\n", slot, pa_fixed_atom_of(atom));
+}
+
+void
+test_free (unsigned slot)
+{
+    if (trec[slot] == NULL)
+	return;
+
+    printf("free %u : %u\n", slot, ids[slot]);
+
+    pa_fixed_free_atom(pfp, pa_fixed_atom(ids[slot]));
+    trec[slot] = NULL;
+    ids[slot] = 0;
+}
+
+void
+test_print (unsigned slot)
+{
+    test_t *tp = trec[slot];
+    unsigned i, bad = 0;
+
+    if (tp == NULL)
+	return;
+
+    for (i = 0; i < opt_size - sizeof(*tp); i++)
+	if (((psu_byte_t *) tp->t_val)[i] != (slot & 0xff))
+	    bad += 1;
+
+    printf("%u : %u%s%s%s%s\n", slot, ids[slot],
+	   (tp->t_magic != opt_magic) ? " bad-magic" : "",
+	   (tp->t_slot != slot) ? " bad-slot" : "",
+	   (tp->t_id != ids[slot]) ? " bad-id" : "",
+	   bad ? " bad-value" : "");
+}
+
+void
+test_dump (void)
+{
+    unsigned slot;
+
+    printf("dumping: (%u)\n", opt_count);
+
+    for (slot = 0; slot < opt_count; slot++)
+	test_print(slot);
+}
+
+void
+test_other (char *buf)
+{
+    unsigned cold, clean, dirty;
+    size_t file_len;
+
+    if (*buf++ != 's')
+	return;
+
+    while (isspace((int) *buf))
+	buf += 1;
+
+    if (strcmp(buf, "ckpt") == 0) {
+	printf("checkpoint %s\n",
+	       (pa_mmap_checkpoint(pmp) == 0) ? "done" : "failed");
+
+    } else if (strcmp(buf, "reopen") == 0) {
+	pa_fixed_close(pfp);
+	pa_mmap_close(pmp);
+	test_open();
+	printf("reopened\n");
+
+    } else if (strcmp(buf, "stats") == 0) {
+	pa_mmap_zone_stats(pmp, &cold, &clean, &dirty, &file_len);
+	printf("pages: cold %u, clean %u, dirty %u; file %zu\n",
+	       cold, clean, dirty, file_len);
+
+    } else {
+	printf("unknown command: '%s'\n", buf);
+    }
+}
+
+void
+test_close (void)
+{
+    pa_fixed_close(pfp);
+    pa_mmap_close(pmp);
+    psu_free(ids);
+}
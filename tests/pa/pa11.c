@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * NUMA node lists and pa_mmap replicas.  Besides the usual commands,
+ * "s numa <list>" parses a node list, "s replica" makes a replica
+ * on node zero, "s check" compares the records in the replica with
+ * the original, and "s sync" brings the replica up to date.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+
+#define NEED_OTHER
+#include "pamain.h"
+
+pa_mmap_t *pmp;
+pa_fixed_t *pfp;
+pa_atom_t *ids;			/* Atom for each slot */
+
+pa_mmap_t *replica;
+pa_fixed_t *rpfp;		/* pfp, opened on the replica */
+
+void
+test_init (void)
+{
+    return;
+}
+
+void
+test_open (void)
+{
+    pmp = pa_mmap_open(opt_filename, "pa11", 0, 0644);
+    assert(pmp != NULL);
+
+    pfp = pa_fixed_open(pmp, "pa_11", opt_shift, opt_size, opt_max_atoms);
+    assert(pfp != NULL);
+
+    ids = psu_calloc(opt_count * sizeof(*ids));
+    assert(ids != NULL);
+}
+
+void
+test_alloc (unsigned slot, unsigned size UNUSED)
+{
+    pa_fixed_atom_t atom = pa_fixed_alloc_atom(pfp);
+    test_t *tp = pa_fixed_atom_addr(pfp, atom);
+
+    trec[slot] = tp;
+    ids[slot] = pa_fixed_atom_of(atom);
+    if (tp) {
+	tp->t_magic = opt_magic;
+	tp->t_id = pa_fixed_atom_of(atom);
+	tp->t_slot = slot;
+	memset(tp->t_val, slot & 0xff, opt_size - sizeof(*tp));
+    }
+
+    if (!opt_quiet)
+	printf("in %u : %u\n", slot, pa_fixed_atom_of(atom));
+}
+
+void
+test_free (unsigned slot)
+{
+    if (trec[slot] == NULL)
+	return;
+
+    printf("free %u : %u\n", slot, ids[slot]);
+
+    /* Scribble on it, so the replica's copy differs */
+    memset(trec[slot], 0, opt_size);
+    pa_fixed_free_atom(pfp, pa_fixed_atom(ids[slot]));
+    trec[slot] = NULL;
+    ids[slot] = 0;
+}
+
+void
+test_print (unsigned slot)
+{
+    test_t *tp = trec[slot];
+
+    if (tp == NULL)
+	return;
+
+    printf("%u : %u%s%s\n", slot, ids[slot],
+	   (tp->t_magic != opt_magic) ? " bad-magic" : "",
+	   (tp->t_slot != slot) ? " bad-slot" : "");
+}
+
+void
+test_dump (void)
+{
+    unsigned slot;
+
+    printf("dumping: (%u)\n", opt_count);
+
+    for (slot = 0; slot < opt_count; slot++)
+	test_print(slot);
+}
+
+/*
+ * Compare each record in the original with its copy in the replica
+ */
+static void
+test_check (void)
+{
+    unsigned slot, count = 0, differ = 0;
+    test_t *tp;
+
+    if (rpfp == NULL) {
+	printf("no replica\n");
+	return;
+    }
+
+    for (slot = 0; slot < opt_count; slot++) {
+	if (ids[slot] == 0)
+	    continue;
+
+	count += 1;
+	tp = pa_fixed_atom_addr(rpfp, pa_fixed_atom(ids[slot]));
+	if (tp == NULL || memcmp(tp, trec[slot], opt_size) != 0)
+	    differ += 1;
+    }
+
+    printf("replica: %u records, %u differ\n", count, differ);
+}
+
+void
+test_other (char *buf)
+{
+    pa_numa_mask_t mask;
+    int pages;
+
+    if (*buf++ != 's')
+	return;
+
+    while (isspace((int) *buf))
+	buf += 1;
+
+    if (strncmp(buf, "numa", 4) == 0 && (buf[4] == '\0' || buf[4] == ' ')) {
+	buf += 4;
+	while (isspace((int) *buf))
+	    buf += 1;
+
+	if (pa_numa_parse(buf, &mask) < 0)
+	    printf("numa '%s': invalid\n", buf);
+	else
+	    printf("numa '%s': %#llx\n", buf, (unsigned long long) mask);
+
+    } else if (strcmp(buf, "replica") == 0) {
+	replica = pa_mmap_replica(pmp, 0);
+	assert(replica != NULL);
+
+	rpfp = pa_fixed_open(replica, "pa_11", opt_shift, opt_size,
+			     opt_max_atoms);
+	assert(rpfp != NULL);
+	printf("replica made\n");
+
+    } else if (strcmp(buf, "sync") == 0) {
+	pages = replica ? pa_mmap_replica_sync(replica) : -1;
+	printf("sync: %d page%s\n", pages, (pages == 1) ? "" : "s");
+
+    } else if (strcmp(buf, "check") == 0) {
+	test_check();
+
+    } else {
+	printf("unknown command: '%s'\n", buf);
+    }
+}
+
+void
+test_close (void)
+{
+    if (rpfp)
+	pa_fixed_close(rpfp);
+    if (replica)
+	pa_mmap_close(replica);
+
+    pa_fixed_close(pfp);
+    pa_mmap_close(pmp);
+    psu_free(ids);
+}
@@ -0,0 +1,1305 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Allocation benchmark for the parrotdb allocators.  A trace is a
+ * sequence of "a<slot> <size>" (allocate) and "f<slot>" (free) lines,
+ * the same format as the pa*.in test scripts, so those scripts can
+ * be replayed as well.  Other lines are ignored.
+ *
+ *   pabench capture FILE...
+ *	Tokenize each XML file with libxi and build the workspace the
+ *	way the XI tree builder does (a pa_fixed node per tag and text
+ *	token, pa_arb copies of text and attribute strings, names
+ *	interned in a pa_istr/pa_pat name pool), writing the
+ *	allocation trace to stdout.  The workspace is discarded after
+ *	each file, so everything still allocated is freed then.
+ *
+ *   pabench replay FILE...
+ *	Replay the trace(s) against each allocator, reporting ops/sec,
+ *	arena and resident bytes, fragmentation (the part of the arena
+ *	not holding live data at the peak), and free list lengths.
+ *
+ *   pabench lookup
+ *	Build a pa_pat name index with concurrent readers enabled and
+ *	time lookups from 1, 8 and 32 reader threads (or just the
+ *	"threads" given), each doing a million lookups per loop.
+ *	With "writer", a writer thread adds and deletes keys the
+ *	whole time.
+ *
+ *   pabench numa
+ *	Build the same index, then for each NUMA node, pin reader
+ *	threads (4, or "threads") to that node's CPUs and time
+ *	lookups against the shared index and against a replica of
+ *	the segment placed on the node (pa_mmap_replica), reporting
+ *	the cost of each lookup.  Readers of the shared index reach
+ *	across to whatever node it landed on; readers of the replica
+ *	stay home.  Without NUMA, there's one node and the two
+ *	should match.
+ *
+ * Options (keywords, like the other pa tests):
+ *	allocator NAME	Replay against mmap, fixed, arb, istr or all
+ *	loops N		Replay the trace N times (freeing all between)
+ *	threads N	Run N threads, each with its own allocator
+ *	size N		Atom size for the fixed allocator
+ *	count N		Number of keys in the lookup index
+ *	writer		Run a writer during lookups
+ *	quiet		Don't report free list details
+ *
+ * pa_mmap and friends are not thread safe, so each thread replays
+ * against a private mmap segment; "threads" measures how well the
+ * allocators scale, not contention.  pa_istr never frees, so frees
+ * are counted but ignored, and the fixed allocator hands out one
+ * atom regardless of the requested size.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <err.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#include <libpsu/psucommon.h>
+#ifdef HAVE_SCHED_SETAFFINITY
+#include <sched.h>
+#endif /* HAVE_SCHED_SETAFFINITY */
+#include <libpsu/psualloc.h>
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paarb.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/papat.h>
+#include <libxi/xicommon.h>
+#include <libxi/xisource.h>
+
+#define BENCH_SHIFT		12 /* Page shift for fixed and istr */
+#define BENCH_NAME_SHIFT	2  /* Atom shift for istr (XI_ISTR_SHIFT) */
+#define BENCH_NODE_SIZE		16 /* sizeof(xi_node_t) */
+#define BENCH_MAX_NAMES		(1 << 20) /* Name pool size */
+
+/* One operation from a trace */
+typedef struct bench_op_s {
+    uint32_t bo_slot;		/* Slot number (object identity) */
+    uint32_t bo_size;		/* Size in bytes (allocations only) */
+    uint8_t bo_op;		/* PA_TRACE_ALLOC or PA_TRACE_FREE */
+} bench_op_t;
+
+typedef struct bench_trace_s {
+    bench_op_t *bt_ops;		/* Operations */
+    unsigned long bt_count;	/* Number of operations */
+    unsigned long bt_max;	/* Number allocated */
+    uint32_t bt_slots;		/* Highest slot number plus one */
+    unsigned long bt_bytes;	/* Total bytes allocated */
+    uint32_t bt_max_size;	/* Largest single allocation */
+} bench_trace_t;
+
+/* The allocators we know how to drive */
+#define BA_MMAP		0
+#define BA_FIXED	1
+#define BA_ARB		2
+#define BA_ISTR		3
+#define BA_MAX		4
+
+static const char *bench_alloc_names[BA_MAX] = {
+    "mmap", "fixed", "arb", "istr",
+};
+
+/* The state of one replay: one allocator in one thread */
+typedef struct bench_run_s {
+    int br_type;		/* Allocator (BA_*) */
+    bench_trace_t *br_trace;	/* Trace being replayed */
+    pa_mmap_t *br_mmap;		/* Our private segment */
+    pa_fixed_t *br_fixed;	/* Allocator, if BA_FIXED */
+    pa_arb_t *br_arb;		/* Allocator, if BA_ARB */
+    pa_istr_t *br_istr;		/* Allocator, if BA_ISTR */
+    pa_atom_t *br_atoms;	/* Atom for each live slot */
+    uint32_t *br_sizes;		/* Size for each live slot */
+    unsigned long br_ops;	/* Operations performed */
+    unsigned long br_failed;	/* Allocations that failed */
+    unsigned long br_ignored;	/* Frees we couldn't do (istr) */
+    unsigned long br_oversize;	/* Allocations bigger than an atom */
+    size_t br_live;		/* Bytes live now */
+    size_t br_peak;		/* Most bytes live at one time */
+} bench_run_t;
+
+static unsigned opt_loops = 1;
+static unsigned opt_threads = 1;
+static unsigned opt_size = 64;
+static int opt_alloc = -1;	/* -1 means all */
+static int opt_quiet;
+static int opt_threads_given;	/* "threads" was on the command line */
+static unsigned opt_count = 100000;
+static int opt_writer;
+
+static char *bench_fill;	/* Source bytes for istr strings */
+
+static void
+bench_trace_add (bench_trace_t *btp, int op, uint32_t slot, uint32_t size)
+{
+    if (btp->bt_count >= btp->bt_max) {
+	unsigned long max = btp->bt_max ? btp->bt_max * 2 : 1 << 16;
+	bench_op_t *ops = realloc(btp->bt_ops, max * sizeof(*ops));
+	if (ops == NULL)
+	    err(1, "out of memory for trace");
+	btp->bt_ops = ops;
+	btp->bt_max = max;
+    }
+
+    bench_op_t *bop = &btp->bt_ops[btp->bt_count++];
+    bop->bo_op = op;
+    bop->bo_slot = slot;
+    bop->bo_size = size;
+
+    if (slot >= btp->bt_slots)
+	btp->bt_slots = slot + 1;
+
+    if (op == PA_TRACE_ALLOC) {
+	btp->bt_bytes += size;
+	if (size > btp->bt_max_size)
+	    btp->bt_max_size = size;
+    }
+}
+
+/*
+ * Read a trace file, appending to the trace.  Slots in each file are
+ * offset past the slots of the previous ones, so several traces can
+ * be replayed together.
+ */
+static void
+bench_trace_read (bench_trace_t *btp, const char *filename)
+{
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL)
+	err(1, "could not open trace: %s", filename);
+
+    char buf[BUFSIZ], *cp;
+    uint32_t base = btp->bt_slots;
+    unsigned long slot, size;
+
+    while (fgets(buf, sizeof(buf), fp) != NULL) {
+	if (buf[0] != 'a' && buf[0] != 'f')
+	    continue;
+
+	slot = strtoul(buf + 1, &cp, 10);
+	if (cp == buf + 1)
+	    continue;
+
+	size = strtoul(cp, NULL, 10);
+	if (buf[0] == 'a' && size == 0)
+	    continue;
+
+	bench_trace_add(btp, (buf[0] == 'a') ? PA_TRACE_ALLOC : PA_TRACE_FREE,
+			base + slot, size);
+    }
+
+    fclose(fp);
+}
+
+/*
+ * Capturing: the trace function maps addresses to slots, reusing
+ * the slots of freed objects, and writes the trace as it goes.
+ */
+typedef struct bench_live_s {
+    void *bl_addr;		/* Address (NULL if unused) */
+    uint32_t bl_slot;		/* Slot number */
+} bench_live_t;
+
+static bench_live_t *bench_live;  /* Open hash of live objects */
+static unsigned long bench_live_max; /* Size of bench_live (power of 2) */
+static unsigned long bench_live_count; /* Entries in use */
+static uint32_t *bench_free_slots; /* Stack of reusable slots */
+static unsigned long bench_free_count;
+static uint32_t bench_next_slot;
+static int bench_capture_type;	/* PA_TYPE_* to capture, or 0 for all */
+
+static inline unsigned long
+bench_live_hash (void *addr)
+{
+    uintptr_t val = (uintptr_t) addr;
+
+    val ^= val >> 17;
+    val *= 0x9e3779b97f4a7c15ULL;
+    return (val >> 20) & (bench_live_max - 1);
+}
+
+static void bench_live_insert (void *addr, uint32_t slot);
+
+static void
+bench_live_grow (void)
+{
+    bench_live_t *old = bench_live;
+    unsigned long i, old_max = bench_live_max;
+
+    bench_live_max = old_max ? old_max * 2 : 1 << 12;
+    bench_live = calloc(bench_live_max, sizeof(*bench_live));
+    if (bench_live == NULL)
+	err(1, "out of memory for capture");
+
+    bench_live_count = 0;
+    for (i = 0; i < old_max; i++)
+	if (old[i].bl_addr)
+	    bench_live_insert(old[i].bl_addr, old[i].bl_slot);
+
+    free(old);
+}
+
+static void
+bench_live_insert (void *addr, uint32_t slot)
+{
+    if ((bench_live_count + 1) * 2 > bench_live_max)
+	bench_live_grow();
+
+    unsigned long i = bench_live_hash(addr);
+    while (bench_live[i].bl_addr && bench_live[i].bl_addr != addr)
+	i = (i + 1) & (bench_live_max - 1);
+
+    if (bench_live[i].bl_addr == NULL)
+	bench_live_count += 1;
+
+    bench_live[i].bl_addr = addr;
+    bench_live[i].bl_slot = slot;
+}
+
+/*
+ * Remove an entry, returning its slot (or -1 if not found).  Later
+ * entries in the same run are shifted back, so lookups never need
+ * tombstones.
+ */
+static long
+bench_live_remove (void *addr)
+{
+    if (bench_live_max == 0)
+	return -1;
+
+    unsigned long mask = bench_live_max - 1;
+    unsigned long i = bench_live_hash(addr), j, k;
+
+    while (bench_live[i].bl_addr != addr) {
+	if (bench_live[i].bl_addr == NULL)
+	    return -1;
+	i = (i + 1) & mask;
+    }
+
+    long slot = bench_live[i].bl_slot;
+
+    for (j = i;;) {
+	bench_live[i].bl_addr = NULL;
+	for (;;) {
+	    j = (j + 1) & mask;
+	    if (bench_live[j].bl_addr == NULL)
+		goto done;
+	    k = bench_live_hash(bench_live[j].bl_addr);
+	    /* Can entry j move back to i? Only if k isn't in (i, j] */
+	    if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+		continue;
+	    break;
+	}
+	bench_live[i] = bench_live[j];
+	i = j;
+    }
+
+ done:
+    bench_live_count -= 1;
+    return slot;
+}
+
+static void
+bench_slot_release (uint32_t slot)
+{
+    if ((bench_free_count & (bench_free_count - 1)) == 0) {
+	unsigned long max = bench_free_count ? bench_free_count * 2 : 64;
+	uint32_t *slots = realloc(bench_free_slots, max * sizeof(*slots));
+	if (slots == NULL)
+	    err(1, "out of memory for capture");
+	bench_free_slots = slots;
+    }
+
+    bench_free_slots[bench_free_count++] = slot;
+}
+
+static void
+bench_capture_func (int op, unsigned type, void *addr, size_t size)
+{
+    long slot;
+
+    if (bench_capture_type && (int) type != bench_capture_type)
+	return;
+
+    if (op == PA_TRACE_ALLOC) {
+	/* An address we think is live has been reused; close it out */
+	slot = bench_live_remove(addr);
+	if (slot >= 0) {
+	    printf("f%ld\n", slot);
+	    bench_slot_release(slot);
+	}
+
+	slot = bench_free_count ? bench_free_slots[--bench_free_count]
+	    : bench_next_slot++;
+	bench_live_insert(addr, slot);
+	printf("a%ld %zu\n", slot, size);
+
+    } else {
+	slot = bench_live_remove(addr);
+	if (slot >= 0) {
+	    printf("f%ld\n", slot);
+	    bench_slot_release(slot);
+	}
+    }
+}
+
+/* Free everything still live, as when a workspace is discarded */
+static void
+bench_capture_flush (void)
+{
+    unsigned long i;
+
+    for (i = 0; i < bench_live_max; i++) {
+	if (bench_live[i].bl_addr) {
+	    printf("f%u\n", bench_live[i].bl_slot);
+	    bench_slot_release(bench_live[i].bl_slot);
+	    bench_live[i].bl_addr = NULL;
+	}
+    }
+
+    bench_live_count = 0;
+}
+
+static const uint8_t *
+bench_name_key_func (pa_pat_t *root, pa_pat_data_atom_t datom)
+{
+    pa_istr_atom_t atom = pa_istr_atom(pa_pat_data_atom_of(datom));
+    return (const uint8_t *) pa_istr_atom_string(root->pp_data, atom);
+}
+
+/* Intern a name, as xi_namepool_atom() does */
+static void
+bench_capture_name (pa_pat_t *ppp, const char *name)
+{
+    uint16_t len = strlen(name) + 1;
+
+    if (len > PA_PAT_MAXKEY)
+	return;
+
+    pa_pat_data_atom_t datom = pa_pat_get_atom(ppp, len, name);
+    if (!pa_pat_data_is_null(datom))
+	return;
+
+    pa_istr_atom_t iatom = pa_istr_string(ppp->pp_data, name);
+    if (!pa_istr_is_null(iatom))
+	pa_pat_add(ppp, pa_pat_data_atom(pa_istr_atom_of(iatom)), len);
+}
+
+/* Copy a string into the text pool, as xi_insert_text() does */
+static void
+bench_capture_text (pa_arb_t *prp, const char *data, size_t len)
+{
+    pa_arb_atom_t atom = pa_arb_alloc(prp, len + 1);
+    char *cp = pa_arb_atom_addr(prp, atom);
+
+    if (cp) {
+	memcpy(cp, data, len);
+	cp[len] = '\0';
+    }
+}
+
+static void
+bench_capture_file (const char *filename)
+{
+    pa_mmap_t *pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+    if (pmp == NULL)
+	errx(1, "could not open mmap segment");
+
+    pa_fixed_t *nodes = pa_fixed_open(pmp, "nodes", BENCH_SHIFT,
+				      BENCH_NODE_SIZE, 1 << 26);
+    pa_arb_t *text = pa_arb_open(pmp, "data");
+    pa_istr_t *names = pa_istr_open(pmp, "names", BENCH_SHIFT,
+				    BENCH_NAME_SHIFT, BENCH_MAX_NAMES);
+    pa_pat_t *index = names ? pa_pat_open(pmp, "names.index", names,
+					  bench_name_key_func, PA_PAT_MAXKEY,
+					  BENCH_SHIFT, BENCH_MAX_NAMES) : NULL;
+    if (nodes == NULL || text == NULL || index == NULL)
+	errx(1, "could not open allocators");
+
+    xi_source_t *srcp = xi_source_open(filename, 0);
+    if (srcp == NULL)
+	errx(1, "could not open input: %s", filename);
+
+    printf("# capture of %s\n", filename);
+    pa_trace_set_func(bench_capture_func);
+
+    char *data, *rest;
+    xi_node_type_t type;
+
+    for (;;) {
+	type = xi_source_next_token(srcp, &data, &rest);
+	if (type == XI_TYPE_EOF || type == XI_TYPE_FAIL)
+	    break;
+
+	switch (type) {
+	case XI_TYPE_OPEN:
+	case XI_TYPE_EMPTY:
+	    bench_capture_name(index, data);
+	    pa_fixed_alloc_atom(nodes);
+	    if (rest && *rest) {
+		/* Attributes are kept as a single string until needed */
+		bench_capture_text(text, rest, strlen(rest));
+		pa_fixed_alloc_atom(nodes);
+	    }
+	    break;
+
+	case XI_TYPE_TEXT:
+	case XI_TYPE_UNESC:
+	case XI_TYPE_COMMENT:
+	case XI_TYPE_PI:
+	    bench_capture_text(text, data, strlen(data));
+	    pa_fixed_alloc_atom(nodes);
+	    break;
+	}
+    }
+
+    pa_trace_set_func(NULL);
+    bench_capture_flush();
+
+    xi_source_destroy(srcp);
+    pa_pat_close(index);
+    pa_istr_close(names);
+    pa_arb_close(text);
+    pa_fixed_close(nodes);
+    pa_mmap_close(pmp);
+}
+
+static void
+bench_run_open (bench_run_t *brp, int type, bench_trace_t *btp)
+{
+    uint32_t max_atoms;
+
+    bzero(brp, sizeof(*brp));
+    brp->br_type = type;
+    brp->br_trace = btp;
+
+    brp->br_mmap = pa_mmap_open(NULL, "pabench", 0, 0);
+    if (brp->br_mmap == NULL)
+	errx(1, "could not open mmap segment");
+
+    switch (type) {
+    case BA_FIXED:
+	max_atoms = pa_roundup_shift32(btp->bt_slots + 1, BENCH_SHIFT);
+	brp->br_fixed = pa_fixed_open(brp->br_mmap, "fixed", BENCH_SHIFT,
+				      opt_size, max_atoms);
+	if (brp->br_fixed == NULL)
+	    errx(1, "could not open fixed allocator");
+	break;
+
+    case BA_ARB:
+	brp->br_arb = pa_arb_open(brp->br_mmap, "arb");
+	if (brp->br_arb == NULL)
+	    errx(1, "could not open arb allocator");
+	break;
+
+    case BA_ISTR: {
+	/*
+	 * istr never frees, so it needs room for every loop.  A string
+	 * that doesn't fit in the current page starts a new one, so
+	 * the worst case is a page per string.
+	 */
+	unsigned long long pages = btp->bt_bytes
+	    >> (BENCH_SHIFT + BENCH_NAME_SHIFT);
+	pages = (pages + btp->bt_count + 1) * opt_loops;
+	if (pages > (1U << (31 - BENCH_SHIFT)))
+	    pages = 1U << (31 - BENCH_SHIFT);
+	max_atoms = pages << BENCH_SHIFT;
+
+	brp->br_istr = pa_istr_open(brp->br_mmap, "istr", BENCH_SHIFT,
+				    BENCH_NAME_SHIFT, max_atoms);
+	if (brp->br_istr == NULL)
+	    errx(1, "could not open istr allocator");
+	break;
+    }
+    }
+
+    brp->br_atoms = calloc(btp->bt_slots, sizeof(*brp->br_atoms));
+    brp->br_sizes = calloc(btp->bt_slots, sizeof(*brp->br_sizes));
+    if (brp->br_atoms == NULL || brp->br_sizes == NULL)
+	err(1, "out of memory for replay");
+}
+
+static void
+bench_run_close (bench_run_t *brp)
+{
+    if (brp->br_fixed)
+	pa_fixed_close(brp->br_fixed);
+    if (brp->br_arb)
+	pa_arb_close(brp->br_arb);
+    if (brp->br_istr)
+	pa_istr_close(brp->br_istr);
+    pa_mmap_close(brp->br_mmap);
+
+    free(brp->br_atoms);
+    free(brp->br_sizes);
+}
+
+static void
+bench_run_free (bench_run_t *brp, uint32_t slot)
+{
+    pa_atom_t atom = brp->br_atoms[slot];
+
+    if (atom == PA_NULL_ATOM)
+	return;
+
+    switch (brp->br_type) {
+    case BA_MMAP:
+	pa_mmap_free(brp->br_mmap, pa_mmap_atom(atom), brp->br_sizes[slot]);
+	break;
+
+    case BA_FIXED:
+	pa_fixed_free_atom(brp->br_fixed, pa_fixed_atom(atom));
+	break;
+
+    case BA_ARB:
+	pa_arb_free_atom(brp->br_arb, pa_arb_atom(atom));
+	break;
+
+    case BA_ISTR:
+	brp->br_ignored += 1;
+	break;
+    }
+
+    brp->br_live -= brp->br_sizes[slot];
+    brp->br_atoms[slot] = PA_NULL_ATOM;
+    brp->br_sizes[slot] = 0;
+}
+
+static void
+bench_run_alloc (bench_run_t *brp, uint32_t slot, uint32_t size)
+{
+    pa_atom_t atom = PA_NULL_ATOM;
+    void *addr = NULL;
+    size_t fill = size;
+
+    if (brp->br_atoms[slot] != PA_NULL_ATOM)
+	bench_run_free(brp, slot);
+
+    switch (brp->br_type) {
+    case BA_MMAP: {
+	pa_mmap_atom_t matom = pa_mmap_alloc(brp->br_mmap, size);
+	atom = pa_mmap_atom_of(matom);
+	addr = pa_mmap_addr(brp->br_mmap, matom);
+	break;
+    }
+
+    case BA_FIXED: {
+	pa_fixed_atom_t fatom = pa_fixed_alloc_atom(brp->br_fixed);
+	atom = pa_fixed_atom_of(fatom);
+	addr = pa_fixed_atom_addr(brp->br_fixed, fatom);
+	if (size > opt_size)
+	    brp->br_oversize += 1;
+	size = fill = opt_size;	/* We only hold one atom */
+	break;
+    }
+
+    case BA_ARB: {
+	pa_arb_atom_t aatom = pa_arb_alloc(brp->br_arb, size);
+	atom = pa_arb_atom_of(aatom);
+	addr = pa_arb_atom_addr(brp->br_arb, aatom);
+	break;
+    }
+
+    case BA_ISTR: {
+	/* Strings of one byte or less are never allocated */
+	pa_istr_atom_t iatom = pa_istr_nstring(brp->br_istr, bench_fill,
+					       size - 1);
+	atom = pa_istr_atom_of(iatom);
+	fill = 0;		/* pa_istr did the copy */
+	break;
+    }
+    }
+
+    if (atom == PA_NULL_ATOM) {
+	brp->br_failed += 1;
+	return;
+    }
+
+    /* Touch the memory, the way a real caller would */
+    if (addr && fill)
+	memset(addr, slot & 0xff, fill);
+
+    brp->br_atoms[slot] = atom;
+    brp->br_sizes[slot] = size;
+    brp->br_live += size;
+    if (brp->br_live > brp->br_peak)
+	brp->br_peak = brp->br_live;
+}
+
+static void *
+bench_run_replay (void *arg)
+{
+    bench_run_t *brp = arg;
+    bench_trace_t *btp = brp->br_trace;
+    bench_op_t *bop, *end = btp->bt_ops + btp->bt_count;
+    unsigned loop;
+    uint32_t slot;
+
+    for (loop = 0; loop < opt_loops; loop++) {
+	/* Start each loop after the last, with nothing live */
+	if (loop > 0)
+	    for (slot = 0; slot < btp->bt_slots; slot++)
+		bench_run_free(brp, slot);
+
+	for (bop = btp->bt_ops; bop < end; bop++) {
+	    if (bop->bo_op == PA_TRACE_ALLOC)
+		bench_run_alloc(brp, bop->bo_slot, bop->bo_size);
+	    else
+		bench_run_free(brp, bop->bo_slot);
+	}
+
+	brp->br_ops += btp->bt_count;
+    }
+
+    return NULL;
+}
+
+/*
+ * Count the pages of the segment that are actually resident
+ */
+static size_t
+bench_resident (pa_mmap_t *pmp)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    size_t pages = (pmp->pm_len + page - 1) / page;
+    size_t i, count = 0;
+    unsigned char *vec = malloc(pages);
+
+    if (vec == NULL)
+	return 0;
+
+    if (mincore((void *) pmp->pm_addr, pmp->pm_len, (void *) vec) == 0) {
+	for (i = 0; i < pages; i++)
+	    if (vec[i] & 1)
+		count += 1;
+    }
+
+    free(vec);
+    return count * page;
+}
+
+static double
+bench_now (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+bench_report_free_lists (bench_run_t *brp)
+{
+    unsigned count, slot, n;
+    pa_atom_t atoms;
+
+    pa_mmap_free_stats(brp->br_mmap, &count, &atoms);
+    printf("%s:   free lists: mmap %u segment%s (%lu bytes)",
+	   bench_alloc_names[brp->br_type], count, (count == 1) ? "" : "s",
+	   (unsigned long) atoms << PA_MMAP_ATOM_SHIFT);
+
+    if (brp->br_fixed)
+	printf(", fixed %u", pa_fixed_free_count(brp->br_fixed));
+
+    if (brp->br_arb) {
+	printf(", arb");
+	for (slot = 0; slot <= PA_ARB_MAX_POW2; slot++) {
+	    n = pa_arb_free_count(brp->br_arb, slot);
+	    if (n)
+		printf(" %lu:%u", (unsigned long) 1 << (slot + PA_ARB_ATOM_SHIFT),
+		       n);
+	}
+    }
+
+    printf("\n");
+}
+
+static void
+bench_replay (bench_trace_t *btp, int type)
+{
+    bench_run_t *runs = calloc(opt_threads, sizeof(*runs));
+    pthread_t *tids = calloc(opt_threads, sizeof(*tids));
+    unsigned i;
+
+    if (runs == NULL || tids == NULL)
+	err(1, "out of memory");
+
+    /* Open everything first; pa_mmap_open isn't thread safe */
+    for (i = 0; i < opt_threads; i++)
+	bench_run_open(&runs[i], type, btp);
+
+    double start = bench_now();
+
+    if (opt_threads == 1) {
+	bench_run_replay(&runs[0]);
+    } else {
+	for (i = 0; i < opt_threads; i++)
+	    if (pthread_create(&tids[i], NULL, bench_run_replay, &runs[i]))
+		errx(1, "could not create thread");
+	for (i = 0; i < opt_threads; i++)
+	    pthread_join(tids[i], NULL);
+    }
+
+    double secs = bench_now() - start;
+
+    unsigned long ops = 0, failed = 0, ignored = 0, oversize = 0;
+    size_t arena = 0, resident = 0, peak = 0, live = 0;
+
+    for (i = 0; i < opt_threads; i++) {
+	bench_run_t *brp = &runs[i];
+
+	ops += brp->br_ops;
+	failed += brp->br_failed;
+	ignored += brp->br_ignored;
+	oversize += brp->br_oversize;
+	arena += brp->br_mmap->pm_len;
+	resident += bench_resident(brp->br_mmap);
+	peak += brp->br_peak;
+	live += brp->br_live;
+    }
+
+    const char *name = bench_alloc_names[type];
+
+    printf("%s: %u thread%s, %lu ops in %.1f ms, %.0f ops/sec\n",
+	   name, opt_threads, (opt_threads == 1) ? "" : "s",
+	   ops, secs * 1000, secs > 0 ? ops / secs : 0.0);
+    printf("%s:   arena %zu bytes, resident %zu, peak live %zu, "
+	   "live %zu, fragmentation %.1f%%\n",
+	   name, arena, resident, peak, live,
+	   (arena > peak) ? 100.0 * (arena - peak) / arena : 0.0);
+
+    if (failed || ignored || oversize)
+	printf("%s:   %lu failed, %lu frees ignored, %lu oversize\n",
+	       name, failed, ignored, oversize);
+
+    if (!opt_quiet)
+	bench_report_free_lists(&runs[0]);
+
+    for (i = 0; i < opt_threads; i++)
+	bench_run_close(&runs[i]);
+
+    free(runs);
+    free(tids);
+}
+
+/*
+ * Lookup benchmark: concurrent readers on a name index
+ */
+#define BENCH_LOOKUPS		1000000	/* Lookups per reader per loop */
+#define BENCH_WRITER_KEYS	64	/* Keys the writer churns */
+
+typedef struct bench_lookup_s {
+    pa_mmap_t *bl_mmap;		/* Segment holding everything */
+    pa_istr_t *bl_names;	/* Key strings */
+    pa_pat_t *bl_index;		/* The index under test */
+    const char **bl_keys;	/* Keys in the index */
+    uint16_t *bl_lens;		/* Key lengths (with the NUL) */
+    pa_istr_atom_t bl_writer_keys[BENCH_WRITER_KEYS];
+} bench_lookup_t;
+
+typedef struct bench_reader_s {
+    pthread_t brd_tid;		/* Our thread */
+    bench_lookup_t *brd_lookup;	/* Shared index */
+    pa_pat_t *brd_index;	/* Index to search (or NULL for shared) */
+    void *brd_cpus;		/* CPUs to run on (or NULL) */
+    uint32_t brd_seed;		/* Random state */
+    unsigned long brd_lookups;	/* Lookups done */
+    unsigned long brd_misses;	/* Lookups that failed */
+} bench_reader_t;
+
+static volatile int bench_writer_done;
+static unsigned long bench_writer_ops;
+
+static void *
+bench_lookup_reader (void *arg)
+{
+    bench_reader_t *brdp = arg;
+    bench_lookup_t *blp = brdp->brd_lookup;
+    pa_pat_t *ppp = brdp->brd_index ?: blp->bl_index;
+    unsigned long n, max = (unsigned long) BENCH_LOOKUPS * opt_loops;
+    uint32_t x = brdp->brd_seed, i;
+    int reader = 0;
+
+#ifdef HAVE_SCHED_SETAFFINITY
+    if (brdp->brd_cpus
+	&& sched_setaffinity(0, sizeof(cpu_set_t), brdp->brd_cpus) < 0)
+	warn("could not pin reader");
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+    /* Replicas are read-only, so they don't need reader slots */
+    if (ppp->pp_rcu) {
+	reader = pa_pat_read_register(ppp);
+	if (reader < 0)
+	    errx(1, "out of reader slots");
+    }
+
+    for (n = 0; n < max; n++) {
+	/* xorshift32, to pick keys in an order the cache can't guess */
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	i = x % opt_count;
+
+	pa_pat_read_enter(ppp, reader);
+	if (pa_pat_get(ppp, blp->bl_lens[i], blp->bl_keys[i]) == NULL)
+	    brdp->brd_misses += 1;
+	pa_pat_read_exit(ppp, reader);
+    }
+
+    brdp->brd_lookups = n;
+    return NULL;
+}
+
+static void *
+bench_lookup_writer (void *arg)
+{
+    bench_lookup_t *blp = arg;
+    pa_pat_t *ppp = blp->bl_index;
+    pa_pat_node_t *node;
+    pa_istr_atom_t atom;
+    const char *key;
+    unsigned i;
+
+    while (!bench_writer_done) {
+	for (i = 0; i < BENCH_WRITER_KEYS; i++) {
+	    atom = blp->bl_writer_keys[i];
+	    key = pa_istr_atom_string(blp->bl_names, atom);
+	    pa_pat_add(ppp, pa_pat_data_atom(pa_istr_atom_of(atom)),
+		       strlen(key) + 1);
+	}
+
+	for (i = 0; i < BENCH_WRITER_KEYS; i++) {
+	    key = pa_istr_atom_string(blp->bl_names, blp->bl_writer_keys[i]);
+	    node = pa_pat_get(ppp, strlen(key) + 1, key);
+	    if (node)
+		pa_pat_delete(ppp, node);
+	}
+
+	bench_writer_ops += 2 * BENCH_WRITER_KEYS;
+    }
+
+    return NULL;
+}
+
+static void
+bench_lookup_open (bench_lookup_t *blp, unsigned readers)
+{
+    static const char *prefixes[] = {
+	"interface", "unit", "family", "address", "route", "neighbor",
+	"policy-statement", "term", "community", "filter", "user", "file",
+    };
+    const unsigned nprefixes = sizeof(prefixes) / sizeof(prefixes[0]);
+    char buf[64];
+    pa_istr_atom_t atom;
+    unsigned i;
+
+    bzero(blp, sizeof(*blp));
+
+    blp->bl_mmap = pa_mmap_open(NULL, "pabench", 0, 0);
+    if (blp->bl_mmap == NULL)
+	errx(1, "could not open mmap segment");
+
+    blp->bl_names = pa_istr_open(blp->bl_mmap, "names", BENCH_SHIFT,
+				 BENCH_NAME_SHIFT, BENCH_MAX_NAMES * 4);
+    blp->bl_index = blp->bl_names
+	? pa_pat_open(blp->bl_mmap, "names.index", blp->bl_names,
+		      bench_name_key_func, PA_PAT_MAXKEY,
+		      BENCH_SHIFT, BENCH_MAX_NAMES) : NULL;
+    if (blp->bl_index == NULL)
+	errx(1, "could not open index");
+
+    /* One slot per reader, plus one for the writer's own lookups */
+    if (!pa_pat_rcu_init(blp->bl_index, readers + 1))
+	errx(1, "could not enable concurrent readers");
+
+    blp->bl_keys = calloc(opt_count, sizeof(*blp->bl_keys));
+    blp->bl_lens = calloc(opt_count, sizeof(*blp->bl_lens));
+    if (blp->bl_keys == NULL || blp->bl_lens == NULL)
+	err(1, "out of memory for keys");
+
+    for (i = 0; i < opt_count; i++) {
+	snprintf(buf, sizeof(buf), "%s-%u", prefixes[i % nprefixes], i);
+	atom = pa_istr_string(blp->bl_names, buf);
+	if (pa_istr_is_null(atom)
+	    || !pa_pat_add(blp->bl_index,
+			   pa_pat_data_atom(pa_istr_atom_of(atom)),
+			   strlen(buf) + 1))
+	    errx(1, "could not add key %u", i);
+
+	blp->bl_keys[i] = pa_istr_atom_string(blp->bl_names, atom);
+	blp->bl_lens[i] = strlen(buf) + 1;
+    }
+
+    for (i = 0; i < BENCH_WRITER_KEYS; i++) {
+	snprintf(buf, sizeof(buf), "~writer-%u", i);
+	blp->bl_writer_keys[i] = pa_istr_string(blp->bl_names, buf);
+    }
+}
+
+static void
+bench_lookup_close (bench_lookup_t *blp)
+{
+    pa_pat_rcu_synchronize(blp->bl_index);
+    pa_pat_close(blp->bl_index);
+    pa_istr_close(blp->bl_names);
+    pa_mmap_close(blp->bl_mmap);
+    free(blp->bl_keys);
+    free(blp->bl_lens);
+}
+
+static void
+bench_lookup (unsigned threads)
+{
+    bench_lookup_t lookup;
+    bench_reader_t *readers = calloc(threads, sizeof(*readers));
+    pthread_t writer;
+    unsigned long lookups = 0, misses = 0;
+    unsigned i;
+
+    if (readers == NULL)
+	err(1, "out of memory");
+
+    bench_lookup_open(&lookup, threads);
+
+    bench_writer_done = FALSE;
+    bench_writer_ops = 0;
+    if (opt_writer && pthread_create(&writer, NULL,
+				     bench_lookup_writer, &lookup))
+	errx(1, "could not create writer thread");
+
+    double start = bench_now();
+
+    for (i = 0; i < threads; i++) {
+	readers[i].brd_lookup = &lookup;
+	readers[i].brd_seed = 2463534242U + i;
+	if (pthread_create(&readers[i].brd_tid, NULL,
+			   bench_lookup_reader, &readers[i]))
+	    errx(1, "could not create thread");
+    }
+
+    for (i = 0; i < threads; i++) {
+	pthread_join(readers[i].brd_tid, NULL);
+	lookups += readers[i].brd_lookups;
+	misses += readers[i].brd_misses;
+    }
+
+    double secs = bench_now() - start;
+
+    if (opt_writer) {
+	bench_writer_done = TRUE;
+	pthread_join(writer, NULL);
+    }
+
+    printf("lookup: %u thread%s, %lu lookups in %.1f ms, %.0f lookups/sec"
+	   " (%.0f per thread)\n",
+	   threads, (threads == 1) ? "" : "s", lookups, secs * 1000,
+	   secs > 0 ? lookups / secs : 0.0,
+	   secs > 0 ? lookups / secs / threads : 0.0);
+
+    if (opt_writer)
+	printf("lookup:   writer did %lu adds and deletes\n",
+	       bench_writer_ops);
+
+    if (misses)
+	printf("lookup:   %lu misses\n", misses);
+
+    bench_lookup_close(&lookup);
+    free(readers);
+}
+
+/*
+ * NUMA benchmark: readers on each node, shared index vs local replica
+ */
+#define BENCH_NUMA_THREADS	4 /* Readers per node */
+
+/*
+ * Find the CPUs of a NUMA node.  Returns the number found.
+ */
+static unsigned
+bench_numa_cpus (unsigned node, void *cpus UNUSED)
+{
+    unsigned count = 0;
+#ifdef HAVE_SCHED_SETAFFINITY
+    char path[128], buf[BUFSIZ], *cp, *ep;
+    unsigned long first, last;
+    FILE *fp;
+
+    CPU_ZERO((cpu_set_t *) cpus);
+
+    snprintf(path, sizeof(path),
+	     "/sys/devices/system/node/node%u/cpulist", node);
+    fp = fopen(path, "r");
+    if (fp == NULL)
+	return 0;
+
+    if (fgets(buf, sizeof(buf), fp)) {
+	for (cp = buf; *cp && *cp != '\n'; cp = ep) {
+	    first = last = strtoul(cp, &ep, 10);
+	    if (ep == cp)
+		break;
+	    if (*ep == '-')
+		last = strtoul(ep + 1, &ep, 10);
+	    for (; first <= last && first < CPU_SETSIZE; first++, count++)
+		CPU_SET(first, (cpu_set_t *) cpus);
+	    if (*ep == ',')
+		ep += 1;
+	}
+    }
+
+    fclose(fp);
+#else /* HAVE_SCHED_SETAFFINITY */
+    (void) node;
+#endif /* HAVE_SCHED_SETAFFINITY */
+    return count;
+}
+
+/*
+ * Run "threads" readers against an index, returning ns per lookup
+ */
+static double
+bench_numa_run (bench_lookup_t *blp, pa_pat_t *ppp, void *cpus,
+		unsigned threads, unsigned long *missesp)
+{
+    bench_reader_t *readers = calloc(threads, sizeof(*readers));
+    unsigned long lookups = 0;
+    unsigned i;
+
+    if (readers == NULL)
+	err(1, "out of memory");
+
+    double start = bench_now();
+
+    for (i = 0; i < threads; i++) {
+	readers[i].brd_lookup = blp;
+	readers[i].brd_index = ppp;
+	readers[i].brd_cpus = cpus;
+	readers[i].brd_seed = 2463534242U + i;
+	if (pthread_create(&readers[i].brd_tid, NULL,
+			   bench_lookup_reader, &readers[i]))
+	    errx(1, "could not create thread");
+    }
+
+    for (i = 0; i < threads; i++) {
+	pthread_join(readers[i].brd_tid, NULL);
+	lookups += readers[i].brd_lookups;
+	*missesp += readers[i].brd_misses;
+    }
+
+    double secs = bench_now() - start;
+
+    free(readers);
+
+    /* Each thread's lookups ran in parallel, so it's per thread */
+    return lookups ? secs * 1e9 * threads / lookups : 0.0;
+}
+
+static void
+bench_numa (unsigned threads)
+{
+    bench_lookup_t lookup;
+    pa_numa_mask_t online;
+    pa_mmap_t *replica;
+    pa_istr_t *names;
+    pa_pat_t *index;
+    unsigned long misses = 0;
+    unsigned node, ncpus;
+    double shared, local;
+    void *cpus = NULL;
+
+#ifdef HAVE_SCHED_SETAFFINITY
+    cpus = malloc(sizeof(cpu_set_t));
+    if (cpus == NULL)
+	err(1, "out of memory");
+#else /* HAVE_SCHED_SETAFFINITY */
+    printf("numa: cannot pin threads here; readers run anywhere\n");
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+    /*
+     * Reader slots aren't given back, so the shared index needs
+     * enough for every node's pass; readers of a replica take none.
+     */
+    pa_numa_online(&online);
+    bench_lookup_open(&lookup, threads * __builtin_popcountll(online));
+
+    for (node = 0; node < PA_NUMA_MAX_NODES; node++) {
+	if (!(online & (((pa_numa_mask_t) 1) << node)))
+	    continue;
+
+	ncpus = bench_numa_cpus(node, cpus);
+	if (cpus && ncpus == 0) {
+	    printf("numa: node %u: no cpus\n", node);
+	    continue;
+	}
+
+	replica = pa_mmap_replica(lookup.bl_mmap, node);
+	if (replica == NULL)
+	    errx(1, "could not make replica on node %u", node);
+
+	names = pa_istr_open(replica, "names", BENCH_SHIFT,
+			     BENCH_NAME_SHIFT, BENCH_MAX_NAMES * 4);
+	index = names
+	    ? pa_pat_open(replica, "names.index", names, bench_name_key_func,
+			  PA_PAT_MAXKEY, BENCH_SHIFT, BENCH_MAX_NAMES) : NULL;
+	if (index == NULL)
+	    errx(1, "could not open replica index");
+
+	shared = bench_numa_run(&lookup, lookup.bl_index, ncpus ? cpus : NULL,
+				threads, &misses);
+	local = bench_numa_run(&lookup, index, ncpus ? cpus : NULL,
+			       threads, &misses);
+
+	printf("numa: node %u (%u cpu%s), %u thread%s: shared %.1f ns/lookup,"
+	       " replica %.1f ns/lookup (%+.1f%%)\n",
+	       node, ncpus, (ncpus == 1) ? "" : "s",
+	       threads, (threads == 1) ? "" : "s", shared, local,
+	       shared > 0 ? (local - shared) * 100 / shared : 0.0);
+
+	pa_pat_close(index);
+	pa_istr_close(names);
+	pa_mmap_close(replica);
+    }
+
+    if (misses)
+	printf("numa:   %lu misses\n", misses);
+
+    bench_lookup_close(&lookup);
+    free(cpus);
+}
+
+static void
+print_help (void)
+{
+    fprintf(stderr,
+	    "Usage: pabench capture FILE...\n"
+	    "       pabench replay [allocator mmap|fixed|arb|istr|all]"
+	    " [loops N]\n"
+	    "              [threads N] [size N] [quiet] FILE...\n"
+	    "       pabench lookup [threads N] [count N] [loops N]"
+	    " [writer]\n"
+	    "       pabench numa [threads N] [count N] [loops N]\n");
+}
+
+int
+main (int argc, char **argv)
+{
+    const char *verb;
+    bench_trace_t trace;
+    int i, type;
+
+    if (argc < 2 || (argc < 3 && strcmp(argv[1], "lookup") != 0
+		     && strcmp(argv[1], "numa") != 0)) {
+	print_help();
+	return 1;
+    }
+
+    verb = argv[1];
+    bzero(&trace, sizeof(trace));
+
+    for (argc = 2; argv[argc]; argc++) {
+	if (strcmp(argv[argc], "allocator") == 0) {
+	    if (argv[argc + 1] == NULL)
+		break;
+	    argc += 1;
+	    opt_alloc = -1;
+	    for (i = 0; i < BA_MAX; i++)
+		if (strcmp(argv[argc], bench_alloc_names[i]) == 0)
+		    opt_alloc = i;
+	    if (opt_alloc < 0 && strcmp(argv[argc], "all") != 0)
+		errx(1, "unknown allocator: %s", argv[argc]);
+	} else if (strcmp(argv[argc], "loops") == 0) {
+	    if (argv[argc + 1])
+		opt_loops = atoi(argv[++argc]) ?: 1;
+	} else if (strcmp(argv[argc], "threads") == 0) {
+	    if (argv[argc + 1])
+		opt_threads = atoi(argv[++argc]) ?: 1;
+	    opt_threads_given = TRUE;
+	} else if (strcmp(argv[argc], "count") == 0) {
+	    if (argv[argc + 1])
+		opt_count = atoi(argv[++argc]) ?: 1;
+	} else if (strcmp(argv[argc], "writer") == 0) {
+	    opt_writer = TRUE;
+	} else if (strcmp(argv[argc], "size") == 0) {
+	    if (argv[argc + 1])
+		opt_size = atoi(argv[++argc]);
+	} else if (strcmp(argv[argc], "type") == 0) {
+	    /* Capture only one kind of allocation */
+	    if (argv[argc + 1] == NULL)
+		break;
+	    argc += 1;
+	    if (strcmp(argv[argc], "fixed") == 0)
+		bench_capture_type = PA_TYPE_FIXED;
+	    else if (strcmp(argv[argc], "arb") == 0)
+		bench_capture_type = PA_TYPE_ARB;
+	    else if (strcmp(argv[argc], "istr") == 0)
+		bench_capture_type = PA_TYPE_ISTR;
+	} else if (strcmp(argv[argc], "quiet") == 0) {
+	    opt_quiet = TRUE;
+	} else if (strcmp(verb, "capture") == 0) {
+	    bench_capture_file(argv[argc]);
+	} else if (strcmp(verb, "replay") == 0) {
+	    bench_trace_read(&trace, argv[argc]);
+	} else {
+	    print_help();
+	    return 1;
+	}
+    }
+
+    if (strcmp(verb, "lookup") == 0) {
+	if (opt_threads_given) {
+	    bench_lookup(opt_threads);
+	} else {
+	    bench_lookup(1);
+	    bench_lookup(8);
+	    bench_lookup(32);
+	}
+	return 0;
+    }
+
+    if (strcmp(verb, "numa") == 0) {
+	bench_numa(opt_threads_given ? opt_threads : BENCH_NUMA_THREADS);
+	return 0;
+    }
+
+    if (strcmp(verb, "replay") != 0)
+	return 0;
+
+    if (trace.bt_count == 0)
+	errx(1, "empty trace");
+
+    if (opt_size < sizeof(pa_atom_t))
+	opt_size = sizeof(pa_atom_t);
+
+    bench_fill = malloc(trace.bt_max_size + 1);
+    if (bench_fill == NULL)
+	err(1, "out of memory");
+    memset(bench_fill, 'x', trace.bt_max_size);
+    bench_fill[trace.bt_max_size] = '\0';
+
+    printf("trace: %lu ops, %u slots, %lu bytes allocated, "
+	   "largest %u\n", trace.bt_count, trace.bt_slots,
+	   trace.bt_bytes, trace.bt_max_size);
+
+    for (type = 0; type < BA_MAX; type++)
+	if (opt_alloc < 0 || opt_alloc == type)
+	    bench_replay(&trace, type);
+
+    free(bench_fill);
+    free(trace.bt_ops);
+
+    return 0;
+}
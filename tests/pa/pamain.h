@@ -45,6 +45,7 @@ const char *opt_input;
 const char *opt_config;
 int opt_clean, opt_quiet, opt_dump, opt_top_dump;
 uint32_t opt_size = 8;
+unsigned opt_threads;
 int opt_value = -1;
 int opt_value_index = 2;
 int opt_bad_value_test = 1;
@@ -114,6 +115,9 @@ main (int argc UNUSED, char **argv UNUSED)
 		opt_value_index = atoi(argv[++argc]);
 	} else if (strcmp(argv[argc], "no-value-test") == 0) {
 	    opt_bad_value_test = 0;
+	} else if (strcmp(argv[argc], "threads") == 0) {
+	    if (argv[argc + 1]) 
+		opt_threads = atoi(argv[++argc]);
 	} else if (strcmp(argv[argc], "file") == 0) {
 	    if (argv[argc + 1]) 
 		opt_filename = argv[++argc];
@@ -270,6 +274,12 @@ main (int argc UNUSED, char **argv UNUSED)
 
 	case 'q':
 	    goto done;
+
+#ifdef NEED_OTHER
+	default:
+	    test_other(cp - 1);
+	    break;
+#endif /* NEED_OTHER */
 	}
     }
 
@@ -0,0 +1,13 @@
+break 10 if
+break 10 if $i =
+break 10 if $i = 3
+info breakpoints
+run
+print $sq
+delete 3
+watch $nosuch:var
+watch $label
+info breakpoints
+cont
+cont
+quit
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * syslog-stub -- a stand-in for syslogd, used for testing
+ *
+ * Usage: syslog-stub -s <socket> [-o <file>] command [args ...]
+ *
+ * Binds a unix datagram socket at the given path, runs the command,
+ * and writes each datagram received as a line to the given file (or
+ * stdout), until the command exits.  The command's exit status is returned.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define STUB_TIMEOUT	100	/* Poll interval, in milliseconds */
+#define STUB_USAGE \
+    "usage: syslog-stub -s <socket> [-o <file>] command [args ...]"
+
+static FILE *stub_out;
+
+static void
+stub_drain (int sock, int flags)
+{
+    char buf[BUFSIZ * 8];
+    ssize_t len;
+
+    for (;;) {
+	len = recv(sock, buf, sizeof(buf), flags);
+	if (len <= 0)
+	    return;
+
+	fwrite(buf, 1, len, stub_out);
+	fputc('\n', stub_out);
+	flags = MSG_DONTWAIT;
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+    struct sockaddr_un sun;
+    struct pollfd pfd;
+    const char *path = NULL, *output = NULL;
+    int sock, status, ch;
+    pid_t pid;
+
+    while ((ch = getopt(argc, argv, "+o:s:")) != -1) {
+	switch (ch) {
+	case 'o':
+	    output = optarg;
+	    break;
+
+	case 's':
+	    path = optarg;
+	    break;
+
+	default:
+	    errx(1, STUB_USAGE);
+	}
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (path == NULL || argc == 0)
+	errx(1, STUB_USAGE);
+
+    stub_out = stdout;
+    if (output) {
+	stub_out = fopen(output, "w");
+	if (stub_out == NULL)
+	    err(1, "open: %s", output);
+    }
+
+    if (strlen(path) >= sizeof(sun.sun_path))
+	errx(1, "socket path too long: %s", path);
+
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, path);
+
+    sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (sock < 0)
+	err(1, "socket");
+
+    unlink(path);
+    if (bind(sock, (struct sockaddr *) &sun, sizeof(sun)) < 0)
+	err(1, "bind: %s", path);
+
+    pid = fork();
+    if (pid < 0)
+	err(1, "fork");
+
+    if (pid == 0) {
+	close(sock);
+	execvp(argv[0], argv);
+	err(1, "exec: %s", argv[0]);
+    }
+
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+
+    for (;;) {
+	if (poll(&pfd, 1, STUB_TIMEOUT) > 0)
+	    stub_drain(sock, MSG_DONTWAIT);
+
+	if (waitpid(pid, &status, WNOHANG) == pid)
+	    break;
+    }
+
+    /* Pick up anything sent just before the command exited */
+    stub_drain(sock, MSG_DONTWAIT);
+
+    close(sock);
+    unlink(path);
+
+    if (stub_out != stdout)
+	fclose(stub_out);
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
@@ -0,0 +1,1135 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * xidiff -- differential tester for libxi: parse each document with
+ * both xi_parse() and libxml2, reduce both trees to the same
+ * canonical event stream, and report the first place they disagree.
+ *
+ * The canonical stream is a list of "open", "attr", "text" and
+ * "close" events, with names expanded to "{uri}local", entity and
+ * character references decoded, line ends normalized, adjacent text
+ * and CDATA merged, and comments, PIs and namespace declarations
+ * dropped.  libxml2 is the reference; each of its events records the
+ * byte offset where it was read, which is what we report.
+ *
+ * Besides named files, "--random <count>" generates documents from a
+ * seeded generator that leans on the troublesome corners: entities,
+ * character references, CDATA, namespaces (including default and
+ * undeclared ones), whitespace, quoting, comments and PIs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <string.h>
+#include <err.h>
+
+#include <libxml/xmlreader.h>
+
+#include <libpsu/psucommon.h>
+#include <libpsu/psulog.h>
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paarb.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/papat.h>
+#include <parrotdb/pabitmap.h>
+#include <libxi/xicommon.h>
+#include <libxi/xisource.h>
+#include <libxi/xirules.h>
+#include <libxi/xitree.h>
+#include <libxi/xiworkspace.h>
+#include <libxi/xiparse.h>
+
+#define XIDIFF_NAME	"xidiff" /* Workspace and document name */
+#define XIDIFF_WORK	"xidiff.tmp.xml" /* Work file for random documents */
+#define XIDIFF_SHOW	72	/* Max bytes of an event to display */
+#define XIDIFF_SCOPE_MAX 1024	/* Max in-scope namespace declarations */
+
+/*
+ * A simple growable buffer
+ */
+typedef struct xidiff_buf_s {
+    char *xb_data;		/* Content (always NUL terminated) */
+    size_t xb_len;		/* Length of content */
+    size_t xb_size;		/* Size of allocated data */
+} xidiff_buf_t;
+
+/*
+ * One canonical event.  The offset and line are only known for
+ * events from libxml2.
+ */
+typedef struct xidiff_event_s {
+    char *xe_text;		/* Canonical form of the event */
+    long xe_offset;		/* Byte offset in the input */
+    int xe_line;		/* Line number in the input */
+} xidiff_event_t;
+
+typedef struct xidiff_events_s {
+    xidiff_event_t *xes_events;	/* Array of events */
+    unsigned xes_count;		/* Number of events in use */
+    unsigned xes_size;		/* Number of events allocated */
+    xidiff_buf_t xes_text;	/* Pending (merged) text */
+    int xes_failed;		/* Parser rejected the input */
+} xidiff_events_t;
+
+/*
+ * A namespace declaration that's in scope during the xi tree walk
+ */
+typedef struct xidiff_scope_s {
+    pa_atom_t xsc_prefix;	/* Prefix atom (PA_NULL_ATOM for default) */
+    pa_atom_t xsc_uri;		/* URI atom (PA_NULL_ATOM for none) */
+    unsigned xsc_depth;		/* Depth of the declaring element */
+} xidiff_scope_t;
+
+/*
+ * State for walking an xi tree
+ */
+typedef struct xidiff_walk_s {
+    xidiff_events_t *xw_events;	/* Events we're building */
+    xi_workspace_t *xw_workspace; /* Workspace holding the tree */
+    unsigned xw_depth;		/* Current element depth */
+    xi_node_t *xw_elt;		/* Element waiting for its attributes */
+    unsigned xw_elt_slot;	/* Event slot reserved for xw_elt */
+    unsigned xw_num_scope;	/* Number of entries in xw_scope */
+    xidiff_scope_t xw_scope[XIDIFF_SCOPE_MAX];
+} xidiff_walk_t;
+
+static int opt_ignore_ws;
+static int opt_verbose;
+
+/*
+ * Deterministic PRNG (xorshift32), so the random corpus for a given
+ * seed is the same everywhere.
+ */
+static uint32_t xidiff_seed = 1;
+
+static uint32_t
+xidiff_rand (void)
+{
+    uint32_t x = xidiff_seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return xidiff_seed = x;
+}
+
+static unsigned
+xidiff_range (unsigned limit)
+{
+    return limit ? xidiff_rand() % limit : 0;
+}
+
+static int
+xidiff_chance (unsigned percent)
+{
+    return xidiff_range(100) < percent;
+}
+
+static void
+xidiff_buf_append (xidiff_buf_t *bp, const char *data, size_t len)
+{
+    if (bp->xb_len + len + 1 > bp->xb_size) {
+	size_t size = bp->xb_size ? bp->xb_size * 2 : 256;
+	while (size < bp->xb_len + len + 1)
+	    size *= 2;
+
+	char *newp = realloc(bp->xb_data, size);
+	if (newp == NULL)
+	    errx(1, "out of memory");
+
+	bp->xb_data = newp;
+	bp->xb_size = size;
+    }
+
+    memcpy(bp->xb_data + bp->xb_len, data, len);
+    bp->xb_len += len;
+    bp->xb_data[bp->xb_len] = '\0';
+}
+
+static void
+xidiff_buf_puts (xidiff_buf_t *bp, const char *data)
+{
+    xidiff_buf_append(bp, data, strlen(data));
+}
+
+static void
+xidiff_buf_printf (xidiff_buf_t *bp, const char *fmt, ...)
+{
+    char buf[BUFSIZ];
+    va_list vap;
+    int len;
+
+    va_start(vap, fmt);
+    len = vsnprintf(buf, sizeof(buf), fmt, vap);
+    va_end(vap);
+
+    if (len >= (int) sizeof(buf))
+	len = sizeof(buf) - 1;
+    if (len > 0)
+	xidiff_buf_append(bp, buf, len);
+}
+
+static void
+xidiff_buf_reset (xidiff_buf_t *bp)
+{
+    bp->xb_len = 0;
+    if (bp->xb_data)
+	bp->xb_data[0] = '\0';
+}
+
+static void
+xidiff_buf_free (xidiff_buf_t *bp)
+{
+    free(bp->xb_data);
+    bzero(bp, sizeof(*bp));
+}
+
+/*
+ * Append a code point as UTF-8
+ */
+static void
+xidiff_buf_utf8 (xidiff_buf_t *bp, unsigned long cp)
+{
+    char buf[4];
+    size_t len;
+
+    if (cp < 0x80) {
+	buf[0] = cp;
+	len = 1;
+    } else if (cp < 0x800) {
+	buf[0] = 0xc0 | (cp >> 6);
+	buf[1] = 0x80 | (cp & 0x3f);
+	len = 2;
+    } else if (cp < 0x10000) {
+	buf[0] = 0xe0 | (cp >> 12);
+	buf[1] = 0x80 | ((cp >> 6) & 0x3f);
+	buf[2] = 0x80 | (cp & 0x3f);
+	len = 3;
+    } else {
+	buf[0] = 0xf0 | (cp >> 18);
+	buf[1] = 0x80 | ((cp >> 12) & 0x3f);
+	buf[2] = 0x80 | ((cp >> 6) & 0x3f);
+	buf[3] = 0x80 | (cp & 0x3f);
+	len = 4;
+    }
+
+    xidiff_buf_append(bp, buf, len);
+}
+
+/*
+ * Decode text the way an XML processor reports it: line ends are
+ * normalized and entity and character references are expanded.  For
+ * attribute values, literal whitespace characters become spaces
+ * (XML 1.0 section 3.3.3).  Unknown entities are kept as-is.
+ */
+static void
+xidiff_decode (xidiff_buf_t *bp, const char *data, int attrib)
+{
+    const char *cp, *ep;
+    char *end;
+    unsigned long val;
+
+    for (cp = data; *cp; cp++) {
+	if (*cp == '\r') {
+	    if (cp[1] == '\n')
+		cp += 1;
+	    xidiff_buf_puts(bp, attrib ? " " : "\n");
+
+	} else if (attrib && (*cp == '\n' || *cp == '\t')) {
+	    xidiff_buf_puts(bp, " ");
+
+	} else if (*cp == '&' && (ep = strchr(cp, ';')) != NULL) {
+	    size_t len = ep - cp - 1;
+	    const char *name = cp + 1;
+
+	    if (len == 2 && strncmp(name, "lt", len) == 0)
+		xidiff_buf_puts(bp, "<");
+	    else if (len == 2 && strncmp(name, "gt", len) == 0)
+		xidiff_buf_puts(bp, ">");
+	    else if (len == 3 && strncmp(name, "amp", len) == 0)
+		xidiff_buf_puts(bp, "&");
+	    else if (len == 4 && strncmp(name, "quot", len) == 0)
+		xidiff_buf_puts(bp, "\"");
+	    else if (len == 4 && strncmp(name, "apos", len) == 0)
+		xidiff_buf_puts(bp, "'");
+	    else if (len > 1 && *name == '#') {
+		if (name[1] == 'x')
+		    val = strtoul(name + 2, &end, 16);
+		else
+		    val = strtoul(name + 1, &end, 10);
+		if (end != ep)
+		    goto verbatim;
+		xidiff_buf_utf8(bp, val);
+	    } else
+		goto verbatim;
+
+	    cp = ep;
+
+	} else {
+	verbatim:
+	    xidiff_buf_append(bp, cp, 1);
+	}
+    }
+}
+
+static int
+xidiff_is_ws (const char *data, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+	if (data[i] != ' ' && data[i] != '\t'
+	    && data[i] != '\n' && data[i] != '\r')
+	    return FALSE;
+
+    return TRUE;
+}
+
+static void
+xidiff_events_add (xidiff_events_t *xesp, const char *text,
+		   long offset, int line)
+{
+    if (xesp->xes_count >= xesp->xes_size) {
+	unsigned size = xesp->xes_size ? xesp->xes_size * 2 : 64;
+	xidiff_event_t *newp = realloc(xesp->xes_events,
+				       size * sizeof(*newp));
+	if (newp == NULL)
+	    errx(1, "out of memory");
+
+	xesp->xes_events = newp;
+	xesp->xes_size = size;
+    }
+
+    xidiff_event_t *xep = &xesp->xes_events[xesp->xes_count++];
+    xep->xe_text = text ? strdup(text) : NULL;
+    xep->xe_offset = offset;
+    xep->xe_line = line;
+}
+
+/*
+ * Emit any pending text as a single event.  Text and CDATA are
+ * merged until the next markup event, since parsers are free to
+ * split them differently.
+ */
+static void
+xidiff_events_flush (xidiff_events_t *xesp, long offset, int line)
+{
+    xidiff_buf_t *bp = &xesp->xes_text;
+
+    if (bp->xb_len == 0)
+	return;
+
+    xidiff_buf_t ev;
+
+    bzero(&ev, sizeof(ev));
+    xidiff_buf_puts(&ev, "text ");
+    xidiff_buf_append(&ev, bp->xb_data, bp->xb_len);
+    xidiff_events_add(xesp, ev.xb_data, offset, line);
+    xidiff_buf_free(&ev);
+
+    xidiff_buf_reset(bp);
+}
+
+static void
+xidiff_events_free (xidiff_events_t *xesp)
+{
+    unsigned i;
+
+    for (i = 0; i < xesp->xes_count; i++)
+	free(xesp->xes_events[i].xe_text);
+    free(xesp->xes_events);
+    xidiff_buf_free(&xesp->xes_text);
+    bzero(xesp, sizeof(*xesp));
+}
+
+/*
+ * Build the canonical "{uri}local" form of a name
+ */
+static void
+xidiff_name (xidiff_buf_t *bp, const char *uri, const char *local)
+{
+    if (uri && *uri)
+	xidiff_buf_printf(bp, "{%s}", uri);
+    xidiff_buf_puts(bp, local ?: "");
+}
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Record the libxml2 error message (just the first), instead of
+ * letting it spray onto stderr.
+ */
+static void
+xidiff_xml_error (void *arg, const char *msg,
+		  xmlParserSeverities severity UNUSED,
+		  xmlTextReaderLocatorPtr locator UNUSED)
+{
+    xidiff_events_t *xesp = arg;
+
+    if (!xesp->xes_failed && opt_verbose)
+	fprintf(stderr, "libxml2: %s", msg);
+
+    xesp->xes_failed = TRUE;
+}
+
+static void
+xidiff_xml_parse (const char *filename, xidiff_events_t *xesp)
+{
+    xmlTextReaderPtr reader;
+    xidiff_buf_t ev;
+    const char *value;
+    long offset;
+    int line, type, rc;
+
+    bzero(&ev, sizeof(ev));
+
+    reader = xmlReaderForFile(filename, NULL, XML_PARSE_NONET);
+    if (reader == NULL) {
+	xesp->xes_failed = TRUE;
+	return;
+    }
+
+    xmlTextReaderSetErrorHandler(reader, xidiff_xml_error, xesp);
+
+    while ((rc = xmlTextReaderRead(reader)) == 1) {
+	type = xmlTextReaderNodeType(reader);
+	offset = xmlTextReaderByteConsumed(reader);
+	line = xmlTextReaderGetParserLineNumber(reader);
+
+	switch (type) {
+	case XML_READER_TYPE_ELEMENT:
+	    xidiff_events_flush(xesp, offset, line);
+
+	    xidiff_buf_reset(&ev);
+	    xidiff_buf_puts(&ev, "open ");
+	    xidiff_name(&ev,
+			(const char *) xmlTextReaderConstNamespaceUri(reader),
+			(const char *) xmlTextReaderConstLocalName(reader));
+	    xidiff_events_add(xesp, ev.xb_data, offset, line);
+
+	    while (xmlTextReaderMoveToNextAttribute(reader) == 1) {
+		if (xmlTextReaderIsNamespaceDecl(reader))
+		    continue;
+
+		xidiff_buf_reset(&ev);
+		xidiff_buf_puts(&ev, "attr ");
+		xidiff_name(&ev,
+		    (const char *) xmlTextReaderConstNamespaceUri(reader),
+		    (const char *) xmlTextReaderConstLocalName(reader));
+		value = (const char *) xmlTextReaderConstValue(reader);
+		xidiff_buf_printf(&ev, "=%s", value ?: "");
+		xidiff_events_add(xesp, ev.xb_data, offset, line);
+	    }
+	    xmlTextReaderMoveToElement(reader);
+
+	    if (xmlTextReaderIsEmptyElement(reader))
+		xidiff_events_add(xesp, "close", offset, line);
+	    break;
+
+	case XML_READER_TYPE_END_ELEMENT:
+	    xidiff_events_flush(xesp, offset, line);
+	    xidiff_events_add(xesp, "close", offset, line);
+	    break;
+
+	case XML_READER_TYPE_TEXT:
+	case XML_READER_TYPE_CDATA:
+	case XML_READER_TYPE_WHITESPACE:
+	case XML_READER_TYPE_SIGNIFICANT_WHITESPACE:
+	    /* Text outside the document element isn't content */
+	    if (xmlTextReaderDepth(reader) == 0)
+		break;
+
+	    /*
+	     * With --ignore-ws, whitespace-only text is dropped before
+	     * merging, but CDATA is always kept.
+	     */
+	    value = (const char *) xmlTextReaderConstValue(reader);
+	    if (value && (!opt_ignore_ws || type == XML_READER_TYPE_CDATA
+			  || !xidiff_is_ws(value, strlen(value))))
+		xidiff_buf_puts(&xesp->xes_text, value);
+	    break;
+	}
+    }
+
+    if (rc < 0)
+	xesp->xes_failed = TRUE;
+
+    xidiff_events_flush(xesp, xmlTextReaderByteConsumed(reader),
+			xmlTextReaderGetParserLineNumber(reader));
+
+    xmlFreeTextReader(reader);
+    xidiff_buf_free(&ev);
+}
+
+/* ---------------------------------------------------------------------- */
+
+static const char *
+xidiff_walk_uri (xidiff_walk_t *xwp, xi_node_t *nodep, int use_default)
+{
+    xi_workspace_t *wsp = xwp->xw_workspace;
+    xi_ns_map_t *ns_map;
+    int i;
+
+    /* Prefixed names have their mapping recorded in the node */
+    if (nodep->xn_ns_map != PA_NULL_ATOM) {
+	ns_map = xi_ns_map_addr(wsp, nodep->xn_ns_map);
+	return ns_map ? xi_namepool_string(wsp, ns_map->xnm_uri) : NULL;
+    }
+
+    /* Unprefixed attributes are in no namespace */
+    if (!use_default)
+	return NULL;
+
+    /* Unprefixed elements use the innermost default namespace */
+    for (i = xwp->xw_num_scope - 1; i >= 0; i--)
+	if (xwp->xw_scope[i].xsc_prefix == PA_NULL_ATOM)
+	    return xi_namepool_string(wsp, xwp->xw_scope[i].xsc_uri);
+
+    return NULL;
+}
+
+/*
+ * Fill in the "open" event we reserved for the current element.  We
+ * have to wait for the end of the attributes, since a default
+ * namespace declaration can follow them.
+ */
+static void
+xidiff_walk_open (xidiff_walk_t *xwp)
+{
+    xidiff_buf_t ev;
+
+    if (xwp->xw_elt == NULL)
+	return;
+
+    bzero(&ev, sizeof(ev));
+    xidiff_buf_puts(&ev, "open ");
+    xidiff_name(&ev, xidiff_walk_uri(xwp, xwp->xw_elt, TRUE),
+		xi_namepool_string(xwp->xw_workspace, xwp->xw_elt->xn_name));
+
+    xwp->xw_events->xes_events[xwp->xw_elt_slot].xe_text = ev.xb_data;
+    xwp->xw_elt = NULL;
+}
+
+static int
+xidiff_walk_cb (xi_parse_t *parsep UNUSED, xi_node_type_t type,
+		pa_atom_t node_atom UNUSED, xi_node_t *nodep,
+		const char *data, void *opaque)
+{
+    xidiff_walk_t *xwp = opaque;
+    xidiff_events_t *xesp = xwp->xw_events;
+    xi_workspace_t *wsp = xwp->xw_workspace;
+    xi_ns_map_t *ns_map;
+    xidiff_buf_t ev;
+
+    bzero(&ev, sizeof(ev));
+
+    switch (type) {
+    case XI_TYPE_OPEN:
+	xidiff_events_flush(xesp, -1, 0);
+
+	/* Reserve a slot for the event; we'll fill it in later */
+	xwp->xw_depth += 1;
+	xwp->xw_elt = nodep;
+	xwp->xw_elt_slot = xesp->xes_count;
+	xidiff_events_add(xesp, NULL, -1, 0);
+	break;
+
+    case XI_TYPE_NS:
+	ns_map = xi_ns_map_addr(wsp, nodep->xn_contents);
+	if (ns_map && xwp->xw_num_scope < XIDIFF_SCOPE_MAX) {
+	    xidiff_scope_t *scp = &xwp->xw_scope[xwp->xw_num_scope++];
+	    scp->xsc_prefix = ns_map->xnm_prefix;
+	    scp->xsc_uri = ns_map->xnm_uri;
+	    scp->xsc_depth = xwp->xw_depth;
+	}
+	break;
+
+    case XI_TYPE_ATTRIB:
+	xidiff_buf_puts(&ev, "attr ");
+	xidiff_name(&ev, xidiff_walk_uri(xwp, nodep, FALSE),
+		    xi_namepool_string(wsp, nodep->xn_name));
+	xidiff_buf_puts(&ev, "=");
+	xidiff_decode(&ev, data ?: "", TRUE);
+	xidiff_events_add(xesp, ev.xb_data, -1, 0);
+	break;
+
+    case XI_TYPE_ATSTR:
+	xidiff_events_add(xesp, "attr (unparsed)", -1, 0);
+	break;
+
+    case XI_TYPE_EOL_ATTRIB:
+	xidiff_walk_open(xwp);
+	break;
+
+    case XI_TYPE_EOL_EMPTY:
+	xidiff_walk_open(xwp);
+	break;
+
+    case XI_TYPE_CLOSE:
+	if (nodep && nodep->xn_type == XI_TYPE_ROOT)
+	    break;		/* Not an element */
+
+	xidiff_walk_open(xwp);
+	xidiff_events_flush(xesp, -1, 0);
+	xidiff_events_add(xesp, "close", -1, 0);
+
+	while (xwp->xw_num_scope > 0
+	       && xwp->xw_scope[xwp->xw_num_scope - 1].xsc_depth
+	       >= xwp->xw_depth)
+	    xwp->xw_num_scope -= 1;
+	if (xwp->xw_depth > 0)
+	    xwp->xw_depth -= 1;
+	break;
+
+    case XI_TYPE_TEXT:
+	if (opt_ignore_ws && xidiff_is_ws(data ?: "", strlen(data ?: "")))
+	    break;
+	if (xwp->xw_depth > 0)
+	    xidiff_decode(&xesp->xes_text, data ?: "", FALSE);
+	break;
+
+    case XI_TYPE_UNESC:
+	if (xwp->xw_depth > 0) {
+	    /* Raw (CDATA) content; only line ends need normalizing */
+	    const char *cp;
+
+	    for (cp = data ?: ""; *cp; cp++) {
+		if (*cp == '\r' && cp[1] == '\n')
+		    continue;
+		xidiff_buf_append(&xesp->xes_text, (*cp == '\r') ? "\n" : cp, 1);
+	    }
+	}
+	break;
+
+    case XI_TYPE_EOF:
+	xidiff_walk_open(xwp);
+	xidiff_events_flush(xesp, -1, 0);
+	break;
+    }
+
+    xidiff_buf_free(&ev);
+    return 0;
+}
+
+static void
+xidiff_xi_parse (pa_mmap_t *pmp, xi_workspace_t *xwsp,
+		 const char *filename, xidiff_events_t *xesp)
+{
+    xi_source_flags_t flags = opt_ignore_ws ? XPSF_IGNORE_WS : 0;
+    xi_parse_t *parsep;
+    xidiff_walk_t *xwp;
+
+    /*
+     * Reusing the document name gives each parse a fresh root; the
+     * old tree's nodes just stay behind in the (in-memory) workspace.
+     */
+    parsep = xi_parse_open(pmp, xwsp, XIDIFF_NAME, filename, flags);
+    if (parsep == NULL) {
+	xesp->xes_failed = TRUE;
+	return;
+    }
+
+    xi_parse_set_default_rule(parsep, XIA_SAVE_ATTRIB);
+
+    if (xi_parse(parsep) < 0) {
+	xesp->xes_failed = TRUE;
+    } else {
+	xwp = calloc(1, sizeof(*xwp));
+	if (xwp == NULL)
+	    errx(1, "out of memory");
+
+	xwp->xw_events = xesp;
+	xwp->xw_workspace = xwsp;
+	xi_parse_emit(parsep, xidiff_walk_cb, xwp);
+	free(xwp);
+    }
+
+    xi_parse_destroy(parsep);
+}
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Display an event, escaping control characters and trimming it
+ */
+static void
+xidiff_show (const char *who, const char *text)
+{
+    const char *cp;
+    int len = 0;
+
+    printf("    %-8s ", who);
+
+    if (text == NULL) {
+	printf("(end of document)\n");
+	return;
+    }
+
+    for (cp = text; *cp && len < XIDIFF_SHOW; cp++, len++) {
+	if (*cp == '\n')
+	    fputs("\\n", stdout);
+	else if (*cp == '\r')
+	    fputs("\\r", stdout);
+	else if (*cp == '\t')
+	    fputs("\\t", stdout);
+	else
+	    putchar(*cp);
+    }
+
+    printf("%s\n", *cp ? "..." : "");
+}
+
+/*
+ * Parse a file both ways and compare.  Returns TRUE if they agree.
+ */
+static int
+xidiff_file (pa_mmap_t *pmp, xi_workspace_t *xwsp,
+	     const char *filename, const char *label, int report_ok)
+{
+    xidiff_events_t xml_events, xi_events;
+    xidiff_event_t *xep;
+    unsigned i, count;
+    int same = TRUE;
+
+    bzero(&xml_events, sizeof(xml_events));
+    bzero(&xi_events, sizeof(xi_events));
+
+    xidiff_xml_parse(filename, &xml_events);
+    xidiff_xi_parse(pmp, xwsp, filename, &xi_events);
+
+    if (xml_events.xes_failed || xi_events.xes_failed) {
+	if (xml_events.xes_failed && xi_events.xes_failed) {
+	    if (report_ok)
+		printf("%s: ok (rejected by both)\n", label);
+	} else {
+	    printf("%s: divergence: %s\n", label, xml_events.xes_failed
+		   ? "rejected by libxml2 only" : "rejected by xi only");
+	    same = FALSE;
+	}
+	goto done;
+    }
+
+    count = MAX(xml_events.xes_count, xi_events.xes_count);
+    for (i = 0; i < count; i++) {
+	const char *xml_text = (i < xml_events.xes_count)
+	    ? xml_events.xes_events[i].xe_text : NULL;
+	const char *xi_text = (i < xi_events.xes_count)
+	    ? xi_events.xes_events[i].xe_text : NULL;
+
+	if (xml_text && xi_text && streq(xml_text, xi_text))
+	    continue;
+
+	/* Use the libxml2 offset, or its last one if it ran out */
+	xep = (i < xml_events.xes_count) ? &xml_events.xes_events[i]
+	    : &xml_events.xes_events[xml_events.xes_count - 1];
+
+	printf("%s: divergence at byte offset %ld (line %d), event %u\n",
+	       label, xep->xe_offset, xep->xe_line, i + 1);
+	xidiff_show("xi:", xi_text);
+	xidiff_show("libxml2:", xml_text);
+	same = FALSE;
+	break;
+    }
+
+    if (same && report_ok)
+	printf("%s: ok (%u events)\n", label, xml_events.xes_count);
+
+ done:
+    xidiff_events_free(&xml_events);
+    xidiff_events_free(&xi_events);
+
+    return same;
+}
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * The random document generator.  Everything it makes is well-formed
+ * and namespace-well-formed, so any divergence is a parser problem.
+ */
+static const char *xidiff_gen_names[] = {
+    "item", "name", "data", "a", "b-c", "d.e", "_f", "g1",
+    "long-element-name", "Mixed", "caf\xc3\xa9",
+};
+
+static const char *xidiff_gen_prefixes[] = { "p", "q", "ns1", "x" };
+
+static const char *xidiff_gen_uris[] = {
+    "urn:one", "urn:two", "http://example.com/three",
+    "http://example.com/four?a=b",
+};
+
+static const char *xidiff_gen_chunks[] = {
+    "hello", "world", " ", "  ", "\n", "\t", "42", "a b", ">",
+    "&amp;", "&lt;", "&gt;", "&quot;", "&apos;", "&#65;", "&#x42;",
+    "&#233;", "&#x263A;", "\xc3\xa9t\xc3\xa9", "\xe2\x98\x83", "]",
+    "\"", "'", "x=y", "/", "?", "-", "%",
+};
+
+#define GEN_NUM(_x) (sizeof(_x) / sizeof(_x[0]))
+#define GEN_PREFIXES GEN_NUM(xidiff_gen_prefixes)
+
+typedef struct xidiff_gen_s {
+    xidiff_buf_t xg_buf;	/* Document being built */
+    size_t xg_budget;		/* Rough target size */
+    unsigned xg_inscope;	/* Bitmask of declared prefixes */
+} xidiff_gen_t;
+
+/*
+ * Generate some text.  Quote characters are escaped when they would
+ * end an attribute value; "<" and "&" only appear as references.
+ */
+static void
+xidiff_gen_text (xidiff_gen_t *xgp, char quote, unsigned max_chunks)
+{
+    unsigned i, count = 1 + xidiff_range(max_chunks);
+    const char *cp;
+
+    for (i = 0; i < count; i++) {
+	cp = xidiff_gen_chunks[xidiff_range(GEN_NUM(xidiff_gen_chunks))];
+
+	if (quote && *cp == quote)
+	    cp = (quote == '"') ? "&quot;" : "&apos;";
+	else if (!quote && *cp == ']')
+	    cp = "]x";	/* Don't make "]]>" by accident */
+
+	xidiff_buf_puts(&xgp->xg_buf, cp);
+    }
+}
+
+static void
+xidiff_gen_misc (xidiff_gen_t *xgp)
+{
+    if (xidiff_chance(50)) {
+	xidiff_buf_puts(&xgp->xg_buf, "<!-- ");
+	xidiff_buf_puts(&xgp->xg_buf, xidiff_chance(50)
+			? "a comment <with> & markup" : "x");
+	xidiff_buf_puts(&xgp->xg_buf, " -->");
+    } else {
+	xidiff_buf_puts(&xgp->xg_buf, "<?target ");
+	xidiff_buf_puts(&xgp->xg_buf, xidiff_chance(50)
+			? "data='1' <x>" : "y");
+	xidiff_buf_puts(&xgp->xg_buf, "?>");
+    }
+}
+
+static void
+xidiff_gen_cdata (xidiff_gen_t *xgp)
+{
+    static const char *cdata[] = {
+	"<tag attr='1'>", "a & b", "]]", "] ]>", "\n  ", "x", "<![CDATA[",
+    };
+    unsigned i, count = 1 + xidiff_range(3);
+
+    xidiff_buf_puts(&xgp->xg_buf, "<![CDATA[");
+    for (i = 0; i < count; i++)
+	xidiff_buf_puts(&xgp->xg_buf, cdata[xidiff_range(GEN_NUM(cdata))]);
+    xidiff_buf_puts(&xgp->xg_buf, "]]>");
+}
+
+static void
+xidiff_gen_element (xidiff_gen_t *xgp, unsigned depth)
+{
+    xidiff_buf_t *bp = &xgp->xg_buf;
+    unsigned saved_inscope = xgp->xg_inscope;
+    const char *name = xidiff_gen_names[xidiff_range(GEN_NUM(xidiff_gen_names))];
+    const char *prefix = NULL;
+    unsigned i, count, used = 0;
+    char quote;
+
+    /* Namespace declarations come first, so we can use them */
+    xidiff_buf_t decls;
+    bzero(&decls, sizeof(decls));
+
+    if (xidiff_chance(20)) {
+	if (xidiff_chance(20))
+	    xidiff_buf_puts(&decls, " xmlns=\"\"");
+	else
+	    xidiff_buf_printf(&decls, " xmlns='%s'",
+		      xidiff_gen_uris[xidiff_range(GEN_NUM(xidiff_gen_uris))]);
+    }
+
+    count = xidiff_range(3);
+    for (i = 0; i < count; i++) {
+	unsigned pi = xidiff_range(GEN_PREFIXES);
+	if (used & (1 << pi))
+	    continue;
+	used |= 1 << pi;
+	xgp->xg_inscope |= 1 << pi;
+	xidiff_buf_printf(&decls, " xmlns:%s=\"%s\"", xidiff_gen_prefixes[pi],
+		      xidiff_gen_uris[xidiff_range(GEN_NUM(xidiff_gen_uris))]);
+    }
+
+    /* Pick an in-scope prefix for the element, sometimes */
+    if (xgp->xg_inscope && xidiff_chance(40)) {
+	unsigned pi;
+	do {
+	    pi = xidiff_range(GEN_PREFIXES);
+	} while (!(xgp->xg_inscope & (1 << pi)));
+	prefix = xidiff_gen_prefixes[pi];
+    }
+
+    xidiff_buf_printf(bp, "<%s%s%s", prefix ?: "", prefix ? ":" : "", name);
+
+    /* Declarations either before or after the attributes */
+    int decls_first = xidiff_chance(50);
+    if (decls_first && decls.xb_len)
+	xidiff_buf_puts(bp, decls.xb_data);
+
+    /*
+     * Attributes need unique expanded names; using distinct local
+     * names (and each prefix at most once) is the easy way.
+     */
+    count = xidiff_range(4);
+    for (i = 0; i < count; i++) {
+	const char *aprefix = NULL;
+
+	if (xgp->xg_inscope && xidiff_chance(30)) {
+	    unsigned pi = xidiff_range(GEN_PREFIXES);
+	    if (xgp->xg_inscope & (1 << pi))
+		aprefix = xidiff_gen_prefixes[pi];
+	}
+
+	quote = xidiff_chance(50) ? '"' : '\'';
+	xidiff_buf_printf(bp, "%s%s%s%sattr%u%s=%s%c",
+			  xidiff_chance(10) ? "\n    " : " ",
+			  aprefix ?: "", aprefix ? ":" : "",
+			  aprefix ? "p" : "", i,
+			  xidiff_chance(10) ? " " : "",
+			  xidiff_chance(10) ? " " : "", quote);
+	xidiff_gen_text(xgp, quote, 4);
+	xidiff_buf_append(bp, &quote, 1);
+    }
+
+    if (!decls_first && decls.xb_len)
+	xidiff_buf_puts(bp, decls.xb_data);
+    xidiff_buf_free(&decls);
+
+    if (xidiff_chance(10))
+	xidiff_buf_puts(bp, " ");
+
+    /* Maybe an empty element, in either form */
+    if (depth > 12 || bp->xb_len > xgp->xg_budget || xidiff_chance(15)) {
+	if (xidiff_chance(50))
+	    xidiff_buf_puts(bp, "/>");
+	else
+	    xidiff_buf_printf(bp, "></%s%s%s>",
+			      prefix ?: "", prefix ? ":" : "", name);
+	xgp->xg_inscope = saved_inscope;
+	return;
+    }
+
+    xidiff_buf_puts(bp, ">");
+
+    count = 1 + xidiff_range(depth < 2 ? 12 : 6);
+    for (i = 0; i < count && bp->xb_len < xgp->xg_budget; i++) {
+	unsigned kind = xidiff_range(100);
+
+	if (kind < 40)
+	    xidiff_gen_element(xgp, depth + 1);
+	else if (kind < 70)
+	    xidiff_gen_text(xgp, 0, 6);
+	else if (kind < 80)
+	    xidiff_buf_printf(bp, "\n%*s", (int) (depth + 1) * 2, "");
+	else if (kind < 90)
+	    xidiff_gen_cdata(xgp);
+	else
+	    xidiff_gen_misc(xgp);
+    }
+
+    xidiff_buf_printf(bp, "</%s%s%s>", prefix ?: "", prefix ? ":" : "", name);
+    xgp->xg_inscope = saved_inscope;
+}
+
+static void
+xidiff_gen_document (xidiff_gen_t *xgp, size_t budget)
+{
+    xidiff_buf_reset(&xgp->xg_buf);
+    xgp->xg_budget = budget;
+    xgp->xg_inscope = 0;
+
+    if (xidiff_chance(50))
+	xidiff_buf_puts(&xgp->xg_buf, "<?xml version=\"1.0\"?>\n");
+    if (xidiff_chance(20))
+	xidiff_gen_misc(xgp);
+
+    xidiff_gen_element(xgp, 0);
+
+    if (xidiff_chance(20))
+	xidiff_gen_misc(xgp);
+    xidiff_buf_puts(&xgp->xg_buf, "\n");
+}
+
+static int
+xidiff_write (const char *filename, xidiff_buf_t *bp)
+{
+    FILE *fp = fopen(filename, "w");
+
+    if (fp == NULL) {
+	warn("could not open '%s'", filename);
+	return -1;
+    }
+
+    fwrite(bp->xb_data, 1, bp->xb_len, fp);
+    fclose(fp);
+    return 0;
+}
+
+static unsigned
+xidiff_random (pa_mmap_t *pmp, xi_workspace_t *xwsp, unsigned count,
+	       size_t max_size, const char *save_dir)
+{
+    xidiff_gen_t gen;
+    unsigned i, failures = 0;
+    unsigned long bytes = 0;
+    char label[64], path[BUFSIZ];
+
+    bzero(&gen, sizeof(gen));
+
+    for (i = 1; i <= count; i++) {
+	xidiff_gen_document(&gen, 64 + xidiff_range(max_size));
+	bytes += gen.xg_buf.xb_len;
+
+	if (xidiff_write(XIDIFF_WORK, &gen.xg_buf) < 0)
+	    break;
+
+	snprintf(label, sizeof(label), "random-%04u", i);
+	if (xidiff_file(pmp, xwsp, XIDIFF_WORK, label, opt_verbose))
+	    continue;
+
+	failures += 1;
+	if (save_dir) {
+	    snprintf(path, sizeof(path), "%s/%s.xml", save_dir, label);
+	    if (xidiff_write(path, &gen.xg_buf) == 0)
+		printf("    saved as %s\n", path);
+	}
+    }
+
+    unlink(XIDIFF_WORK);
+    xidiff_buf_free(&gen.xg_buf);
+
+    printf("random: %u documents, %lu bytes, %u divergences\n",
+	   count, bytes, failures);
+
+    return failures;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static void
+print_help (void)
+{
+    fprintf(stderr,
+"Usage: xidiff [options] [file ...]\n"
+"\t--help OR -h: display this help message\n"
+"\t--ignore-ws OR -w: discard whitespace-only text (but not CDATA)\n"
+"\t--max-size <bytes>: rough size limit for random documents\n"
+"\t--random <count> OR -r <count>: test <count> generated documents\n"
+"\t--save <dir>: save divergent random documents in <dir>\n"
+"\t--seed <number>: seed for the random document generator\n"
+"\t--verbose OR -v: report every document, and libxml2 errors\n"
+"\n"
+"Random documents are written to \"" XIDIFF_WORK "\" in the current\n"
+"directory while they are being tested.\n"
+"\n");
+}
+
+static char *
+check_arg (const char *name, char ***argvp)
+{
+    char *opt, *arg;
+
+    opt = **argvp;
+    *argvp += 1;
+    arg = **argvp;
+
+    if (arg == NULL)
+	errx(1, "missing %s argument for '%s' option", name, opt);
+
+    return arg;
+}
+
+int
+main (int argc UNUSED, char **argv)
+{
+    const char *cp, *save_dir = NULL;
+    unsigned random_count = 0, failures = 0;
+    size_t max_size = 8192;
+    uint32_t seed = 1;
+
+    for (argv++; *argv; argv++) {
+	cp = *argv;
+
+	if (*cp != '-')
+	    break;
+
+	if (streq(cp, "--help") || streq(cp, "-h")) {
+	    print_help();
+	    return -1;
+
+	} else if (streq(cp, "--ignore-ws") || streq(cp, "-w")) {
+	    opt_ignore_ws = TRUE;
+
+	} else if (streq(cp, "--max-size")) {
+	    max_size = strtoul(check_arg("size", &argv), NULL, 0);
+
+	} else if (streq(cp, "--random") || streq(cp, "-r")) {
+	    random_count = strtoul(check_arg("count", &argv), NULL, 0);
+
+	} else if (streq(cp, "--save")) {
+	    save_dir = check_arg("directory", &argv);
+
+	} else if (streq(cp, "--seed")) {
+	    seed = strtoul(check_arg("seed", &argv), NULL, 0);
+
+	} else if (streq(cp, "--verbose") || streq(cp, "-v")) {
+	    opt_verbose = TRUE;
+
+	} else {
+	    fprintf(stderr, "invalid option: %s\n", cp);
+	    print_help();
+	    return -1;
+	}
+    }
+
+    if (*argv == NULL && random_count == 0) {
+	print_help();
+	return -1;
+    }
+
+    xidiff_seed = seed ?: 1;	/* xorshift needs a non-zero seed */
+
+    LIBXML_TEST_VERSION;
+
+    pa_mmap_t *pmp = pa_mmap_open(NULL, XIDIFF_NAME, 0, 0644);
+    if (pmp == NULL)
+	err(1, "could not open workspace");
+
+    xi_workspace_t *xwsp = xi_workspace_open(pmp, XIDIFF_NAME);
+    if (xwsp == NULL)
+	errx(1, "could not create workspace");
+
+    for ( ; *argv; argv++)
+	if (!xidiff_file(pmp, xwsp, *argv, *argv, TRUE))
+	    failures += 1;
+
+    if (random_count)
+	failures += xidiff_random(pmp, xwsp, random_count, max_size, save_dir);
+
+    pa_mmap_close(pmp);
+    xmlCleanupParser();
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,487 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * xiproc -- a command line interface to libxi, for parsing XML into
+ * a workspace, selecting and counting elements, and re-emitting XML.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <string.h>
+#include <err.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <libpsu/psucommon.h>
+#include <libpsu/psulog.h>
+#include <libslax/slaxversion.h>
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paarb.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/papat.h>
+#include <parrotdb/pabitmap.h>
+#include <libxi/xicommon.h>
+#include <libxi/xisource.h>
+#include <libxi/xirules.h>
+#include <libxi/xitree.h>
+#include <libxi/xiworkspace.h>
+#include <libxi/xiparse.h>
+#include <libxi/xinodeset.h>
+
+#define XIPROC_NAME	"xiproc" /* Default document (tree) name */
+#define XIPROC_PATH_MAX	XI_DEPTH_MAX /* Max steps in a --select path */
+
+/*
+ * A step in a --select path.  We only handle names, since the point
+ * is speed: "a/b/c" from the top, "//c" for anywhere, and "*" for
+ * any name.
+ */
+typedef struct xiproc_step_s {
+    pa_atom_t xps_name;		/* Name atom to match */
+    unsigned xps_flags;		/* Flags (XIPROC_STEP_*) */
+} xiproc_step_t;
+
+/* Flags for xps_flags */
+#define XIPROC_STEP_ANY		(1<<0) /* Match any name ("*") */
+#define XIPROC_STEP_DESCENDANT	(1<<1) /* Preceded by "//" */
+
+typedef struct xiproc_select_s {
+    xi_workspace_t *xs_workspace; /* Workspace we're searching */
+    xi_nodeset_t *xs_nodeset;	/* Matching nodes */
+    unsigned xs_num_steps;	/* Number of steps in xs_steps */
+    xiproc_step_t xs_steps[XIPROC_PATH_MAX]; /* Steps of the path */
+    pa_atom_t xs_stack[XI_DEPTH_MAX + 1]; /* Names of open elements */
+    unsigned long xs_elements;	/* Number of elements seen */
+    unsigned long xs_nodes;	/* Number of nodes seen */
+} xiproc_select_t;
+
+typedef struct xiproc_emit_s {
+    xi_parse_t *xe_parse;	/* Parser (and tree) */
+    FILE *xe_out;		/* Output file */
+    unsigned xe_indent;		/* Indent for emitting XML */
+} xiproc_emit_t;
+
+static int opt_count;
+static int opt_indent;
+static int opt_quiet;
+static int opt_stats;
+static int opt_intern;
+
+/*
+ * Turn the path into a set of steps.  Returns the number of steps,
+ * or -1 when a name can't match anything (it's not in the namepool).
+ */
+static int
+xiproc_select_compile (xiproc_select_t *xsp, const char *path)
+{
+    char *copy = strdup(path), *cp, *sp;
+    unsigned flags = 0;
+    int rc = 0;
+
+    if (copy == NULL)
+	errx(1, "out of memory");
+
+    for (cp = copy; cp; cp = sp) {
+	sp = strchr(cp, '/');
+	if (sp)
+	    *sp++ = '\0';
+
+	if (*cp == '\0') {
+	    /* Leading "/" means from the top; "//" means anywhere below */
+	    if (cp != copy)
+		flags |= XIPROC_STEP_DESCENDANT;
+	    continue;
+	}
+
+	if (xsp->xs_num_steps >= XIPROC_PATH_MAX)
+	    errx(1, "select path has too many steps: '%s'", path);
+
+	xiproc_step_t *stepp = &xsp->xs_steps[xsp->xs_num_steps++];
+	stepp->xps_flags = flags;
+	flags = 0;
+
+	if (streq(cp, "*")) {
+	    stepp->xps_flags |= XIPROC_STEP_ANY;
+	} else {
+	    stepp->xps_name = xi_namepool_atom(xsp->xs_workspace, cp, FALSE);
+	    if (stepp->xps_name == PA_NULL_ATOM)
+		rc = -1;	/* Never seen, so can't match */
+	}
+    }
+
+    free(copy);
+
+    if (xsp->xs_num_steps == 0)
+	errx(1, "empty select path: '%s'", path);
+
+    return (rc < 0) ? rc : (int) xsp->xs_num_steps;
+}
+
+/*
+ * Does the path (starting at step "si") match the stack of open
+ * elements (starting at depth "di")?
+ */
+static int
+xiproc_select_match (xiproc_select_t *xsp, unsigned si,
+		     unsigned di, unsigned depth)
+{
+    xiproc_step_t *stepp;
+    unsigned k;
+
+    if (si == xsp->xs_num_steps)
+	return (di == depth + 1);
+    if (di > depth)
+	return FALSE;
+
+    stepp = &xsp->xs_steps[si];
+
+#define STEP_MATCHES(_d) ((stepp->xps_flags & XIPROC_STEP_ANY) \
+			  || stepp->xps_name == xsp->xs_stack[_d])
+
+    if (!(stepp->xps_flags & XIPROC_STEP_DESCENDANT))
+	return STEP_MATCHES(di) && xiproc_select_match(xsp, si + 1, di + 1,
+						       depth);
+
+    for (k = di; k <= depth; k++)
+	if (STEP_MATCHES(k) && xiproc_select_match(xsp, si + 1, k + 1, depth))
+	    return TRUE;
+
+#undef STEP_MATCHES
+
+    return FALSE;
+}
+
+static int
+xiproc_select_cb (xi_parse_t *parsep UNUSED, xi_node_type_t type,
+		  pa_atom_t node_atom, xi_node_t *nodep,
+		  const char *data UNUSED, void *opaque)
+{
+    xiproc_select_t *xsp = opaque;
+    unsigned depth;
+
+    if (nodep == NULL || type == XI_TYPE_CLOSE
+	|| type == XI_TYPE_EOL_ATTRIB || type == XI_TYPE_EOL_EMPTY)
+	return 0;
+
+    xsp->xs_nodes += 1;
+    if (type != XI_TYPE_OPEN)
+	return 0;
+
+    xsp->xs_elements += 1;
+    depth = nodep->xn_depth;
+    if (depth > XI_DEPTH_MAX)
+	return 0;		/* Should not occur */
+
+    xsp->xs_stack[depth] = nodep->xn_name;
+
+    if (xsp->xs_nodeset && xiproc_select_match(xsp, 0, XI_DEPTH_MIN, depth))
+	xi_nodeset_add(xsp->xs_nodeset, node_atom);
+
+    return 0;
+}
+
+static int
+xiproc_emit_cb (xi_nodeset_t *nodeset UNUSED, pa_atom_t node_atom,
+		void *opaque)
+{
+    xiproc_emit_t *xep = opaque;
+
+    xi_parse_emit_xml_node(xep->xe_parse, node_atom,
+			   xep->xe_out, xep->xe_indent);
+    return 0;
+}
+
+/*
+ * Load a rulebook, which is an XML file describing states and rules
+ * (see tests/xi/xi02.conf).  We parse it into the same workspace as
+ * our document, since the rules refer to names by their atoms.
+ */
+static xi_rulebook_t *
+xiproc_rules_load (pa_mmap_t *pmp, xi_workspace_t *xwp,
+		   const char *name, const char *filename)
+{
+    char namebuf[PA_MMAP_HEADER_NAME_LEN];
+    xi_parse_t *rulesp;
+    xi_rulebook_t *xrbp;
+
+    pa_config_name(namebuf, sizeof(namebuf), name, "rules");
+
+    rulesp = xi_parse_open(pmp, xwp, namebuf, filename, XPSF_IGNORE_WS);
+    if (rulesp == NULL)
+	err(1, "could not open rules file: '%s'", filename);
+
+    xi_parse_set_default_rule(rulesp, XIA_SAVE_ATTRIB);
+
+    if (xi_parse(rulesp) < 0)
+	errx(1, "could not parse rules file: '%s'", filename);
+
+    xrbp = xi_rulebook_prep(rulesp, namebuf);
+    if (xrbp == NULL)
+	errx(1, "could not build rulebook: '%s'", filename);
+
+    return xrbp;
+}
+
+static void
+print_version (void)
+{
+    printf("libslax version %s%s\n",  LIBSLAX_VERSION, LIBSLAX_VERSION_EXTRA);
+}
+
+static void
+print_help (void)
+{
+    fprintf(stderr,
+"Usage: xiproc [options] [file]\n"
+"\t--compress OR -z: keep the --database file compressed\n"
+"\t--count OR -c: count matching elements (or all elements) and exit\n"
+"\t--database <file> OR -D <file>: keep the workspace in the given file\n"
+"\t--help OR -h: display this help message\n"
+"\t--ignore-ws OR -w: discard whitespace-only text\n"
+"\t--indent OR -g: indent the output XML\n"
+"\t--input <file> OR -i <file>: take input from the given file\n"
+"\t--intern-text: share storage for repeated short text values\n"
+"\t--name <name> OR -n <name>: name of the document in the workspace\n"
+"\t--output <file> OR -o <file>: make output into the given file\n"
+"\t--quiet OR -q: parse only; do not emit XML\n"
+"\t--rules <file> OR -r <file>: parse using the given rulebook\n"
+"\t--select <path> OR -s <path>: select elements by name path (a/b, //b)\n"
+"\t--stats: report parse time, throughput, and text sharing on stderr\n"
+"\t--verbose OR -v: enable debugging output (slaxLog())\n"
+"\t--version OR -V: show version information (and exit)\n"
+"\nProject libslax home page: https://github.com/Juniper/libslax\n"
+"\n");
+}
+
+static char *
+check_arg (const char *name, char ***argvp)
+{
+    char *opt, *arg;
+
+    opt = **argvp;
+    *argvp += 1;
+    arg = **argvp;
+
+    if (arg == NULL)
+	errx(1, "missing %s argument for '%s' option", name, opt);
+
+    return arg;
+}
+
+int
+main (int argc UNUSED, char **argv)
+{
+    const char *cp;
+    const char *input = NULL, *output = NULL, *database = NULL;
+    const char *rules = NULL, *select = NULL, *name = XIPROC_NAME;
+    xi_source_flags_t flags = 0;
+    pa_mmap_flags_t mflags = 0;
+    struct timeval start, end;
+    struct stat st;
+    FILE *out = stdout;
+    int rc;
+
+    for (argv++; *argv; argv++) {
+	cp = *argv;
+
+	if (*cp != '-' || streq(cp, "-"))
+	    break;
+
+	if (streq(cp, "--compress") || streq(cp, "-z")) {
+	    mflags |= PMF_COMPRESSED;
+
+	} else if (streq(cp, "--count") || streq(cp, "-c")) {
+	    opt_count = TRUE;
+
+	} else if (streq(cp, "--database") || streq(cp, "-D")) {
+	    database = check_arg("database file", &argv);
+
+	} else if (streq(cp, "--help") || streq(cp, "-h")) {
+	    print_help();
+	    return -1;
+
+	} else if (streq(cp, "--ignore-ws") || streq(cp, "-w")) {
+	    flags |= XPSF_IGNORE_WS;
+
+	} else if (streq(cp, "--indent") || streq(cp, "-g")) {
+	    opt_indent = TRUE;
+
+	} else if (streq(cp, "--input") || streq(cp, "-i")) {
+	    input = check_arg("input file", &argv);
+
+	} else if (streq(cp, "--intern-text")) {
+	    opt_intern = TRUE;
+
+	} else if (streq(cp, "--name") || streq(cp, "-n")) {
+	    name = check_arg("document name", &argv);
+
+	} else if (streq(cp, "--output") || streq(cp, "-o")) {
+	    output = check_arg("output file", &argv);
+
+	} else if (streq(cp, "--quiet") || streq(cp, "-q")) {
+	    opt_quiet = TRUE;
+
+	} else if (streq(cp, "--rules") || streq(cp, "-r")) {
+	    rules = check_arg("rules file", &argv);
+
+	} else if (streq(cp, "--select") || streq(cp, "-s")) {
+	    select = check_arg("select path", &argv);
+
+	} else if (streq(cp, "--stats")) {
+	    opt_stats = TRUE;
+
+	} else if (streq(cp, "--verbose") || streq(cp, "-v")) {
+	    psu_log_enable(TRUE);
+
+	} else if (streq(cp, "--version") || streq(cp, "-V")) {
+	    print_version();
+	    exit(0);
+
+	} else {
+	    fprintf(stderr, "invalid option: %s\n", cp);
+	    print_help();
+	    return -1;
+	}
+    }
+
+    if (*argv) {
+	if (input)
+	    errx(1, "input file given twice");
+	input = *argv++;
+    }
+
+    if (*argv)
+	errx(1, "extra arguments: '%s'", *argv);
+
+    /*
+     * Without a database, there's no previous parse to reuse, so
+     * we read standard input.
+     */
+    if (input == NULL && database == NULL)
+	input = "-";
+
+    pa_mmap_t *pmp = pa_mmap_open(database, XIPROC_NAME, mflags, 0644);
+    if (pmp == NULL)
+	err(1, "could not open workspace: '%s'", database ?: "(memory)");
+
+    xi_workspace_t *xwp = xi_workspace_open(pmp, XIPROC_NAME);
+    if (xwp == NULL)
+	errx(1, "could not create workspace");
+
+    if (opt_intern)
+	xi_workspace_set_flags(xwp, XWF_INTERN_TEXT);
+
+    xi_parse_t *parsep = xi_parse_open(pmp, xwp, name, input, flags);
+    if (parsep == NULL)
+	err(1, "could not open input: '%s'", input ?: "-");
+
+    /* Keep attributes unless a rule says otherwise */
+    xi_parse_set_default_rule(parsep, XIA_SAVE_ATTRIB);
+
+    if (rules)
+	xi_parse_set_rulebook(parsep, xiproc_rules_load(pmp, xwp, name, rules));
+
+    gettimeofday(&start, NULL);
+    rc = xi_parse(parsep);
+    gettimeofday(&end, NULL);
+
+    if (rc < 0)
+	errx(1, "parse failed: '%s'", input);
+
+    if (input == NULL) {
+	xi_node_t *rootp = xi_node_addr(xwp, parsep->xp_insert->xi_tree->xt_root);
+	if (rootp == NULL || rootp->xn_contents == PA_NULL_ATOM)
+	    errx(1, "no document named '%s' in database '%s'", name, database);
+    }
+
+    /*
+     * Walk the tree once, counting nodes and finding matches.  The
+     * walk is only needed for --select, --count, and --stats.
+     */
+    xiproc_select_t *xsp = calloc(1, sizeof(*xsp));
+    if (xsp == NULL)
+	errx(1, "out of memory");
+    xsp->xs_workspace = xwp;
+
+    if (select && xiproc_select_compile(xsp, select) > 0) {
+	xsp->xs_nodeset = xi_nodeset_alloc(xwp, XI_NSTYPE_NORMAL, 0);
+	if (xsp->xs_nodeset == NULL)
+	    errx(1, "could not allocate nodeset");
+    }
+
+    if (select || opt_count || opt_stats)
+	xi_parse_emit(parsep, xiproc_select_cb, xsp);
+
+    if (output && !streq(output, "-")) {
+	out = fopen(output, "w");
+	if (out == NULL)
+	    err(1, "could not open output file: '%s'", output);
+    }
+
+    if (opt_count) {
+	fprintf(out, "%lu\n", select ? (unsigned long)
+		xi_nodeset_count(xsp->xs_nodeset) : xsp->xs_elements);
+
+    } else if (opt_quiet) {
+	/* Nothing to see here */
+
+    } else if (select) {
+	xiproc_emit_t emit = { parsep, out, opt_indent ? 3 : 0 };
+	xi_nodeset_foreach(xsp->xs_nodeset, xiproc_emit_cb, &emit);
+
+    } else {
+	xi_parse_emit_xml_node(parsep, parsep->xp_insert->xi_tree->xt_root,
+			       out, opt_indent ? 3 : 0);
+    }
+
+    if (opt_stats) {
+	double secs = (end.tv_sec - start.tv_sec)
+	    + (end.tv_usec - start.tv_usec) / 1000000.0;
+	off_t bytes = 0;
+
+	if (input && !streq(input, "-") && stat(input, &st) == 0)
+	    bytes = st.st_size;
+
+	fprintf(stderr, "parse-ms %lu\n", (unsigned long) (secs * 1000));
+	fprintf(stderr, "bytes %lu\n", (unsigned long) bytes);
+	fprintf(stderr, "mb-per-sec %.1f\n",
+		(secs > 0) ? bytes / secs / (1024 * 1024) : 0.0);
+	fprintf(stderr, "elements %lu\n", xsp->xs_elements);
+	fprintf(stderr, "nodes %lu\n", xsp->xs_nodes);
+	fprintf(stderr, "max-depth %u\n",
+		parsep->xp_insert->xi_tree->xt_max_depth);
+
+	xi_textpool_stats_t xts;
+	unsigned long atoms;
+
+	xi_textpool_stats(xwp, &xts);
+	atoms = xts.xts_values - xts.xts_shared;
+	fprintf(stderr, "text-values %lu\n", xts.xts_values);
+	fprintf(stderr, "text-shared %lu\n", xts.xts_shared);
+	fprintf(stderr, "text-bytes %lu\n", xts.xts_bytes);
+	fprintf(stderr, "text-bytes-saved %lu\n", xts.xts_bytes_saved);
+	fprintf(stderr, "text-dedup-ratio %.2f\n",
+		atoms ? (double) xts.xts_values / atoms : 1.0);
+    }
+
+    if (out != stdout)
+	fclose(out);
+
+    xi_nodeset_free(xsp->xs_nodeset);
+    free(xsp);
+    xi_parse_destroy(parsep);
+    pa_mmap_close(pmp);
+
+    return 0;
+}